@@ -0,0 +1,1334 @@
+#include "App.hpp"
+#include "Assets.hpp"
+#include "DocumentFile.hpp"
+#include "Exporter.hpp"
+#include "RenderStats.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+namespace {
+    // Zoom range in screen pixels per document unit.
+    const float minZoom=1.f/256.f;
+    const float maxZoom=32.f;
+    // Output pixels per document unit for Ctrl+E.
+    const float exportScale=4.f;
+    // Character sizes Up/Down step through while typing.
+    const unsigned minTextSize=8, maxTextSize=256;
+    // Live items are never flattened below this many, whatever the budget.
+    const std::size_t minLiveItems=256;
+    // How often a running compaction or export is checked on while idle.
+    const sf::Time compactionPoll=sf::milliseconds(100);
+    // Freehand strokes thin by up to this fraction of the brush as the
+    // pointer reaches thinningSpeed screen pixels per second, and ease
+    // towards that width over roughly inkEasing seconds.
+    const float maxThinning=0.45f;
+    const float thinningSpeed=2500.f;
+    const float inkEasing=0.06f;
+    // Selection handles in screen pixels: how big they are and how far above
+    // the selection the rotation one sits. Shift snaps rotation to steps of
+    // rotateSnap degrees.
+    const float handleSize=8.f, rotateOffset=24.f, rotateSnap=15.f;
+    // Smallest factor a drag can scale a selection by, so it stays invertible.
+    const float minScale=0.01f;
+    // The eraser is as wide as the brush, and no smaller than this many
+    // screen pixels across its radius.
+    const float minEraser=8.f;
+    const float pi=3.14159265f;
+
+    float limitScale(float factor) {
+        if(std::fabs(factor)>=minScale) return factor;
+        return factor<0.f?-minScale:minScale;
+    }
+
+    bool nearHandle(const sf::Vector2f& a, const sf::Vector2f& b, float reach) {
+        return std::fabs(a.x-b.x)<=reach && std::fabs(a.y-b.y)<=reach;
+    }
+
+    // Keys a viewer still has: they only move the camera, export, or show
+    // profiling. Everything else would draw on the shared drawing.
+    bool viewerKey(sf::Keyboard::Key code) {
+        return code==sf::Keyboard::Home||code==sf::Keyboard::E||code==sf::Keyboard::F3||code==sf::Keyboard::F4;
+    }
+}
+
+App::App()
+    : textCursor(false), redraw(true), caretDrawn(false),
+      bgc(62,63,63), brush(211,211,211), thick(5.f), fillTolerance(24),
+      bgColors{
+          sf::Color(62,63,63),sf::Color(255,200,200),sf::Color(200,255,200),
+          sf::Color(200,220,255),sf::Color(255,255,200),sf::Color(220,200,255),
+          sf::Color(255,220,200)
+      },
+      bgIndex(0), generation(0), memoryBudget(256u<<20), checkedSize(0),
+      sharedSamples(0), resync(false), viewing(false), following(true),
+      isDrawing(false), showPicker(false), isRect(false), isCircle(false),
+      isTyping(false), isTri(false), isPanning(false), rainbowModeActive(false), rainbowHue(0.f),
+      triClicks(0), inkWidth(0.f), inkTime(0.f), tailPredicted(false), textSize(21), mode(DrawingMode::FreeDraw),
+      drag(Drag::None), shiftHeld(false), isErasing(false), erased(false), stepArea(0.f,0.f,-1.f,-1.f)
+{
+#ifdef DIBUJO_PROFILE
+    showHud=false;
+#endif
+}
+
+bool App::init(const sf::Vector2u& windowSize) {
+    size=windowSize;
+    camera=sf::View(sf::FloatRect(0.f,0.f,(float)size.x,(float)size.y));
+
+    if(!Assets::loadFont(font)){
+        std::cerr<<"Failed to load font.\n";
+        return false;
+    }
+
+    doc.setFont(font);
+    if(!canvas.create(size.x,size.y)){
+        std::cerr<<"Failed to create canvas.\n";
+        return false;
+    }
+
+#ifdef DIBUJO_PROFILE
+    hud.setFont(font);
+#endif
+
+    if(!toolbar.load()){
+        std::cerr<<"Failed to create toolbar.\n";
+        return false;
+    }
+    bgBtn=sf::FloatRect(10.f,10.f,100.f,30.f);
+    toolbar.add(AssetBundle::White,bgBtn,sf::Color(150,150,150));
+    sf::Vector2f label=toolbar.bakeLabel(font,"BG color",21);
+    toolbar.add(AssetBundle::Label,sf::FloatRect(std::round(bgBtn.left+(bgBtn.width-label.x)/2.f),
+                                                 std::round(bgBtn.top+(bgBtn.height-label.y)/2.f),
+                                                 label.x,label.y),sf::Color::Black);
+
+    struct { sf::FloatRect* btn; AssetBundle::Sprite sprite; float x; } buttons[]={
+        {&squaresBtn,AssetBundle::Squares,250.f},{&drawBtn,AssetBundle::Draw,330.f},
+        {&circleBtn,AssetBundle::Circle,410.f},{&textBtn,AssetBundle::Text,490.f},
+        {&triBtn,AssetBundle::Triangle,570.f},{&rainbowModeBtn,AssetBundle::Rainbow,650.f},
+        {&bucketBtn,AssetBundle::Bucket,730.f}
+    };
+    for(auto& b:buttons){
+        *b.btn=sf::FloatRect(b.x,10.f,70.f,30.f);
+        toolbar.add(b.sprite,*b.btn);
+    }
+    const sf::IntRect& wheel=AssetBundle::sprites[AssetBundle::ColorWheel];
+    colorWheel=sf::FloatRect(1024.f-wheel.width-10.f,10.f,(float)wheel.width,(float)wheel.height);
+    toolbar.add(AssetBundle::ColorWheel,colorWheel);
+
+    colorPick.setSize(150);
+    colorPick.setPosition(10.f,50.f);
+    return true;
+}
+
+bool App::open(const std::string& file) {
+    close();
+    std::string error;
+    std::uint32_t loaded=0;
+    std::ifstream probe(file,std::ios::binary);
+    if(probe && !DocumentFile::load(doc,file,loaded,error)){
+        std::cerr<<"Failed to open "<<file<<": "<<error<<"\n";
+        return false;
+    }
+    probe.close();
+
+    // A journal from the same generation holds edits made after the last
+    // full save that never reached it. Folding them in with a save right
+    // away means the journal below can start empty.
+    std::string journal=file+".journal";
+    long replayed=DocumentFile::replayFile(doc,journal,loaded);
+    if(replayed>0){
+        std::cerr<<"Recovered "<<replayed<<" unsaved edits.\n";
+        if(!DocumentFile::save(doc,file,++loaded,error)){
+            std::cerr<<error<<"\n";
+            return false;
+        }
+    }
+    if(!autosave.start(journal,loaded)){
+        std::cerr<<"Failed to create "<<journal<<"\n";
+        return false;
+    }
+
+    path=file;
+    generation=loaded;
+    if(doc.getBackground().a==0) doc.setBackground(bgc);
+    else bgc=doc.getBackground();
+    changes.clear();
+    doc.setChangeLog(&changes);
+    canvas.invalidateAll();
+    redraw=true;
+    return true;
+}
+
+void App::close() {
+    server.stop();
+    client.disconnect();
+    exported(true);
+    if(!autosave.isRunning()) return;
+    autosave.push(changes);
+    autosave.stop();
+    doc.setChangeLog(nullptr);
+
+    // The journal goes only once the file that replaces it is on disk.
+    std::string error;
+    if(DocumentFile::save(doc,path,generation+1,error)) std::remove((path+".journal").c_str());
+    else std::cerr<<error<<"\n";
+}
+
+bool App::share(unsigned short port, std::function<void()> wake) {
+    if(viewing || !server.start(port,std::move(wake))){
+        std::cerr<<"Failed to share on port "<<port<<"\n";
+        return false;
+    }
+    doc.setChangeLog(&changes);
+    sharedSamples=0;
+    sharedSize=sf::Vector2f();
+    resync=false;
+    std::cout<<"Sharing on port "<<server.getPort()<<"\n";
+    return true;
+}
+
+unsigned short App::getSharePort() const {
+    return server.getPort();
+}
+
+std::uint64_t App::getSharedBytes() const {
+    return server.bytesSent();
+}
+
+bool App::view(const std::string& host, unsigned short port, std::function<void()> wake) {
+    close();
+    std::string error;
+    if(!client.connect(host,port,std::move(wake),error)){
+        std::cerr<<"Failed to view: "<<error<<"\n";
+        return false;
+    }
+    viewing=true;
+    following=true;
+    shareReader=ShareStream::Reader();
+    return true;
+}
+
+// Sends viewers this frame's edits, the stroke in progress and the camera,
+// and a snapshot to any that have just joined. Joiners get the stroke and
+// camera again in the next frame, after their snapshot.
+void App::publish() {
+    if(resync){
+        resync=false;
+        snapshot.clear();
+        DocumentFile::write(doc,generation,snapshot);
+        ShareStream::append(ShareStream::Message::Snapshot,snapshot.data(),snapshot.size(),shareFrame);
+        server.pushSnapshot(shareFrame,true);
+        sharedSamples=0;
+        sharedSize=sf::Vector2f();
+    }
+    else if(!changes.empty()){
+        ShareStream::append(ShareStream::Message::Edits,changes.data(),changes.size(),shareFrame);
+    }
+
+    const std::vector<Stroke::Sample>& samples=stroke.getSamples();
+    if(isDrawing && samples.size()>sharedSamples){
+        ShareStream::appendStroke((std::uint32_t)sharedSamples,samples.data()+sharedSamples,
+                                  samples.size()-sharedSamples,shareFrame);
+        sharedSamples=samples.size();
+    }
+    else if(!isDrawing && sharedSamples>0){
+        ShareStream::appendStroke(0,nullptr,0,shareFrame);
+        sharedSamples=0;
+    }
+    if(camera.getCenter()!=sharedCenter || camera.getSize()!=sharedSize){
+        sharedCenter=camera.getCenter();
+        sharedSize=camera.getSize();
+        ShareStream::appendView(sharedCenter,sharedSize,shareFrame);
+    }
+    server.push(shareFrame);
+
+    if(server.hasJoiners()){
+        snapshot.clear();
+        DocumentFile::write(doc,generation,snapshot);
+        ShareStream::append(ShareStream::Message::Snapshot,snapshot.data(),snapshot.size(),shareFrame);
+        server.pushSnapshot(shareFrame,false);
+        sharedSamples=0;
+        sharedSize=sf::Vector2f();
+        redraw=true;
+    }
+}
+
+// Applies whatever the presenter has sent since the last frame.
+void App::receive() {
+    if(!client.hasData()) return;
+    client.receive(shareReader);
+    ShareStream::Message type;
+    const std::uint8_t* data;
+    std::uint32_t length;
+    while(shareReader.next(type,data,length)){
+        redraw=true;
+        if(type==ShareStream::Message::Snapshot){
+            std::uint32_t shared;
+            std::string error;
+            if(!DocumentFile::read(doc,data,length,shared,error)) return stopViewing("bad snapshot: "+error);
+            canvas.invalidateAll();
+        }
+        else if(type==ShareStream::Message::Edits){
+            touched.items.clear();
+            touched.areas.clear();
+            touched.all=false;
+            std::size_t before=doc.size();
+            bool ok=DocumentFile::apply(doc,data,length,&touched);
+            // New items are composited on top; edits to older ones repaint
+            // their area.
+            if(touched.all) canvas.invalidateAll();
+            else{
+                for(std::uint32_t id:touched.items){
+                    if(id<before) canvas.invalidate(doc.getBounds(id));
+                }
+                for(const sf::FloatRect& area:touched.areas) canvas.invalidate(area);
+                for(std::uint32_t id=(std::uint32_t)before;id<doc.size();++id){
+                    if(doc.isVisible(id)) canvas.append(doc,id);
+                }
+            }
+            if(!ok) return stopViewing("edits out of step with the drawing");
+        }
+        else if(type==ShareStream::Message::Stroke){
+            std::uint32_t first;
+            if(!ShareStream::readStroke(data,length,first,receivedSamples) || first>remoteSamples.size())
+                return stopViewing("stroke out of step");
+            bool appended=first==remoteSamples.size();
+            remoteSamples.resize(first);
+            remoteSamples.insert(remoteSamples.end(),receivedSamples.begin(),receivedSamples.end());
+            if(!appended){
+                remoteStroke.clear();
+                remoteStroke.setPixelSize(1.f/canvas.getScale());
+            }
+            const std::vector<Stroke::Sample>& add=appended?receivedSamples:remoteSamples;
+            for(const Stroke::Sample& sample:add) remoteStroke.addPoint(sample.position,sample.width,sample.color);
+        }
+        else if(type==ShareStream::Message::View){
+            if(!ShareStream::readView(data,length,presenterCenter,presenterSize)) return stopViewing("bad camera");
+            if(following) followPresenter();
+        }
+        if(doc.getBackground().a!=0) bgc=doc.getBackground();
+    }
+    if(shareReader.failed()) return stopViewing("corrupt stream");
+    if(!client.isConnected()) stopViewing("the presenter stopped sharing");
+}
+
+// Keeps showing what has arrived so far.
+void App::stopViewing(const std::string& reason) {
+    std::cerr<<"Stopped viewing: "<<reason<<"\n";
+    client.disconnect();
+    remoteStroke.clear();
+    remoteSamples.clear();
+    redraw=true;
+}
+
+// Fits the presenter's view into this window around the same centre.
+void App::followPresenter() {
+    if(presenterSize.x<=0.f || presenterSize.y<=0.f) return;
+    float scale=std::min((float)size.x/presenterSize.x,(float)size.y/presenterSize.y);
+    scale=std::max(minZoom,std::min(maxZoom,scale));
+    camera.setCenter(presenterCenter);
+    camera.setSize(sf::Vector2f((float)size.x,(float)size.y)/scale);
+}
+
+void App::setMemoryBudget(std::size_t bytes) {
+    memoryBudget=bytes;
+    checkedSize=0;
+}
+
+void App::compact() {
+    checkedSize=doc.size();
+    if(compactor.isRunning()) return;
+    // The raster layer costs what its pixels compress to, whatever the
+    // number of items in it, so only live items count against the budget.
+    std::size_t used=doc.memoryUsage()-doc.getRaster().memoryUsage();
+    if(used<=memoryBudget) return;
+
+    std::size_t keep=std::max(minLiveItems,(std::size_t)((double)doc.size()*memoryBudget/2/used));
+    if(keep>=doc.size()) return;
+    std::uint32_t count=history.redoFloor((std::uint32_t)(doc.size()-keep));
+    if(count==0) return;
+    history.forget(count);
+    compactor.start(doc,count);
+}
+
+void App::compacted(std::uint32_t flattened) {
+    cancelDrag();
+    history.shift(flattened);
+    std::size_t left=0;
+    for(std::uint32_t id:selection){
+        if(id>=flattened) selection[left++]=id-flattened;
+    }
+    selection.resize(left);
+    updateSelectionBounds();
+    // Placements and cuts only the forgotten steps named can go too.
+    std::vector<std::uint32_t> placementsUsed, cutsUsed, placementMap, cutMap;
+    history.collect(History::Op::Place,placementsUsed);
+    history.collect(History::Op::Cut,cutsUsed);
+    doc.compactEdits(placementsUsed,cutsUsed,placementMap,cutMap);
+    history.renumber(History::Op::Place,placementMap);
+    history.renumber(History::Op::Cut,cutMap);
+    resync=true;
+    checkedSize=doc.size();
+    canvas.invalidateAll();
+    redraw=true;
+    if(!autosave.isRunning()) return;
+
+    // Journal records name items by id, so the renumbered document is
+    // saved in full and starts a new generation of the journal.
+    changes.clear();
+    std::string error;
+    if(!DocumentFile::save(doc,path,generation+1,error) || !autosave.start(path+".journal",generation+1)){
+        std::cerr<<"Failed to save compacted document: "<<error<<"\n";
+        autosave.stop();
+        if(!server.isRunning()) doc.setChangeLog(nullptr);
+        return;
+    }
+    ++generation;
+}
+
+// Writes the drawing next to the document, at print resolution for PNG, on
+// a thread of its own so frames keep coming while it does.
+void App::exportDocument(const std::string& extension) {
+    std::string out=path.empty()?"dibujo":path;
+    std::size_t dot=out.find_last_of('.');
+    std::size_t slash=out.find_last_of("/\\");
+    if(dot!=std::string::npos && (slash==std::string::npos || dot>slash+1)) out.erase(dot);
+    out+=extension;
+
+    Exporter::Options options;
+    options.scale=exportScale;
+    if(exporting.start(doc,out,options)) std::cout<<"Exporting "<<out<<"\n";
+    else std::cerr<<"Still exporting, "<<out<<" not started\n";
+}
+
+// Reports an export once its thread has written it.
+void App::exported(bool wait) {
+    std::string out,error;
+    if(!exporting.poll(out,error,wait)) return;
+    if(error.empty()) std::cout<<"Exported "<<out<<"\n";
+    else std::cerr<<"Failed to export "<<out<<": "<<error<<"\n";
+}
+
+bool App::wantsTextCursor() const {
+    return textCursor;
+}
+
+DrawingMode App::getMode() const {
+    return mode;
+}
+
+const Document& App::getDocument() const {
+    return doc;
+}
+
+// Every edit starts here: items left over from undone adds are freed before
+// anything new is appended after them.
+void App::beginEdit() {
+    std::int64_t first=history.discardRedo();
+    if(first>=0) doc.truncate((std::uint32_t)first);
+}
+
+void App::commit(std::uint32_t id) {
+    history.record({History::Op::Add,false,id,0,0});
+    canvas.append(doc,id);
+}
+
+void App::changeBackground(sf::Color color) {
+    if(color==bgc) return;
+    beginEdit();
+    history.record({History::Op::Background,false,0,bgc.toInteger(),color.toInteger()});
+    bgc=color;
+    doc.setBackground(bgc);
+}
+
+// A step joining many entries repaints the area they covered once, rather
+// than an area per item.
+void App::undo() {
+    cancelDrag();
+    while(const History::Entry* e=history.undo()){
+        apply(*e,false);
+        if(!e->joined) break;
+    }
+    if(stepArea.width>=0.f) canvas.invalidate(stepArea);
+    stepArea=sf::FloatRect(0.f,0.f,-1.f,-1.f);
+    pruneSelection();
+}
+
+void App::redo() {
+    cancelDrag();
+    for(const History::Entry* e=history.redo();e;e=history.redoJoined()) apply(*e,true);
+    if(stepArea.width>=0.f) canvas.invalidate(stepArea);
+    stepArea=sf::FloatRect(0.f,0.f,-1.f,-1.f);
+    pruneSelection();
+}
+
+void App::apply(const History::Entry& e, bool forward) {
+    switch(e.op){
+        case History::Op::Add:
+        case History::Op::Hide:
+            if(forward==(e.op==History::Op::Add)) doc.show(e.id);
+            else doc.hide(e.id);
+            touch(doc.getBounds(e.id));
+            break;
+        case History::Op::Recolor:
+            doc.setColor(e.id,sf::Color(forward?e.after:e.before));
+            touch(doc.getBounds(e.id));
+            break;
+        case History::Op::Background:
+            bgc=sf::Color(forward?e.after:e.before);
+            doc.setBackground(bgc);
+            break;
+        case History::Op::Place:
+            touch(doc.getBounds(e.id));
+            doc.setPlacement(e.id,forward?e.after:e.before);
+            touch(doc.getBounds(e.id));
+            break;
+        case History::Op::Cut:
+            touch(doc.getBounds(e.id));
+            doc.setCut(e.id,forward?e.after:e.before);
+            touch(doc.getBounds(e.id));
+            break;
+        case History::Op::Clear:
+            if(forward) doc.clear();
+            else doc.restore(e.id);
+            canvas.invalidateAll();
+            break;
+    }
+}
+
+void App::touch(const sf::FloatRect& area) {
+    if(stepArea.width<0.f){
+        stepArea=area;
+        return;
+    }
+    float right=std::max(stepArea.left+stepArea.width,area.left+area.width);
+    float bottom=std::max(stepArea.top+stepArea.height,area.top+area.height);
+    stepArea.left=std::min(stepArea.left,area.left);
+    stepArea.top=std::min(stepArea.top,area.top);
+    stepArea.width=right-stepArea.left;
+    stepArea.height=bottom-stepArea.top;
+}
+
+// Selecting a selected item again, or grabbing the selection anywhere
+// inside its bounds, moves it; the corner handles scale it about the
+// opposite corner and the one above it rotates it about its centre.
+void App::pressSelect(const sf::Vector2f& p) {
+    cancelDrag();
+    pruneSelection();
+    dragStart=dragPoint=p;
+    if(!selection.empty()){
+        sf::Vector2f handles[5];
+        selectionHandles(handles);
+        float reach=handleSize/canvas.getScale();
+        const sf::FloatRect& b=selectionBounds;
+        if(nearHandle(p,handles[4],reach)){
+            drag=Drag::Rotate;
+            dragPivot=sf::Vector2f(b.left+b.width/2.f,b.top+b.height/2.f);
+        }
+        for(int i=0;i<4 && drag==Drag::None;++i){
+            if(!nearHandle(p,handles[i],reach)) continue;
+            drag=Drag::Scale;
+            dragPivot=handles[(i+2)%4];
+        }
+        if(drag==Drag::None && b.contains(p)) drag=Drag::Move;
+        if(drag!=Drag::None) return;
+    }
+    std::int64_t hit=doc.pick(p);
+    if(hit<0 || !doc.isEditable((std::uint32_t)hit)){
+        if(!shiftHeld) selection.clear();
+        drag=Drag::Band;
+    }
+    else{
+        std::uint32_t id=(std::uint32_t)hit;
+        if(!shiftHeld) selection.clear();
+        auto at=std::lower_bound(selection.begin(),selection.end(),id);
+        if(at==selection.end() || *at!=id) selection.insert(at,id);
+        drag=Drag::Move;
+    }
+    updateSelectionBounds();
+}
+
+void App::dragSelection(const sf::Vector2f& p) {
+    dragPoint=p;
+    if(drag==Drag::Band) return;
+    if(lifted.empty()){
+        liftSelection();
+        if(lifted.empty()) return;
+    }
+    sf::Transform transform;
+    sf::Vector2f from=dragStart-dragPivot, to=p-dragPivot;
+    if(drag==Drag::Move){
+        transform.translate(p-dragStart);
+    }
+    else if(drag==Drag::Scale){
+        float sx=std::fabs(from.x)>0.f?to.x/from.x:1.f;
+        float sy=std::fabs(from.y)>0.f?to.y/from.y:1.f;
+        if(shiftHeld) sx=sy=std::fabs(sx)>std::fabs(sy)?sx:sy;
+        transform.scale(limitScale(sx),limitScale(sy),dragPivot.x,dragPivot.y);
+    }
+    else{
+        float angle=(std::atan2(to.y,to.x)-std::atan2(from.y,from.x))*180.f/pi;
+        if(shiftHeld) angle=std::round(angle/rotateSnap)*rotateSnap;
+        transform.rotate(angle,dragPivot);
+    }
+    dragTransform=transform;
+}
+
+// Takes the selection out of the canvas and builds its vertices once; each
+// frame of the drag then only draws them under a new transform.
+void App::liftSelection() {
+    pruneSelection();
+    if(selection.empty()){
+        drag=Drag::None;
+        return;
+    }
+    beginEdit();
+    doc.lift(selection);
+    doc.appendBatches(selection,canvas.getScale(),lifted);
+    canvas.invalidate(selectionBounds);
+}
+
+// Puts the selection back where the drag left it. Each item gets a new
+// placement, and the whole move is one undo step.
+void App::dropSelection() {
+    if(drag==Drag::Band){
+        sf::FloatRect band(std::min(dragStart.x,dragPoint.x),std::min(dragStart.y,dragPoint.y),
+                           std::fabs(dragPoint.x-dragStart.x),std::fabs(dragPoint.y-dragStart.y));
+        doc.select(band,picked);
+        std::size_t before=selection.size();
+        selection.insert(selection.end(),picked.begin(),picked.end());
+        std::inplace_merge(selection.begin(),selection.begin()+before,selection.end());
+        selection.erase(std::unique(selection.begin(),selection.end()),selection.end());
+        updateSelectionBounds();
+    }
+    else if(!lifted.empty()){
+        doc.drop();
+        lifted.clear();
+        bool joined=false;
+        if(dragPoint!=dragStart){
+            for(std::uint32_t id:selection){
+                if(!doc.isEditable(id)) continue;
+                std::uint32_t before=doc.place(id,dragTransform*doc.getTransform(id));
+                history.record({History::Op::Place,joined,id,before,doc.getPlacement(id)});
+                joined=true;
+            }
+            updateSelectionBounds();
+        }
+        canvas.invalidate(selectionBounds);
+    }
+    drag=Drag::None;
+    dragTransform=sf::Transform::Identity;
+}
+
+// Abandons a drag in progress, leaving the selection where it was.
+void App::cancelDrag() {
+    if(!lifted.empty()){
+        doc.drop();
+        lifted.clear();
+        canvas.invalidate(selectionBounds);
+    }
+    drag=Drag::None;
+    dragTransform=sf::Transform::Identity;
+}
+
+void App::deleteSelection() {
+    cancelDrag();
+    pruneSelection();
+    if(selection.empty()) return;
+    beginEdit();
+    for(std::size_t i=0;i<selection.size();++i){
+        doc.hide(selection[i]);
+        history.record({History::Op::Hide,i>0,selection[i],0,0});
+    }
+    canvas.invalidate(selectionBounds);
+    selection.clear();
+    updateSelectionBounds();
+}
+
+// Drops selected items that undo, deletion or flattening took away.
+void App::pruneSelection() {
+    std::size_t left=0;
+    for(std::uint32_t id:selection){
+        if(id<doc.size() && doc.isEditable(id)) selection[left++]=id;
+    }
+    selection.resize(left);
+    updateSelectionBounds();
+}
+
+void App::updateSelectionBounds() {
+    selectionBounds=sf::FloatRect();
+    for(std::size_t i=0;i<selection.size();++i){
+        const sf::FloatRect& b=doc.getBounds(selection[i]);
+        if(i==0){
+            selectionBounds=b;
+            continue;
+        }
+        float right=std::max(selectionBounds.left+selectionBounds.width,b.left+b.width);
+        float bottom=std::max(selectionBounds.top+selectionBounds.height,b.top+b.height);
+        selectionBounds.left=std::min(selectionBounds.left,b.left);
+        selectionBounds.top=std::min(selectionBounds.top,b.top);
+        selectionBounds.width=right-selectionBounds.left;
+        selectionBounds.height=bottom-selectionBounds.top;
+    }
+}
+
+// Corners of the selection clockwise from the top left, then the rotation
+// handle, all as the drag has moved them so far.
+void App::selectionHandles(sf::Vector2f* points) const {
+    const sf::FloatRect& b=selectionBounds;
+    points[0]=sf::Vector2f(b.left,b.top);
+    points[1]=sf::Vector2f(b.left+b.width,b.top);
+    points[2]=sf::Vector2f(b.left+b.width,b.top+b.height);
+    points[3]=sf::Vector2f(b.left,b.top+b.height);
+    points[4]=sf::Vector2f(b.left+b.width/2.f,b.top-rotateOffset/canvas.getScale());
+    for(int i=0;i<5;++i) points[i]=dragTransform.transformPoint(points[i]);
+}
+
+// Sweeps the eraser from its last position to p. Strokes lose just the
+// part it passes over, split into pieces where it crosses them; anything
+// else it touches goes whole.
+void App::eraseTo(const sf::Vector2f& p) {
+    float radius=eraserRadius();
+    sf::Vector2f a=eraserPoint;
+    eraserPoint=p;
+    sf::FloatRect area(std::min(a.x,p.x)-radius,std::min(a.y,p.y)-radius,
+                       std::fabs(p.x-a.x)+2.f*radius,std::fabs(p.y-a.y)+2.f*radius);
+    doc.query(area,hits);
+    for(std::uint32_t id:hits){
+        if(!doc.isEditable(id)) continue;
+        sf::FloatRect old=doc.getBounds(id);
+        if(doc.getItem(id).kind==ItemKind::Stroke){
+            if(!doc.eraseAlong(id,a,p,radius,kept)) continue;
+            if(kept.empty()){
+                doc.hide(id);
+                history.record({History::Op::Hide,erased,id,0,0});
+            }
+            else{
+                std::uint32_t before=doc.cut(id,kept.data(),kept.size());
+                history.record({History::Op::Cut,erased,id,before,doc.getCut(id)});
+            }
+        }
+        else{
+            sf::Vector2f d=p-a;
+            int steps=1+(int)(std::sqrt(d.x*d.x+d.y*d.y)/radius);
+            bool hit=false;
+            for(int i=0;i<=steps && !hit;++i) hit=doc.contains(id,a+d*((float)i/steps));
+            if(!hit) continue;
+            doc.hide(id);
+            history.record({History::Op::Hide,erased,id,0,0});
+        }
+        erased=true;
+        canvas.invalidate(old);
+    }
+}
+
+float App::eraserRadius() const {
+    return std::max(thick,minEraser)/canvas.getScale();
+}
+
+void App::nextRainbowColor() {
+    if(rainbowModeActive){
+        updateRainbow();
+        rainbowHue+=30.f;
+        if(rainbowHue>360.f) rainbowHue-=360.f;
+    }
+}
+
+// The hue cycles at 30 degrees per second of wall time rather than per
+// frame, so it keeps its pace without the loop waking up to advance it.
+void App::updateRainbow() {
+    if(rainbowModeActive && mode==DrawingMode::Rainbow){
+        float hue=std::fmod(rainbowHue+rainbowClock.getElapsedTime().asSeconds()*30.f,360.f);
+        brush=HsvToRgb(hue,1.f,1.f);
+    }
+}
+
+bool App::caretVisible() const {
+    return (int)(caretClock.getElapsedTime().asSeconds()/0.5f)%2==0;
+}
+
+bool App::showsPointer() const {
+    return isDrawing||isRect||isCircle||isTri||isPanning||drag!=Drag::None||mode==DrawingMode::Erase;
+}
+
+sf::Vector2f App::toWorld(const sf::Vector2i& mp) const {
+    sf::Vector2f origin=camera.getCenter()-camera.getSize()/2.f;
+    return origin+sf::Vector2f((float)mp.x,(float)mp.y)*(camera.getSize().x/(float)size.x);
+}
+
+// Brush thickness is chosen in screen pixels, so it stays the same on
+// screen at any zoom.
+float App::brushWidth() const {
+    return thick*camera.getSize().x/(float)size.x;
+}
+
+// Width for the points the pointer has just produced: like a pen, the
+// brush thins as it speeds up, easing there so uneven sample timing does
+// not make the edge wobble. Kept to quarter pixels, so the stored width
+// only changes every few samples.
+float App::strokeWidth() {
+    float now=eventTime.asSeconds();
+    float scale=canvas.getScale();
+    float speed=sampler.speed(now)*scale;
+    float target=brushWidth()*(1.f-maxThinning*std::min(1.f,speed/thinningSpeed));
+    inkWidth+=(target-inkWidth)*(1.f-std::exp(-std::max(0.f,now-inkTime)/inkEasing));
+    inkTime=now;
+    return std::round(inkWidth*scale*4.f)/(scale*4.f);
+}
+
+void App::pan(const sf::Vector2i& delta) {
+    following=false;
+    camera.move(sf::Vector2f((float)delta.x,(float)delta.y)*(camera.getSize().x/(float)size.x));
+}
+
+// Zooms keeping the document point under the cursor in place.
+void App::zoomAt(const sf::Vector2i& mp, float factor) {
+    float scale=(float)size.x/camera.getSize().x;
+    float target=std::max(minZoom,std::min(maxZoom,scale*factor));
+    if(target==scale) return;
+    following=false;
+    sf::Vector2f anchor=toWorld(mp);
+    camera.setSize(camera.getSize()*(scale/target));
+    camera.move(anchor-toWorld(mp));
+}
+
+bool App::needsRender() const {
+    return redraw||(isDrawing && tailPredicted)||canvas.isDirty()||(isTyping && caretVisible()!=caretDrawn)||compactor.isDone()||
+           exporting.isDone()||server.hasJoiners()||client.hasData();
+}
+
+bool App::nextAnimation(sf::Time& wait) const {
+    bool working=compactor.isRunning()||exporting.isRunning();
+    if(!isTyping && !working) return false;
+    wait=compactionPoll;
+    if(isTyping){
+        float phase=std::fmod(caretClock.getElapsedTime().asSeconds(),0.5f);
+        if(!working || sf::seconds(0.5f-phase)<wait) wait=sf::seconds(0.5f-phase);
+    }
+    return true;
+}
+
+sf::Time App::inputTime() const {
+    return inputClock.getElapsedTime();
+}
+
+void App::handleEvent(const sf::Event& ev) {
+    handleEvent(ev,inputTime());
+}
+
+void App::handleEvent(const sf::Event& ev, sf::Time time) {
+    eventTime=time;
+    // Pointer motion only shows up on screen through a shape preview.
+    if(ev.type!=sf::Event::MouseMoved || showsPointer()) redraw=true;
+    if(ev.type==sf::Event::MouseMoved){
+        sf::Vector2i previous=mouse;
+        mouse=sf::Vector2i(ev.mouseMove.x,ev.mouseMove.y);
+        if(isPanning) pan(previous-mouse);
+        if(isDrawing) extendStroke(mouse);
+        if(drag!=Drag::None) dragSelection(toWorld(mouse));
+        if(isErasing) eraseTo(toWorld(mouse));
+    }
+    else if(ev.type==sf::Event::MouseButtonPressed){
+        mouse=sf::Vector2i(ev.mouseButton.x,ev.mouseButton.y);
+        if(ev.mouseButton.button!=sf::Mouse::Left) isPanning=true;
+        else if(!viewing) press(mouse);
+    }
+    else if(ev.type==sf::Event::MouseButtonReleased){
+        mouse=sf::Vector2i(ev.mouseButton.x,ev.mouseButton.y);
+        if(ev.mouseButton.button!=sf::Mouse::Left) isPanning=false;
+        else if(!viewing) release(mouse);
+    }
+    else if(ev.type==sf::Event::MouseWheelScrolled){
+        mouse=sf::Vector2i(ev.mouseWheelScroll.x,ev.mouseWheelScroll.y);
+        zoomAt(mouse,std::pow(1.1f,ev.mouseWheelScroll.delta));
+    }
+    else if(ev.type==sf::Event::TextEntered && isTyping){
+        textEntered(ev.text.unicode);
+    }
+    else if(ev.type==sf::Event::KeyPressed){
+        shiftHeld=ev.key.shift;
+        keyPressed(ev.key);
+    }
+    else if(ev.type==sf::Event::KeyReleased){
+        shiftHeld=ev.key.shift;
+    }
+}
+
+void App::press(const sf::Vector2i& mp) {
+    updateRainbow();
+    if(bgBtn.contains((float)mp.x,(float)mp.y)){
+        bgIndex=(bgIndex+1)%bgColors.size();
+        changeBackground(bgColors[bgIndex]);
+    }
+    else if(squaresBtn.contains((float)mp.x,(float)mp.y)){
+        mode=DrawingMode::Rectangle;
+    }
+    else if(drawBtn.contains((float)mp.x,(float)mp.y)){
+        mode=DrawingMode::FreeDraw;
+    }
+    else if(circleBtn.contains((float)mp.x,(float)mp.y)){
+        mode=DrawingMode::Circle;
+    }
+    else if(textBtn.contains((float)mp.x,(float)mp.y)){
+        mode=DrawingMode::Text;
+    }
+    else if(triBtn.contains((float)mp.x,(float)mp.y)){
+        mode=DrawingMode::Triangle;
+    }
+    else if(rainbowModeBtn.contains((float)mp.x,(float)mp.y)){
+        mode=DrawingMode::Rainbow;
+        rainbowModeActive=true;
+    }
+    else if(bucketBtn.contains((float)mp.x,(float)mp.y)){
+        mode=DrawingMode::PaintBucket;
+    }
+    else if(colorWheel.contains((float)mp.x,(float)mp.y)){
+        showPicker=!showPicker;
+    }
+    else if(showPicker && colorPick.getBounds().contains((float)mp.x,(float)mp.y)){
+        sf::Color picked;
+        if(colorPick.pick(sf::Vector2f((float)mp.x,(float)mp.y),picked)){
+            brush=picked;
+            rainbowModeActive=false;
+            mode=DrawingMode::FreeDraw;
+        }
+    }
+    else{
+        if(mode==DrawingMode::Rectangle){
+            rectStart=toWorld(mp);
+            isRect=true;
+        }
+        else if(mode==DrawingMode::Circle){
+            circCenter=toWorld(mp);
+            isCircle=true;
+        }
+        else if(mode==DrawingMode::Text && !isTyping){
+            textCursor=true;
+            textPosition=toWorld(mp);
+            textColor=brush;
+            typed.clear();
+            typedRun.reset(font,textSize);
+            typedVertices.clear();
+            isTyping=true;
+        }
+        else if(mode==DrawingMode::Triangle){
+            if(!isTri){
+                isTri=true;
+                triClicks=1;
+                triPts[0]=toWorld(mp);
+            }
+            else{
+                triClicks++;
+                triPts[triClicks-1]=toWorld(mp);
+                if(triClicks==3){
+                    nextRainbowColor();
+                    beginEdit();
+                    commit(doc.addTriangle(triPts[0],triPts[1],triPts[2],brush));
+                    isTri=false;
+                    triClicks=0;
+                }
+            }
+        }
+        else if(mode==DrawingMode::FreeDraw||mode==DrawingMode::Rainbow){
+            isDrawing=true;
+            sf::Vector2f p=toWorld(mp);
+            sampler.setTolerance(0.25f/canvas.getScale());
+            sampler.begin(p,eventTime.asSeconds());
+            stroke.clear();
+            stroke.setPixelSize(1.f/canvas.getScale());
+            strokeTail.setPixelSize(1.f/canvas.getScale());
+            sharedSamples=0;
+            inkWidth=brushWidth();
+            inkTime=eventTime.asSeconds();
+            stroke.addPoint(p,inkWidth,brush);
+        }
+        else if(mode==DrawingMode::PaintBucket){
+            bool shapeFound=false;
+            std::int64_t hit=doc.pick(toWorld(mp));
+            if(hit>=0){
+                std::uint32_t id=(std::uint32_t)hit;
+                beginEdit();
+                history.record({History::Op::Recolor,false,id,doc.setColor(id,brush).toInteger(),brush.toInteger()});
+                canvas.invalidate(doc.getBounds(id));
+                shapeFound=true;
+            }
+            if(!shapeFound){
+                changeBackground(brush);
+            }
+        }
+        else if(mode==DrawingMode::FloodFill && mp.x>=0 && mp.y>=0){
+            canvas.setBackground(bgc);
+            canvas.setView(camera);
+            if(canvas.isDirty()) canvas.repaint(doc);
+            sf::Image snapshot=canvas.getTexture().copyToImage();
+            FloodFill::Region region;
+            if(FloodFill::fill(snapshot.getPixelsPtr(),snapshot.getSize().x,snapshot.getSize().y,
+                               (unsigned)mp.x,(unsigned)mp.y,fillTolerance,region)){
+                const sf::View& view=canvas.getView();
+                beginEdit();
+                commit(doc.addFill(region,brush,view.getCenter()-view.getSize()/2.f,1.f/canvas.getScale()));
+            }
+        }
+        else if(mode==DrawingMode::Select){
+            pressSelect(toWorld(mp));
+        }
+        else if(mode==DrawingMode::Erase){
+            beginEdit();
+            isErasing=true;
+            erased=false;
+            eraserPoint=toWorld(mp);
+            eraseTo(eraserPoint);
+        }
+    }
+}
+
+void App::release(const sf::Vector2i& mp) {
+    if(drag!=Drag::None) dropSelection();
+    isErasing=false;
+    if(mode==DrawingMode::Rectangle && isRect){
+        sf::Vector2f ep=toWorld(mp);
+        sf::Vector2f sz(std::fabs(ep.x-rectStart.x),std::fabs(ep.y-rectStart.y));
+        nextRainbowColor();
+        beginEdit();
+        commit(doc.addRectangle(sf::Vector2f(std::min(rectStart.x,ep.x),std::min(rectStart.y,ep.y)),sz,brush));
+        isRect=false;
+    }
+    else if(mode==DrawingMode::Circle && isCircle){
+        sf::Vector2f ep=toWorld(mp);
+        float rad=std::sqrt((ep.x-circCenter.x)*(ep.x-circCenter.x)+(ep.y-circCenter.y)*(ep.y-circCenter.y));
+        nextRainbowColor();
+        beginEdit();
+        commit(doc.addCircle(circCenter,rad,brush));
+        isCircle=false;
+    }
+    else if((mode==DrawingMode::FreeDraw||mode==DrawingMode::Rainbow) && isDrawing){
+        finishStroke(mp);
+        nextRainbowColor();
+        if(stroke.getPointCount()>1){
+            beginEdit();
+            doc.setStrokeTolerance(0.5f/canvas.getScale());
+            commit(doc.addStroke(stroke));
+        }
+        stroke.clear();
+        isDrawing=false;
+    }
+    if(mode==DrawingMode::Text) textCursor=false;
+}
+
+// Every MouseMoved sample goes into the stroke as it arrives, stamped with
+// the time the event was received rather than when it is handled, so a
+// slow frame does not bunch up the samples behind it.
+void App::extendStroke(const sf::Vector2i& mp) {
+    strokePoints.clear();
+    sampler.add(toWorld(mp),eventTime.asSeconds(),strokePoints);
+    if(strokePoints.empty()) return;
+    float width=strokeWidth();
+    for(const sf::Vector2f& p:strokePoints){
+        stroke.addPoint(p,width,brush);
+    }
+}
+
+void App::finishStroke(const sf::Vector2i& mp) {
+    extendStroke(mp);
+    strokePoints.clear();
+    sampler.end(strokePoints);
+    for(const sf::Vector2f& p:strokePoints){
+        stroke.addPoint(p,inkWidth,brush);
+    }
+}
+
+void App::textEntered(sf::Uint32 unicode) {
+    if(unicode=='\b'){
+        if(typed.isEmpty()) return;
+        typed.erase(typed.getSize()-1);
+        typedRun.pop();
+        typedVertices.resize(typedRun.getQuads().size()*6);
+    }
+    else{
+        if(unicode=='\r') unicode='\n';
+        typed+=unicode;
+        std::size_t before=typedRun.getQuads().size();
+        typedRun.push(unicode);
+        const auto& quads=typedRun.getQuads();
+        GlyphRun::appendVertices(quads.data()+before,quads.size()-before,textPosition,textColor,typedVertices);
+    }
+}
+
+void App::setTextSize(unsigned characterSize) {
+    // Only scales the quads unless the size crosses into another atlas band.
+    textSize=characterSize;
+    if(!isTyping) return;
+    typedRun.reset(font,textSize);
+    for(std::size_t i=0;i<typed.getSize();++i) typedRun.push(typed[i]);
+    typedVertices.clear();
+    const auto& quads=typedRun.getQuads();
+    GlyphRun::appendVertices(quads.data(),quads.size(),textPosition,textColor,typedVertices);
+}
+
+void App::keyPressed(const sf::Event::KeyEvent& key) {
+    if(viewing && !viewerKey(key.code)) return;
+    if(isTyping && key.code==sf::Keyboard::Escape){
+        beginEdit();
+        commit(doc.addText(typed,textPosition,textSize,textColor));
+        isTyping=false;
+        textCursor=false;
+    }
+    else if(key.control && (key.code==sf::Keyboard::Z || key.code==sf::Keyboard::Y)){
+        if(key.code==sf::Keyboard::Y || key.shift) redo();
+        else undo();
+    }
+    else if(key.control && key.code==sf::Keyboard::E){
+        exportDocument(key.shift?".svg":".png");
+    }
+    else if(key.code==sf::Keyboard::C){
+        beginEdit();
+        cancelDrag();
+        history.record({History::Op::Clear,false,doc.clear(),0,0});
+        selection.clear();
+        updateSelectionBounds();
+        canvas.invalidateAll();
+    }
+    else if(key.code==sf::Keyboard::V && !isTyping){
+        mode=DrawingMode::Select;
+    }
+    else if(key.code==sf::Keyboard::E && !isTyping && !viewing){
+        mode=DrawingMode::Erase;
+    }
+    else if(mode==DrawingMode::Select && key.code==sf::Keyboard::Delete){
+        deleteSelection();
+    }
+    else if(mode==DrawingMode::Select && key.code==sf::Keyboard::Escape){
+        cancelDrag();
+        selection.clear();
+        updateSelectionBounds();
+    }
+    else if(key.code==sf::Keyboard::P){
+        showPicker=!showPicker;
+    }
+    else if(key.code==sf::Keyboard::H && !isTyping){
+        bool hsv=colorPick.getStyle()==ColorPicker::Style::Hsv;
+        colorPick.setStyle(hsv?ColorPicker::Style::Gradient:ColorPicker::Style::Hsv);
+    }
+    else if(key.code==sf::Keyboard::F && !isTyping){
+        mode=mode==DrawingMode::FloodFill?DrawingMode::PaintBucket:DrawingMode::FloodFill;
+    }
+    else if(key.code==sf::Keyboard::S && !isTyping){
+        sampler.setSmoothing(!sampler.getSmoothing());
+    }
+    else if(key.code==sf::Keyboard::Home){
+        camera=sf::View(sf::FloatRect(0.f,0.f,(float)size.x,(float)size.y));
+        following=true;
+        if(viewing) followPresenter();
+    }
+    else if(key.code==sf::Keyboard::B){
+        bgIndex=(bgIndex+1)%bgColors.size();
+        changeBackground(bgColors[bgIndex]);
+    }
+    else if(isTyping && key.code==sf::Keyboard::Up){
+        setTextSize(std::min(textSize+2,maxTextSize));
+    }
+    else if(isTyping && key.code==sf::Keyboard::Down){
+        setTextSize(std::max(textSize-2,minTextSize));
+    }
+    else if(key.code==sf::Keyboard::Up){
+        thick+=1.f;
+    }
+    else if(key.code==sf::Keyboard::Down){
+        thick=std::max(1.f,thick-1.f);
+    }
+#ifdef DIBUJO_PROFILE
+    else if(key.code==sf::Keyboard::F3){
+        showHud=!showHud;
+    }
+    else if(key.code==sf::Keyboard::F4){
+        toggleTrace();
+    }
+#endif
+}
+
+#ifdef DIBUJO_PROFILE
+void App::toggleTrace() {
+    const char* tracePath="dibujo-trace.json";
+    if(!Profiler::isTracing()){
+        Profiler::startTrace();
+        std::cout<<"Tracing, press F4 again to write "<<tracePath<<"\n";
+        return;
+    }
+    std::string error;
+    if(Profiler::stopTrace(tracePath,error)) std::cout<<"Wrote "<<tracePath<<"\n";
+    else std::cerr<<"Failed to write trace: "<<error<<"\n";
+}
+#endif
+
+void App::update() {
+    updateRainbow();
+    exported(false);
+    if(std::uint32_t flattened=compactor.poll(doc)) compacted(flattened);
+    // A viewer's items are numbered by the presenter, who flattens them.
+    else if(doc.size()!=checkedSize && !viewing) compact();
+    if(server.isRunning()) publish();
+    else if(viewing) receive();
+    autosave.push(changes);
+}
+
+void App::drawUi(sf::RenderTarget& target, const sf::Drawable& drawable, std::size_t vertices) {
+    target.draw(drawable);
+    RenderStats::draw(vertices);
+}
+
+void App::render(sf::RenderTarget& target) {
+    redraw=false;
+    canvas.setBackground(bgc);
+    canvas.setView(camera);
+    if(canvas.isDirty()){
+        DIBUJO_PROFILE_SCOPE("repaint");
+        canvas.repaint(doc);
+    }
+    target.clear(bgc);
+    target.draw(canvas);
+
+    // Previews live in the document, everything after them on the screen.
+    target.setView(camera);
+    float outline=1.f/canvas.getScale();
+    if(isDrawing){
+        target.draw(stroke);
+        // Provisional tail: the span still waiting for its next sample, plus
+        // roughly one frame of predicted motion. Rebuilt every frame, and
+        // frames keep coming only while the prediction moves.
+        float now=inputClock.getElapsedTime().asSeconds();
+        tailPredicted=sampler.isPredicting(now);
+        sampler.preview(now,1.f/60.f,strokePoints);
+        strokeTail.clear();
+        for(const sf::Vector2f& p:strokePoints){
+            strokeTail.addPoint(p,inkWidth,brush);
+        }
+        if(strokeTail.getPointCount()>1) target.draw(strokeTail);
+    }
+    if(remoteStroke.getPointCount()>1) target.draw(remoteStroke);
+    if(!lifted.empty()){
+        sf::RenderStates states(dragTransform);
+        for(const Document::Batch& batch:lifted){
+            states.texture=batch.texture;
+            target.draw(batch.vertices.data(),batch.vertices.size(),sf::Triangles,states);
+            RenderStats::draw(batch.vertices.size());
+        }
+    }
+    if(isTyping){
+        // Glyphs and caret in one draw; the caret is appended for this frame only.
+        std::size_t glyphs=typedVertices.size();
+        caretDrawn=caretVisible();
+        if(caretDrawn){
+            sf::Vector2f caret=textPosition+typedRun.getCaret();
+            GlyphRun::appendSolid(sf::FloatRect(caret.x+1.f,caret.y,1.f,(float)textSize),sf::Color::Black,typedVertices);
+        }
+        if(!typedVertices.empty()){
+            sf::RenderStates states(&typedRun.getTexture());
+            target.draw(typedVertices.data(),typedVertices.size(),sf::Triangles,states);
+            RenderStats::draw(typedVertices.size());
+        }
+        typedVertices.resize(glyphs);
+    }
+    if(isTri && triClicks>0 && triClicks<3){
+        sf::Vector2f current=toWorld(mouse);
+        int pc=triClicks+1;
+        sf::ConvexShape preview(pc);
+        for(int i=0;i<triClicks;++i){
+            preview.setPoint(i,triPts[i]);
+        }
+        preview.setPoint(pc-1,current);
+        preview.setFillColor(sf::Color::Transparent);
+        preview.setOutlineColor(sf::Color::Black);
+        preview.setOutlineThickness(outline);
+        drawUi(target,preview,pc*2+2);
+    }
+    if(isRect && mode==DrawingMode::Rectangle){
+        sf::Vector2f cp=toWorld(mouse);
+        sf::Vector2f topleft(std::min(rectStart.x,cp.x),std::min(rectStart.y,cp.y));
+        sf::Vector2f sz(std::fabs(cp.x-rectStart.x),std::fabs(cp.y-rectStart.y));
+        sf::RectangleShape pr(sz);
+        pr.setPosition(topleft);
+        pr.setFillColor(sf::Color::Transparent);
+        pr.setOutlineColor(sf::Color::Black);
+        pr.setOutlineThickness(outline);
+        drawUi(target,pr,10);
+    }
+    if(isCircle && mode==DrawingMode::Circle){
+        sf::Vector2f cp=toWorld(mouse);
+        float rad=std::sqrt((cp.x-circCenter.x)*(cp.x-circCenter.x)+(cp.y-circCenter.y)*(cp.y-circCenter.y));
+        sf::CircleShape c(rad);
+        c.setOrigin(rad,rad);
+        c.setPosition(circCenter);
+        c.setFillColor(sf::Color::Transparent);
+        c.setOutlineColor(sf::Color::Black);
+        c.setOutlineThickness(outline);
+        drawUi(target,c,c.getPointCount()*2+2);
+    }
+    const sf::Color selectColor(0,120,215);
+    if(mode==DrawingMode::Select && !selection.empty()){
+        sf::Vector2f handles[5];
+        selectionHandles(handles);
+        sf::ConvexShape frame(4);
+        for(int i=0;i<4;++i) frame.setPoint(i,handles[i]);
+        frame.setFillColor(sf::Color::Transparent);
+        frame.setOutlineColor(selectColor);
+        frame.setOutlineThickness(outline);
+        drawUi(target,frame,10);
+        float half=handleSize/2.f*outline;
+        sf::RectangleShape corner(sf::Vector2f(half*2.f,half*2.f));
+        corner.setOrigin(half,half);
+        corner.setOutlineColor(selectColor);
+        corner.setOutlineThickness(outline);
+        for(int i=0;i<4;++i){
+            corner.setPosition(handles[i]);
+            drawUi(target,corner,10);
+        }
+        sf::CircleShape knob(half);
+        knob.setOrigin(half,half);
+        knob.setPosition(handles[4]);
+        knob.setOutlineColor(selectColor);
+        knob.setOutlineThickness(outline);
+        drawUi(target,knob,knob.getPointCount()*2+2);
+    }
+    if(drag==Drag::Band){
+        sf::RectangleShape band(sf::Vector2f(std::fabs(dragPoint.x-dragStart.x),std::fabs(dragPoint.y-dragStart.y)));
+        band.setPosition(std::min(dragStart.x,dragPoint.x),std::min(dragStart.y,dragPoint.y));
+        band.setFillColor(sf::Color(selectColor.r,selectColor.g,selectColor.b,40));
+        band.setOutlineColor(selectColor);
+        band.setOutlineThickness(outline);
+        drawUi(target,band,10);
+    }
+    if(mode==DrawingMode::Erase && !viewing){
+        float radius=eraserRadius();
+        sf::CircleShape eraser(radius);
+        eraser.setOrigin(radius,radius);
+        eraser.setPosition(toWorld(mouse));
+        eraser.setFillColor(sf::Color::Transparent);
+        eraser.setOutlineColor(sf::Color::Black);
+        eraser.setOutlineThickness(outline);
+        drawUi(target,eraser,eraser.getPointCount()*2+2);
+    }
+    target.setView(target.getDefaultView());
+    if(showPicker){
+        target.draw(colorPick);
+    }
+    if(!viewing) drawUi(target,toolbar,toolbar.getVertexCount());
+#ifdef DIBUJO_PROFILE
+    if(showHud){
+        DIBUJO_PROFILE_SCOPE("hud");
+        const RenderStats::Counters& counters=RenderStats::current();
+        PerfHud::Stats stats;
+        stats.drawCalls=counters.drawCalls;
+        stats.vertices=counters.vertices;
+        stats.textureUploads=counters.textureUploads;
+        stats.items=doc.size();
+        stats.strokePoints=stroke.getPointCount();
+        hud.update(stats,target.getSize());
+        target.draw(hud);
+        RenderStats::current().drawCalls+=hud.drawCalls();
+        RenderStats::current().vertices+=hud.vertexCount();
+    }
+#endif
+}
@@ -0,0 +1,260 @@
+#ifndef APP_HPP
+#define APP_HPP
+
+#include <SFML/Graphics.hpp>
+#include <functional>
+#include <string>
+#include <vector>
+#include "Autosave.hpp"
+#include "Canvas.hpp"
+#include "Color.hpp"
+#include "Compactor.hpp"
+#include "Document.hpp"
+#include "DocumentFile.hpp"
+#include "Exporter.hpp"
+#include "GlyphRun.hpp"
+#include "History.hpp"
+#include "PerfHud.hpp"
+#include "ShareClient.hpp"
+#include "ShareServer.hpp"
+#include "ShareStream.hpp"
+#include "Stroke.hpp"
+#include "StrokeSampler.hpp"
+#include "Toolbar.hpp"
+
+enum class DrawingMode {
+    FreeDraw,
+    Rectangle,
+    Circle,
+    Text,
+    Triangle,
+    Rainbow,
+    PaintBucket,
+    FloodFill,
+    Select,
+    Erase
+};
+
+// Everything dibujo does between receiving an event and presenting a frame.
+// It never touches the window directly: the pointer position comes from the
+// events themselves and rendering goes to any sf::RenderTarget, so the same
+// code runs in the window loop and headless in the benchmark.
+class App
+{
+public:
+    App();
+
+    // Loads the bundled font and toolbar atlas and sizes the canvas.
+    bool init(const sf::Vector2u& size);
+
+    // Loads the document at path, replaying any journal a crash left
+    // behind, and journals every later edit to path.journal until close()
+    // saves it back in full. Without a successful open nothing is saved.
+    // close() also stops sharing or viewing.
+    bool open(const std::string& path);
+    void close();
+
+    // Streams every edit, the stroke being drawn and the camera to viewers
+    // connecting on port (any free one when zero), with a snapshot of the
+    // document for each as it joins. wake is called from another thread
+    // when one does, to get an idle render loop going.
+    bool share(unsigned short port, std::function<void()> wake);
+    unsigned short getSharePort() const;
+    // Bytes written to viewers so far.
+    std::uint64_t getSharedBytes() const;
+
+    // Shows the drawing shared at host:port instead of a document of its
+    // own. Nothing can be drawn; the camera follows the presenter's until
+    // panned or zoomed, and Home follows it again. wake is called from
+    // another thread whenever something arrives.
+    bool view(const std::string& host, unsigned short port, std::function<void()> wake);
+
+    // Once the live items hold more than this many bytes, the oldest are
+    // flattened in the background until they hold about half, dropping
+    // the undo steps that refer to them.
+    void setMemoryBudget(std::size_t bytes);
+
+    // time is when the event was received, on the inputTime() clock, which
+    // is what stroke sampling goes by; without it the event is taken as
+    // arriving now.
+    void handleEvent(const sf::Event& ev);
+    void handleEvent(const sf::Event& ev, sf::Time time);
+
+    // Clock input events are stamped with. Safe to read from any thread.
+    sf::Time inputTime() const;
+
+    // Per-frame work that is not driven by a single event.
+    void update();
+
+    void render(sf::RenderTarget& target);
+
+    // True when the next frame would differ from the last one rendered:
+    // after input that changed something (during a gesture, any pointer
+    // motion moves its preview), while the stroke tail drawn last was still
+    // predicted and so moves with time, or when the caret is due to blink.
+    // A pointer held still costs one more frame, to drop the prediction.
+    bool needsRender() const;
+
+    // Time until the next timed animation frame is due. Returns false when
+    // nothing is animating, so the caller can block until the next event.
+    bool nextAnimation(sf::Time& wait) const;
+
+    bool wantsTextCursor() const;
+    DrawingMode getMode() const;
+    const Document& getDocument() const;
+
+private:
+    void press(const sf::Vector2i& mp);
+    void release(const sf::Vector2i& mp);
+    void keyPressed(const sf::Event::KeyEvent& key);
+    void textEntered(sf::Uint32 unicode);
+    void setTextSize(unsigned characterSize);
+    void extendStroke(const sf::Vector2i& mp);
+    void finishStroke(const sf::Vector2i& mp);
+    void nextRainbowColor();
+    void updateRainbow();
+    bool caretVisible() const;
+    bool showsPointer() const;
+    sf::Vector2f toWorld(const sf::Vector2i& mp) const;
+    float brushWidth() const;
+    float strokeWidth();
+    void pan(const sf::Vector2i& delta);
+    void zoomAt(const sf::Vector2i& mp, float factor);
+    void beginEdit();
+    void commit(std::uint32_t id);
+    void changeBackground(sf::Color color);
+    void undo();
+    void redo();
+    void apply(const History::Entry& entry, bool forward);
+    void touch(const sf::FloatRect& area);
+    void pressSelect(const sf::Vector2f& p);
+    void dragSelection(const sf::Vector2f& p);
+    void liftSelection();
+    void dropSelection();
+    void cancelDrag();
+    void deleteSelection();
+    void pruneSelection();
+    void updateSelectionBounds();
+    void selectionHandles(sf::Vector2f* points) const;
+    void eraseTo(const sf::Vector2f& p);
+    float eraserRadius() const;
+    void compact();
+    void compacted(std::uint32_t flattened);
+    void publish();
+    void receive();
+    void stopViewing(const std::string& reason);
+    void followPresenter();
+    void exportDocument(const std::string& extension);
+    void exported(bool wait);
+    void drawUi(sf::RenderTarget& target, const sf::Drawable& drawable, std::size_t vertices);
+
+    sf::Vector2u size;
+    sf::Vector2i mouse;
+    bool textCursor;
+    bool redraw, caretDrawn;
+
+    sf::Font font;
+
+    sf::Color bgc, brush;
+    float thick;
+    int fillTolerance;
+    std::vector<sf::Color> bgColors;
+    int bgIndex;
+
+    Document doc;
+    History history;
+    std::string path;
+    std::uint32_t generation;
+    std::vector<std::uint8_t> changes;
+    Autosave autosave;
+    Compactor compactor;
+    Exporter::Task exporting;
+    std::size_t memoryBudget;
+    // Document size when the budget was last checked.
+    std::size_t checkedSize;
+
+    ShareServer server;
+    // Messages going out this frame, and a snapshot for viewers joining.
+    std::vector<std::uint8_t> shareFrame, snapshot;
+    // Samples of the stroke being drawn that viewers have, and the camera
+    // they last got.
+    std::size_t sharedSamples;
+    sf::Vector2f sharedCenter, sharedSize;
+    // Items were renumbered, so every viewer needs a fresh snapshot.
+    bool resync;
+
+    ShareClient client;
+    ShareStream::Reader shareReader;
+    DocumentFile::Touched touched;
+    bool viewing, following;
+    sf::Vector2f presenterCenter, presenterSize;
+    // The presenter's stroke in progress.
+    Stroke remoteStroke;
+    std::vector<Stroke::Sample> remoteSamples, receivedSamples;
+
+    Canvas canvas;
+    // Maps document units onto the window; UI is drawn in window pixels.
+    sf::View camera;
+
+    bool isDrawing, showPicker, isRect, isCircle, isTyping, isTri, isPanning, rainbowModeActive;
+    float rainbowHue;
+    sf::Clock rainbowClock;
+
+    int triClicks;
+    sf::Vector2f triPts[3];
+    Stroke stroke, strokeTail;
+    StrokeSampler sampler;
+    std::vector<sf::Vector2f> strokePoints;
+    // Width the stroke being drawn has eased to, and when it last moved.
+    float inkWidth, inkTime;
+    // The tail last drawn included a prediction, which the next frame moves.
+    bool tailPredicted;
+    sf::Clock inputClock;
+    sf::Time eventTime;
+    sf::Vector2f rectStart, circCenter;
+    // Text being typed, shaped a character at a time into typedVertices.
+    sf::String typed;
+    GlyphRun typedRun;
+    std::vector<sf::Vertex> typedVertices;
+    sf::Vector2f textPosition;
+    sf::Color textColor;
+    unsigned textSize;
+    sf::Clock caretClock;
+
+    DrawingMode mode;
+
+    // Items picked with the select tool, by id, and the area they cover.
+    std::vector<std::uint32_t> selection, picked;
+    sf::FloatRect selectionBounds;
+    // What dragging with the select tool does, and the transform it has
+    // built so far. Items it moves are lifted out of the canvas and drawn
+    // from vertices made once, under that transform, until released.
+    enum class Drag { None, Band, Move, Scale, Rotate };
+    Drag drag;
+    sf::Vector2f dragStart, dragPoint, dragPivot;
+    sf::Transform dragTransform;
+    std::vector<Document::Batch> lifted;
+    bool shiftHeld;
+    // The eraser's last position, and whether this pass has recorded
+    // anything yet, so the rest joins it as one undo step.
+    bool isErasing, erased;
+    sf::Vector2f eraserPoint;
+    std::vector<Document::Piece> kept;
+    std::vector<std::uint32_t> hits;
+    // Area the undo or redo step being applied has changed, so it is
+    // repainted once; empty while its width is negative.
+    sf::FloatRect stepArea;
+
+    Toolbar toolbar;
+    sf::FloatRect bgBtn, squaresBtn, drawBtn, circleBtn, textBtn, triBtn, rainbowModeBtn, bucketBtn, colorWheel;
+    ColorPicker colorPick;
+
+#ifdef DIBUJO_PROFILE
+    void toggleTrace();
+
+    PerfHud hud;
+    bool showHud;
+#endif
+};
+
+#endif
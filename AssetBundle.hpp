@@ -0,0 +1,49 @@
+#ifndef ASSETBUNDLE_HPP
+#define ASSETBUNDLE_HPP
+
+#include <SFML/Graphics/Rect.hpp>
+#include <cstddef>
+
+// Every asset dibujo needs, compiled into the binary. AssetBundle.cpp is
+// generated by bundle.cpp from the files in the source tree and rebuilt by
+// the makefile whenever one of them changes, so startup never searches the
+// filesystem or decodes an image.
+namespace AssetBundle
+{
+    struct Blob
+    {
+        const unsigned char* data;
+        std::size_t size;
+    };
+
+    // arial.ttf, for sf::Font::loadFromMemory.
+    extern const Blob font;
+    // logo.png, encoded; only the window icon uses it.
+    extern const Blob logo;
+
+    // Regions of the toolbar atlas. ColorWheel is the rainbow wheel,
+    // rendered at build time; White is a solid block for flat fills; Label
+    // is left transparent for text baked in at runtime.
+    enum Sprite
+    {
+        Squares,
+        Draw,
+        Circle,
+        Text,
+        Triangle,
+        Rainbow,
+        Bucket,
+        ColorWheel,
+        White,
+        Label,
+        SpriteCount
+    };
+
+    // The atlas as raw RGBA pixels, ready for sf::Texture::create/update.
+    extern const unsigned atlasWidth;
+    extern const unsigned atlasHeight;
+    extern const unsigned char atlasPixels[];
+    extern const sf::IntRect sprites[SpriteCount];
+}
+
+#endif
@@ -0,0 +1,16 @@
+#include "Assets.hpp"
+#include "AssetBundle.hpp"
+
+namespace Assets
+{
+    bool loadFont(sf::Font& font)
+    {
+        return font.loadFromMemory(AssetBundle::font.data, AssetBundle::font.size);
+    }
+
+    const unsigned char* fontData(std::size_t& size)
+    {
+        size = AssetBundle::font.size;
+        return AssetBundle::font.data;
+    }
+}
@@ -0,0 +1,15 @@
+#ifndef ASSETS_HPP
+#define ASSETS_HPP
+
+#include <SFML/Graphics.hpp>
+#include <cstddef>
+
+namespace Assets
+{
+    // The bundled arial.ttf; see AssetBundle.
+    bool loadFont(sf::Font& font);
+    // The same font's file, for rendering glyphs without sf::Font.
+    const unsigned char* fontData(std::size_t& size);
+}
+
+#endif
@@ -0,0 +1,87 @@
+#include "Autosave.hpp"
+#include "DocumentFile.hpp"
+
+#if !defined(_WIN32)
+#include <unistd.h>
+#endif
+
+Autosave::Autosave()
+    : file(nullptr), stopping(false)
+{
+}
+
+Autosave::~Autosave()
+{
+    stop();
+}
+
+bool Autosave::start(const std::string& path, std::uint32_t generation)
+{
+    stop();
+    file = std::fopen(path.c_str(), "wb");
+    if (!file) return false;
+
+    std::vector<std::uint8_t> header;
+    DocumentFile::writeJournalHeader(generation, header);
+    std::fwrite(header.data(), 1, header.size(), file);
+    std::fflush(file);
+
+    stopping = false;
+    worker = std::thread(&Autosave::run, this);
+    return true;
+}
+
+void Autosave::push(std::vector<std::uint8_t>& records)
+{
+    if (records.empty()) return;
+    if (!file)
+    {
+        records.clear();
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (pending.empty()) pending.swap(records);
+        else pending.insert(pending.end(), records.begin(), records.end());
+    }
+    records.clear();
+    wake.notify_one();
+}
+
+void Autosave::stop()
+{
+    if (!worker.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    worker.join();
+    std::fclose(file);
+    file = nullptr;
+}
+
+bool Autosave::isRunning() const
+{
+    return file != nullptr;
+}
+
+void Autosave::run()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;)
+    {
+        wake.wait(lock, [this] { return stopping || !pending.empty(); });
+        if (pending.empty()) return;
+
+        writing.swap(pending);
+        lock.unlock();
+        std::fwrite(writing.data(), 1, writing.size(), file);
+        std::fflush(file);
+#if !defined(_WIN32)
+        ::fsync(fileno(file));
+#endif
+        writing.clear();
+        lock.lock();
+    }
+}
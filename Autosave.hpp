@@ -0,0 +1,48 @@
+#ifndef AUTOSAVE_HPP
+#define AUTOSAVE_HPP
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Appends journal records to disk on a background thread, so the UI thread
+// never waits on the file system. Records handed over between writes are
+// batched into one write and one fsync; the two buffers are swapped rather
+// than copied.
+class Autosave
+{
+public:
+    Autosave();
+    ~Autosave();
+
+    Autosave(const Autosave&) = delete;
+    Autosave& operator=(const Autosave&) = delete;
+
+    // Starts a fresh journal at path for the given document generation.
+    bool start(const std::string& path, std::uint32_t generation);
+
+    // Queues the records and clears records. Never blocks on I/O.
+    void push(std::vector<std::uint8_t>& records);
+
+    // Writes whatever is still queued and closes the journal.
+    void stop();
+
+    bool isRunning() const;
+
+private:
+    void run();
+
+    std::FILE* file;
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::vector<std::uint8_t> pending;
+    std::vector<std::uint8_t> writing;
+    bool stopping;
+};
+
+#endif
@@ -0,0 +1,244 @@
+#include "Canvas.hpp"
+#include "Document.hpp"
+#include "RenderStats.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    // Past this many separate regions a single full repaint is cheaper.
+    const std::size_t maxDirtyRegions = 16;
+
+    // Below this zoom, small items come from imposter tiles, building no
+    // more than tileBudget new tiles per dirty region and frame.
+    const float imposterScale = 0.5f;
+    const int tileBudget = 8;
+
+    sf::IntRect unite(const sf::IntRect& a, const sf::IntRect& b)
+    {
+        int left = std::min(a.left, b.left);
+        int top = std::min(a.top, b.top);
+        int right = std::max(a.left + a.width, b.left + b.width);
+        int bottom = std::max(a.top + a.height, b.top + b.height);
+        return sf::IntRect(left, top, right - left, bottom - top);
+    }
+}
+
+Canvas::Canvas()
+    : background(sf::Color::Black), fullRepaint(true)
+{
+}
+
+bool Canvas::create(unsigned width, unsigned height)
+{
+    if (!texture.create(width, height) || !scrollBuffer.create(width, height)) return false;
+    sprite.setTexture(texture.getTexture(), true);
+    view = texture.getDefaultView();
+    fullRepaint = true;
+    dirty.clear();
+    return true;
+}
+
+void Canvas::setBackground(sf::Color color)
+{
+    if (color == background) return;
+    background = color;
+    fullRepaint = true;
+    dirty.clear();
+}
+
+void Canvas::setView(const sf::View& camera)
+{
+    if (camera.getCenter() == view.getCenter() && camera.getSize() == view.getSize()) return;
+
+    bool sameZoom = camera.getSize() == view.getSize();
+    sf::Vector2f shift = (camera.getCenter() - view.getCenter()) * getScale();
+    view = camera;
+    if (sameZoom && !fullRepaint)
+    {
+        float dx = std::round(shift.x), dy = std::round(shift.y);
+        sf::Vector2u size = texture.getSize();
+        if (std::fabs(shift.x - dx) < 1e-2f && std::fabs(shift.y - dy) < 1e-2f &&
+            std::fabs(dx) < size.x && std::fabs(dy) < size.y)
+        {
+            scroll((int)dx, (int)dy);
+            return;
+        }
+    }
+    fullRepaint = true;
+    dirty.clear();
+}
+
+const sf::View& Canvas::getView() const
+{
+    return view;
+}
+
+float Canvas::getScale() const
+{
+    return texture.getSize().x / view.getSize().x;
+}
+
+void Canvas::scroll(int dx, int dy)
+{
+    // A render texture cannot sample itself, so bounce through a second one.
+    sf::Sprite shifted(texture.getTexture());
+    shifted.setPosition((float)-dx, (float)-dy);
+    scrollBuffer.clear(background);
+    scrollBuffer.draw(shifted, sf::BlendNone);
+    scrollBuffer.display();
+    texture.setView(texture.getDefaultView());
+    texture.draw(sf::Sprite(scrollBuffer.getTexture()), sf::BlendNone);
+    texture.display();
+    RenderStats::draw(8);
+
+    sf::Vector2u size = texture.getSize();
+    int w = (int)size.x, h = (int)size.y;
+    painting.swap(dirty);
+    dirty.clear();
+    for (const auto& region : painting)
+    {
+        invalidatePixels(sf::IntRect(region.left - dx, region.top - dy, region.width, region.height));
+    }
+    painting.clear();
+    if (dx > 0) invalidatePixels(sf::IntRect(w - dx, 0, dx, h));
+    if (dx < 0) invalidatePixels(sf::IntRect(0, 0, -dx, h));
+    if (dy > 0) invalidatePixels(sf::IntRect(0, h - dy, w, dy));
+    if (dy < 0) invalidatePixels(sf::IntRect(0, 0, w, -dy));
+}
+
+void Canvas::append(const Document& document, std::uint32_t id)
+{
+    tiles.invalidate(document.getBounds(id));
+    texture.setView(view);
+    document.drawItem(id, texture, sf::RenderStates::Default, getScale());
+    texture.setView(texture.getDefaultView());
+    texture.display();
+}
+
+void Canvas::invalidate(const sf::FloatRect& area)
+{
+    tiles.invalidate(area);
+    if (fullRepaint) return;
+
+    float scale = getScale();
+    sf::Vector2f origin = view.getCenter() - view.getSize() / 2.f;
+    int left = (int)std::floor((area.left - origin.x) * scale);
+    int top = (int)std::floor((area.top - origin.y) * scale);
+    int right = (int)std::ceil((area.left + area.width - origin.x) * scale);
+    int bottom = (int)std::ceil((area.top + area.height - origin.y) * scale);
+    invalidatePixels(sf::IntRect(left, top, right - left, bottom - top));
+}
+
+void Canvas::invalidatePixels(const sf::IntRect& area)
+{
+    if (fullRepaint) return;
+
+    sf::Vector2u size = texture.getSize();
+    int left = std::max(0, area.left - 1);
+    int top = std::max(0, area.top - 1);
+    int right = std::min((int)size.x, area.left + area.width + 1);
+    int bottom = std::min((int)size.y, area.top + area.height + 1);
+    if (right <= left || bottom <= top) return;
+
+    sf::IntRect region(left, top, right - left, bottom - top);
+    for (std::size_t i = 0; i < dirty.size();)
+    {
+        if (dirty[i].intersects(region))
+        {
+            region = unite(region, dirty[i]);
+            dirty.erase(dirty.begin() + i);
+            i = 0;
+        }
+        else
+        {
+            ++i;
+        }
+    }
+    dirty.push_back(region);
+    if (dirty.size() > maxDirtyRegions)
+    {
+        fullRepaint = true;
+        dirty.clear();
+    }
+}
+
+void Canvas::invalidateAll()
+{
+    tiles.clear();
+    fullRepaint = true;
+    dirty.clear();
+}
+
+bool Canvas::isDirty() const
+{
+    return fullRepaint || !dirty.empty();
+}
+
+void Canvas::repaint(const Document& document)
+{
+    sf::Vector2u size = texture.getSize();
+    painting.swap(dirty);
+    dirty.clear();
+    if (fullRepaint)
+    {
+        painting.assign(1, sf::IntRect(0, 0, (int)size.x, (int)size.y));
+        fullRepaint = false;
+    }
+
+    // Regions still waiting on imposter tiles stay dirty for the next frame.
+    for (const auto& region : painting)
+    {
+        if (!paintRegion(region, document)) invalidatePixels(region);
+    }
+    painting.clear();
+    texture.setView(texture.getDefaultView());
+    texture.display();
+}
+
+sf::FloatRect Canvas::areaOf(const sf::IntRect& region) const
+{
+    float scale = getScale();
+    sf::Vector2f origin = view.getCenter() - view.getSize() / 2.f;
+    return sf::FloatRect(origin.x + region.left / scale, origin.y + region.top / scale,
+                         region.width / scale, region.height / scale);
+}
+
+bool Canvas::paintRegion(const sf::IntRect& region, const Document& document)
+{
+    sf::Vector2u size = texture.getSize();
+    sf::FloatRect area = areaOf(region);
+    sf::View clip(area);
+    clip.setViewport(sf::FloatRect((float)region.left / size.x, (float)region.top / size.y,
+                                   (float)region.width / size.x, (float)region.height / size.y));
+    texture.setView(clip);
+
+    sf::RectangleShape fill(sf::Vector2f(area.width, area.height));
+    fill.setPosition(area.left, area.top);
+    fill.setFillColor(background);
+    texture.draw(fill, sf::BlendNone);
+
+    Document::Detail detail;
+    detail.scale = getScale();
+    document.drawRaster(texture, sf::RenderStates::Default, area, detail.scale);
+    bool complete = true;
+    if (detail.scale < imposterScale)
+    {
+        int level = TileCache::levelFor(detail.scale);
+        complete = tiles.draw(texture, area, level, document, tileBudget);
+        detail.minExtent = TileCache::extentLimit(level);
+    }
+    document.draw(texture, sf::RenderStates::Default, &area, detail);
+    return complete;
+}
+
+const sf::Texture& Canvas::getTexture() const
+{
+    return texture.getTexture();
+}
+
+void Canvas::draw(sf::RenderTarget& target, sf::RenderStates states) const
+{
+    target.draw(sprite, states);
+    RenderStats::draw(4);
+}
@@ -0,0 +1,63 @@
+#ifndef CANVAS_HPP
+#define CANVAS_HPP
+
+#include <SFML/Graphics.hpp>
+#include <cstdint>
+#include <vector>
+#include "TileCache.hpp"
+
+class Document;
+
+// Off-screen layer holding the committed drawing as seen through a camera
+// view. New items are composited on top as they are committed; edits to
+// existing items mark dirty rectangles that are repainted from the document
+// on the next repaint(). Panning by whole pixels scrolls the cached pixels
+// and only repaints the strips that came into view. Zoomed out, items too
+// small to see individually come from a TileCache instead of the document.
+class Canvas : public sf::Drawable
+{
+public:
+    Canvas();
+
+    bool create(unsigned width, unsigned height);
+    void setBackground(sf::Color color);
+
+    // Camera in document units. The view must keep the layer's aspect ratio.
+    void setView(const sf::View& view);
+    const sf::View& getView() const;
+
+    // Screen pixels per document unit.
+    float getScale() const;
+
+    // Draws a freshly committed item straight into the cached layer.
+    void append(const Document& document, std::uint32_t id);
+
+    // Marks a document-space area as changed.
+    void invalidate(const sf::FloatRect& area);
+
+    // Marks the whole document as changed.
+    void invalidateAll();
+    bool isDirty() const;
+
+    // Rebakes every dirty rectangle, clipped so untouched pixels are kept.
+    void repaint(const Document& document);
+
+    const sf::Texture& getTexture() const;
+
+private:
+    void draw(sf::RenderTarget& target, sf::RenderStates states) const override;
+    void invalidatePixels(const sf::IntRect& region);
+    void scroll(int dx, int dy);
+    sf::FloatRect areaOf(const sf::IntRect& region) const;
+    bool paintRegion(const sf::IntRect& region, const Document& document);
+
+    sf::RenderTexture texture, scrollBuffer;
+    sf::Sprite sprite;
+    sf::Color background;
+    sf::View view;
+    TileCache tiles;
+    std::vector<sf::IntRect> dirty, painting;
+    bool fullRepaint;
+};
+
+#endif
@@ -0,0 +1,270 @@
+#include "Color.hpp"
+#include "RenderStats.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    const float twoPi = 6.2831853f;
+    const float barGap = 4.f;
+
+    // One channel of the branch-free HSV formula, with h6 = hue / 60 in [0, 6)
+    // and n = 5, 3, 1 for red, green and blue.
+    inline float channel(float n, float h6, float s, float v)
+    {
+        float k = n + h6;
+        k = k >= 6.f ? k - 6.f : k;
+        float t = std::min(std::min(k, 4.f - k), 1.f);
+        t = t > 0.f ? t : 0.f;
+        return v - v * s * t;
+    }
+
+    inline float wrapHue(float h)
+    {
+        h = std::fmod(h, 360.f);
+        return h < 0.f ? h + 360.f : h;
+    }
+
+    inline void store(sf::Uint8* px, float r, float g, float b, sf::Uint8 a)
+    {
+        px[0] = (sf::Uint8)(r * 255.f);
+        px[1] = (sf::Uint8)(g * 255.f);
+        px[2] = (sf::Uint8)(b * 255.f);
+        px[3] = a;
+    }
+
+    // Polynomial atan2 (max error ~0.0015 rad), written with selects only so
+    // the wheel loop vectorises instead of calling libm per pixel.
+    inline float fastAtan2(float y, float x)
+    {
+        float ax = std::fabs(x), ay = std::fabs(y);
+        float lo = std::min(ax, ay), hi = std::max(ax, ay);
+        float a = lo / (hi + 1e-20f);
+        float s = a * a;
+        float r = ((-0.0464964749f * s + 0.15931422f) * s - 0.327622764f) * s * a + a;
+        r = ay > ax ? 1.57079637f - r : r;
+        r = x < 0.f ? 3.14159274f - r : r;
+        return y < 0.f ? -r : r;
+    }
+}
+
+sf::Color HsvToRgb(float H, float S, float V)
+{
+    sf::Uint8 px[4];
+    ColorSpace::hsvToRgb(&H, &S, &V, px, 1);
+    return sf::Color(px[0], px[1], px[2]);
+}
+
+sf::Color getColorFromPosition(int x, int y, int w, int h)
+{
+    float r = (float)x / w * 255.f;
+    float g = (float)y / h * 255.f;
+    float b = (float)(w - x) / w * 255.f;
+    return sf::Color((sf::Uint8)r, (sf::Uint8)g, (sf::Uint8)b);
+}
+
+namespace ColorSpace
+{
+    void hsvToRgb(const float* h, const float* s, const float* v, sf::Uint8* rgba, std::size_t count)
+    {
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            float h6 = wrapHue(h[i]) / 60.f;
+            store(rgba + i * 4, channel(5.f, h6, s[i], v[i]), channel(3.f, h6, s[i], v[i]),
+                  channel(1.f, h6, s[i], v[i]), 255);
+        }
+    }
+
+    void fillGradient(sf::Uint8* rgba, unsigned width, unsigned height)
+    {
+        const float sx = 255.f / width, sy = 255.f / height;
+        for (unsigned y = 0; y < height; ++y)
+        {
+            sf::Uint8* row = rgba + (std::size_t)y * width * 4;
+            const sf::Uint8 g = (sf::Uint8)((float)y * sy);
+            for (unsigned x = 0; x < width; ++x)
+            {
+                row[x * 4] = (sf::Uint8)((float)x * sx);
+                row[x * 4 + 1] = g;
+                row[x * 4 + 2] = (sf::Uint8)((float)(width - x) * sx);
+                row[x * 4 + 3] = 255;
+            }
+        }
+    }
+
+    void fillSaturationValue(sf::Uint8* rgba, unsigned width, unsigned height, float hue)
+    {
+        const float h6 = wrapHue(hue) / 60.f;
+        const float ds = width > 1 ? 1.f / (width - 1) : 0.f;
+        const float dv = height > 1 ? 1.f / (height - 1) : 0.f;
+        // The hue only decides the shape of each channel; hoist it out of the loops.
+        const float tr = 1.f - channel(5.f, h6, 1.f, 1.f);
+        const float tg = 1.f - channel(3.f, h6, 1.f, 1.f);
+        const float tb = 1.f - channel(1.f, h6, 1.f, 1.f);
+        for (unsigned y = 0; y < height; ++y)
+        {
+            sf::Uint8* row = rgba + (std::size_t)y * width * 4;
+            const float v = 1.f - y * dv;
+            for (unsigned x = 0; x < width; ++x)
+            {
+                const float vs = v * (x * ds);
+                store(row + x * 4, v - vs * tr, v - vs * tg, v - vs * tb, 255);
+            }
+        }
+    }
+
+    void fillHueBar(sf::Uint8* rgba, unsigned width, unsigned height)
+    {
+        const float dh = width > 1 ? 6.f / width : 0.f;
+        for (unsigned x = 0; x < width; ++x)
+        {
+            const float h6 = x * dh;
+            store(rgba + x * 4, channel(5.f, h6, 1.f, 1.f), channel(3.f, h6, 1.f, 1.f),
+                  channel(1.f, h6, 1.f, 1.f), 255);
+        }
+        for (unsigned y = 1; y < height; ++y)
+        {
+            std::copy(rgba, rgba + (std::size_t)width * 4, rgba + (std::size_t)y * width * 4);
+        }
+    }
+
+    void fillColorWheel(sf::Uint8* rgba, unsigned diameter)
+    {
+        const float radius = diameter * 0.5f;
+        for (unsigned y = 0; y < diameter; ++y)
+        {
+            sf::Uint8* row = rgba + (std::size_t)y * diameter * 4;
+            const float dy = y - radius;
+            for (unsigned x = 0; x < diameter; ++x)
+            {
+                const float dx = x - radius;
+                float angle = fastAtan2(dy, dx);
+                angle = angle < 0.f ? angle + twoPi : angle;
+                const float h6 = std::min(angle * (6.f / twoPi), 5.9999f);
+                const float in = dx * dx + dy * dy <= radius * radius ? 1.f : 0.f;
+                store(row + x * 4, in * channel(5.f, h6, 1.f, 1.f), in * channel(3.f, h6, 1.f, 1.f),
+                      in * channel(1.f, h6, 1.f, 1.f), (sf::Uint8)(in * 255.f));
+            }
+        }
+    }
+}
+
+ColorPicker::ColorPicker()
+    : size(150), barHeight(14), style(Style::Gradient), hue(0.f), squareDirty(true), barDirty(true)
+{
+}
+
+void ColorPicker::setSize(unsigned s)
+{
+    if (s == size) return;
+    size = s;
+    squareDirty = barDirty = true;
+}
+
+void ColorPicker::setStyle(Style s)
+{
+    if (s == style) return;
+    style = s;
+    squareDirty = true;
+}
+
+ColorPicker::Style ColorPicker::getStyle() const
+{
+    return style;
+}
+
+void ColorPicker::setHue(float h)
+{
+    h = wrapHue(h);
+    if (h == hue) return;
+    hue = h;
+    if (style == Style::Hsv) squareDirty = true;
+}
+
+sf::FloatRect ColorPicker::getBounds() const
+{
+    float height = (float)size;
+    if (style == Style::Hsv) height += barGap + barHeight;
+    return getTransform().transformRect(sf::FloatRect(0.f, 0.f, (float)size, height));
+}
+
+bool ColorPicker::pick(const sf::Vector2f& point, sf::Color& color)
+{
+    sf::Vector2f local = getInverseTransform().transformPoint(point);
+    if (local.x < 0.f || local.y < 0.f || local.x >= size) return false;
+
+    int x = (int)local.x, y = (int)local.y;
+    if (y < (int)size)
+    {
+        if (style == Style::Gradient)
+        {
+            color = getColorFromPosition(x, y, size, size);
+        }
+        else
+        {
+            float span = size > 1 ? (float)(size - 1) : 1.f;
+            color = HsvToRgb(hue, x / span, 1.f - y / span);
+        }
+        return true;
+    }
+    if (style == Style::Hsv && local.y >= size + barGap && local.y < size + barGap + barHeight)
+    {
+        setHue(local.x / size * 360.f);
+    }
+    return false;
+}
+
+void ColorPicker::refresh() const
+{
+    if (squareDirty)
+    {
+        pixels.resize((std::size_t)size * size * 4);
+        if (style == Style::Gradient) ColorSpace::fillGradient(pixels.data(), size, size);
+        else ColorSpace::fillSaturationValue(pixels.data(), size, size, hue);
+        if (square.getSize() != sf::Vector2u(size, size)) square.create(size, size);
+        square.update(pixels.data());
+        RenderStats::upload();
+        squareDirty = false;
+    }
+    if (barDirty && style == Style::Hsv)
+    {
+        pixels.resize((std::size_t)size * barHeight * 4);
+        ColorSpace::fillHueBar(pixels.data(), size, barHeight);
+        if (bar.getSize() != sf::Vector2u(size, barHeight)) bar.create(size, barHeight);
+        bar.update(pixels.data());
+        RenderStats::upload();
+        barDirty = false;
+    }
+}
+
+void ColorPicker::draw(sf::RenderTarget& target, sf::RenderStates states) const
+{
+    refresh();
+    states.transform *= getTransform();
+
+    float s = (float)size;
+    sf::Vertex quad[4] = {
+        sf::Vertex({0.f, 0.f}, {0.f, 0.f}), sf::Vertex({s, 0.f}, {s, 0.f}),
+        sf::Vertex({0.f, s}, {0.f, s}), sf::Vertex({s, s}, {s, s})};
+    states.texture = &square;
+    target.draw(quad, 4, sf::TriangleStrip, states);
+    RenderStats::draw(4);
+
+    if (style == Style::Hsv)
+    {
+        float top = s + barGap, bottom = top + barHeight, h = (float)barHeight;
+        sf::Vertex strip[4] = {
+            sf::Vertex({0.f, top}, {0.f, 0.f}), sf::Vertex({s, top}, {s, 0.f}),
+            sf::Vertex({0.f, bottom}, {0.f, h}), sf::Vertex({s, bottom}, {s, h})};
+        states.texture = &bar;
+        target.draw(strip, 4, sf::TriangleStrip, states);
+        RenderStats::draw(4);
+
+        float marker = hue / 360.f * s;
+        sf::Vertex line[2] = {sf::Vertex({marker, top}, sf::Color::Black),
+                              sf::Vertex({marker, bottom}, sf::Color::Black)};
+        states.texture = nullptr;
+        target.draw(line, 2, sf::Lines, states);
+        RenderStats::draw(2);
+    }
+}
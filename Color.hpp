@@ -0,0 +1,69 @@
+#ifndef COLOR_HPP
+#define COLOR_HPP
+
+#include <SFML/Graphics.hpp>
+#include <cstddef>
+#include <vector>
+
+sf::Color HsvToRgb(float H, float S, float V);
+sf::Color getColorFromPosition(int x, int y, int w, int h);
+
+// Batch colour kernels. Every loop is branch-free straight-line arithmetic
+// over contiguous buffers so the compiler can vectorise it; rgba outputs
+// are tightly packed 8-bit RGBA, ready for sf::Texture::update.
+namespace ColorSpace
+{
+    void hsvToRgb(const float* h, const float* s, const float* v, sf::Uint8* rgba, std::size_t count);
+
+    // The classic picker gradient, identical to getColorFromPosition per pixel.
+    void fillGradient(sf::Uint8* rgba, unsigned width, unsigned height);
+
+    // Saturation left to right, value top to bottom, for one hue.
+    void fillSaturationValue(sf::Uint8* rgba, unsigned width, unsigned height, float hue);
+
+    // Fully saturated hues from 0 to 360 degrees, left to right.
+    void fillHueBar(sf::Uint8* rgba, unsigned width, unsigned height);
+
+    // Hue by angle around the centre, transparent outside the inscribed circle.
+    void fillColorWheel(sf::Uint8* rgba, unsigned diameter);
+}
+
+// Colour picker whose textures are generated once and only rebuilt when the
+// size, style or (for the HSV square) the selected hue changes.
+class ColorPicker : public sf::Drawable, public sf::Transformable
+{
+public:
+    enum class Style
+    {
+        Gradient,
+        Hsv
+    };
+
+    ColorPicker();
+
+    void setSize(unsigned size);
+    void setStyle(Style style);
+    Style getStyle() const;
+    void setHue(float hue);
+    sf::FloatRect getBounds() const;
+
+    // Picks the colour under a window-space point. Clicking the hue bar only
+    // moves the hue and returns false.
+    bool pick(const sf::Vector2f& point, sf::Color& color);
+
+private:
+    void draw(sf::RenderTarget& target, sf::RenderStates states) const override;
+    void refresh() const;
+
+    unsigned size;
+    unsigned barHeight;
+    Style style;
+    float hue;
+    mutable bool squareDirty;
+    mutable bool barDirty;
+    mutable std::vector<sf::Uint8> pixels;
+    mutable sf::Texture square;
+    mutable sf::Texture bar;
+};
+
+#endif
@@ -0,0 +1,123 @@
+#include "Compactor.hpp"
+#include "Document.hpp"
+#include "Exporter.hpp"
+#include "WorkerPool.hpp"
+#include <algorithm>
+#include <cmath>
+
+struct Compactor::Job
+{
+    std::uint32_t count;
+    Document items;
+    RasterLayer layer;
+    std::unique_ptr<Exporter::Raster> raster;
+    std::atomic<bool> cancelled;
+};
+
+Compactor::Compactor()
+    : done(false)
+{
+}
+
+Compactor::~Compactor()
+{
+    if (!worker.joinable()) return;
+    job->cancelled = true;
+    worker.join();
+}
+
+bool Compactor::start(Document& document, std::uint32_t count)
+{
+    if (job || count == 0) return false;
+    job = std::make_unique<Job>();
+    job->count = count;
+    job->cancelled = false;
+    document.freeze(count);
+    document.copyItems(count, job->items);
+    job->layer = job->items.getRaster();
+    job->raster = std::make_unique<Exporter::Raster>(job->items, job->layer.getPixelsPerUnit());
+
+    done = false;
+    Job& j = *job;
+    worker = std::thread([this, &j] {
+        flatten(j);
+        done = true;
+    });
+    return true;
+}
+
+bool Compactor::isRunning() const
+{
+    return job != nullptr;
+}
+
+bool Compactor::isDone() const
+{
+    return job && done;
+}
+
+std::uint32_t Compactor::poll(Document& document)
+{
+    if (!job || !done) return 0;
+    if (worker.joinable()) worker.join();
+    std::uint32_t count = job->count;
+    document.flatten(count, job->layer);
+    job.reset();
+    return count;
+}
+
+std::uint32_t Compactor::run(Document& document, std::uint32_t count)
+{
+    if (!start(document, count)) return 0;
+    worker.join();
+    return poll(document);
+}
+
+void Compactor::flatten(Job& job)
+{
+    const std::int32_t size = (std::int32_t)RasterLayer::tileSize;
+    float pixelsPerUnit = job.layer.getPixelsPerUnit();
+    float span = size / pixelsPerUnit;
+    // Anti-aliased edges reach a pixel past the bounds.
+    float pad = 1.f / pixelsPerUnit;
+
+    std::vector<sf::Vector2i> changed;
+    for (std::uint32_t id = 0; id < job.items.size(); ++id)
+    {
+        const sf::FloatRect& b = job.items.getBounds(id);
+        std::int32_t x0 = (std::int32_t)std::floor((b.left - pad) / span);
+        std::int32_t y0 = (std::int32_t)std::floor((b.top - pad) / span);
+        std::int32_t x1 = (std::int32_t)std::floor((b.left + b.width + pad) / span);
+        std::int32_t y1 = (std::int32_t)std::floor((b.top + b.height + pad) / span);
+        for (std::int32_t y = y0; y <= y1; ++y)
+        {
+            for (std::int32_t x = x0; x <= x1; ++x) changed.push_back(sf::Vector2i(x, y));
+        }
+    }
+    std::sort(changed.begin(), changed.end(), [](const sf::Vector2i& a, const sf::Vector2i& b) {
+        return a.y != b.y ? a.y < b.y : a.x < b.x;
+    });
+    changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+
+    // Tiles already there are drawn underneath by the rasterizer itself.
+    // One thread is left to the window.
+    std::vector<RasterLayer::Data> rendered(changed.size());
+    {
+        WorkerPool pool(std::max(2u, std::thread::hardware_concurrency()) - 1);
+        for (std::size_t i = 0; i < changed.size(); ++i)
+        {
+            pool.submit([&, i] {
+                if (job.cancelled) return;
+                std::vector<std::uint8_t> pixels((std::size_t)size * size * 4);
+                const sf::Vector2i& tile = changed[i];
+                job.raster->render((std::int64_t)tile.x * size, (std::int64_t)tile.y * size, size, size,
+                                   pixels.data(), (std::size_t)size * 4);
+                rendered[i] = RasterLayer::encode(pixels.data());
+            });
+        }
+        pool.wait();
+    }
+    if (job.cancelled) return;
+    for (std::size_t i = 0; i < changed.size(); ++i) job.layer.set(0, changed[i].x, changed[i].y, rendered[i]);
+    job.layer.rebuildPyramid(changed);
+}
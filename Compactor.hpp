@@ -0,0 +1,50 @@
+#ifndef COMPACTOR_HPP
+#define COMPACTOR_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+class Document;
+
+// Keeps long sessions within a memory budget by flattening the oldest items
+// of a document into its raster layer on a background thread. start()
+// copies what the job needs on the calling thread; the document stays fully
+// usable meanwhile, except that the items being flattened are no longer
+// picked. Level 0 tiles under them are rendered with the exporter's CPU
+// rasterizer over the tiles already there, then the pyramid above them is
+// rebuilt; nothing touches the GPU until the result is drawn.
+class Compactor
+{
+public:
+    Compactor();
+    ~Compactor();
+
+    Compactor(const Compactor&) = delete;
+    Compactor& operator=(const Compactor&) = delete;
+
+    // Starts flattening items [0, count). False while a job is running.
+    bool start(Document& document, std::uint32_t count);
+    bool isRunning() const;
+    // True once the job has finished and poll() would apply it.
+    bool isDone() const;
+
+    // Once the job is done, frees the flattened items, installs the new
+    // tiles and returns how many items went so the caller can renumber what
+    // refers to the rest. Zero while running or idle.
+    std::uint32_t poll(Document& document);
+
+    // Runs a job to completion on the calling thread.
+    std::uint32_t run(Document& document, std::uint32_t count);
+
+private:
+    struct Job;
+    static void flatten(Job& job);
+
+    std::unique_ptr<Job> job;
+    std::thread worker;
+    std::atomic<bool> done;
+};
+
+#endif
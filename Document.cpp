@@ -0,0 +1,1221 @@
+#include "Document.hpp"
+#include "DocumentFile.hpp"
+#include "HitTest.hpp"
+#include "RenderStats.hpp"
+#include "StrokeCodec.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+    const float pi = 3.14159265f;
+
+    sf::FloatRect boundsOf(const sf::Vector2f* points, std::size_t count, float pad)
+    {
+        float left = points[0].x, top = points[0].y, right = left, bottom = top;
+        for (std::size_t i = 1; i < count; ++i)
+        {
+            left = std::min(left, points[i].x);
+            top = std::min(top, points[i].y);
+            right = std::max(right, points[i].x);
+            bottom = std::max(bottom, points[i].y);
+        }
+        return sf::FloatRect(left - pad, top - pad, right - left + 2 * pad, bottom - top + 2 * pad);
+    }
+
+    // Drops samples closer than spacing to the last one kept, so a stroke
+    // seen from far away is not tessellated finer than the screen can show.
+    // Returns how many are left.
+    std::size_t decimate(Stroke::Sample* samples, std::size_t count, float spacing)
+    {
+        if (count < 3) return count;
+        float spacing2 = spacing * spacing;
+        std::size_t kept = 1;
+        for (std::size_t i = 1; i + 1 < count; ++i)
+        {
+            sf::Vector2f d = samples[i].position - samples[kept - 1].position;
+            if (d.x * d.x + d.y * d.y >= spacing2) samples[kept++] = samples[i];
+        }
+        samples[kept++] = samples[count - 1];
+        return kept;
+    }
+
+    sf::FloatRect unite(const sf::FloatRect& a, const sf::FloatRect& b)
+    {
+        float left = std::min(a.left, b.left), top = std::min(a.top, b.top);
+        float right = std::max(a.left + a.width, b.left + b.width);
+        float bottom = std::max(a.top + a.height, b.top + b.height);
+        return sf::FloatRect(left, top, right - left, bottom - top);
+    }
+
+    // Strokes widen by how much the transform scales areas, so a stroke
+    // scaled unevenly keeps a uniform width.
+    void placeSamples(Stroke::Sample* samples, std::size_t count, const sf::Transform& transform)
+    {
+        const float* m = transform.getMatrix();
+        float widen = std::sqrt(std::fabs(m[0] * m[5] - m[4] * m[1]));
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            samples[i].position = transform.transformPoint(samples[i].position);
+            samples[i].width *= widen;
+        }
+    }
+
+    // Appends the samples of one piece of the first count after them;
+    // nothing when there are none to take it from.
+    void appendPiece(std::vector<Stroke::Sample>& samples, std::size_t count, const Document::Piece& piece)
+    {
+        if (count == 0 || count > samples.size()) return;
+        auto at = [&](float t) {
+            std::size_t i = (std::size_t)t;
+            if (i + 1 >= count) return samples[count - 1];
+            Stroke::Sample s = samples[i];
+            const Stroke::Sample& next = samples[i + 1];
+            float f = t - (float)i;
+            s.position += (next.position - s.position) * f;
+            s.width += (next.width - s.width) * f;
+            if (f > 0.5f) s.color = next.color;
+            return s;
+        };
+        samples.push_back(at(piece.from));
+        for (std::size_t i = (std::size_t)piece.from + 1; i < count && (float)i < piece.to; ++i)
+            samples.push_back(samples[i]);
+        Stroke::Sample end = at(piece.to);
+        if (end.position != samples.back().position) samples.push_back(end);
+    }
+
+    float distanceToSegment(const sf::Vector2f& p, const sf::Vector2f& a, const sf::Vector2f& b)
+    {
+        sf::Vector2f ab = b - a, ap = p - a;
+        float length2 = ab.x * ab.x + ab.y * ab.y;
+        float t = length2 > 0.f ? std::max(0.f, std::min(1.f, (ap.x * ab.x + ap.y * ab.y) / length2)) : 0.f;
+        sf::Vector2f d = ap - ab * t;
+        return std::sqrt(d.x * d.x + d.y * d.y);
+    }
+
+    // Part [s0, s1] of the segment pq closer than reach to the segment ab.
+    // The distance is convex along pq, so that part is a single interval,
+    // found by bisection either side of the nearest point.
+    bool within(const sf::Vector2f& p, const sf::Vector2f& q, const sf::Vector2f& a, const sf::Vector2f& b,
+                float reach, float& s0, float& s1)
+    {
+        auto distance = [&](float s) { return distanceToSegment(p + (q - p) * s, a, b); };
+        float lo = 0.f, hi = 1.f;
+        for (int i = 0; i < 40; ++i)
+        {
+            float m1 = lo + (hi - lo) / 3.f, m2 = hi - (hi - lo) / 3.f;
+            if (distance(m1) < distance(m2)) hi = m2;
+            else lo = m1;
+        }
+        float nearest = (lo + hi) * 0.5f;
+        if (distance(nearest) >= reach) return false;
+        s0 = 0.f;
+        s1 = 1.f;
+        if (distance(0.f) >= reach)
+        {
+            lo = 0.f;
+            hi = nearest;
+            for (int i = 0; i < 24; ++i)
+            {
+                float m = (lo + hi) * 0.5f;
+                (distance(m) < reach ? hi : lo) = m;
+            }
+            s0 = lo;
+        }
+        if (distance(1.f) >= reach)
+        {
+            lo = nearest;
+            hi = 1.f;
+            for (int i = 0; i < 24; ++i)
+            {
+                float m = (lo + hi) * 0.5f;
+                (distance(m) < reach ? lo : hi) = m;
+            }
+            s1 = hi;
+        }
+        return true;
+    }
+
+    void appendQuad(std::vector<sf::Vertex>& out, float left, float top, float right, float bottom,
+                    sf::Color color, const sf::FloatRect& uv = sf::FloatRect())
+    {
+        float u0 = uv.left, v0 = uv.top, u1 = uv.left + uv.width, v1 = uv.top + uv.height;
+        out.push_back(sf::Vertex({left, top}, color, {u0, v0}));
+        out.push_back(sf::Vertex({right, top}, color, {u1, v0}));
+        out.push_back(sf::Vertex({left, bottom}, color, {u0, v1}));
+        out.push_back(sf::Vertex({left, bottom}, color, {u0, v1}));
+        out.push_back(sf::Vertex({right, top}, color, {u1, v0}));
+        out.push_back(sf::Vertex({right, bottom}, color, {u1, v1}));
+    }
+
+    // Marks in map the numbers below its size that are used, with 0, and
+    // then numbers those in order. Returns how many there are.
+    std::uint32_t numberUsed(const std::vector<std::uint32_t>& items, const std::vector<std::uint32_t>& used,
+                             std::vector<std::uint32_t>& map)
+    {
+        for (std::uint32_t n : items)
+        {
+            if (n < map.size()) map[n] = 0;
+        }
+        for (std::uint32_t n : used)
+        {
+            if (n < map.size()) map[n] = 0;
+        }
+        std::uint32_t kept = 0;
+        for (auto& n : map)
+        {
+            if (n != Document::none) n = kept++;
+        }
+        return kept;
+    }
+}
+
+Document::Detail::Detail()
+    : scale(1.f), minExtent(0.f), maxExtent(std::numeric_limits<float>::infinity())
+{
+}
+
+Document::Document()
+    : font(nullptr), strokeTolerance(0.5f), changeLog(nullptr), background(sf::Color::Transparent), base(0),
+      frozen(0)
+{
+}
+
+void Document::setFont(const sf::Font& f)
+{
+    font = &f;
+    shaped.clear();
+    shapedArena.clear();
+}
+
+void Document::setStrokeTolerance(float tolerance)
+{
+    strokeTolerance = std::max(0.f, tolerance);
+}
+
+void Document::setChangeLog(std::vector<std::uint8_t>* log)
+{
+    changeLog = log;
+}
+
+void Document::setBackground(sf::Color color)
+{
+    background = color;
+    if (changeLog) DocumentFile::logColor(*changeLog, DocumentFile::Op::Background, 0, color);
+}
+
+sf::Color Document::getBackground() const
+{
+    return background;
+}
+
+std::uint32_t Document::push(ItemKind kind, std::uint32_t slot, const sf::FloatRect& bounds)
+{
+    std::uint32_t id = (std::uint32_t)order.size();
+    order.push_back(ItemRef{kind, slot});
+    itemBounds.push_back(bounds);
+    index.insert(id, bounds);
+    if (changeLog) DocumentFile::logAdd(*this, id, *changeLog);
+    return id;
+}
+
+std::uint32_t Document::addRectangle(const sf::Vector2f& position, const sf::Vector2f& size, sf::Color color)
+{
+    rectangles.push_back(RectangleItem{position, size, color});
+    return push(ItemKind::Rectangle, (std::uint32_t)rectangles.size() - 1, sf::FloatRect(position, size));
+}
+
+std::uint32_t Document::addCircle(const sf::Vector2f& center, float radius, sf::Color color)
+{
+    circles.push_back(CircleItem{center, radius, color});
+    sf::FloatRect bounds(center.x - radius, center.y - radius, radius * 2, radius * 2);
+    return push(ItemKind::Circle, (std::uint32_t)circles.size() - 1, bounds);
+}
+
+std::uint32_t Document::addTriangle(const sf::Vector2f& a, const sf::Vector2f& b, const sf::Vector2f& c, sf::Color color)
+{
+    triangles.push_back(TriangleItem{{a, b, c}, color});
+    return push(ItemKind::Triangle, (std::uint32_t)triangles.size() - 1, boundsOf(triangles.back().points, 3, 0.f));
+}
+
+std::uint32_t Document::addText(const sf::String& text, const sf::Vector2f& position, unsigned size, sf::Color color)
+{
+    TextItem item{position, (std::uint32_t)glyphArena.size(), (std::uint32_t)text.getSize(), size, color};
+    for (std::size_t i = 0; i < text.getSize(); ++i) glyphArena.push_back(text[i]);
+    texts.push_back(item);
+
+    // Bound the quads that will actually be drawn.
+    sf::FloatRect bounds(position, sf::Vector2f(0.f, 0.f));
+    std::uint32_t count = 0;
+    const GlyphRun::Quad* quads = shapedText((std::uint32_t)texts.size() - 1, count);
+    for (std::uint32_t i = 0; i < count; ++i)
+    {
+        const sf::FloatRect& q = quads[i].bounds;
+        sf::FloatRect b(position.x + q.left, position.y + q.top, q.width, q.height);
+        if (i == 0) { bounds = b; continue; }
+        float right = std::max(bounds.left + bounds.width, b.left + b.width);
+        float bottom = std::max(bounds.top + bounds.height, b.top + b.height);
+        bounds.left = std::min(bounds.left, b.left);
+        bounds.top = std::min(bounds.top, b.top);
+        bounds.width = right - bounds.left;
+        bounds.height = bottom - bounds.top;
+    }
+    return push(ItemKind::Text, (std::uint32_t)texts.size() - 1, bounds);
+}
+
+std::uint32_t Document::addStroke(const Stroke& stroke)
+{
+    const auto& samples = stroke.getSamples();
+    StrokeCodec::simplify(samples.data(), samples.size(), strokeTolerance, decoded);
+
+    StrokeItem item{(std::uint32_t)strokeArena.size(), 0, (std::uint32_t)decoded.size(), sf::Color::Transparent};
+    StrokeCodec::encode(decoded.data(), decoded.size(), strokeArena);
+    item.size = (std::uint32_t)strokeArena.size() - item.first;
+    strokes.push_back(item);
+
+    // Bound what will actually be tessellated from the samples as they come
+    // back out of the arena.
+    const auto& stored = decodeStroke(item);
+    return push(ItemKind::Stroke, (std::uint32_t)strokes.size() - 1, Stroke::bounds(stored.data(), stored.size()));
+}
+
+std::uint32_t Document::addFill(const FloodFill::Region& region, sf::Color color, const sf::Vector2f& origin,
+                                float pixelSize)
+{
+    fills.push_back(FillItem{region.bounds, origin, pixelSize, (std::uint32_t)maskArena.size(),
+                             (std::uint32_t)fillTextures.size(), color});
+    maskArena.insert(maskArena.end(), region.mask.begin(), region.mask.end());
+    fillTextures.emplace_back();
+    const sf::IntRect& b = region.bounds;
+    return push(ItemKind::Fill, (std::uint32_t)fills.size() - 1,
+                sf::FloatRect(origin.x + b.left * pixelSize, origin.y + b.top * pixelSize,
+                              b.width * pixelSize, b.height * pixelSize));
+}
+
+std::uint32_t Document::clear()
+{
+    std::uint32_t previous = base;
+    base = (std::uint32_t)order.size();
+    index.clear();
+    if (changeLog) DocumentFile::logId(*changeLog, DocumentFile::Op::Clear, 0);
+    return previous;
+}
+
+void Document::restore(std::uint32_t start)
+{
+    for (std::uint32_t id = start; id < base; ++id)
+    {
+        if (id >= hidden.size() || !hidden[id]) index.insert(id, itemBounds[id]);
+    }
+    base = start;
+    if (changeLog) DocumentFile::logId(*changeLog, DocumentFile::Op::Restore, start);
+}
+
+void Document::hide(std::uint32_t id)
+{
+    if (hidden.size() <= id) hidden.resize(id + 1, false);
+    hidden[id] = true;
+    index.remove(id);
+    if (changeLog) DocumentFile::logId(*changeLog, DocumentFile::Op::Hide, id);
+}
+
+void Document::show(std::uint32_t id)
+{
+    if (id < hidden.size()) hidden[id] = false;
+    if (id >= base && !index.contains(id)) index.insert(id, itemBounds[id]);
+    if (changeLog) DocumentFile::logId(*changeLog, DocumentFile::Op::Show, id);
+}
+
+bool Document::isVisible(std::uint32_t id) const
+{
+    return index.contains(id);
+}
+
+bool Document::isEditable(std::uint32_t id) const
+{
+    return id >= frozen && index.contains(id);
+}
+
+void Document::truncate(std::uint32_t count)
+{
+    // Items only ever arrive at the end, so the ones being dropped are the
+    // last of their kind and own the tail of every arena.
+    while (order.size() > count)
+    {
+        ItemRef item = order.back();
+        switch (item.kind)
+        {
+            case ItemKind::Rectangle: rectangles.pop_back(); break;
+            case ItemKind::Circle: circles.pop_back(); break;
+            case ItemKind::Triangle: triangles.pop_back(); break;
+            case ItemKind::Text:
+                if (shaped.size() == texts.size())
+                {
+                    const Shaped& last = shaped.back();
+                    if (last.count != noShape && last.first + last.count == shapedArena.size())
+                        shapedArena.resize(last.first);
+                    shaped.pop_back();
+                }
+                glyphArena.resize(texts.back().first);
+                texts.pop_back();
+                break;
+            case ItemKind::Stroke:
+                strokeArena.resize(strokes.back().first);
+                strokes.pop_back();
+                break;
+            case ItemKind::Fill:
+                maskArena.resize(fills.back().mask);
+                fillTextures.pop_back();
+                fills.pop_back();
+                break;
+        }
+        index.remove((std::uint32_t)order.size() - 1);
+        order.pop_back();
+        itemBounds.pop_back();
+    }
+    // The arenas are kept: undo may still put back what they hold.
+    if (placements.size() > count) placements.resize(count);
+    if (cuts.size() > count) cuts.resize(count);
+    if (lifted.size() > count) lifted.resize(count);
+    if (hidden.size() > count) hidden.resize(count);
+    base = std::min(base, count);
+    if (changeLog) DocumentFile::logId(*changeLog, DocumentFile::Op::Truncate, count);
+}
+
+std::uint32_t Document::place(std::uint32_t id, const sf::Transform& transform)
+{
+    const float* m = transform.getMatrix();
+    placementArena.push_back(Placement{{m[0], m[4], m[12], m[1], m[5], m[13]}});
+    return setPlacement(id, (std::uint32_t)placementArena.size() - 1);
+}
+
+std::uint32_t Document::setPlacement(std::uint32_t id, std::uint32_t placement)
+{
+    if (placements.size() <= id) placements.resize(id + 1, none);
+    std::uint32_t previous = placements[id];
+    placements[id] = placement;
+    remeasure(id);
+    if (changeLog) DocumentFile::logPlace(*this, id, *changeLog);
+    return previous;
+}
+
+std::uint32_t Document::getPlacement(std::uint32_t id) const
+{
+    return id < placements.size() ? placements[id] : none;
+}
+
+sf::Transform Document::getTransform(std::uint32_t id) const
+{
+    std::uint32_t placement = getPlacement(id);
+    if (placement == none) return sf::Transform::Identity;
+    const float* m = placementArena[placement].matrix;
+    return sf::Transform(m[0], m[1], m[2], m[3], m[4], m[5], 0.f, 0.f, 1.f);
+}
+
+std::uint32_t Document::cut(std::uint32_t id, const Piece* pieces, std::size_t count)
+{
+    cutArena.push_back(Cut{(std::uint32_t)pieceArena.size(), (std::uint32_t)count});
+    pieceArena.insert(pieceArena.end(), pieces, pieces + count);
+    return setCut(id, (std::uint32_t)cutArena.size() - 1);
+}
+
+std::uint32_t Document::setCut(std::uint32_t id, std::uint32_t c)
+{
+    if (cuts.size() <= id) cuts.resize(id + 1, none);
+    std::uint32_t previous = cuts[id];
+    cuts[id] = c;
+    remeasure(id);
+    if (changeLog) DocumentFile::logCut(*this, id, *changeLog);
+    return previous;
+}
+
+std::uint32_t Document::getCut(std::uint32_t id) const
+{
+    return id < cuts.size() ? cuts[id] : none;
+}
+
+const Document::Piece* Document::piecesOf(std::uint32_t id, std::size_t& count) const
+{
+    count = 0;
+    std::uint32_t c = getCut(id);
+    if (c == none) return nullptr;
+    count = cutArena[c].count;
+    return pieceArena.data() + cutArena[c].first;
+}
+
+bool Document::eraseAlong(std::uint32_t id, const sf::Vector2f& a, const sf::Vector2f& b, float radius,
+                          std::vector<Piece>& kept) const
+{
+    kept.clear();
+    ItemRef item = order[id];
+    if (item.kind != ItemKind::Stroke) return false;
+    const StrokeItem& s = strokes[item.index];
+    StrokeCodec::decode(strokeArena.data() + s.first, s.size, decoded);
+    if (decoded.empty()) return false;
+    if (getPlacement(id) != none) placeSamples(decoded.data(), decoded.size(), getTransform(id));
+
+    // Stretches of the stroke the eraser reaches, in sample terms and in
+    // order. Reaching the centre line leaves the cut ends' round caps just
+    // short of the eraser.
+    std::vector<Piece> gone;
+    float left = std::min(a.x, b.x) - radius, right = std::max(a.x, b.x) + radius;
+    float top = std::min(a.y, b.y) - radius, bottom = std::max(a.y, b.y) + radius;
+    if (decoded.size() == 1)
+    {
+        if (distanceToSegment(decoded[0].position, a, b) < radius + decoded[0].width * 0.5f)
+            gone.push_back(Piece{0.f, 0.f});
+    }
+    for (std::size_t i = 0; i + 1 < decoded.size(); ++i)
+    {
+        const sf::Vector2f& p = decoded[i].position;
+        const sf::Vector2f& q = decoded[i + 1].position;
+        float half = std::max(decoded[i].width, decoded[i + 1].width) * 0.5f;
+        if (std::min(p.x, q.x) - half > right || std::max(p.x, q.x) + half < left ||
+            std::min(p.y, q.y) - half > bottom || std::max(p.y, q.y) + half < top)
+            continue;
+        float s0, s1;
+        if (within(p, q, a, b, radius + half, s0, s1)) gone.push_back(Piece{i + s0, i + s1});
+    }
+    if (gone.empty()) return false;
+
+    Piece whole{0.f, (float)(decoded.size() - 1)};
+    std::size_t count = 0;
+    const Piece* pieces = piecesOf(id, count);
+    if (!pieces)
+    {
+        pieces = &whole;
+        count = 1;
+    }
+    if (decoded.size() == 1) return true;
+
+    // Slivers left between two erased stretches are dropped.
+    const float overlap = 1e-4f, sliver = 1e-3f;
+    bool erased = false;
+    for (std::size_t k = 0; k < count; ++k)
+    {
+        float from = pieces[k].from, to = pieces[k].to;
+        bool touched = false;
+        for (const Piece& g : gone)
+        {
+            if (g.to <= from + overlap || g.from >= to - overlap) continue;
+            touched = true;
+            if (g.from - from > sliver) kept.push_back(Piece{from, g.from});
+            from = std::max(from, g.to);
+        }
+        erased = erased || touched;
+        if (!touched) kept.push_back(pieces[k]);
+        else if (to - from > sliver) kept.push_back(Piece{from, to});
+    }
+    return erased;
+}
+
+void Document::lift(const std::vector<std::uint32_t>& ids)
+{
+    lifted.assign(order.size(), false);
+    for (std::uint32_t id : ids) lifted[id] = true;
+}
+
+void Document::drop()
+{
+    lifted.clear();
+}
+
+void Document::appendBatches(const std::vector<std::uint32_t>& ids, float scale, std::vector<Batch>& out) const
+{
+    for (std::uint32_t id : ids)
+    {
+        const sf::Texture* texture = textureOf(order[id]);
+        if (out.empty() || out.back().texture != texture) out.push_back(Batch{texture, {}});
+        appendGeometry(id, scale, true, out.back().vertices, decoded);
+    }
+}
+
+void Document::remeasure(std::uint32_t id)
+{
+    itemBounds[id] = measure(id);
+    if (index.contains(id)) index.update(id, itemBounds[id]);
+}
+
+sf::FloatRect Document::measure(std::uint32_t id) const
+{
+    ItemRef item = order[id];
+    sf::Transform transform = getTransform(id);
+    switch (item.kind)
+    {
+        case ItemKind::Rectangle:
+        {
+            const RectangleItem& r = rectangles[item.index];
+            return transform.transformRect(sf::FloatRect(r.position, r.size));
+        }
+        case ItemKind::Circle:
+        {
+            // The extents of the ellipse it becomes.
+            const CircleItem& c = circles[item.index];
+            const float* m = transform.getMatrix();
+            sf::Vector2f center = transform.transformPoint(c.center);
+            float rx = c.radius * std::sqrt(m[0] * m[0] + m[4] * m[4]);
+            float ry = c.radius * std::sqrt(m[1] * m[1] + m[5] * m[5]);
+            return sf::FloatRect(center.x - rx, center.y - ry, rx * 2, ry * 2);
+        }
+        case ItemKind::Triangle:
+        {
+            sf::Vector2f points[3];
+            for (int i = 0; i < 3; ++i) points[i] = transform.transformPoint(triangles[item.index].points[i]);
+            return boundsOf(points, 3, 0.f);
+        }
+        case ItemKind::Text:
+        {
+            const TextItem& t = texts[item.index];
+            std::uint32_t count = 0;
+            const GlyphRun::Quad* quads = shapedText(item.index, count);
+            sf::FloatRect bounds(transform.transformPoint(t.position), sf::Vector2f(0.f, 0.f));
+            for (std::uint32_t i = 0; i < count; ++i)
+            {
+                const sf::FloatRect& q = quads[i].bounds;
+                sf::FloatRect b = transform.transformRect(sf::FloatRect(t.position.x + q.left, t.position.y + q.top,
+                                                                        q.width, q.height));
+                bounds = i == 0 ? b : unite(bounds, b);
+            }
+            return bounds;
+        }
+        case ItemKind::Stroke:
+            strokePieces(id, decoded, pieceEnds);
+            return Stroke::bounds(decoded.data(), decoded.size());
+        case ItemKind::Fill:
+        {
+            const FillItem& f = fills[item.index];
+            const sf::IntRect& b = f.bounds;
+            return transform.transformRect(sf::FloatRect(f.origin.x + b.left * f.pixelSize,
+                                                         f.origin.y + b.top * f.pixelSize, b.width * f.pixelSize,
+                                                         b.height * f.pixelSize));
+        }
+    }
+    return sf::FloatRect();
+}
+
+void Document::strokePieces(std::uint32_t id, std::vector<Stroke::Sample>& samples,
+                            std::vector<std::uint32_t>& ends) const
+{
+    const StrokeItem& s = strokes[order[id].index];
+    StrokeCodec::decode(strokeArena.data() + s.first, s.size, samples);
+    if (s.color.a)
+    {
+        for (auto& sample : samples) sample.color = s.color;
+    }
+    if (getPlacement(id) != none) placeSamples(samples.data(), samples.size(), getTransform(id));
+    ends.clear();
+    std::size_t count = 0;
+    const Piece* pieces = piecesOf(id, count);
+    if (!pieces)
+    {
+        ends.push_back((std::uint32_t)samples.size());
+        return;
+    }
+    std::size_t stored = samples.size();
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        appendPiece(samples, stored, pieces[i]);
+        ends.push_back((std::uint32_t)(samples.size() - stored));
+    }
+    samples.erase(samples.begin(), samples.begin() + stored);
+}
+
+void Document::copyItem(const Document& from, std::uint32_t id)
+{
+    ItemRef item = from.order[id];
+    std::uint32_t slot = 0;
+    switch (item.kind)
+    {
+        case ItemKind::Rectangle:
+            rectangles.push_back(from.rectangles[item.index]);
+            slot = (std::uint32_t)rectangles.size() - 1;
+            break;
+        case ItemKind::Circle:
+            circles.push_back(from.circles[item.index]);
+            slot = (std::uint32_t)circles.size() - 1;
+            break;
+        case ItemKind::Triangle:
+            triangles.push_back(from.triangles[item.index]);
+            slot = (std::uint32_t)triangles.size() - 1;
+            break;
+        case ItemKind::Text:
+        {
+            TextItem t = from.texts[item.index];
+            const sf::Uint32* glyphs = from.glyphArena.data() + t.first;
+            t.first = (std::uint32_t)glyphArena.size();
+            glyphArena.insert(glyphArena.end(), glyphs, glyphs + t.length);
+            texts.push_back(t);
+            slot = (std::uint32_t)texts.size() - 1;
+            break;
+        }
+        case ItemKind::Stroke:
+        {
+            StrokeItem st = from.strokes[item.index];
+            const std::uint8_t* bytes = from.strokeArena.data() + st.first;
+            st.first = (std::uint32_t)strokeArena.size();
+            strokeArena.insert(strokeArena.end(), bytes, bytes + st.size);
+            strokes.push_back(st);
+            slot = (std::uint32_t)strokes.size() - 1;
+            break;
+        }
+        case ItemKind::Fill:
+        {
+            FillItem f = from.fills[item.index];
+            const std::uint8_t* mask = from.maskArena.data() + f.mask;
+            f.mask = (std::uint32_t)maskArena.size();
+            f.texture = (std::uint32_t)fillTextures.size();
+            maskArena.insert(maskArena.end(), mask, mask + (std::size_t)f.bounds.width * f.bounds.height);
+            fillTextures.emplace_back();
+            fills.push_back(f);
+            slot = (std::uint32_t)fills.size() - 1;
+            break;
+        }
+    }
+    std::uint32_t copy = push(item.kind, slot, from.itemBounds[id]);
+    std::uint32_t placement = from.getPlacement(id);
+    if (placement != none)
+    {
+        placementArena.push_back(from.placementArena[placement]);
+        placements.resize(copy + 1, none);
+        placements[copy] = (std::uint32_t)placementArena.size() - 1;
+    }
+    std::size_t count = 0;
+    if (const Piece* pieces = from.piecesOf(id, count))
+    {
+        cutArena.push_back(Cut{(std::uint32_t)pieceArena.size(), (std::uint32_t)count});
+        pieceArena.insert(pieceArena.end(), pieces, pieces + count);
+        cuts.resize(copy + 1, none);
+        cuts[copy] = (std::uint32_t)cutArena.size() - 1;
+    }
+}
+
+void Document::copyItems(std::uint32_t count, Document& out) const
+{
+    out.font = font;
+    out.raster = base == 0 ? raster : RasterLayer(raster.getPixelsPerUnit());
+    count = std::min(count, (std::uint32_t)order.size());
+    for (std::uint32_t id = base; id < count; ++id)
+    {
+        if (index.contains(id)) out.copyItem(*this, id);
+    }
+}
+
+void Document::freeze(std::uint32_t count)
+{
+    frozen = count;
+}
+
+void Document::flatten(std::uint32_t count, const RasterLayer& layer)
+{
+    count = std::min(count, (std::uint32_t)order.size());
+    std::vector<std::uint32_t> shown;
+    for (std::uint32_t id = std::max(base, count); id < order.size(); ++id)
+    {
+        if (index.contains(id)) shown.push_back(id - count);
+    }
+
+    // Each kind's items appear in id order, so the ones going are a prefix
+    // of every array and own the head of every arena.
+    std::uint32_t dropped[6] = {0, 0, 0, 0, 0, 0};
+    for (std::uint32_t id = 0; id < count; ++id) ++dropped[(std::size_t)order[id].kind];
+    order.erase(order.begin(), order.begin() + count);
+    itemBounds.erase(itemBounds.begin(), itemBounds.begin() + count);
+    for (auto& item : order) item.index -= dropped[(std::size_t)item.kind];
+    // Placements and cuts are named by number in the history, so only the
+    // per-item tables move here; compactEdits() frees the arenas.
+    placements.erase(placements.begin(), placements.begin() + std::min<std::size_t>(count, placements.size()));
+    cuts.erase(cuts.begin(), cuts.begin() + std::min<std::size_t>(count, cuts.size()));
+    hidden.erase(hidden.begin(), hidden.begin() + std::min<std::size_t>(count, hidden.size()));
+    lifted.clear();
+
+    rectangles.erase(rectangles.begin(), rectangles.begin() + dropped[(std::size_t)ItemKind::Rectangle]);
+    circles.erase(circles.begin(), circles.begin() + dropped[(std::size_t)ItemKind::Circle]);
+    triangles.erase(triangles.begin(), triangles.begin() + dropped[(std::size_t)ItemKind::Triangle]);
+
+    texts.erase(texts.begin(), texts.begin() + dropped[(std::size_t)ItemKind::Text]);
+    std::uint32_t head = texts.empty() ? (std::uint32_t)glyphArena.size() : texts.front().first;
+    glyphArena.erase(glyphArena.begin(), glyphArena.begin() + head);
+    for (auto& t : texts) t.first -= head;
+    shaped.clear();
+    shapedArena.clear();
+
+    strokes.erase(strokes.begin(), strokes.begin() + dropped[(std::size_t)ItemKind::Stroke]);
+    head = strokes.empty() ? (std::uint32_t)strokeArena.size() : strokes.front().first;
+    strokeArena.erase(strokeArena.begin(), strokeArena.begin() + head);
+    for (auto& st : strokes) st.first -= head;
+
+    std::uint32_t fillsDropped = dropped[(std::size_t)ItemKind::Fill];
+    fills.erase(fills.begin(), fills.begin() + fillsDropped);
+    fillTextures.erase(fillTextures.begin(), fillTextures.begin() + fillsDropped);
+    head = fills.empty() ? (std::uint32_t)maskArena.size() : fills.front().mask;
+    maskArena.erase(maskArena.begin(), maskArena.begin() + head);
+    for (auto& f : fills)
+    {
+        f.mask -= head;
+        f.texture -= fillsDropped;
+    }
+
+    // Give the memory back, or the next budget check would still see it.
+    order.shrink_to_fit();
+    itemBounds.shrink_to_fit();
+    placements.shrink_to_fit();
+    cuts.shrink_to_fit();
+    hidden.shrink_to_fit();
+    rectangles.shrink_to_fit();
+    circles.shrink_to_fit();
+    triangles.shrink_to_fit();
+    texts.shrink_to_fit();
+    strokes.shrink_to_fit();
+    fills.shrink_to_fit();
+    fillTextures.shrink_to_fit();
+    glyphArena.shrink_to_fit();
+    strokeArena.shrink_to_fit();
+    maskArena.shrink_to_fit();
+    shapedArena.shrink_to_fit();
+
+    index = SpatialIndex();
+    for (std::uint32_t id : shown) index.insert(id, itemBounds[id]);
+    base = base > count ? base - count : 0;
+    frozen = 0;
+    raster = layer;
+}
+
+void Document::compactEdits(const std::vector<std::uint32_t>& placementsUsed,
+                            const std::vector<std::uint32_t>& cutsUsed, std::vector<std::uint32_t>& placementMap,
+                            std::vector<std::uint32_t>& cutMap)
+{
+    // Kept entries only ever move towards the front, so each arena is
+    // compacted in place.
+    placementMap.assign(placementArena.size(), none);
+    std::uint32_t kept = numberUsed(placements, placementsUsed, placementMap);
+    for (std::size_t i = 0; i < placementMap.size(); ++i)
+    {
+        if (placementMap[i] != none) placementArena[placementMap[i]] = placementArena[i];
+    }
+    placementArena.resize(kept);
+    for (auto& p : placements)
+    {
+        if (p != none) p = placementMap[p];
+    }
+
+    cutMap.assign(cutArena.size(), none);
+    kept = numberUsed(cuts, cutsUsed, cutMap);
+    std::uint32_t pieces = 0;
+    for (std::size_t i = 0; i < cutMap.size(); ++i)
+    {
+        if (cutMap[i] == none) continue;
+        Cut c = cutArena[i];
+        for (std::uint32_t k = 0; k < c.count; ++k) pieceArena[pieces + k] = pieceArena[c.first + k];
+        cutArena[cutMap[i]] = Cut{pieces, c.count};
+        pieces += c.count;
+    }
+    cutArena.resize(kept);
+    pieceArena.resize(pieces);
+    for (auto& c : cuts)
+    {
+        if (c != none) c = cutMap[c];
+    }
+
+    placementArena.shrink_to_fit();
+    cutArena.shrink_to_fit();
+    pieceArena.shrink_to_fit();
+}
+
+const RasterLayer& Document::getRaster() const
+{
+    return raster;
+}
+
+std::size_t Document::memoryUsage() const
+{
+    std::size_t bytes = order.capacity() * sizeof(ItemRef) + itemBounds.capacity() * sizeof(sf::FloatRect) +
+                        rectangles.capacity() * sizeof(RectangleItem) + circles.capacity() * sizeof(CircleItem) +
+                        triangles.capacity() * sizeof(TriangleItem) + texts.capacity() * sizeof(TextItem) +
+                        strokes.capacity() * sizeof(StrokeItem) + fills.capacity() * sizeof(FillItem) +
+                        glyphArena.capacity() * sizeof(sf::Uint32) + strokeArena.capacity() +
+                        maskArena.capacity() + shaped.capacity() * sizeof(Shaped) +
+                        shapedArena.capacity() * sizeof(GlyphRun::Quad) +
+                        fillTextures.capacity() * sizeof(fillTextures[0]) +
+                        (placements.capacity() + cuts.capacity()) * sizeof(std::uint32_t) +
+                        placementArena.capacity() * sizeof(Placement) + cutArena.capacity() * sizeof(Cut) +
+                        pieceArena.capacity() * sizeof(Piece) + (lifted.capacity() + hidden.capacity()) / 8;
+    for (std::size_t i = 0; i < fills.size(); ++i)
+    {
+        if (fillTextures[fills[i].texture])
+            bytes += (std::size_t)fills[i].bounds.width * fills[i].bounds.height * 4;
+    }
+    return bytes + index.memoryUsage() + raster.memoryUsage();
+}
+
+std::size_t Document::size() const
+{
+    return order.size();
+}
+
+bool Document::empty() const
+{
+    return order.empty();
+}
+
+ItemRef Document::getItem(std::uint32_t id) const
+{
+    return order[id];
+}
+
+const sf::FloatRect& Document::getBounds(std::uint32_t id) const
+{
+    return itemBounds[id];
+}
+
+sf::Color Document::getColor(std::uint32_t id) const
+{
+    ItemRef item = order[id];
+    switch (item.kind)
+    {
+        case ItemKind::Rectangle: return rectangles[item.index].color;
+        case ItemKind::Circle: return circles[item.index].color;
+        case ItemKind::Triangle: return triangles[item.index].color;
+        case ItemKind::Text: return texts[item.index].color;
+        case ItemKind::Stroke:
+        {
+            const StrokeItem& s = strokes[item.index];
+            if (s.color.a) return s.color;
+            return StrokeCodec::firstColor(strokeArena.data() + s.first, s.size);
+        }
+        case ItemKind::Fill: return fills[item.index].color;
+    }
+    return sf::Color::Transparent;
+}
+
+sf::Color Document::setColor(std::uint32_t id, sf::Color color)
+{
+    ItemRef item = order[id];
+    sf::Color* slot = nullptr;
+    switch (item.kind)
+    {
+        case ItemKind::Rectangle: slot = &rectangles[item.index].color; break;
+        case ItemKind::Circle: slot = &circles[item.index].color; break;
+        case ItemKind::Triangle: slot = &triangles[item.index].color; break;
+        case ItemKind::Text: slot = &texts[item.index].color; break;
+        case ItemKind::Stroke: slot = &strokes[item.index].color; break;
+        case ItemKind::Fill: slot = &fills[item.index].color; break;
+    }
+    sf::Color previous = *slot;
+    *slot = color;
+    if (changeLog) DocumentFile::logColor(*changeLog, DocumentFile::Op::Recolor, id, color);
+    return previous;
+}
+
+bool Document::contains(std::uint32_t id, const sf::Vector2f& point) const
+{
+    ItemRef item = order[id];
+    // Strokes are tested as drawn, everything else where it was added.
+    sf::Vector2f p = point;
+    if (item.kind != ItemKind::Stroke && getPlacement(id) != none) p = getTransform(id).getInverse().transformPoint(p);
+    switch (item.kind)
+    {
+        case ItemKind::Rectangle:
+        {
+            const RectangleItem& r = rectangles[item.index];
+            return sf::FloatRect(r.position, r.size).contains(p);
+        }
+        case ItemKind::Circle:
+        {
+            const CircleItem& c = circles[item.index];
+            return HitTest::pointInCircle(p, c.center, c.radius);
+        }
+        case ItemKind::Triangle:
+        {
+            const TriangleItem& t = triangles[item.index];
+            return HitTest::pointInTriangle(p, t.points[0], t.points[1], t.points[2]);
+        }
+        case ItemKind::Text:
+        {
+            const TextItem& t = texts[item.index];
+            std::uint32_t count = 0;
+            const GlyphRun::Quad* quads = shapedText(item.index, count);
+            for (std::uint32_t i = 0; i < count; ++i)
+            {
+                if (quads[i].bounds.contains(p - t.position)) return true;
+            }
+            return false;
+        }
+        case ItemKind::Stroke:
+        {
+            strokePieces(id, decoded, pieceEnds);
+            std::uint32_t start = 0;
+            for (std::uint32_t end : pieceEnds)
+            {
+                for (std::uint32_t i = start + 1; i < end; ++i)
+                {
+                    float radius = std::max(decoded[i - 1].width, decoded[i].width) * 0.5f;
+                    if (HitTest::pointInCapsule(p, decoded[i - 1].position, decoded[i].position, radius)) return true;
+                }
+                if (end - start == 1 && HitTest::pointInCircle(p, decoded[start].position, decoded[start].width * 0.5f))
+                    return true;
+                start = end;
+            }
+            return false;
+        }
+        case ItemKind::Fill:
+        {
+            const FillItem& f = fills[item.index];
+            int x = (int)std::floor((p.x - f.origin.x) / f.pixelSize) - f.bounds.left;
+            int y = (int)std::floor((p.y - f.origin.y) / f.pixelSize) - f.bounds.top;
+            if (x < 0 || y < 0 || x >= f.bounds.width || y >= f.bounds.height) return false;
+            return maskArena[f.mask + (std::size_t)y * f.bounds.width + x] != 0;
+        }
+    }
+    return false;
+}
+
+std::int64_t Document::pick(const sf::Vector2f& point) const
+{
+    index.queryPoint(point, visible);
+    for (std::uint32_t id : visible)
+    {
+        // Everything further down is being flattened too.
+        if (id < frozen) break;
+        if (contains(id, point)) return id;
+    }
+    return -1;
+}
+
+void Document::query(const sf::FloatRect& area, std::vector<std::uint32_t>& out) const
+{
+    index.queryRect(area, out);
+}
+
+void Document::select(const sf::FloatRect& area, std::vector<std::uint32_t>& out) const
+{
+    index.queryRect(area, visible);
+    out.clear();
+    for (std::uint32_t id : visible)
+    {
+        const sf::FloatRect& b = itemBounds[id];
+        if (id >= frozen && b.left >= area.left && b.top >= area.top && b.left + b.width <= area.left + area.width &&
+            b.top + b.height <= area.top + area.height)
+            out.push_back(id);
+    }
+}
+
+std::size_t Document::circleSegments(float radius, float tolerance)
+{
+    if (radius <= tolerance) return 8;
+    float step = 2.f * std::acos(1.f - tolerance / radius);
+    std::size_t segments = (std::size_t)std::ceil(2.f * pi / step);
+    return std::max<std::size_t>(8, std::min<std::size_t>(segments, 512));
+}
+
+const sf::Texture* Document::textureOf(const ItemRef& item) const
+{
+    if (item.kind == ItemKind::Text)
+        return font ? &font->getTexture(GlyphRun::atlasSize(texts[item.index].size)) : nullptr;
+    if (item.kind == ItemKind::Fill) return fillTexture(item.index);
+    if (item.kind == ItemKind::Stroke) return &Stroke::getTexture();
+    return nullptr;
+}
+
+const sf::Texture* Document::fillTexture(std::uint32_t fill) const
+{
+    const FillItem& f = fills[fill];
+    auto& texture = fillTextures[f.texture];
+    if (!texture)
+    {
+        // White where the mask is set, so the vertex colour tints it.
+        std::size_t count = (std::size_t)f.bounds.width * f.bounds.height;
+        std::vector<sf::Uint8> rgba(count * 4);
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            rgba[i * 4] = rgba[i * 4 + 1] = rgba[i * 4 + 2] = 255;
+            rgba[i * 4 + 3] = maskArena[f.mask + i] ? 255 : 0;
+        }
+        texture = std::make_unique<sf::Texture>();
+        texture->create(f.bounds.width, f.bounds.height);
+        texture->update(rgba.data());
+        RenderStats::upload();
+    }
+    return texture.get();
+}
+
+const GlyphRun::Quad* Document::shapedText(std::uint32_t text, std::uint32_t& count) const
+{
+    count = 0;
+    if (!font) return nullptr;
+    // Loading fills texts without shaping them.
+    if (shaped.size() < texts.size()) shaped.resize(texts.size(), Shaped{0, noShape});
+    Shaped& s = shaped[text];
+    if (s.count == noShape)
+    {
+        const TextItem& t = texts[text];
+        shaper.reset(*font, t.size);
+        for (std::uint32_t i = 0; i < t.length; ++i) shaper.push(glyphArena[t.first + i]);
+        const auto& quads = shaper.getQuads();
+        s = Shaped{(std::uint32_t)shapedArena.size(), (std::uint32_t)quads.size()};
+        shapedArena.insert(shapedArena.end(), quads.begin(), quads.end());
+    }
+    count = s.count;
+    return shapedArena.data() + s.first;
+}
+
+void Document::appendGeometry(std::uint32_t id, float scale, bool feather, std::vector<sf::Vertex>& out,
+                              std::vector<Stroke::Sample>& samples) const
+{
+    const ItemRef& item = order[id];
+    std::uint32_t placement = getPlacement(id);
+    std::size_t start = out.size();
+    switch (item.kind)
+    {
+        case ItemKind::Rectangle:
+        {
+            const RectangleItem& r = rectangles[item.index];
+            appendQuad(out, r.position.x, r.position.y, r.position.x + r.size.x, r.position.y + r.size.y, r.color);
+            break;
+        }
+        case ItemKind::Circle:
+        {
+            const CircleItem& c = circles[item.index];
+            float stretch = 1.f;
+            if (placement != none)
+            {
+                const float* m = placementArena[placement].matrix;
+                stretch = std::sqrt(std::max(m[0] * m[0] + m[3] * m[3], m[1] * m[1] + m[4] * m[4]));
+            }
+            std::size_t segments = circleSegments(c.radius * scale * stretch);
+            sf::Vector2f prev(c.center.x + c.radius, c.center.y);
+            for (std::size_t i = 1; i <= segments; ++i)
+            {
+                float angle = 2.f * pi * i / segments;
+                sf::Vector2f next(c.center.x + c.radius * std::cos(angle), c.center.y + c.radius * std::sin(angle));
+                out.push_back(sf::Vertex(c.center, c.color));
+                out.push_back(sf::Vertex(prev, c.color));
+                out.push_back(sf::Vertex(next, c.color));
+                prev = next;
+            }
+            break;
+        }
+        case ItemKind::Triangle:
+        {
+            const TriangleItem& t = triangles[item.index];
+            for (const auto& p : t.points) out.push_back(sf::Vertex(p, t.color));
+            break;
+        }
+        case ItemKind::Text:
+        {
+            const TextItem& t = texts[item.index];
+            std::uint32_t count = 0;
+            const GlyphRun::Quad* quads = shapedText(item.index, count);
+            GlyphRun::appendVertices(quads, count, t.position, t.color, out);
+            break;
+        }
+        case ItemKind::Stroke:
+        {
+            // Placed before tessellation, so the fringe stays a pixel wide.
+            const StrokeItem& s = strokes[item.index];
+            StrokeCodec::decode(strokeArena.data() + s.first, s.size, samples);
+            if (s.color.a)
+            {
+                for (auto& sample : samples) sample.color = s.color;
+            }
+            if (placement != none) placeSamples(samples.data(), samples.size(), getTransform(id));
+            std::size_t count = 0;
+            const Piece* pieces = piecesOf(id, count);
+            if (!pieces)
+            {
+                std::size_t kept = samples.size();
+                if (scale < 1.f) kept = decimate(samples.data(), kept, 1.f / scale);
+                Stroke::appendTriangles(samples.data(), kept, 1.f / scale, feather, out);
+                return;
+            }
+            std::size_t stored = samples.size();
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                samples.resize(stored);
+                appendPiece(samples, stored, pieces[i]);
+                std::size_t kept = samples.size() - stored;
+                if (scale < 1.f) kept = decimate(samples.data() + stored, kept, 1.f / scale);
+                Stroke::appendTriangles(samples.data() + stored, kept, 1.f / scale, feather, out);
+            }
+            return;
+        }
+        case ItemKind::Fill:
+        {
+            const FillItem& f = fills[item.index];
+            const sf::IntRect& b = f.bounds;
+            float left = f.origin.x + b.left * f.pixelSize, top = f.origin.y + b.top * f.pixelSize;
+            appendQuad(out, left, top, left + b.width * f.pixelSize, top + b.height * f.pixelSize,
+                       f.color, sf::FloatRect(0.f, 0.f, (float)b.width, (float)b.height));
+            break;
+        }
+    }
+    if (placement == none) return;
+    sf::Transform transform = getTransform(id);
+    for (std::size_t i = start; i < out.size(); ++i) out[i].position = transform.transformPoint(out[i].position);
+}
+
+void Document::flush(sf::RenderTarget& target, sf::RenderStates states, const sf::Texture* texture) const
+{
+    if (batch.empty()) return;
+    states.texture = texture;
+    target.draw(batch.data(), batch.size(), sf::Triangles, states);
+    RenderStats::draw(batch.size());
+    batch.clear();
+}
+
+void Document::draw(sf::RenderTarget& target, sf::RenderStates states, const sf::FloatRect* area,
+                    const Detail& detail) const
+{
+    const sf::Texture* current = nullptr;
+    auto emit = [&](std::uint32_t id) {
+        if (id < lifted.size() && lifted[id]) return;
+        const ItemRef& item = order[id];
+        const sf::Texture* texture = textureOf(item);
+        if (texture != current)
+        {
+            flush(target, states, current);
+            current = texture;
+        }
+        appendGeometry(id, detail.scale, true, batch, decoded);
+    };
+
+    if (area)
+    {
+        index.queryRect(*area, visible, detail.minExtent, detail.maxExtent);
+        for (std::uint32_t id : visible) emit(id);
+    }
+    else
+    {
+        bool filtered = detail.minExtent > 0.f || detail.maxExtent < std::numeric_limits<float>::infinity();
+        for (std::uint32_t id = base; id < order.size(); ++id)
+        {
+            if (!index.contains(id)) continue;
+            if (filtered)
+            {
+                const sf::FloatRect& b = itemBounds[id];
+                float extent = std::max(b.width, b.height);
+                if (extent < detail.minExtent || extent >= detail.maxExtent) continue;
+            }
+            emit(id);
+        }
+    }
+    flush(target, states, current);
+}
+
+void Document::drawItem(std::uint32_t id, sf::RenderTarget& target, sf::RenderStates states, float scale) const
+{
+    appendGeometry(id, scale, true, batch, decoded);
+    flush(target, states, textureOf(order[id]));
+}
+
+void Document::drawRaster(sf::RenderTarget& target, sf::RenderStates states, const sf::FloatRect& area,
+                          float scale) const
+{
+    if (base == 0) raster.draw(target, states, area, scale);
+}
+
+const std::vector<Stroke::Sample>& Document::decodeStroke(const StrokeItem& stroke) const
+{
+    StrokeCodec::decode(strokeArena.data() + stroke.first, stroke.size, decoded);
+    return decoded;
+}
@@ -0,0 +1,347 @@
+#ifndef DOCUMENT_HPP
+#define DOCUMENT_HPP
+
+#include <SFML/Graphics.hpp>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "FloodFill.hpp"
+#include "GlyphRun.hpp"
+#include "RasterLayer.hpp"
+#include "SpatialIndex.hpp"
+#include "Stroke.hpp"
+
+enum class ItemKind : std::uint8_t
+{
+    Rectangle,
+    Circle,
+    Triangle,
+    Text,
+    Stroke,
+    Fill
+};
+
+// Position of an item inside the dense array for its kind.
+struct ItemRef
+{
+    ItemKind kind;
+    std::uint32_t index;
+};
+
+// The committed drawing. Every kind of item lives in its own dense array of
+// plain structs, variable-length payloads (glyphs, encoded strokes, fill
+// masks) are appended to shared arenas, and a single z-order table maps item
+// ids to (kind, index). Nothing is individually heap allocated or
+// ref-counted, and the type of an item is known without RTTI.
+//
+// Items are never edited away, only hidden: clearing moves a base id past
+// everything drawn so far and hiding drops an item from the spatial index,
+// so both can be reversed cheaply for undo. truncate() frees items from the
+// end; flatten() frees them from the start once they have been baked into
+// the raster layer drawn beneath the rest, renumbering what is left.
+//
+// Moving an item or erasing part of a stroke leaves its own record alone
+// too: a placement (an affine transform applied to it as added) or a cut
+// (the pieces of its samples that are left) is appended to an arena and
+// the item pointed at it, so undo just points it back. Only that item's
+// bounds and index entry change.
+//
+// With a change log attached, every mutation is also appended to it as a
+// DocumentFile journal record, for autosave.
+class Document
+{
+    friend class DocumentFile;
+    friend class Exporter;
+
+public:
+    struct RectangleItem
+    {
+        sf::Vector2f position;
+        sf::Vector2f size;
+        sf::Color color;
+    };
+
+    struct CircleItem
+    {
+        sf::Vector2f center;
+        float radius;
+        sf::Color color;
+    };
+
+    struct TriangleItem
+    {
+        sf::Vector2f points[3];
+        sf::Color color;
+    };
+
+    struct TextItem
+    {
+        sf::Vector2f position;
+        std::uint32_t first;
+        std::uint32_t length;
+        unsigned size;
+        sf::Color color;
+    };
+
+    // Simplified samples, encoded by StrokeCodec into size bytes of
+    // strokeArena. A transparent color keeps the colours recorded per sample.
+    struct StrokeItem
+    {
+        std::uint32_t first;
+        std::uint32_t size;
+        std::uint32_t count;
+        sf::Color color;
+    };
+
+    // The mask was captured from the canvas at some zoom: its pixel (x, y)
+    // covers origin + (x, y) * pixelSize in document units.
+    struct FillItem
+    {
+        sf::IntRect bounds;
+        sf::Vector2f origin;
+        float pixelSize;
+        std::uint32_t mask;
+        std::uint32_t texture;
+        sf::Color color;
+    };
+
+    // Part of a stroke the eraser left, between two positions along its
+    // stored samples: sample i is at i, with fractions of the way to the
+    // next one in between.
+    struct Piece
+    {
+        float from;
+        float to;
+    };
+
+    // Geometry of several items tessellated once, grouped by texture, for
+    // drawing again and again under a changing transform.
+    struct Batch
+    {
+        const sf::Texture* texture;
+        std::vector<sf::Vertex> vertices;
+    };
+
+    // Level of detail for draw(). scale is screen pixels per document unit
+    // and sets tessellation; only items whose larger side lies in
+    // [minExtent, maxExtent) are drawn, so callers can bake the tiny ones
+    // into imposters and draw the rest live.
+    struct Detail
+    {
+        Detail();
+
+        float scale;
+        float minExtent;
+        float maxExtent;
+    };
+
+    Document();
+
+    void setFont(const sf::Font& font);
+
+    // Largest distance, in pixels, a committed stroke may stray from its raw
+    // samples when simplified. Zero keeps every sample.
+    void setStrokeTolerance(float tolerance);
+
+    void setChangeLog(std::vector<std::uint8_t>* log);
+
+    // Saved with the document; not drawn by it.
+    void setBackground(sf::Color color);
+    sf::Color getBackground() const;
+
+    std::uint32_t addRectangle(const sf::Vector2f& position, const sf::Vector2f& size, sf::Color color);
+    std::uint32_t addCircle(const sf::Vector2f& center, float radius, sf::Color color);
+    std::uint32_t addTriangle(const sf::Vector2f& a, const sf::Vector2f& b, const sf::Vector2f& c, sf::Color color);
+    std::uint32_t addText(const sf::String& text, const sf::Vector2f& position, unsigned size, sf::Color color);
+    std::uint32_t addStroke(const Stroke& stroke);
+    std::uint32_t addFill(const FloodFill::Region& region, sf::Color color,
+                          const sf::Vector2f& origin = sf::Vector2f(0.f, 0.f), float pixelSize = 1.f);
+
+    // Hides every item and returns the previous base for restore().
+    std::uint32_t clear();
+    void restore(std::uint32_t start);
+
+    void hide(std::uint32_t id);
+    void show(std::uint32_t id);
+    bool isVisible(std::uint32_t id) const;
+    // Visible and not being flattened.
+    bool isEditable(std::uint32_t id) const;
+
+    // Placements and cuts are numbered as they are made and kept for as long
+    // as the document, so undo can put back an earlier one by number; none
+    // is the item as it was added.
+    static constexpr std::uint32_t none = 0xffffffff;
+
+    // Places the item by transform relative to how it was added, and
+    // returns the placement replaced.
+    std::uint32_t place(std::uint32_t id, const sf::Transform& transform);
+    std::uint32_t setPlacement(std::uint32_t id, std::uint32_t placement);
+    std::uint32_t getPlacement(std::uint32_t id) const;
+    sf::Transform getTransform(std::uint32_t id) const;
+
+    // Keeps only the given pieces of a stroke, in order and not
+    // overlapping, and returns the cut replaced.
+    std::uint32_t cut(std::uint32_t id, const Piece* pieces, std::size_t count);
+    std::uint32_t setCut(std::uint32_t id, std::uint32_t cut);
+    std::uint32_t getCut(std::uint32_t id) const;
+
+    // What is left of a stroke once an eraser of the given radius has moved
+    // from a to b. False when the eraser misses everything left of it.
+    bool eraseAlong(std::uint32_t id, const sf::Vector2f& a, const sf::Vector2f& b, float radius,
+                    std::vector<Piece>& kept) const;
+
+    // Leaves the items out of draw() while the caller draws them itself,
+    // e.g. moving under the pointer. Nothing is logged or changed.
+    void lift(const std::vector<std::uint32_t>& ids);
+    void drop();
+    void appendBatches(const std::vector<std::uint32_t>& ids, float scale, std::vector<Batch>& out) const;
+
+    // Frees the items from count onwards.
+    void truncate(std::uint32_t count);
+
+    // Copies the items below count that are still visible, and the raster
+    // layer if it is shown, into an empty document for flattening.
+    void copyItems(std::uint32_t count, Document& out) const;
+
+    // Items below count can no longer be picked, while they are flattened.
+    void freeze(std::uint32_t count);
+
+    // Frees the items below count and renumbers the rest from zero. layer
+    // replaces the raster layer and must already hold what they drew.
+    void flatten(std::uint32_t count, const RasterLayer& layer);
+
+    // Frees the placements and cuts that neither an item nor the numbers
+    // given (those the undo history still names) refer to, and renumbers
+    // the rest. The maps give each old number its new one, or none.
+    void compactEdits(const std::vector<std::uint32_t>& placementsUsed, const std::vector<std::uint32_t>& cutsUsed,
+                      std::vector<std::uint32_t>& placementMap, std::vector<std::uint32_t>& cutMap);
+
+    const RasterLayer& getRaster() const;
+
+    // Bytes held by items, arenas, caches, textures and the raster layer.
+    std::size_t memoryUsage() const;
+
+    // Number of items stored, hidden ones included.
+    std::size_t size() const;
+    bool empty() const;
+    ItemRef getItem(std::uint32_t id) const;
+    const sf::FloatRect& getBounds(std::uint32_t id) const;
+    sf::Color getColor(std::uint32_t id) const;
+
+    // Returns the colour replaced, which restores the item when set back.
+    // For a stroke that is transparent until it is first recoloured.
+    sf::Color setColor(std::uint32_t id, sf::Color color);
+
+    // Exact containment test for one item.
+    bool contains(std::uint32_t id, const sf::Vector2f& point) const;
+
+    // Topmost item under the point, or -1 when only the background is hit.
+    std::int64_t pick(const sf::Vector2f& point) const;
+
+    // Ids whose bounds intersect the area, in z-order.
+    void query(const sf::FloatRect& area, std::vector<std::uint32_t>& out) const;
+
+    // Editable items lying wholly inside the area, in z-order.
+    void select(const sf::FloatRect& area, std::vector<std::uint32_t>& out) const;
+
+    // Draws the items intersecting area (everything when null) bottom to top,
+    // batching consecutive items that share a texture into one draw call.
+    void draw(sf::RenderTarget& target, sf::RenderStates states, const sf::FloatRect* area = nullptr,
+              const Detail& detail = Detail()) const;
+    void drawItem(std::uint32_t id, sf::RenderTarget& target, sf::RenderStates states, float scale = 1.f) const;
+
+    // Draws the raster layer over area, unless it has been cleared away.
+    void drawRaster(sf::RenderTarget& target, sf::RenderStates states, const sf::FloatRect& area,
+                    float scale) const;
+
+    // Number of fan segments that keeps a circle within tolerance pixels of round.
+    static std::size_t circleSegments(float radius, float tolerance = 0.25f);
+
+private:
+    std::uint32_t push(ItemKind kind, std::uint32_t index, const sf::FloatRect& bounds);
+    void copyItem(const Document& from, std::uint32_t id);
+    // Bounds of an item as placed and cut, stored and indexed afresh.
+    void remeasure(std::uint32_t id);
+    sf::FloatRect measure(std::uint32_t id) const;
+    const Piece* piecesOf(std::uint32_t id, std::size_t& count) const;
+    // A stroke's samples as drawn: placed, recoloured and cut, with the
+    // pieces back to back and ends[i] where piece i stops.
+    void strokePieces(std::uint32_t id, std::vector<Stroke::Sample>& samples, std::vector<std::uint32_t>& ends) const;
+    const sf::Texture* textureOf(const ItemRef& item) const;
+    const sf::Texture* fillTexture(std::uint32_t fill) const;
+    // Safe to call from several threads with separate out and samples,
+    // except for text, which goes through the font and the shaping cache.
+    // feather gives strokes their anti-aliasing fringe, which rasterizers
+    // computing their own coverage leave out.
+    void appendGeometry(std::uint32_t id, float scale, bool feather, std::vector<sf::Vertex>& out,
+                        std::vector<Stroke::Sample>& samples) const;
+    // Shaped quads of a text item, made on first use and kept until it is
+    // truncated or the font changes.
+    const GlyphRun::Quad* shapedText(std::uint32_t text, std::uint32_t& count) const;
+    void flush(sf::RenderTarget& target, sf::RenderStates states, const sf::Texture* texture) const;
+    const std::vector<Stroke::Sample>& decodeStroke(const StrokeItem& stroke) const;
+
+    const sf::Font* font;
+    float strokeTolerance;
+    std::vector<std::uint8_t>* changeLog;
+    sf::Color background;
+
+    std::vector<ItemRef> order;
+    std::vector<sf::FloatRect> itemBounds;
+    std::uint32_t base;
+    std::vector<RectangleItem> rectangles;
+    std::vector<CircleItem> circles;
+    std::vector<TriangleItem> triangles;
+    std::vector<TextItem> texts;
+    std::vector<StrokeItem> strokes;
+    std::vector<FillItem> fills;
+
+    std::vector<sf::Uint32> glyphArena;
+    std::vector<std::uint8_t> strokeArena;
+    std::vector<std::uint8_t> maskArena;
+
+    // a00 a01 a02 a10 a11 a12 of the transform.
+    struct Placement
+    {
+        float matrix[6];
+    };
+    struct Cut
+    {
+        std::uint32_t first;
+        std::uint32_t count;
+    };
+    // Per item, and only as long as the last one placed or cut; none past
+    // that.
+    std::vector<std::uint32_t> placements, cuts;
+    std::vector<Placement> placementArena;
+    std::vector<Cut> cutArena;
+    std::vector<Piece> pieceArena;
+    std::vector<bool> lifted;
+    // Per item, and only as long as the last one hidden: hidden by hide()
+    // rather than by clear(), so restore() leaves it hidden.
+    std::vector<bool> hidden;
+    // Created on first draw, so loading a document uploads nothing.
+    mutable std::vector<std::unique_ptr<sf::Texture>> fillTextures;
+
+    struct Shaped
+    {
+        std::uint32_t first;
+        std::uint32_t count;
+    };
+    // Per text item, into shapedArena; count is noShape until shaped.
+    static const std::uint32_t noShape = 0xffffffff;
+    mutable std::vector<Shaped> shaped;
+    mutable std::vector<GlyphRun::Quad> shapedArena;
+    mutable GlyphRun shaper;
+
+    RasterLayer raster;
+    std::uint32_t frozen;
+
+    SpatialIndex index;
+    mutable std::vector<std::uint32_t> visible;
+    mutable std::vector<sf::Vertex> batch;
+    mutable std::vector<Stroke::Sample> decoded;
+    mutable std::vector<std::uint32_t> pieceEnds;
+};
+
+#endif
@@ -0,0 +1,1130 @@
+#include "DocumentFile.hpp"
+#include "Document.hpp"
+#include "StrokeCodec.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#if defined(_WIN32)
+#include <iterator>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    const char fileMagic[8] = {'D', 'I', 'B', 'U', 'J', 'O', '\r', '\n'};
+    const char journalMagic[8] = {'D', 'I', 'B', 'J', 'R', 'N', 'L', '\n'};
+
+    // Anything past these is treated as corruption rather than allocated.
+    const std::uint32_t maxTextSize = 1024;
+    const int maxFillSide = 1 << 15;
+    const float maxCoordinate = 1e30f;
+
+    std::uint32_t fnv1a(const std::uint8_t* data, std::size_t size, std::uint32_t hash = 2166136261u)
+    {
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            hash ^= data[i];
+            hash *= 16777619u;
+        }
+        return hash;
+    }
+
+    struct Writer
+    {
+        std::vector<std::uint8_t>& out;
+
+        void u8(std::uint8_t v) { out.push_back(v); }
+        void u32(std::uint32_t v)
+        {
+            for (int i = 0; i < 4; ++i) out.push_back((std::uint8_t)(v >> (i * 8)));
+        }
+        void i32(std::int32_t v) { u32((std::uint32_t)v); }
+        void f32(float v)
+        {
+            std::uint32_t bits;
+            std::memcpy(&bits, &v, 4);
+            u32(bits);
+        }
+        void vec(const sf::Vector2f& v) { f32(v.x); f32(v.y); }
+        void rect(const sf::FloatRect& r) { f32(r.left); f32(r.top); f32(r.width); f32(r.height); }
+        void color(sf::Color c) { u8(c.r); u8(c.g); u8(c.b); u8(c.a); }
+        void bytes(const std::uint8_t* data, std::size_t size) { out.insert(out.end(), data, data + size); }
+
+        // Chunks and journal records share the [tag][length][data][checksum] framing.
+        std::size_t begin(const std::uint8_t* tag, std::size_t tagSize)
+        {
+            bytes(tag, tagSize);
+            u32(0);
+            return out.size();
+        }
+        void end(std::size_t start, std::size_t tagSize)
+        {
+            std::uint32_t length = (std::uint32_t)(out.size() - start);
+            for (int i = 0; i < 4; ++i) out[start - 4 + i] = (std::uint8_t)(length >> (i * 8));
+            std::uint32_t hash = fnv1a(out.data() + start - 4 - tagSize, tagSize);
+            u32(fnv1a(out.data() + start, length, hash));
+        }
+    };
+
+    struct Reader
+    {
+        const std::uint8_t* p;
+        const std::uint8_t* end;
+        bool ok;
+
+        Reader(const std::uint8_t* data, std::size_t size) : p(data), end(data + size), ok(true) {}
+
+        bool has(std::size_t n)
+        {
+            if ((std::size_t)(end - p) < n) ok = false;
+            return ok;
+        }
+        std::uint8_t u8() { return has(1) ? *p++ : 0; }
+        std::uint32_t u32()
+        {
+            if (!has(4)) return 0;
+            std::uint32_t v = (std::uint32_t)p[0] | (std::uint32_t)p[1] << 8 | (std::uint32_t)p[2] << 16 |
+                              (std::uint32_t)p[3] << 24;
+            p += 4;
+            return v;
+        }
+        std::int32_t i32() { return (std::int32_t)u32(); }
+        float f32()
+        {
+            std::uint32_t bits = u32();
+            float v;
+            std::memcpy(&v, &bits, 4);
+            if (!std::isfinite(v) || std::fabs(v) > maxCoordinate) ok = false;
+            return v;
+        }
+        sf::Vector2f vec()
+        {
+            float x = f32();
+            return sf::Vector2f(x, f32());
+        }
+        sf::FloatRect rect()
+        {
+            float left = f32(), top = f32(), width = f32();
+            return sf::FloatRect(left, top, width, f32());
+        }
+        sf::Color color()
+        {
+            if (!has(4)) return sf::Color();
+            sf::Color c(p[0], p[1], p[2], p[3]);
+            p += 4;
+            return c;
+        }
+        const std::uint8_t* bytes(std::size_t n)
+        {
+            if (!has(n)) return nullptr;
+            const std::uint8_t* start = p;
+            p += n;
+            return start;
+        }
+        bool done() const { return p == end; }
+    };
+
+    void put(Writer& w, const Document::RectangleItem& r) { w.vec(r.position); w.vec(r.size); w.color(r.color); }
+    void put(Writer& w, const Document::CircleItem& c) { w.vec(c.center); w.f32(c.radius); w.color(c.color); }
+    void put(Writer& w, const Document::TriangleItem& t)
+    {
+        for (const auto& p : t.points) w.vec(p);
+        w.color(t.color);
+    }
+    void put(Writer& w, const Document::TextItem& t)
+    {
+        w.vec(t.position);
+        w.u32(t.first);
+        w.u32(t.length);
+        w.u32(t.size);
+        w.color(t.color);
+    }
+    void put(Writer& w, const Document::StrokeItem& s)
+    {
+        w.u32(s.first);
+        w.u32(s.size);
+        w.u32(s.count);
+        w.color(s.color);
+    }
+    void put(Writer& w, const Document::FillItem& f)
+    {
+        w.i32(f.bounds.left);
+        w.i32(f.bounds.top);
+        w.i32(f.bounds.width);
+        w.i32(f.bounds.height);
+        w.vec(f.origin);
+        w.f32(f.pixelSize);
+        w.u32(f.mask);
+        w.color(f.color);
+    }
+
+    void get(Reader& r, Document::RectangleItem& i) { i.position = r.vec(); i.size = r.vec(); i.color = r.color(); }
+    void get(Reader& r, Document::CircleItem& i) { i.center = r.vec(); i.radius = r.f32(); i.color = r.color(); }
+    void get(Reader& r, Document::TriangleItem& i)
+    {
+        for (auto& p : i.points) p = r.vec();
+        i.color = r.color();
+    }
+    void get(Reader& r, Document::TextItem& i)
+    {
+        i.position = r.vec();
+        i.first = r.u32();
+        i.length = r.u32();
+        i.size = r.u32();
+        i.color = r.color();
+    }
+    void get(Reader& r, Document::StrokeItem& i)
+    {
+        i.first = r.u32();
+        i.size = r.u32();
+        i.count = r.u32();
+        i.color = r.color();
+    }
+    void get(Reader& r, Document::FillItem& i)
+    {
+        int left = r.i32(), top = r.i32(), width = r.i32(), height = r.i32();
+        i.bounds = sf::IntRect(left, top, width, height);
+        i.origin = r.vec();
+        i.pixelSize = r.f32();
+        i.mask = r.u32();
+        i.color = r.color();
+    }
+
+    // Size in bytes of one record of each kind, as written by put().
+    const std::size_t rectangleSize = 20, circleSize = 16, triangleSize = 28, textSize = 24, strokeSize = 16,
+                      fillSize = 36, orderSize = 21, placeSize = 28;
+
+    void putMatrix(Writer& w, const sf::Transform& transform)
+    {
+        const float* m = transform.getMatrix();
+        w.f32(m[0]);
+        w.f32(m[4]);
+        w.f32(m[12]);
+        w.f32(m[1]);
+        w.f32(m[5]);
+        w.f32(m[13]);
+    }
+
+    sf::Transform getMatrix(Reader& r)
+    {
+        float m[6];
+        for (float& v : m) v = r.f32();
+        return sf::Transform(m[0], m[1], m[2], m[3], m[4], m[5], 0.f, 0.f, 1.f);
+    }
+
+    // Item bounds, as read or as a placement leaves them. Each value read is
+    // already finite and in range; the edges they add up to must be too.
+    bool validBounds(const sf::FloatRect& b)
+    {
+        float right = b.left + b.width, bottom = b.top + b.height;
+        return b.width >= 0.f && b.height >= 0.f && std::fabs(b.left) <= maxCoordinate &&
+               std::fabs(b.top) <= maxCoordinate && std::fabs(right) <= maxCoordinate &&
+               std::fabs(bottom) <= maxCoordinate;
+    }
+
+    // Pieces must lie along the stroke's samples, in order and apart. The
+    // comparisons are written so that NaN fails them.
+    bool validPieces(const std::vector<Document::Piece>& pieces, std::uint32_t samples)
+    {
+        float last = 0.f;
+        for (const auto& p : pieces)
+        {
+            if (!(p.from >= last && p.to >= p.from && p.to <= (float)samples - 1.f)) return false;
+            last = p.to;
+        }
+        return !pieces.empty();
+    }
+
+    std::uint32_t tagOf(const char* tag)
+    {
+        return (std::uint32_t)(std::uint8_t)tag[0] | (std::uint32_t)(std::uint8_t)tag[1] << 8 |
+               (std::uint32_t)(std::uint8_t)tag[2] << 16 | (std::uint32_t)(std::uint8_t)tag[3] << 24;
+    }
+
+    template <typename Item>
+    void putChunk(Writer& w, const char* tag, const std::vector<Item>& items)
+    {
+        std::size_t start = w.begin((const std::uint8_t*)tag, 4);
+        for (const auto& item : items) put(w, item);
+        w.end(start, 4);
+    }
+
+    template <typename Item>
+    bool getChunk(Reader& r, std::size_t recordSize, std::vector<Item>& items)
+    {
+        std::size_t size = (std::size_t)(r.end - r.p);
+        if (size % recordSize) return false;
+        items.resize(size / recordSize);
+        for (auto& item : items) get(r, item);
+        return r.ok;
+    }
+
+#if !defined(_WIN32)
+    bool writeAll(int fd, const std::uint8_t* data, std::size_t size)
+    {
+        while (size > 0)
+        {
+            ssize_t n = ::write(fd, data, size);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            data += n;
+            size -= (std::size_t)n;
+        }
+        return true;
+    }
+
+    // Waits until what was written to fd is on the disk itself. fsync on
+    // macOS only hands it to the drive, which may still hold it in cache.
+    bool syncFile(int fd)
+    {
+#if defined(__APPLE__)
+        if (::fcntl(fd, F_FULLFSYNC) == 0) return true;
+#endif
+        while (::fsync(fd) != 0)
+        {
+            if (errno != EINTR) return false;
+        }
+        return true;
+    }
+#endif
+
+    // Read-only view of a whole file: memory-mapped where the platform
+    // allows it, so untouched pages are never read from disk.
+    class MappedFile
+    {
+    public:
+        explicit MappedFile(const std::string& path) : data(nullptr), size(0)
+        {
+#if defined(_WIN32)
+            std::ifstream in(path, std::ios::binary);
+            if (!in) return;
+            buffer.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+            data = (const std::uint8_t*)buffer.data();
+            size = buffer.size();
+#else
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0) return;
+            struct stat info;
+            if (::fstat(fd, &info) == 0 && info.st_size > 0)
+            {
+                void* mapped = ::mmap(nullptr, (std::size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (mapped != MAP_FAILED)
+                {
+                    ::madvise(mapped, (std::size_t)info.st_size, MADV_SEQUENTIAL);
+                    data = (const std::uint8_t*)mapped;
+                    size = (std::size_t)info.st_size;
+                }
+            }
+            ::close(fd);
+#endif
+        }
+
+        ~MappedFile()
+        {
+#if !defined(_WIN32)
+            if (data) ::munmap((void*)data, size);
+#endif
+        }
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        const std::uint8_t* data;
+        std::size_t size;
+
+    private:
+#if defined(_WIN32)
+        std::vector<char> buffer;
+#endif
+    };
+}
+
+void DocumentFile::write(const Document& doc, std::uint32_t generation, std::vector<std::uint8_t>& out)
+{
+    Writer w{out};
+    w.bytes((const std::uint8_t*)fileMagic, 8);
+    w.u32(version);
+
+    std::size_t start = w.begin((const std::uint8_t*)"META", 4);
+    w.u32(generation);
+    w.color(doc.background);
+    w.u32(doc.base);
+    w.u32((std::uint32_t)doc.order.size());
+    w.end(start, 4);
+
+    start = w.begin((const std::uint8_t*)"ORDR", 4);
+    for (std::size_t id = 0; id < doc.order.size(); ++id)
+    {
+        w.u8((std::uint8_t)doc.order[id].kind);
+        w.u32(doc.order[id].index);
+        w.rect(doc.itemBounds[id]);
+    }
+    w.end(start, 4);
+
+    // Items hidden before a clear stay listed, so undoing it after a reload
+    // or a replay leaves them hidden.
+    start = w.begin((const std::uint8_t*)"HIDE", 4);
+    for (std::uint32_t id = 0; id < doc.order.size(); ++id)
+    {
+        bool hidden = id < doc.hidden.size() && doc.hidden[id];
+        if (hidden || (id >= doc.base && !doc.index.contains(id))) w.u32(id);
+    }
+    w.end(start, 4);
+
+    putChunk(w, "RECT", doc.rectangles);
+    putChunk(w, "CIRC", doc.circles);
+    putChunk(w, "TRIS", doc.triangles);
+    putChunk(w, "TEXT", doc.texts);
+    putChunk(w, "STRK", doc.strokes);
+    putChunk(w, "FILL", doc.fills);
+
+    start = w.begin((const std::uint8_t*)"GLYP", 4);
+    for (sf::Uint32 glyph : doc.glyphArena) w.u32(glyph);
+    w.end(start, 4);
+
+    start = w.begin((const std::uint8_t*)"SPTS", 4);
+    w.bytes(doc.strokeArena.data(), doc.strokeArena.size());
+    w.end(start, 4);
+
+    start = w.begin((const std::uint8_t*)"MASK", 4);
+    w.bytes(doc.maskArena.data(), doc.maskArena.size());
+    w.end(start, 4);
+
+    if (!doc.placements.empty())
+    {
+        start = w.begin((const std::uint8_t*)"PLAC", 4);
+        for (std::uint32_t id = 0; id < doc.placements.size(); ++id)
+        {
+            if (doc.placements[id] == Document::none) continue;
+            w.u32(id);
+            putMatrix(w, doc.getTransform(id));
+        }
+        w.end(start, 4);
+    }
+
+    if (!doc.cuts.empty())
+    {
+        start = w.begin((const std::uint8_t*)"CUTS", 4);
+        for (std::uint32_t id = 0; id < doc.cuts.size(); ++id)
+        {
+            std::size_t count = 0;
+            const Document::Piece* pieces = doc.piecesOf(id, count);
+            if (!pieces) continue;
+            w.u32(id);
+            w.u32((std::uint32_t)count);
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                w.f32(pieces[i].from);
+                w.f32(pieces[i].to);
+            }
+        }
+        w.end(start, 4);
+    }
+
+    if (!doc.raster.empty())
+    {
+        // In a fixed order, so saving the same document gives the same bytes.
+        struct Tile
+        {
+            int level;
+            std::int32_t x, y;
+            const std::vector<std::uint8_t>* data;
+        };
+        std::vector<Tile> tiles;
+        doc.raster.forEach([&](int level, std::int32_t x, std::int32_t y, const RasterLayer::Data& data) {
+            tiles.push_back(Tile{level, x, y, data.get()});
+        });
+        std::sort(tiles.begin(), tiles.end(), [](const Tile& a, const Tile& b) {
+            if (a.level != b.level) return a.level < b.level;
+            return a.y != b.y ? a.y < b.y : a.x < b.x;
+        });
+
+        start = w.begin((const std::uint8_t*)"RAST", 4);
+        w.f32(doc.raster.getPixelsPerUnit());
+        for (const auto& tile : tiles)
+        {
+            w.u8((std::uint8_t)tile.level);
+            w.i32(tile.x);
+            w.i32(tile.y);
+            w.u32((std::uint32_t)tile.data->size());
+            w.bytes(tile.data->data(), tile.data->size());
+        }
+        w.end(start, 4);
+    }
+
+    w.end(w.begin((const std::uint8_t*)"END ", 4), 4);
+}
+
+bool DocumentFile::read(Document& document, const std::uint8_t* data, std::size_t size, std::uint32_t& generation,
+                        std::string& error)
+{
+    Reader r(data, size);
+    const std::uint8_t* magic = r.bytes(8);
+    if (!magic || std::memcmp(magic, fileMagic, 8) != 0)
+    {
+        error = "not a dibujo document";
+        return false;
+    }
+    std::uint32_t fileVersion = r.u32();
+    if (!r.ok || fileVersion == 0 || fileVersion > version)
+    {
+        error = "unsupported document version";
+        return false;
+    }
+
+    Document doc;
+    std::uint32_t count = 0, fileGeneration = 0;
+    std::vector<std::uint32_t> hidden;
+    struct Placed
+    {
+        std::uint32_t id;
+        sf::Transform transform;
+    };
+    struct Cut
+    {
+        std::uint32_t id;
+        std::vector<Document::Piece> pieces;
+    };
+    std::vector<Placed> placed;
+    std::vector<Cut> cut;
+    std::uint32_t seen = 0;
+    bool ended = false;
+    while (!ended)
+    {
+        const std::uint8_t* tag = r.bytes(4);
+        std::uint32_t length = r.u32();
+        const std::uint8_t* body = r.bytes(length);
+        std::uint32_t checksum = r.u32();
+        if (!r.ok)
+        {
+            error = "document is truncated";
+            return false;
+        }
+        if (fnv1a(body, length, fnv1a(tag, 4)) != checksum)
+        {
+            error = "document is corrupted";
+            return false;
+        }
+
+        std::uint32_t id = tagOf((const char*)tag);
+        Reader c(body, length);
+        bool ok = true;
+        std::uint32_t bit = 0;
+        if (id == tagOf("META"))
+        {
+            bit = 1;
+            fileGeneration = c.u32();
+            doc.background = c.color();
+            doc.base = c.u32();
+            count = c.u32();
+            ok = c.ok && c.done();
+        }
+        else if (id == tagOf("ORDR"))
+        {
+            bit = 2;
+            ok = length % orderSize == 0;
+            doc.order.resize(length / orderSize);
+            doc.itemBounds.resize(doc.order.size());
+            for (std::size_t i = 0; ok && i < doc.order.size(); ++i)
+            {
+                std::uint8_t kind = c.u8();
+                doc.order[i] = ItemRef{(ItemKind)kind, c.u32()};
+                doc.itemBounds[i] = c.rect();
+                ok = c.ok && kind <= (std::uint8_t)ItemKind::Fill && validBounds(doc.itemBounds[i]);
+            }
+        }
+        else if (id == tagOf("HIDE"))
+        {
+            bit = 4;
+            ok = length % 4 == 0;
+            hidden.resize(length / 4);
+            for (auto& h : hidden) h = c.u32();
+        }
+        else if (id == tagOf("RECT")) { bit = 8; ok = getChunk(c, rectangleSize, doc.rectangles); }
+        else if (id == tagOf("CIRC")) { bit = 16; ok = getChunk(c, circleSize, doc.circles); }
+        else if (id == tagOf("TRIS")) { bit = 32; ok = getChunk(c, triangleSize, doc.triangles); }
+        else if (id == tagOf("TEXT")) { bit = 64; ok = getChunk(c, textSize, doc.texts); }
+        else if (id == tagOf("STRK")) { bit = 128; ok = getChunk(c, strokeSize, doc.strokes); }
+        else if (id == tagOf("FILL")) { bit = 256; ok = getChunk(c, fillSize, doc.fills); }
+        else if (id == tagOf("GLYP"))
+        {
+            bit = 512;
+            ok = length % 4 == 0;
+            doc.glyphArena.resize(length / 4);
+            for (auto& g : doc.glyphArena) g = c.u32();
+        }
+        else if (id == tagOf("SPTS"))
+        {
+            bit = 1024;
+            doc.strokeArena.assign(body, body + length);
+        }
+        else if (id == tagOf("MASK"))
+        {
+            bit = 2048;
+            doc.maskArena.assign(body, body + length);
+        }
+        else if (id == tagOf("RAST"))
+        {
+            // Optional: only documents that have been compacted have one.
+            bit = 4096;
+            float pixelsPerUnit = c.f32();
+            RasterLayer layer(pixelsPerUnit);
+            ok = c.ok && pixelsPerUnit > 0.f;
+            while (ok && !c.done())
+            {
+                int level = c.u8();
+                std::int32_t x = c.i32(), y = c.i32();
+                std::uint32_t tileSize = c.u32();
+                const std::uint8_t* tile = c.bytes(tileSize);
+                ok = c.ok && level < RasterLayer::levels && RasterLayer::validate(tile, tileSize) &&
+                     !layer.find(level, x, y);
+                if (ok) layer.set(level, x, y, std::make_shared<std::vector<std::uint8_t>>(tile, tile + tileSize));
+            }
+            doc.raster = std::move(layer);
+        }
+        else if (id == tagOf("PLAC"))
+        {
+            // Optional, like CUTS: only items moved or erased have one.
+            bit = 8192;
+            ok = length % placeSize == 0;
+            placed.resize(length / placeSize);
+            for (auto& p : placed)
+            {
+                p.id = c.u32();
+                p.transform = getMatrix(c);
+            }
+            ok = ok && c.ok;
+        }
+        else if (id == tagOf("CUTS"))
+        {
+            bit = 16384;
+            while (ok && !c.done())
+            {
+                Cut item;
+                item.id = c.u32();
+                std::uint32_t pieces = c.u32();
+                ok = c.ok && c.has((std::size_t)pieces * 8);
+                for (std::uint32_t i = 0; ok && i < pieces; ++i)
+                {
+                    float from = c.f32();
+                    item.pieces.push_back(Document::Piece{from, c.f32()});
+                }
+                ok = ok && c.ok;
+                cut.push_back(std::move(item));
+            }
+        }
+        else if (id == tagOf("END "))
+        {
+            ended = true;
+        }
+
+        if (!ok || (seen & bit))
+        {
+            error = "document has a malformed chunk";
+            return false;
+        }
+        seen |= bit;
+    }
+
+    if ((seen & 4095) != 4095 || count != doc.order.size() || doc.base > count)
+    {
+        error = "document is incomplete";
+        return false;
+    }
+    for (std::size_t i = 0; i < doc.fills.size(); ++i) doc.fills[i].texture = (std::uint32_t)i;
+    if (!validate(doc, error)) return false;
+
+    // Each in id order, so nothing is placed or cut twice. Bounds were saved
+    // as placed and cut.
+    std::int64_t last = -1;
+    for (const auto& p : placed)
+    {
+        if ((std::int64_t)p.id <= last || p.id >= count)
+        {
+            error = "document places an unknown item";
+            return false;
+        }
+        last = p.id;
+        const float* m = p.transform.getMatrix();
+        doc.placementArena.push_back(Document::Placement{{m[0], m[4], m[12], m[1], m[5], m[13]}});
+        doc.placements.resize(p.id + 1, Document::none);
+        doc.placements[p.id] = (std::uint32_t)doc.placementArena.size() - 1;
+    }
+    last = -1;
+    for (const auto& item : cut)
+    {
+        if ((std::int64_t)item.id <= last || item.id >= count || doc.order[item.id].kind != ItemKind::Stroke ||
+            !validPieces(item.pieces, doc.strokes[doc.order[item.id].index].count))
+        {
+            error = "document has a bad cut";
+            return false;
+        }
+        last = item.id;
+        doc.cutArena.push_back(Document::Cut{(std::uint32_t)doc.pieceArena.size(), (std::uint32_t)item.pieces.size()});
+        doc.pieceArena.insert(doc.pieceArena.end(), item.pieces.begin(), item.pieces.end());
+        doc.cuts.resize(item.id + 1, Document::none);
+        doc.cuts[item.id] = (std::uint32_t)doc.cutArena.size() - 1;
+    }
+
+    for (std::uint32_t id = doc.base; id < count; ++id) doc.index.insert(id, doc.itemBounds[id]);
+    for (std::uint32_t id : hidden)
+    {
+        if (id >= count)
+        {
+            error = "document hides an unknown item";
+            return false;
+        }
+        if (doc.hidden.size() <= id) doc.hidden.resize(id + 1, false);
+        doc.hidden[id] = true;
+        doc.index.remove(id);
+    }
+    doc.fillTextures.resize(doc.fills.size());
+
+    doc.font = document.font;
+    doc.strokeTolerance = document.strokeTolerance;
+    doc.changeLog = document.changeLog;
+    document = std::move(doc);
+    generation = fileGeneration;
+    return true;
+}
+
+bool DocumentFile::validate(const Document& doc, std::string& error)
+{
+    // Each kind's items must appear in id order with consecutive indices,
+    // and their arena payloads in order too, which truncate() relies on.
+    std::size_t next[6] = {0, 0, 0, 0, 0, 0};
+    std::size_t sizes[6] = {doc.rectangles.size(), doc.circles.size(), doc.triangles.size(),
+                            doc.texts.size(), doc.strokes.size(), doc.fills.size()};
+    for (const auto& ref : doc.order)
+    {
+        std::size_t kind = (std::size_t)ref.kind;
+        if (ref.index != next[kind]++)
+        {
+            error = "document items are out of order";
+            return false;
+        }
+    }
+    for (int k = 0; k < 6; ++k)
+    {
+        if (next[k] != sizes[k])
+        {
+            error = "document item tables do not match";
+            return false;
+        }
+    }
+
+    std::uint64_t end = 0;
+    for (const auto& t : doc.texts)
+    {
+        if (t.first < end || (std::uint64_t)t.first + t.length > doc.glyphArena.size() || t.size > maxTextSize)
+        {
+            error = "document has a bad text item";
+            return false;
+        }
+        end = (std::uint64_t)t.first + t.length;
+    }
+    end = 0;
+    for (const auto& s : doc.strokes)
+    {
+        if (s.first < end || (std::uint64_t)s.first + s.size > doc.strokeArena.size() ||
+            StrokeCodec::count(doc.strokeArena.data() + s.first, s.size) != s.count)
+        {
+            error = "document has a bad stroke item";
+            return false;
+        }
+        end = (std::uint64_t)s.first + s.size;
+    }
+    end = 0;
+    for (const auto& f : doc.fills)
+    {
+        const sf::IntRect& b = f.bounds;
+        std::uint64_t area = (std::uint64_t)(std::uint32_t)b.width * (std::uint32_t)b.height;
+        if (b.width <= 0 || b.height <= 0 || b.width > maxFillSide || b.height > maxFillSide ||
+            f.pixelSize <= 0.f || f.mask < end || f.mask + area > doc.maskArena.size())
+        {
+            error = "document has a bad fill item";
+            return false;
+        }
+        end = f.mask + area;
+    }
+    return true;
+}
+
+bool DocumentFile::save(const Document& document, const std::string& path, std::uint32_t generation,
+                        std::string& error)
+{
+    std::vector<std::uint8_t> bytes;
+    write(document, generation, bytes);
+
+    std::string temporary = path + ".tmp";
+#if defined(_WIN32)
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        out.write((const char*)bytes.data(), (std::streamsize)bytes.size());
+        out.flush();
+        if (!out)
+        {
+            error = "could not write " + temporary;
+            return false;
+        }
+    }
+    std::remove(path.c_str());
+    if (std::rename(temporary.c_str(), path.c_str()) != 0)
+    {
+        error = "could not replace " + path;
+        return false;
+    }
+#else
+    int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        error = "could not write " + temporary;
+        return false;
+    }
+    bool written = writeAll(fd, bytes.data(), bytes.size()) && syncFile(fd);
+    written = ::close(fd) == 0 && written;
+    if (!written)
+    {
+        std::remove(temporary.c_str());
+        error = "could not write " + temporary;
+        return false;
+    }
+    if (std::rename(temporary.c_str(), path.c_str()) != 0)
+    {
+        error = "could not replace " + path;
+        return false;
+    }
+
+    // The rename is only on disk once the directory holding it is.
+    std::string::size_type slash = path.rfind('/');
+    std::string directory = slash == std::string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+    int dir = ::open(directory.c_str(), O_RDONLY);
+    bool synced = dir >= 0 && syncFile(dir);
+    if (dir >= 0) ::close(dir);
+    if (!synced)
+    {
+        error = "could not sync " + directory;
+        return false;
+    }
+#endif
+    return true;
+}
+
+bool DocumentFile::load(Document& document, const std::string& path, std::uint32_t& generation,
+                        std::string& error)
+{
+    MappedFile file(path);
+    if (!file.data)
+    {
+        error = "could not open " + path;
+        return false;
+    }
+    return read(document, file.data, file.size, generation, error);
+}
+
+void DocumentFile::writeJournalHeader(std::uint32_t generation, std::vector<std::uint8_t>& out)
+{
+    Writer w{out};
+    w.bytes((const std::uint8_t*)journalMagic, 8);
+    w.u32(version);
+    w.u32(generation);
+}
+
+void DocumentFile::logAdd(const Document& doc, std::uint32_t id, std::vector<std::uint8_t>& out)
+{
+    Writer w{out};
+    std::uint8_t op = (std::uint8_t)Op::Add;
+    std::size_t start = w.begin(&op, 1);
+    ItemRef item = doc.order[id];
+    w.u32(id);
+    w.u8((std::uint8_t)item.kind);
+    w.rect(doc.itemBounds[id]);
+    switch (item.kind)
+    {
+        case ItemKind::Rectangle: put(w, doc.rectangles[item.index]); break;
+        case ItemKind::Circle: put(w, doc.circles[item.index]); break;
+        case ItemKind::Triangle: put(w, doc.triangles[item.index]); break;
+        case ItemKind::Text:
+        {
+            const auto& t = doc.texts[item.index];
+            put(w, t);
+            for (std::uint32_t i = 0; i < t.length; ++i) w.u32(doc.glyphArena[t.first + i]);
+            break;
+        }
+        case ItemKind::Stroke:
+        {
+            const auto& s = doc.strokes[item.index];
+            put(w, s);
+            w.bytes(doc.strokeArena.data() + s.first, s.size);
+            break;
+        }
+        case ItemKind::Fill:
+        {
+            const auto& f = doc.fills[item.index];
+            put(w, f);
+            w.bytes(doc.maskArena.data() + f.mask, (std::size_t)f.bounds.width * f.bounds.height);
+            break;
+        }
+    }
+    w.end(start, 1);
+}
+
+void DocumentFile::logId(std::vector<std::uint8_t>& out, Op op, std::uint32_t id)
+{
+    Writer w{out};
+    std::uint8_t tag = (std::uint8_t)op;
+    std::size_t start = w.begin(&tag, 1);
+    w.u32(id);
+    w.end(start, 1);
+}
+
+void DocumentFile::logColor(std::vector<std::uint8_t>& out, Op op, std::uint32_t id, sf::Color color)
+{
+    Writer w{out};
+    std::uint8_t tag = (std::uint8_t)op;
+    std::size_t start = w.begin(&tag, 1);
+    w.u32(id);
+    w.color(color);
+    w.end(start, 1);
+}
+
+void DocumentFile::logPlace(const Document& doc, std::uint32_t id, std::vector<std::uint8_t>& out)
+{
+    Writer w{out};
+    std::uint8_t tag = (std::uint8_t)Op::Place;
+    std::size_t start = w.begin(&tag, 1);
+    w.u32(id);
+    putMatrix(w, doc.getTransform(id));
+    w.end(start, 1);
+}
+
+// Undoing every cut is logged as the one piece the whole stroke makes.
+void DocumentFile::logCut(const Document& doc, std::uint32_t id, std::vector<std::uint8_t>& out)
+{
+    Writer w{out};
+    std::uint8_t tag = (std::uint8_t)Op::Cut;
+    std::size_t start = w.begin(&tag, 1);
+    w.u32(id);
+    std::size_t count = 0;
+    const Document::Piece* pieces = doc.piecesOf(id, count);
+    Document::Piece whole{0.f, (float)doc.strokes[doc.order[id].index].count - 1.f};
+    if (!pieces)
+    {
+        pieces = &whole;
+        count = 1;
+    }
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        w.f32(pieces[i].from);
+        w.f32(pieces[i].to);
+    }
+    w.end(start, 1);
+}
+
+bool DocumentFile::applyCut(Document& doc, std::uint32_t id, const std::uint8_t* data, std::size_t size)
+{
+    Reader r(data, size);
+    r.u32();
+    if (id >= doc.order.size() || doc.order[id].kind != ItemKind::Stroke || (size - 4) % 8) return false;
+    std::vector<Document::Piece> pieces((size - 4) / 8);
+    for (auto& p : pieces)
+    {
+        p.from = r.f32();
+        p.to = r.f32();
+    }
+    if (!r.ok || !validPieces(pieces, doc.strokes[doc.order[id].index].count)) return false;
+    doc.cut(id, pieces.data(), pieces.size());
+    return true;
+}
+
+bool DocumentFile::applyAdd(Document& doc, const std::uint8_t* data, std::size_t size)
+{
+    Reader r(data, size);
+    std::uint32_t id = r.u32();
+    std::uint8_t kind = r.u8();
+    sf::FloatRect bounds = r.rect();
+    if (!r.ok || id != doc.order.size() || kind > (std::uint8_t)ItemKind::Fill || !validBounds(bounds)) return false;
+
+    std::uint32_t index = 0;
+    switch ((ItemKind)kind)
+    {
+        case ItemKind::Rectangle:
+        {
+            Document::RectangleItem item;
+            get(r, item);
+            index = (std::uint32_t)doc.rectangles.size();
+            if (r.ok) doc.rectangles.push_back(item);
+            break;
+        }
+        case ItemKind::Circle:
+        {
+            Document::CircleItem item;
+            get(r, item);
+            index = (std::uint32_t)doc.circles.size();
+            if (r.ok) doc.circles.push_back(item);
+            break;
+        }
+        case ItemKind::Triangle:
+        {
+            Document::TriangleItem item;
+            get(r, item);
+            index = (std::uint32_t)doc.triangles.size();
+            if (r.ok) doc.triangles.push_back(item);
+            break;
+        }
+        case ItemKind::Text:
+        {
+            Document::TextItem item;
+            get(r, item);
+            if (!r.ok || item.size > maxTextSize || (std::size_t)(r.end - r.p) != (std::size_t)item.length * 4)
+                return false;
+            item.first = (std::uint32_t)doc.glyphArena.size();
+            for (std::uint32_t i = 0; i < item.length; ++i) doc.glyphArena.push_back(r.u32());
+            index = (std::uint32_t)doc.texts.size();
+            doc.texts.push_back(item);
+            break;
+        }
+        case ItemKind::Stroke:
+        {
+            Document::StrokeItem item;
+            get(r, item);
+            if (!r.ok || (std::size_t)(r.end - r.p) != item.size || StrokeCodec::count(r.p, item.size) != item.count)
+                return false;
+            item.first = (std::uint32_t)doc.strokeArena.size();
+            doc.strokeArena.insert(doc.strokeArena.end(), r.p, r.end);
+            r.p = r.end;
+            index = (std::uint32_t)doc.strokes.size();
+            doc.strokes.push_back(item);
+            break;
+        }
+        case ItemKind::Fill:
+        {
+            Document::FillItem item;
+            get(r, item);
+            const sf::IntRect& b = item.bounds;
+            if (!r.ok || b.width <= 0 || b.height <= 0 || b.width > maxFillSide || b.height > maxFillSide ||
+                item.pixelSize <= 0.f || (std::size_t)(r.end - r.p) != (std::size_t)b.width * b.height)
+                return false;
+            item.mask = (std::uint32_t)doc.maskArena.size();
+            item.texture = (std::uint32_t)doc.fillTextures.size();
+            doc.maskArena.insert(doc.maskArena.end(), r.p, r.end);
+            r.p = r.end;
+            index = (std::uint32_t)doc.fills.size();
+            doc.fills.push_back(item);
+            doc.fillTextures.emplace_back();
+            break;
+        }
+    }
+    if (!r.ok || !r.done()) return false;
+    doc.push((ItemKind)kind, index, bounds);
+    return true;
+}
+
+long DocumentFile::replay(Document& doc, const std::uint8_t* data, std::size_t size, std::uint32_t generation)
+{
+    Reader r(data, size);
+    const std::uint8_t* magic = r.bytes(8);
+    std::uint32_t journalVersion = r.u32();
+    std::uint32_t journalGeneration = r.u32();
+    if (!r.ok || std::memcmp(magic, journalMagic, 8) != 0 || journalVersion == 0 || journalVersion > version ||
+        journalGeneration != generation)
+        return -1;
+
+    std::size_t used = 0;
+    return applyRecords(doc, r.p, (std::size_t)(r.end - r.p), nullptr, used);
+}
+
+bool DocumentFile::apply(Document& doc, const std::uint8_t* data, std::size_t size, Touched* touched)
+{
+    std::size_t used = 0;
+    applyRecords(doc, data, size, touched, used);
+    return used == size;
+}
+
+long DocumentFile::applyRecords(Document& doc, const std::uint8_t* data, std::size_t size, Touched* touched,
+                                std::size_t& used)
+{
+    Reader r(data, size);
+    long applied = 0;
+    while (!r.done())
+    {
+        std::uint8_t op = r.u8();
+        std::uint32_t length = r.u32();
+        const std::uint8_t* body = r.bytes(length);
+        std::uint32_t checksum = r.u32();
+        if (!r.ok || fnv1a(body, length, fnv1a(&op, 1)) != checksum) break;
+
+        Reader c(body, length);
+        std::uint32_t id = op == (std::uint8_t)Op::Add ? (std::uint32_t)doc.order.size() : c.u32();
+        bool ok = c.ok;
+        switch ((Op)op)
+        {
+            case Op::Add: ok = applyAdd(doc, body, length); break;
+            case Op::Hide: ok = ok && id < doc.order.size() && c.done(); if (ok) doc.hide(id); break;
+            case Op::Show: ok = ok && id < doc.order.size() && c.done(); if (ok) doc.show(id); break;
+            case Op::Recolor:
+            {
+                sf::Color color = c.color();
+                ok = c.ok && c.done() && id < doc.order.size();
+                if (ok) doc.setColor(id, color);
+                break;
+            }
+            case Op::Background:
+            {
+                sf::Color color = c.color();
+                ok = c.ok && c.done();
+                if (ok) doc.setBackground(color);
+                break;
+            }
+            case Op::Place:
+            {
+                sf::Transform transform = getMatrix(c);
+                ok = c.ok && c.done() && id < doc.order.size();
+                if (!ok) break;
+                sf::FloatRect area = doc.getBounds(id);
+                std::uint32_t previous = doc.place(id, transform);
+                // A matrix that throws the item out of range is as bad as
+                // a damaged record; the item stays where it was.
+                ok = validBounds(doc.getBounds(id));
+                if (!ok) doc.setPlacement(id, previous);
+                else if (touched) touched->areas.push_back(area);
+                break;
+            }
+            case Op::Cut:
+            {
+                sf::FloatRect area = id < doc.order.size() ? doc.getBounds(id) : sf::FloatRect();
+                ok = ok && applyCut(doc, id, body, length);
+                if (ok && touched) touched->areas.push_back(area);
+                break;
+            }
+            case Op::Clear: ok = ok && c.done(); if (ok) doc.clear(); break;
+            case Op::Restore: ok = ok && c.done() && id <= doc.base; if (ok) doc.restore(id); break;
+            case Op::Truncate: ok = ok && c.done() && id <= doc.order.size(); if (ok) doc.truncate(id); break;
+            default: ok = false; break;
+        }
+        if (!ok) break;
+        ++applied;
+        used = (std::size_t)(r.p - data);
+        if (!touched) continue;
+        if (op == (std::uint8_t)Op::Clear || op == (std::uint8_t)Op::Restore || op == (std::uint8_t)Op::Truncate)
+            touched->all = true;
+        else if (op != (std::uint8_t)Op::Background)
+            touched->items.push_back(id);
+    }
+    return applied;
+}
+
+long DocumentFile::replayFile(Document& document, const std::string& path, std::uint32_t generation)
+{
+    MappedFile file(path);
+    if (!file.data) return -1;
+    return replay(document, file.data, file.size, generation);
+}
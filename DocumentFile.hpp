@@ -0,0 +1,105 @@
+#ifndef DOCUMENTFILE_HPP
+#define DOCUMENTFILE_HPP
+
+#include <SFML/Graphics/Color.hpp>
+#include <SFML/Graphics/Rect.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class Document;
+
+// Native binary format for a Document, and the journal that autosave
+// appends to between full saves.
+//
+// A document file is the magic "DIBUJO\r\n", a u32 version, then chunks of
+// [tag:4][length:u32][data][checksum:u32] closed by an "END " chunk. The
+// checksum is FNV-1a over tag and data. Everything is little-endian. The
+// chunks hold the document's own dense arrays as typed fixed-size records,
+// with the glyph string table, quantized stroke deltas and fill masks as
+// arenas. A compacted document also has a RAST chunk holding the encoded
+// tiles of its raster layer, and one with items moved or erased has PLAC
+// and CUTS chunks holding their transforms and the pieces of strokes left.
+// Unknown chunks are skipped, so later versions can add more.
+//
+// Loading memory-maps the file and copies the arrays out in bulk. Strokes
+// stay encoded and fill textures are created on first draw, so nothing is
+// tessellated or uploaded up front. Every record and reference is checked
+// first, and a damaged file leaves the document untouched.
+//
+// A journal is the magic "DIBJRNL\n", a u32 version, the generation of the
+// document file it extends, then records of [op:u8][length:u32][data]
+// [checksum:u32]. Replay stops at the first damaged record, which is how a
+// write torn by a crash is dropped. Live sharing streams the same records,
+// without the header.
+class DocumentFile
+{
+public:
+    enum class Op : std::uint8_t
+    {
+        Add = 1,
+        Hide,
+        Show,
+        Recolor,
+        Clear,
+        Restore,
+        Truncate,
+        Background,
+        Place,
+        Cut
+    };
+
+    static const std::uint32_t version = 1;
+
+    // Items that applying records changed, so a view can redraw just those,
+    // and areas they covered before records moved or cut them. all is set
+    // by records that affect every item: clear, restore and truncate.
+    struct Touched
+    {
+        std::vector<std::uint32_t> items;
+        std::vector<sf::FloatRect> areas;
+        bool all = false;
+    };
+
+    // Writes the whole document through a temporary file and a rename, so a
+    // crash mid-save keeps the previous file. The temporary file is synced
+    // to disk before the rename and its directory after it, so once this
+    // returns true the new file survives a power loss and the journal it
+    // replaces can go.
+    static bool save(const Document& document, const std::string& path, std::uint32_t generation,
+                     std::string& error);
+    static bool load(Document& document, const std::string& path, std::uint32_t& generation, std::string& error);
+
+    static void write(const Document& document, std::uint32_t generation, std::vector<std::uint8_t>& out);
+    static bool read(Document& document, const std::uint8_t* data, std::size_t size, std::uint32_t& generation,
+                     std::string& error);
+
+    static void writeJournalHeader(std::uint32_t generation, std::vector<std::uint8_t>& out);
+
+    // Applies journal records in order. Returns how many were applied, or
+    // -1 when the journal belongs to another generation of the file.
+    static long replay(Document& document, const std::uint8_t* data, std::size_t size, std::uint32_t generation);
+    static long replayFile(Document& document, const std::string& path, std::uint32_t generation);
+
+    // Applies bare journal records. False when one is damaged or does not
+    // fit the document; those before it have been applied all the same.
+    static bool apply(Document& document, const std::uint8_t* data, std::size_t size, Touched* touched = nullptr);
+
+    // Journal records, appended to out as the document changes.
+    static void logAdd(const Document& document, std::uint32_t id, std::vector<std::uint8_t>& out);
+    static void logId(std::vector<std::uint8_t>& out, Op op, std::uint32_t id);
+    static void logColor(std::vector<std::uint8_t>& out, Op op, std::uint32_t id, sf::Color color);
+    // The item's transform and a stroke's pieces as they stand.
+    static void logPlace(const Document& document, std::uint32_t id, std::vector<std::uint8_t>& out);
+    static void logCut(const Document& document, std::uint32_t id, std::vector<std::uint8_t>& out);
+
+private:
+    // Applies records up to the first bad one; used is how many bytes they took.
+    static long applyRecords(Document& document, const std::uint8_t* data, std::size_t size, Touched* touched,
+                             std::size_t& used);
+    static bool applyAdd(Document& document, const std::uint8_t* data, std::size_t size);
+    static bool applyCut(Document& document, std::uint32_t id, const std::uint8_t* data, std::size_t size);
+    static bool validate(const Document& document, std::string& error);
+};
+
+#endif
@@ -0,0 +1,90 @@
+#include "EventTrace.hpp"
+#include <istream>
+#include <ostream>
+#include <sstream>
+#include <string>
+
+namespace EventTrace
+{
+    bool write(std::ostream& out, std::uint32_t frame, const sf::Event& ev)
+    {
+        switch (ev.type)
+        {
+            case sf::Event::MouseMoved:
+                out << frame << " move " << ev.mouseMove.x << ' ' << ev.mouseMove.y << '\n';
+                return true;
+            case sf::Event::MouseButtonPressed:
+            case sf::Event::MouseButtonReleased:
+                out << frame << (ev.type == sf::Event::MouseButtonPressed ? " press " : " release ")
+                    << ev.mouseButton.button << ' ' << ev.mouseButton.x << ' ' << ev.mouseButton.y << '\n';
+                return true;
+            case sf::Event::KeyPressed:
+                out << frame << " key " << ev.key.code << ' ' << ev.key.control << ' ' << ev.key.shift << ' '
+                    << ev.key.alt << ' ' << ev.key.system << '\n';
+                return true;
+            case sf::Event::TextEntered:
+                out << frame << " text " << ev.text.unicode << '\n';
+                return true;
+            case sf::Event::MouseWheelScrolled:
+                out << frame << " wheel " << ev.mouseWheelScroll.delta << ' ' << ev.mouseWheelScroll.x << ' '
+                    << ev.mouseWheelScroll.y << '\n';
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    bool read(std::istream& in, std::vector<Entry>& entries)
+    {
+        std::string line, kind;
+        while (std::getline(in, line))
+        {
+            if (line.empty() || line[0] == '#') continue;
+            std::istringstream fields(line);
+            Entry entry{};
+            if (!(fields >> entry.frame >> kind)) return false;
+
+            sf::Event& ev = entry.event;
+            int a = 0, b = 0, c = 0, d = 0, e = 0;
+            if (kind == "move")
+            {
+                ev.type = sf::Event::MouseMoved;
+                fields >> ev.mouseMove.x >> ev.mouseMove.y;
+            }
+            else if (kind == "press" || kind == "release")
+            {
+                ev.type = kind == "press" ? sf::Event::MouseButtonPressed : sf::Event::MouseButtonReleased;
+                fields >> a >> ev.mouseButton.x >> ev.mouseButton.y;
+                ev.mouseButton.button = (sf::Mouse::Button)a;
+            }
+            else if (kind == "key")
+            {
+                ev.type = sf::Event::KeyPressed;
+                fields >> a >> b >> c >> d >> e;
+                ev.key.code = (sf::Keyboard::Key)a;
+                ev.key.control = b != 0;
+                ev.key.shift = c != 0;
+                ev.key.alt = d != 0;
+                ev.key.system = e != 0;
+            }
+            else if (kind == "text")
+            {
+                ev.type = sf::Event::TextEntered;
+                fields >> ev.text.unicode;
+            }
+            else if (kind == "wheel")
+            {
+                ev.type = sf::Event::MouseWheelScrolled;
+                ev.mouseWheelScroll.wheel = sf::Mouse::VerticalWheel;
+                fields >> ev.mouseWheelScroll.delta >> ev.mouseWheelScroll.x >> ev.mouseWheelScroll.y;
+            }
+            else
+            {
+                return false;
+            }
+            if (fields.fail()) return false;
+            entries.push_back(entry);
+        }
+        return true;
+    }
+}
@@ -0,0 +1,25 @@
+#ifndef EVENTTRACE_HPP
+#define EVENTTRACE_HPP
+
+#include <SFML/Window/Event.hpp>
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+
+// Plain-text recording of the input events App consumes, one event per
+// line prefixed by the frame it arrived in, so a session can be replayed
+// frame-accurately by the benchmark.
+namespace EventTrace
+{
+    struct Entry
+    {
+        std::uint32_t frame;
+        sf::Event event;
+    };
+
+    // Returns false (and writes nothing) for event types App ignores.
+    bool write(std::ostream& out, std::uint32_t frame, const sf::Event& event);
+    bool read(std::istream& in, std::vector<Entry>& entries);
+}
+
+#endif
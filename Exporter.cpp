@@ -0,0 +1,1290 @@
+#include "Exporter.hpp"
+#include "Assets.hpp"
+#include "Document.hpp"
+#include "WorkerPool.hpp"
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <zlib.h>
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+namespace
+{
+    // Largest image side written, and what the bands in flight may hold.
+    const std::int64_t maxImageSide = 1 << 20;
+    const std::size_t bandBudget = 96u << 20;
+    const std::size_t bandsInFlight = 3;
+    // Glyphs are rasterized at the output size, up to this.
+    const unsigned maxGlyphSize = 512;
+
+    void put32(std::uint8_t* out, std::uint32_t v)
+    {
+        out[0] = (std::uint8_t)(v >> 24);
+        out[1] = (std::uint8_t)(v >> 16);
+        out[2] = (std::uint8_t)(v >> 8);
+        out[3] = (std::uint8_t)v;
+    }
+
+    int paeth(int a, int b, int c)
+    {
+        int p = a + b - c;
+        int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+        if (pa <= pb && pa <= pc) return a;
+        return pb <= pc ? b : c;
+    }
+
+    // Filters one RGBA row with the given PNG filter type into out, returning
+    // the sum of absolute filtered values that picks the best type.
+    template <int Type>
+    std::uint64_t filterRow(const std::uint8_t* x, const std::uint8_t* up, std::size_t size, std::uint8_t* out)
+    {
+        std::uint64_t cost = 0;
+        out[0] = (std::uint8_t)Type;
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            int a = i >= 4 ? x[i - 4] : 0, b = up[i], c = i >= 4 ? up[i - 4] : 0;
+            int predicted = Type == 1 ? a : Type == 2 ? b : Type == 3 ? (a + b) / 2 : Type == 4 ? paeth(a, b, c) : 0;
+            std::uint8_t v = (std::uint8_t)(x[i] - predicted);
+            out[i + 1] = v;
+            cost += v < 128 ? v : 256 - v;
+        }
+        return cost;
+    }
+
+    // Writes an 8-bit RGBA PNG one row at a time. Each row gets the filter
+    // that leaves the smallest residuals, and compressed output is written
+    // out in IDAT chunks as it fills a fixed buffer.
+    class PngStream
+    {
+    public:
+        PngStream() : out(nullptr), started(false)
+        {
+            std::memset(&zs, 0, sizeof(zs));
+        }
+
+        ~PngStream()
+        {
+            if (started) deflateEnd(&zs);
+        }
+
+        bool open(std::ostream& stream, std::uint32_t width, std::uint32_t height)
+        {
+            out = &stream;
+            if (!*out) return false;
+            static const std::uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+            out->write((const char*)signature, 8);
+            std::uint8_t header[13] = {};
+            put32(header, width);
+            put32(header + 4, height);
+            header[8] = 8; // bits per channel
+            header[9] = 6; // RGBA
+            chunk("IHDR", header, sizeof(header));
+
+            previous.assign((std::size_t)width * 4, 0);
+            for (auto& f : filtered) f.resize(previous.size() + 1);
+            buffer.resize(1 << 16);
+            if (deflateInit(&zs, 6) != Z_OK) return false;
+            started = true;
+            zs.next_out = buffer.data();
+            zs.avail_out = (uInt)buffer.size();
+            return (bool)*out;
+        }
+
+        bool row(const std::uint8_t* rgba)
+        {
+            std::size_t size = previous.size();
+            const std::uint8_t* up = previous.data();
+            std::uint64_t cost[5] = {filterRow<0>(rgba, up, size, filtered[0].data()),
+                                     filterRow<1>(rgba, up, size, filtered[1].data()),
+                                     filterRow<2>(rgba, up, size, filtered[2].data()),
+                                     filterRow<3>(rgba, up, size, filtered[3].data()),
+                                     filterRow<4>(rgba, up, size, filtered[4].data())};
+            std::size_t best = std::min_element(cost, cost + 5) - cost;
+
+            zs.next_in = filtered[best].data();
+            zs.avail_in = (uInt)filtered[best].size();
+            while (zs.avail_in > 0)
+            {
+                if (deflate(&zs, Z_NO_FLUSH) != Z_OK) return false;
+                drain(false);
+            }
+            std::memcpy(previous.data(), rgba, size);
+            return (bool)*out;
+        }
+
+        bool finish()
+        {
+            int status;
+            do
+            {
+                status = deflate(&zs, Z_FINISH);
+                if (status != Z_OK && status != Z_STREAM_END) return false;
+                drain(true);
+            } while (status != Z_STREAM_END);
+            chunk("IEND", nullptr, 0);
+            out->flush();
+            return !out->fail();
+        }
+
+    private:
+        void drain(bool all)
+        {
+            std::size_t used = buffer.size() - zs.avail_out;
+            if (used == 0 || (!all && zs.avail_out > 0)) return;
+            chunk("IDAT", buffer.data(), used);
+            zs.next_out = buffer.data();
+            zs.avail_out = (uInt)buffer.size();
+        }
+
+        void chunk(const char* type, const std::uint8_t* data, std::size_t size)
+        {
+            std::uint8_t word[4];
+            put32(word, (std::uint32_t)size);
+            out->write((const char*)word, 4);
+            out->write(type, 4);
+            if (size) out->write((const char*)data, (std::streamsize)size);
+            uLong crc = crc32(0, (const Bytef*)type, 4);
+            if (size) crc = crc32(crc, data, (uInt)size);
+            put32(word, (std::uint32_t)crc);
+            out->write((const char*)word, 4);
+        }
+
+        std::ostream* out;
+        z_stream zs;
+        bool started;
+        std::vector<std::uint8_t> previous;
+        std::vector<std::uint8_t> filtered[5];
+        std::vector<std::uint8_t> buffer;
+    };
+
+    // Adds the signed area a line covers in each cell of a coverage
+    // accumulation buffer, whose rows summed left to right then give the
+    // exact fraction of every pixel a closed outline covers. p0 is above
+    // p1, both lie inside the buffer, and dir is the winding sign.
+    void accumulate(float* cells, std::size_t stride, float width, sf::Vector2f p0, sf::Vector2f p1, float dir)
+    {
+        if (p0.y == p1.y) return;
+        float dxdy = (p1.x - p0.x) / (p1.y - p0.y);
+        float x = p0.x;
+        int end = (int)std::ceil(p1.y);
+        for (int y = (int)p0.y; y < end; ++y)
+        {
+            float* row = cells + (std::size_t)y * stride;
+            float dy = std::min((float)(y + 1), p1.y) - std::max((float)y, p0.y);
+            float xnext = std::min(std::max(x + dxdy * dy, 0.f), width);
+            float d = dy * dir;
+            float x0 = std::min(x, xnext), x1 = std::max(x, xnext);
+            float x0floor = std::floor(x0), x1ceil = std::ceil(x1);
+            int x0i = (int)x0floor, x1i = (int)x1ceil;
+            if (x1i <= x0i + 1)
+            {
+                // Inside a single column: split by the line's mean position.
+                float xmf = 0.5f * (x + xnext) - x0floor;
+                row[x0i] += d - d * xmf;
+                row[x0i + 1] += d * xmf;
+            }
+            else
+            {
+                float s = 1.f / (x1 - x0);
+                float x0f = x0 - x0floor;
+                float a0 = 0.5f * s * (1.f - x0f) * (1.f - x0f);
+                float x1f = x1 - x1ceil + 1.f;
+                float am = 0.5f * s * x1f * x1f;
+                row[x0i] += d * a0;
+                if (x1i == x0i + 2)
+                {
+                    row[x0i + 1] += d * (1.f - a0 - am);
+                }
+                else
+                {
+                    float a1 = s * (1.5f - x0f);
+                    row[x0i + 1] += d * (a1 - a0);
+                    for (int xi = x0i + 2; xi < x1i - 1; ++xi) row[xi] += d * s;
+                    float a2 = a1 + (x1i - x0i - 3) * s;
+                    row[x1i - 1] += d * (1.f - a2 - am);
+                }
+                row[x1i] += d * am;
+            }
+            x = xnext;
+        }
+    }
+
+    // Clips a line to a width x height buffer and accumulates it. Parts to
+    // the left or right become vertical lines on that border, which keeps
+    // the row sums exact, so shapes cut by tile edges still meet seamlessly.
+    void addLine(float* cells, std::size_t stride, float width, float height, sf::Vector2f p0, sf::Vector2f p1)
+    {
+        float dir = 1.f;
+        if (p0.y > p1.y)
+        {
+            std::swap(p0, p1);
+            dir = -1.f;
+        }
+        if (p0.y == p1.y || p1.y <= 0.f || p0.y >= height) return;
+        if (p0.y < 0.f)
+        {
+            p0.x += (p1.x - p0.x) * -p0.y / (p1.y - p0.y);
+            p0.y = 0.f;
+        }
+        if (p1.y > height)
+        {
+            p1.x = p0.x + (p1.x - p0.x) * (height - p0.y) / (p1.y - p0.y);
+            p1.y = height;
+        }
+
+        float cuts[4] = {0.f, 1.f, 1.f, 1.f};
+        int count = 1;
+        float dx = p1.x - p0.x;
+        for (float border : {0.f, width})
+        {
+            if (dx == 0.f) break;
+            float t = (border - p0.x) / dx;
+            if (t > 0.f && t < 1.f) cuts[count++] = t;
+        }
+        std::sort(cuts, cuts + count);
+        cuts[count] = 1.f;
+        for (int i = 0; i < count; ++i)
+        {
+            sf::Vector2f a = p0 + (p1 - p0) * cuts[i], b = p0 + (p1 - p0) * cuts[i + 1];
+            if (i + 1 == count) b = p1;
+            a.x = std::min(std::max(a.x, 0.f), width);
+            b.x = std::min(std::max(b.x, 0.f), width);
+            accumulate(cells, stride, width, a, b, dir);
+        }
+    }
+
+    // Composites a straight colour over a premultiplied pixel.
+    void blend(float* pixel, sf::Color color, float coverage)
+    {
+        float alpha = coverage * color.a * (1.f / 255.f);
+        float keep = 1.f - alpha;
+        pixel[0] = color.r * (1.f / 255.f) * alpha + pixel[0] * keep;
+        pixel[1] = color.g * (1.f / 255.f) * alpha + pixel[1] * keep;
+        pixel[2] = color.b * (1.f / 255.f) * alpha + pixel[2] * keep;
+        pixel[3] = alpha + pixel[3] * keep;
+    }
+
+    // Bilinear sample of an 8-bit channel, zero outside the image.
+    float bilinear(const std::uint8_t* data, int width, int height, std::size_t pitch, float u, float v)
+    {
+        float fu = std::floor(u), fv = std::floor(v);
+        int x = (int)fu, y = (int)fv;
+        float tx = u - fu, ty = v - fv;
+        auto at = [&](int px, int py) -> float {
+            if (px < 0 || py < 0 || px >= width || py >= height) return 0.f;
+            return data[(std::size_t)py * pitch + (std::size_t)px];
+        };
+        float top = at(x, y) + (at(x + 1, y) - at(x, y)) * tx;
+        float bottom = at(x, y + 1) + (at(x + 1, y + 1) - at(x, y + 1)) * tx;
+        return (top + (bottom - top) * ty) * (1.f / 255.f);
+    }
+
+    void appendUtf8(std::string& out, std::uint32_t c)
+    {
+        if (c < 0x80)
+        {
+            out += (char)c;
+        }
+        else if (c < 0x800)
+        {
+            out += (char)(0xc0 | (c >> 6));
+            out += (char)(0x80 | (c & 0x3f));
+        }
+        else if (c < 0x10000)
+        {
+            out += (char)(0xe0 | (c >> 12));
+            out += (char)(0x80 | ((c >> 6) & 0x3f));
+            out += (char)(0x80 | (c & 0x3f));
+        }
+        else
+        {
+            out += (char)(0xf0 | (c >> 18));
+            out += (char)(0x80 | ((c >> 12) & 0x3f));
+            out += (char)(0x80 | ((c >> 6) & 0x3f));
+            out += (char)(0x80 | (c & 0x3f));
+        }
+    }
+
+    void appendEscaped(std::string& out, std::uint32_t c)
+    {
+        switch (c)
+        {
+            case '&': out += "&amp;"; break;
+            case '<': out += "&lt;"; break;
+            case '>': out += "&gt;"; break;
+            case '"': out += "&quot;"; break;
+            default:
+                if (c >= 0x20 || c == '\t') appendUtf8(out, c);
+                break;
+        }
+    }
+
+    // Shortest fixed-point form, three decimals at most.
+    std::string number(float v)
+    {
+        char text[32];
+        std::snprintf(text, sizeof(text), "%.3f", v);
+        std::string s(text);
+        while (s.back() == '0') s.pop_back();
+        if (s.back() == '.') s.pop_back();
+        if (s == "-0") s = "0";
+        return s;
+    }
+
+    std::string paint(const char* attribute, sf::Color color)
+    {
+        char text[64];
+        std::snprintf(text, sizeof(text), " %s=\"#%02x%02x%02x\"", attribute, color.r, color.g, color.b);
+        std::string s(text);
+        if (color.a < 255) s += " " + std::string(attribute) + "-opacity=\"" + number(color.a / 255.f) + "\"";
+        return s;
+    }
+
+    void appendBase64(std::string& out, const std::string& data)
+    {
+        static const char digits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        for (std::size_t i = 0; i < data.size(); i += 3)
+        {
+            std::uint32_t v = (std::uint32_t)(std::uint8_t)data[i] << 16;
+            if (i + 1 < data.size()) v |= (std::uint32_t)(std::uint8_t)data[i + 1] << 8;
+            if (i + 2 < data.size()) v |= (std::uint8_t)data[i + 2];
+            out += digits[v >> 18];
+            out += digits[(v >> 12) & 63];
+            out += i + 1 < data.size() ? digits[(v >> 6) & 63] : '=';
+            out += i + 2 < data.size() ? digits[v & 63] : '=';
+        }
+    }
+
+    std::int32_t floorDiv(std::int64_t v, std::int64_t d)
+    {
+        return (std::int32_t)(v >= 0 ? v / d : -((-v + d - 1) / d));
+    }
+
+    // Glyph coverage straight from FreeType and the bundled font, which is
+    // the font sf::Font renders: sf::Font only hands glyphs out on pages
+    // that are GL textures, and there may be no display to make them on.
+    // Metrics follow sf::Font so text lines up with what is drawn on screen.
+    class GlyphRasterizer
+    {
+    public:
+        struct Glyph
+        {
+            // Bitmap placement relative to the pen, in pixels; coverage is
+            // width x height bytes at offset in the rasterizer's pixels.
+            int left, top, width, height;
+            float advance;
+            std::size_t offset;
+        };
+
+        GlyphRasterizer() : library(nullptr), face(nullptr), size(0)
+        {
+            std::size_t bytes = 0;
+            const unsigned char* data = Assets::fontData(bytes);
+            if (FT_Init_FreeType(&library) != 0)
+            {
+                library = nullptr;
+                return;
+            }
+            if (FT_New_Memory_Face(library, data, (FT_Long)bytes, 0, &face) != 0 ||
+                FT_Select_Charmap(face, FT_ENCODING_UNICODE) != 0)
+            {
+                if (face) FT_Done_Face(face);
+                face = nullptr;
+            }
+        }
+
+        ~GlyphRasterizer()
+        {
+            if (face) FT_Done_Face(face);
+            if (library) FT_Done_FreeType(library);
+        }
+
+        GlyphRasterizer(const GlyphRasterizer&) = delete;
+        GlyphRasterizer& operator=(const GlyphRasterizer&) = delete;
+
+        bool isOpen() const { return face != nullptr; }
+
+        void setSize(unsigned characterSize)
+        {
+            if (characterSize == size) return;
+            size = characterSize;
+            FT_Set_Pixel_Sizes(face, 0, size);
+        }
+
+        float lineSpacing() const { return face->size->metrics.height / 64.f; }
+
+        float kerning(std::uint32_t first, std::uint32_t second) const
+        {
+            if (!first || !second || !FT_HAS_KERNING(face)) return 0.f;
+            FT_Vector k;
+            if (FT_Get_Kerning(face, FT_Get_Char_Index(face, first), FT_Get_Char_Index(face, second),
+                               FT_KERNING_UNFITTED, &k) != 0)
+                return 0.f;
+            return FT_IS_SCALABLE(face) ? k.x / 64.f : (float)k.x;
+        }
+
+        // Rendered once per size and character.
+        const Glyph& glyph(std::uint32_t c)
+        {
+            auto found = glyphs.find(std::make_pair(size, c));
+            if (found != glyphs.end()) return found->second;
+            Glyph g{0, 0, 0, 0, 0.f, pixels.size()};
+            if (FT_Load_Char(face, c, FT_LOAD_TARGET_NORMAL | FT_LOAD_FORCE_AUTOHINT) == 0)
+            {
+                FT_GlyphSlot slot = face->glyph;
+                g.advance = slot->metrics.horiAdvance / 64.f;
+                if (FT_Render_Glyph(slot, FT_RENDER_MODE_NORMAL) == 0)
+                {
+                    const FT_Bitmap& bitmap = slot->bitmap;
+                    g.left = slot->bitmap_left;
+                    g.top = -slot->bitmap_top;
+                    g.width = (int)bitmap.width;
+                    g.height = (int)bitmap.rows;
+                    for (int y = 0; y < g.height; ++y)
+                    {
+                        const unsigned char* row = bitmap.buffer + (std::ptrdiff_t)y * bitmap.pitch;
+                        pixels.insert(pixels.end(), row, row + g.width);
+                    }
+                }
+            }
+            return glyphs.emplace(std::make_pair(size, c), g).first->second;
+        }
+
+        const std::vector<std::uint8_t>& coverage() const { return pixels; }
+
+    private:
+        FT_Library library;
+        FT_Face face;
+        unsigned size;
+        std::map<std::pair<unsigned, std::uint32_t>, Glyph> glyphs;
+        std::vector<std::uint8_t> pixels;
+    };
+}
+
+// Everything tiles share, prepared once on the calling thread: text is laid
+// out and its glyphs rasterized before any worker starts.
+class Exporter::TileRenderer
+{
+public:
+    TileRenderer(const Document& document, float scale, std::int64_t left, std::int64_t top,
+                 bool transparent = false)
+        : doc(document), scale(scale), originX(left), originY(top),
+          background(transparent ? sf::Color::Transparent : document.getBackground())
+    {
+        // A document without a font shows no text, and exports none.
+        if (!doc.font) return;
+        GlyphRasterizer rasterizer;
+        if (!rasterizer.isOpen()) return;
+        runs.resize(doc.texts.size());
+        for (std::uint32_t id = doc.base; id < doc.order.size(); ++id)
+        {
+            const ItemRef& item = doc.order[id];
+            if (item.kind != ItemKind::Text || !doc.index.contains(id)) continue;
+            const Document::TextItem& text = doc.texts[item.index];
+            long size = std::lround(text.size * scale);
+            unsigned characterSize = (unsigned)std::min<long>(std::max<long>(size, 1), maxGlyphSize);
+            Run& run = runs[item.index];
+            run.first = placed.size();
+            layOut(rasterizer, text, characterSize);
+            run.count = placed.size() - run.first;
+        }
+        coverage = rasterizer.coverage();
+    }
+
+    // Renders the w x h tile at image pixel (x, y) into out, RGBA rows of
+    // pitch bytes. Safe to call from several threads at once.
+    void render(std::int64_t x, std::int64_t y, std::uint32_t w, std::uint32_t h, std::uint8_t* out,
+                std::size_t pitch) const
+    {
+        thread_local Scratch s;
+        s.width = w;
+        s.height = h;
+        s.offsetX = (float)(originX + x);
+        s.offsetY = (float)(originY + y);
+        s.pixels.resize((std::size_t)w * h * 4);
+        float bg[4] = {background.r / 255.f, background.g / 255.f, background.b / 255.f, background.a / 255.f};
+        for (std::size_t i = 0; i < s.pixels.size(); i += 4)
+        {
+            s.pixels[i] = bg[0] * bg[3];
+            s.pixels[i + 1] = bg[1] * bg[3];
+            s.pixels[i + 2] = bg[2] * bg[3];
+            s.pixels[i + 3] = bg[3];
+        }
+        if (doc.base == 0 && !doc.raster.empty()) drawRaster(s);
+
+        // One pixel of margin catches anti-aliased edges of items just outside.
+        sf::FloatRect area((s.offsetX - 1.f) / scale, (s.offsetY - 1.f) / scale, (w + 2.f) / scale,
+                           (h + 2.f) / scale);
+        doc.index.queryRect(area, s.ids);
+        for (std::uint32_t id : s.ids)
+        {
+            const ItemRef& item = doc.order[id];
+            sf::Transform transform = doc.getTransform(id);
+            const sf::Transform* placement = doc.getPlacement(id) != Document::none ? &transform : nullptr;
+            if (item.kind == ItemKind::Text)
+            {
+                drawGlyphs(s, runs.empty() ? Run() : runs[item.index], placement);
+            }
+            else if (item.kind == ItemKind::Fill)
+            {
+                if (placement) drawPlacedFill(s, doc.fills[item.index], *placement);
+                else drawFill(s, doc.fills[item.index]);
+            }
+            else
+            {
+                s.vertices.clear();
+                doc.appendGeometry(id, scale, false, s.vertices, s.samples);
+                drawTriangles(s);
+            }
+        }
+
+        for (std::uint32_t row = 0; row < h; ++row)
+        {
+            const float* src = s.pixels.data() + (std::size_t)row * w * 4;
+            std::uint8_t* dst = out + row * pitch;
+            for (std::uint32_t i = 0; i < w; ++i, src += 4, dst += 4)
+            {
+                float alpha = src[3];
+                float unpremultiply = alpha > 0.f ? 255.f / alpha : 0.f;
+                for (int c = 0; c < 3; ++c)
+                    dst[c] = (std::uint8_t)std::min(255.f, src[c] * unpremultiply + 0.5f);
+                dst[3] = (std::uint8_t)std::min(255.f, alpha * 255.f + 0.5f);
+            }
+        }
+    }
+
+private:
+    struct Run
+    {
+        Run() : first(0), count(0) {}
+
+        std::size_t first;
+        std::size_t count;
+    };
+
+    // A glyph bitmap where a text item puts it, in document units, with one
+    // pixel of empty margin so smoothed edges are not clipped.
+    struct PlacedGlyph
+    {
+        float left, top, right, bottom;
+        int width, height;
+        std::size_t offset;
+        sf::Color color;
+    };
+
+    // The pen moves the way sf::Text moves it, with glyphs rendered at
+    // characterSize and scaled back to the item's size.
+    void layOut(GlyphRasterizer& rasterizer, const Document::TextItem& text, unsigned characterSize)
+    {
+        rasterizer.setSize(characterSize);
+        float ratio = (float)text.size / characterSize;
+        float whitespace = rasterizer.glyph(U' ').advance;
+        float lineSpacing = rasterizer.lineSpacing();
+        float x = 0.f, y = (float)characterSize;
+        std::uint32_t prev = 0;
+        for (std::uint32_t i = 0; i < text.length; ++i)
+        {
+            std::uint32_t c = doc.glyphArena[text.first + i];
+            x += rasterizer.kerning(prev, c);
+            prev = c;
+            if (c == U' ') { x += whitespace; continue; }
+            if (c == U'\t') { x += whitespace * 4; continue; }
+            if (c == U'\n') { x = 0.f; y += lineSpacing; continue; }
+            const GlyphRasterizer::Glyph& g = rasterizer.glyph(c);
+            if (g.width > 0 && g.height > 0)
+            {
+                placed.push_back(PlacedGlyph{text.position.x + (x + g.left - 1.f) * ratio,
+                                             text.position.y + (y + g.top - 1.f) * ratio,
+                                             text.position.x + (x + g.left + g.width + 1.f) * ratio,
+                                             text.position.y + (y + g.top + g.height + 1.f) * ratio,
+                                             g.width, g.height, g.offset, text.color});
+            }
+            x += g.advance;
+        }
+    }
+
+    struct Scratch
+    {
+        std::uint32_t width, height;
+        float offsetX, offsetY;
+        std::vector<float> pixels;
+        std::vector<float> cells;
+        std::vector<std::uint32_t> ids;
+        std::vector<sf::Vertex> vertices;
+        std::vector<Stroke::Sample> samples;
+        std::vector<sf::Vector2f> points;
+        // Raster tiles decoded for this tile, with their texel origin.
+        std::vector<std::pair<sf::Vector2<std::int64_t>, std::vector<std::uint8_t>>> raster;
+    };
+
+    // Pixel range [x0, x1) x [y0, y1) of a document rectangle inside the tile.
+    bool clip(const Scratch& s, float left, float top, float right, float bottom, int& x0, int& y0, int& x1,
+              int& y1) const
+    {
+        x0 = (int)std::max(0.f, std::floor(left * scale - s.offsetX));
+        y0 = (int)std::max(0.f, std::floor(top * scale - s.offsetY));
+        x1 = (int)std::min((float)s.width, std::ceil(right * scale - s.offsetX));
+        y1 = (int)std::min((float)s.height, std::ceil(bottom * scale - s.offsetY));
+        return x0 < x1 && y0 < y1;
+    }
+
+    // Triangles of one colour are accumulated together and composited
+    // once, so the seams between them and any overlaps inside a stroke
+    // do not show.
+    void drawTriangles(Scratch& s) const
+    {
+        const auto& v = s.vertices;
+        for (std::size_t start = 0; start + 3 <= v.size();)
+        {
+            sf::Color color = v[start].color;
+            std::size_t end = start + 3;
+            while (end + 3 <= v.size() && v[end].color == color) end += 3;
+            cover(s, start, end, color);
+            start = end;
+        }
+    }
+
+    void cover(Scratch& s, std::size_t start, std::size_t end, sf::Color color) const
+    {
+        s.points.resize(end - start);
+        float left = 0.f, top = 0.f, right = 0.f, bottom = 0.f;
+        for (std::size_t i = start; i < end; ++i)
+        {
+            sf::Vector2f p(s.vertices[i].position.x * scale - s.offsetX, s.vertices[i].position.y * scale - s.offsetY);
+            s.points[i - start] = p;
+            if (i == start) { left = right = p.x; top = bottom = p.y; }
+            left = std::min(left, p.x);
+            right = std::max(right, p.x);
+            top = std::min(top, p.y);
+            bottom = std::max(bottom, p.y);
+        }
+        int x0 = (int)std::max(0.f, std::floor(left)), y0 = (int)std::max(0.f, std::floor(top));
+        int x1 = (int)std::min((float)s.width, std::ceil(right)), y1 = (int)std::min((float)s.height, std::ceil(bottom));
+        if (x0 >= x1 || y0 >= y1) return;
+
+        int w = x1 - x0, h = y1 - y0;
+        std::size_t stride = (std::size_t)w + 2;
+        s.cells.assign(stride * h, 0.f);
+        sf::Vector2f shift((float)x0, (float)y0);
+        for (std::size_t i = 0; i + 3 <= s.points.size(); i += 3)
+        {
+            sf::Vector2f a = s.points[i] - shift, b = s.points[i + 1] - shift, c = s.points[i + 2] - shift;
+            // Wind every triangle the same way so overlaps add up instead of cancelling.
+            float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+            if (area == 0.f) continue;
+            if (area < 0.f) std::swap(b, c);
+            addLine(s.cells.data(), stride, (float)w, (float)h, a, b);
+            addLine(s.cells.data(), stride, (float)w, (float)h, b, c);
+            addLine(s.cells.data(), stride, (float)w, (float)h, c, a);
+        }
+
+        for (int row = 0; row < h; ++row)
+        {
+            const float* cells = s.cells.data() + row * stride;
+            float* pixel = s.pixels.data() + ((std::size_t)(y0 + row) * s.width + x0) * 4;
+            float sum = 0.f;
+            for (int i = 0; i < w; ++i, pixel += 4)
+            {
+                sum += cells[i];
+                float coverage = std::min(1.f, std::fabs(sum));
+                if (coverage > 1.f / 512.f) blend(pixel, color, coverage);
+            }
+        }
+    }
+
+    // Mask texels are squares pixelSize wide; each pixel takes the share of
+    // its footprint they cover, so fills stay crisp at any scale.
+    void drawFill(Scratch& s, const Document::FillItem& f) const
+    {
+        const sf::IntRect& b = f.bounds;
+        float left = f.origin.x + b.left * f.pixelSize, top = f.origin.y + b.top * f.pixelSize;
+        int x0, y0, x1, y1;
+        if (!clip(s, left, top, left + b.width * f.pixelSize, top + b.height * f.pixelSize, x0, y0, x1, y1)) return;
+
+        const std::uint8_t* mask = doc.maskArena.data() + f.mask;
+        float step = 1.f / (scale * f.pixelSize);
+        for (int y = y0; y < y1; ++y)
+        {
+            float v0 = ((s.offsetY + y) / scale - top) / f.pixelSize, v1 = v0 + step;
+            int j0 = std::max(0, (int)std::floor(v0)), j1 = std::min(b.height, (int)std::ceil(v1));
+            float* pixel = s.pixels.data() + ((std::size_t)y * s.width + x0) * 4;
+            for (int x = x0; x < x1; ++x, pixel += 4)
+            {
+                float u0 = ((s.offsetX + x) / scale - left) / f.pixelSize, u1 = u0 + step;
+                int i0 = std::max(0, (int)std::floor(u0)), i1 = std::min(b.width, (int)std::ceil(u1));
+                float covered = 0.f;
+                for (int j = j0; j < j1; ++j)
+                {
+                    float wy = std::min(v1, j + 1.f) - std::max(v0, (float)j);
+                    const std::uint8_t* texel = mask + (std::size_t)j * b.width;
+                    for (int i = i0; i < i1; ++i)
+                    {
+                        if (texel[i]) covered += wy * (std::min(u1, i + 1.f) - std::max(u0, (float)i));
+                    }
+                }
+                float coverage = covered / (step * step);
+                if (coverage > 1.f / 512.f) blend(pixel, f.color, std::min(1.f, coverage));
+            }
+        }
+    }
+
+    // A placed fill is sampled four by four per pixel through the inverse
+    // of its transform.
+    void drawPlacedFill(Scratch& s, const Document::FillItem& f, const sf::Transform& placement) const
+    {
+        const sf::IntRect& b = f.bounds;
+        float left = f.origin.x + b.left * f.pixelSize, top = f.origin.y + b.top * f.pixelSize;
+        sf::FloatRect area = placement.transformRect(sf::FloatRect(left, top, b.width * f.pixelSize,
+                                                                   b.height * f.pixelSize));
+        int x0, y0, x1, y1;
+        if (!clip(s, area.left, area.top, area.left + area.width, area.top + area.height, x0, y0, x1, y1)) return;
+
+        const std::uint8_t* mask = doc.maskArena.data() + f.mask;
+        sf::Transform inverse = placement.getInverse();
+        for (int y = y0; y < y1; ++y)
+        {
+            float* pixel = s.pixels.data() + ((std::size_t)y * s.width + x0) * 4;
+            for (int x = x0; x < x1; ++x, pixel += 4)
+            {
+                int covered = 0;
+                for (int j = 0; j < 4; ++j)
+                {
+                    for (int i = 0; i < 4; ++i)
+                    {
+                        sf::Vector2f p = inverse.transformPoint((s.offsetX + x + (i + 0.5f) / 4.f) / scale,
+                                                                (s.offsetY + y + (j + 0.5f) / 4.f) / scale);
+                        float u = std::floor((p.x - left) / f.pixelSize), v = std::floor((p.y - top) / f.pixelSize);
+                        if (u >= 0.f && v >= 0.f && u < b.width && v < b.height &&
+                            mask[(std::size_t)v * b.width + (std::size_t)u])
+                            ++covered;
+                    }
+                }
+                if (covered) blend(pixel, f.color, covered / 16.f);
+            }
+        }
+    }
+
+    // Flattened items come first, bilinearly sampled from the pyramid
+    // level nearest the output scale. At the layer's own resolution on its
+    // pixel grid, which is how the compactor renders, every sample lands on
+    // a texel centre and tiles are copied exactly.
+    void drawRaster(Scratch& s) const
+    {
+        const RasterLayer& layer = doc.raster;
+        int level = layer.levelFor(scale);
+        float step = std::ldexp(layer.getPixelsPerUnit(), -level) / scale;
+        const std::int64_t size = RasterLayer::tileSize;
+
+        std::int64_t u0 = (std::int64_t)std::floor((s.offsetX + 0.5f) * step - 0.5f);
+        std::int64_t v0 = (std::int64_t)std::floor((s.offsetY + 0.5f) * step - 0.5f);
+        std::int64_t u1 = (std::int64_t)std::floor((s.offsetX + s.width - 0.5f) * step - 0.5f) + 1;
+        std::int64_t v1 = (std::int64_t)std::floor((s.offsetY + s.height - 0.5f) * step - 0.5f) + 1;
+        s.raster.clear();
+        for (std::int32_t ty = floorDiv(v0, size); ty <= floorDiv(v1, size); ++ty)
+        {
+            for (std::int32_t tx = floorDiv(u0, size); tx <= floorDiv(u1, size); ++tx)
+            {
+                RasterLayer::Data data = layer.find(level, tx, ty);
+                if (!data) continue;
+                s.raster.emplace_back(sf::Vector2<std::int64_t>(tx * size, ty * size),
+                                      std::vector<std::uint8_t>((std::size_t)(size * size * 4)));
+                if (!RasterLayer::decode(data->data(), data->size(), s.raster.back().second.data()))
+                    s.raster.pop_back();
+            }
+        }
+        if (s.raster.empty()) return;
+
+        std::size_t last = 0;
+        auto texel = [&](std::int64_t u, std::int64_t v, float weight, float* sum) {
+            for (std::size_t k = 0; k < s.raster.size(); ++k)
+            {
+                std::size_t i = (last + k) % s.raster.size();
+                const auto& tile = s.raster[i];
+                std::int64_t x = u - tile.first.x, y = v - tile.first.y;
+                if (x < 0 || y < 0 || x >= size || y >= size) continue;
+                last = i;
+                const std::uint8_t* p = tile.second.data() + (std::size_t)(y * size + x) * 4;
+                float alpha = p[3] * (1.f / 255.f) * weight;
+                for (int c = 0; c < 3; ++c) sum[c] += p[c] * (1.f / 255.f) * alpha;
+                sum[3] += alpha;
+                return;
+            }
+        };
+        for (std::uint32_t y = 0; y < s.height; ++y)
+        {
+            float v = (s.offsetY + y + 0.5f) * step - 0.5f, fv = std::floor(v), ty = v - fv;
+            float* pixel = s.pixels.data() + (std::size_t)y * s.width * 4;
+            for (std::uint32_t x = 0; x < s.width; ++x, pixel += 4)
+            {
+                float u = (s.offsetX + x + 0.5f) * step - 0.5f, fu = std::floor(u), tx = u - fu;
+                std::int64_t iu = (std::int64_t)fu, iv = (std::int64_t)fv;
+                float sum[4] = {0.f, 0.f, 0.f, 0.f};
+                texel(iu, iv, (1.f - tx) * (1.f - ty), sum);
+                if (tx > 0.f) texel(iu + 1, iv, tx * (1.f - ty), sum);
+                if (ty > 0.f) texel(iu, iv + 1, (1.f - tx) * ty, sum);
+                if (tx > 0.f && ty > 0.f) texel(iu + 1, iv + 1, tx * ty, sum);
+                if (sum[3] <= 0.f) continue;
+                float keep = 1.f - sum[3];
+                for (int c = 0; c < 4; ++c) pixel[c] = sum[c] + pixel[c] * keep;
+            }
+        }
+    }
+
+    // Placed glyphs are sampled through the inverse of the transform.
+    void drawGlyphs(Scratch& s, const Run& run, const sf::Transform* placement) const
+    {
+        sf::Transform inverse = placement ? placement->getInverse() : sf::Transform();
+        for (std::size_t g = run.first; g < run.first + run.count; ++g)
+        {
+            const PlacedGlyph& glyph = placed[g];
+            const std::uint8_t* alpha = coverage.data() + glyph.offset;
+            float left = glyph.left, top = glyph.top, right = glyph.right, bottom = glyph.bottom;
+            sf::FloatRect area(left, top, right - left, bottom - top);
+            if (placement) area = placement->transformRect(area);
+            int x0, y0, x1, y1;
+            if (!clip(s, area.left, area.top, area.left + area.width, area.top + area.height, x0, y0, x1, y1))
+                continue;
+
+            // Bitmap pixels run from -1 to width + 1 across the margin.
+            float du = (glyph.width + 2.f) / ((right - left) * scale);
+            float dv = (glyph.height + 2.f) / ((bottom - top) * scale);
+            for (int y = y0; y < y1; ++y)
+            {
+                float v = -1.f + ((s.offsetY + y + 0.5f) - top * scale) * dv - 0.5f;
+                float* pixel = s.pixels.data() + ((std::size_t)y * s.width + x0) * 4;
+                for (int x = x0; x < x1; ++x, pixel += 4)
+                {
+                    float u = -1.f + ((s.offsetX + x + 0.5f) - left * scale) * du - 0.5f;
+                    if (placement)
+                    {
+                        sf::Vector2f p = inverse.transformPoint((s.offsetX + x + 0.5f) / scale,
+                                                                (s.offsetY + y + 0.5f) / scale);
+                        if (p.x < left || p.x > right || p.y < top || p.y > bottom) continue;
+                        u = -1.f + (p.x - left) * scale * du - 0.5f;
+                        v = -1.f + (p.y - top) * scale * dv - 0.5f;
+                    }
+                    float c = bilinear(alpha, glyph.width, glyph.height, (std::size_t)glyph.width, u, v);
+                    if (c > 1.f / 512.f) blend(pixel, glyph.color, c);
+                }
+            }
+        }
+    }
+
+    const Document& doc;
+    float scale;
+    std::int64_t originX, originY;
+    sf::Color background;
+    std::vector<Run> runs;
+    std::vector<PlacedGlyph> placed;
+    std::vector<std::uint8_t> coverage;
+};
+
+Exporter::Options::Options()
+    : scale(1.f), tileSize(256), threads(0)
+{
+}
+
+Exporter::Raster::Raster(const Document& document, float scale)
+    : renderer(std::make_unique<TileRenderer>(document, scale, 0, 0, true))
+{
+}
+
+Exporter::Raster::~Raster() = default;
+
+void Exporter::Raster::render(std::int64_t x, std::int64_t y, std::uint32_t w, std::uint32_t h, std::uint8_t* out,
+                              std::size_t pitch) const
+{
+    renderer->render(x, y, w, h, out, pitch);
+}
+
+sf::FloatRect Exporter::contentBounds(const Document& doc)
+{
+    float left = 0.f, top = 0.f, right = 0.f, bottom = 0.f;
+    bool any = false;
+    auto include = [&](const sf::FloatRect& b) {
+        if (!any)
+        {
+            left = b.left;
+            top = b.top;
+            right = b.left + b.width;
+            bottom = b.top + b.height;
+            any = true;
+        }
+        left = std::min(left, b.left);
+        top = std::min(top, b.top);
+        right = std::max(right, b.left + b.width);
+        bottom = std::max(bottom, b.top + b.height);
+    };
+    if (doc.base == 0 && !doc.raster.empty()) include(doc.raster.getBounds());
+    for (std::uint32_t id = doc.base; id < doc.order.size(); ++id)
+    {
+        if (doc.index.contains(id)) include(doc.itemBounds[id]);
+    }
+    return sf::FloatRect(left, top, right - left, bottom - top);
+}
+
+bool Exporter::writePng(const Document& document, const std::string& path, const Options& options,
+                        std::string& error)
+{
+    sf::FloatRect bounds = contentBounds(document);
+    if (bounds.width <= 0.f || bounds.height <= 0.f)
+    {
+        error = "nothing to export";
+        return false;
+    }
+    if (!(options.scale > 0.f))
+    {
+        error = "scale must be positive";
+        return false;
+    }
+
+    double scale = options.scale;
+    std::int64_t left = (std::int64_t)std::floor(bounds.left * scale) - 1;
+    std::int64_t top = (std::int64_t)std::floor(bounds.top * scale) - 1;
+    std::int64_t right = (std::int64_t)std::ceil((bounds.left + bounds.width) * scale) + 1;
+    std::int64_t bottom = (std::int64_t)std::ceil((bounds.top + bounds.height) * scale) + 1;
+    if (right - left > maxImageSide || bottom - top > maxImageSide)
+    {
+        error = "image would be larger than " + std::to_string(maxImageSide) + " pixels across";
+        return false;
+    }
+    std::uint32_t width = (std::uint32_t)(right - left), height = (std::uint32_t)(bottom - top);
+
+    // Bands get shorter for very wide images so the ones in flight stay
+    // within budget.
+    std::uint32_t tile = std::max(16u, options.tileSize);
+    std::uint32_t bandHeight = (std::uint32_t)std::min<std::size_t>(
+        tile, std::max<std::size_t>(1, bandBudget / bandsInFlight / ((std::size_t)width * 4)));
+
+    TileRenderer renderer(document, options.scale, left, top);
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    PngStream png;
+    if (!png.open(file, width, height))
+    {
+        error = "could not write " + path;
+        return false;
+    }
+
+    struct Band
+    {
+        std::vector<std::uint8_t> pixels;
+        std::uint32_t remaining;
+    };
+    std::vector<Band> bands(bandsInFlight);
+    std::mutex mutex;
+    std::condition_variable done;
+    std::uint32_t bandCount = (height + bandHeight - 1) / bandHeight;
+    std::uint32_t columns = (width + tile - 1) / tile;
+    std::size_t pitch = (std::size_t)width * 4;
+
+    WorkerPool pool(options.threads);
+    auto submit = [&](std::uint32_t index) {
+        Band& band = bands[index % bandsInFlight];
+        std::uint32_t y = index * bandHeight, h = std::min(bandHeight, height - y);
+        band.pixels.resize(pitch * h);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            band.remaining = columns;
+        }
+        for (std::uint32_t c = 0; c < columns; ++c)
+        {
+            std::uint32_t x = c * tile, w = std::min(tile, width - x);
+            pool.submit([&, &band = band, x, y, w, h] {
+                renderer.render(x, y, w, h, band.pixels.data() + (std::size_t)x * 4, pitch);
+                std::lock_guard<std::mutex> lock(mutex);
+                if (--band.remaining == 0) done.notify_all();
+            });
+        }
+    };
+
+    for (std::uint32_t b = 0; b < std::min<std::uint32_t>(bandsInFlight, bandCount); ++b) submit(b);
+    bool ok = true;
+    for (std::uint32_t b = 0; b < bandCount; ++b)
+    {
+        Band& band = bands[b % bandsInFlight];
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            done.wait(lock, [&] { return band.remaining == 0; });
+        }
+        std::uint32_t rows = std::min(bandHeight, height - b * bandHeight);
+        for (std::uint32_t r = 0; ok && r < rows; ++r) ok = png.row(band.pixels.data() + r * pitch);
+        if (b + bandsInFlight < bandCount) submit(b + (std::uint32_t)bandsInFlight);
+    }
+    pool.wait();
+
+    if (!ok || !png.finish() || (file.close(), file.fail()))
+    {
+        error = "could not write " + path;
+        return false;
+    }
+    return true;
+}
+
+bool Exporter::writeSvg(const Document& doc, const std::string& path, const Options& options,
+                        std::string& error)
+{
+    sf::FloatRect bounds = contentBounds(doc);
+    if (bounds.width <= 0.f || bounds.height <= 0.f)
+    {
+        error = "nothing to export";
+        return false;
+    }
+
+    std::string svg;
+    svg += "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n";
+    svg += "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"" + number(bounds.width * options.scale) +
+           "\" height=\"" + number(bounds.height * options.scale) + "\" viewBox=\"" + number(bounds.left) + " " +
+           number(bounds.top) + " " + number(bounds.width) + " " + number(bounds.height) + "\">\n";
+    if (doc.background.a)
+    {
+        svg += "<rect x=\"" + number(bounds.left) + "\" y=\"" + number(bounds.top) + "\" width=\"" +
+               number(bounds.width) + "\" height=\"" + number(bounds.height) + "\"" +
+               paint("fill", doc.background) + "/>\n";
+    }
+
+    GlyphRasterizer rasterizer;
+
+    // Flattened items go underneath as embedded PNG tiles.
+    std::vector<std::uint8_t> pixels;
+    if (doc.base == 0)
+    {
+        doc.raster.forEach([&](int level, std::int32_t x, std::int32_t y, const RasterLayer::Data& data) {
+            if (level != 0) return;
+            const std::uint32_t size = RasterLayer::tileSize;
+            pixels.resize((std::size_t)size * size * 4);
+            if (!RasterLayer::decode(data->data(), data->size(), pixels.data())) return;
+            std::ostringstream encoded;
+            PngStream png;
+            if (!png.open(encoded, size, size)) return;
+            for (std::uint32_t row = 0; row < size; ++row) png.row(pixels.data() + (std::size_t)row * size * 4);
+            if (!png.finish()) return;
+            sf::FloatRect area = doc.raster.tileArea(0, x, y);
+            svg += "<image x=\"" + number(area.left) + "\" y=\"" + number(area.top) + "\" width=\"" +
+                   number(area.width) + "\" height=\"" + number(area.height) + "\" href=\"data:image/png;base64,";
+            appendBase64(svg, encoded.str());
+            svg += "\"/>\n";
+        });
+    }
+
+    std::vector<Stroke::Sample> samples;
+    std::vector<std::uint32_t> ends;
+    std::vector<sf::Vector2f> outline;
+    for (std::uint32_t id = doc.base; id < doc.order.size(); ++id)
+    {
+        if (!doc.index.contains(id)) continue;
+        const ItemRef& item = doc.order[id];
+        // Strokes come out placed already; everything else is wrapped in its
+        // transform.
+        bool placed = doc.getPlacement(id) != Document::none && item.kind != ItemKind::Stroke;
+        if (placed)
+        {
+            sf::Transform transform = doc.getTransform(id);
+            const float* m = transform.getMatrix();
+            char matrix[160];
+            std::snprintf(matrix, sizeof(matrix), "<g transform=\"matrix(%g %g %g %g %g %g)\">\n", m[0], m[1], m[4],
+                          m[5], m[12], m[13]);
+            svg += matrix;
+        }
+        switch (item.kind)
+        {
+            case ItemKind::Rectangle:
+            {
+                const Document::RectangleItem& r = doc.rectangles[item.index];
+                svg += "<rect x=\"" + number(std::min(r.position.x, r.position.x + r.size.x)) + "\" y=\"" +
+                       number(std::min(r.position.y, r.position.y + r.size.y)) + "\" width=\"" +
+                       number(std::fabs(r.size.x)) + "\" height=\"" + number(std::fabs(r.size.y)) + "\"" +
+                       paint("fill", r.color) + "/>\n";
+                break;
+            }
+            case ItemKind::Circle:
+            {
+                const Document::CircleItem& c = doc.circles[item.index];
+                svg += "<circle cx=\"" + number(c.center.x) + "\" cy=\"" + number(c.center.y) + "\" r=\"" +
+                       number(c.radius) + "\"" + paint("fill", c.color) + "/>\n";
+                break;
+            }
+            case ItemKind::Triangle:
+            {
+                const Document::TriangleItem& t = doc.triangles[item.index];
+                svg += "<polygon points=\"";
+                for (int i = 0; i < 3; ++i)
+                    svg += (i ? " " : "") + number(t.points[i].x) + "," + number(t.points[i].y);
+                svg += "\"" + paint("fill", t.color) + "/>\n";
+                break;
+            }
+            case ItemKind::Text:
+            {
+                const Document::TextItem& t = doc.texts[item.index];
+                // sf::Font changes its size to answer, which the editor's
+                // thread may be doing at the same time.
+                float lineSpacing = t.size * 1.2f;
+                if (doc.font && rasterizer.isOpen())
+                {
+                    rasterizer.setSize(t.size);
+                    lineSpacing = rasterizer.lineSpacing();
+                }
+                svg += "<text x=\"" + number(t.position.x) + "\" y=\"" + number(t.position.y + t.size) +
+                       "\" font-size=\"" + number((float)t.size) + "\"";
+                if (doc.font)
+                {
+                    svg += " font-family=\"";
+                    for (char c : doc.font->getInfo().family) appendEscaped(svg, (unsigned char)c);
+                    svg += "\"";
+                }
+                svg += paint("fill", t.color) + " xml:space=\"preserve\"><tspan x=\"" + number(t.position.x) + "\">";
+                for (std::uint32_t i = 0; i < t.length; ++i)
+                {
+                    std::uint32_t c = doc.glyphArena[t.first + i];
+                    if (c == '\n')
+                        svg += "</tspan><tspan x=\"" + number(t.position.x) + "\" dy=\"" + number(lineSpacing) + "\">";
+                    else
+                        appendEscaped(svg, c);
+                }
+                svg += "</tspan></text>\n";
+                break;
+            }
+            case ItemKind::Stroke:
+            {
+                // The outline the renderer tessellates, one polygon per run of
+                // samples sharing a colour in each piece the eraser left. Runs
+                // overlap where their round ends meet.
+                doc.strokePieces(id, samples, ends);
+                std::size_t first = 0;
+                for (std::uint32_t last : ends)
+                {
+                    if (last == first) continue;
+                    // A piece of a single sample is a dot.
+                    std::size_t start = first;
+                    do
+                    {
+                        std::size_t end = std::min<std::size_t>(start + 1, last - 1);
+                        while (end + 1 < last && samples[end].color == samples[start].color) ++end;
+                        outline.clear();
+                        Stroke::appendOutline(samples.data() + start, end - start + 1, 1.f, outline);
+                        svg += "<path d=\"M";
+                        for (const sf::Vector2f& p : outline) svg += " " + number(p.x) + "," + number(p.y);
+                        svg += " Z\"" + paint("fill", samples[start].color) + "/>\n";
+                        start = end;
+                    } while (start + 1 < last);
+                    first = last;
+                }
+                break;
+            }
+            case ItemKind::Fill:
+            {
+                // One rectangle per horizontal run of mask pixels.
+                const Document::FillItem& f = doc.fills[item.index];
+                const sf::IntRect& b = f.bounds;
+                const std::uint8_t* mask = doc.maskArena.data() + f.mask;
+                svg += "<path shape-rendering=\"crispEdges\" d=\"";
+                for (int y = 0; y < b.height; ++y)
+                {
+                    const std::uint8_t* row = mask + (std::size_t)y * b.width;
+                    for (int x = 0; x < b.width;)
+                    {
+                        if (!row[x])
+                        {
+                            ++x;
+                            continue;
+                        }
+                        int run = x;
+                        while (run < b.width && row[run]) ++run;
+                        svg += "M" + number(f.origin.x + (b.left + x) * f.pixelSize) + "," +
+                               number(f.origin.y + (b.top + y) * f.pixelSize) + "h" +
+                               number((run - x) * f.pixelSize) + "v" + number(f.pixelSize) + "h" +
+                               number(-(run - x) * f.pixelSize) + "z";
+                        x = run;
+                    }
+                }
+                svg += "\"" + paint("fill", f.color) + "/>\n";
+                break;
+            }
+        }
+        if (placed) svg += "</g>\n";
+    }
+    svg += "</svg>\n";
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(svg.data(), (std::streamsize)svg.size());
+    out.close();
+    if (out.fail())
+    {
+        error = "could not write " + path;
+        return false;
+    }
+    return true;
+}
+
+bool Exporter::write(const Document& document, const std::string& path, const Options& options,
+                     std::string& error)
+{
+    bool svg = path.size() >= 4 && path.compare(path.size() - 4, 4, ".svg") == 0;
+    return svg ? writeSvg(document, path, options, error) : writePng(document, path, options, error);
+}
+
+struct Exporter::Task::Job
+{
+    Document items;
+    std::string path;
+    Options options;
+    bool ok;
+    std::string error;
+};
+
+Exporter::Task::Task()
+    : done(false)
+{
+}
+
+Exporter::Task::~Task()
+{
+    if (worker.joinable()) worker.join();
+}
+
+bool Exporter::Task::start(const Document& document, const std::string& path, const Options& options)
+{
+    if (job) return false;
+    job = std::make_unique<Job>();
+    document.copyItems((std::uint32_t)document.size(), job->items);
+    job->items.setBackground(document.getBackground());
+    job->path = path;
+    job->options = options;
+    job->ok = false;
+
+    done = false;
+    Job& j = *job;
+    worker = std::thread([this, &j] {
+        j.ok = write(j.items, j.path, j.options, j.error);
+        done = true;
+    });
+    return true;
+}
+
+bool Exporter::Task::isRunning() const
+{
+    return job != nullptr;
+}
+
+bool Exporter::Task::isDone() const
+{
+    return job && done;
+}
+
+bool Exporter::Task::poll(std::string& path, std::string& error, bool wait)
+{
+    if (!job || (!done && !wait)) return false;
+    if (worker.joinable()) worker.join();
+    path = job->path;
+    error = job->error;
+    bool ok = job->ok;
+    job.reset();
+    if (!ok && error.empty()) error = "could not write " + path;
+    return true;
+}
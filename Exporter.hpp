@@ -0,0 +1,106 @@
+#ifndef EXPORTER_HPP
+#define EXPORTER_HPP
+
+#include <SFML/Graphics/Rect.hpp>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+
+class Document;
+
+// Writes a document out as an image at any resolution, without the GPU.
+//
+// PNG export rasterizes on the CPU: the image is cut into tiles that a
+// WorkerPool renders in parallel with exact-area anti-aliasing, and whole
+// bands of tiles are filtered and deflated in order as soon as they are
+// done, so only a few bands are ever held in memory however large the
+// image. Glyphs are rendered by FreeType from the bundled font, so text
+// needs no GL context either and exports on machines without a display.
+//
+// SVG export writes the items themselves as vector shapes, one element
+// per item. Flattened items have no shapes left and are embedded as the
+// PNG tiles of the document's raster layer.
+class Exporter
+{
+    class TileRenderer;
+
+public:
+    struct Options
+    {
+        Options();
+
+        // Output pixels per document unit.
+        float scale;
+        unsigned tileSize;
+        // Zero uses one per hardware thread.
+        unsigned threads;
+    };
+
+    // The same CPU rasterizer, for background work that must not touch the
+    // GPU: it renders the document over a transparent background, pixel
+    // (x, y) lying at document point (x, y) / scale. Construct it on the
+    // thread that owns the document; render() may then run on any thread
+    // for as long as the document is left alone.
+    class Raster
+    {
+    public:
+        Raster(const Document& document, float scale);
+        ~Raster();
+
+        // w x h pixels into out, straight RGBA rows of pitch bytes.
+        void render(std::int64_t x, std::int64_t y, std::uint32_t w, std::uint32_t h, std::uint8_t* out,
+                    std::size_t pitch) const;
+
+    private:
+        std::unique_ptr<TileRenderer> renderer;
+    };
+
+    // Writes a document on a background thread, so an editor keeps drawing
+    // frames while a large image is written. start() copies the visible
+    // items on the calling thread and the document may change meanwhile;
+    // the copy shares its font, which the writer leaves to FreeType.
+    class Task
+    {
+    public:
+        Task();
+        // Waits for a write in progress rather than leave half a file.
+        ~Task();
+
+        Task(const Task&) = delete;
+        Task& operator=(const Task&) = delete;
+
+        // Starts writing the document to path. False while a write is running.
+        bool start(const Document& document, const std::string& path, const Options& options);
+        bool isRunning() const;
+        // True once the write has finished and poll() would report it.
+        bool isDone() const;
+
+        // Once the write has finished, or after waiting for it if wait is
+        // set, gives the path written and an error that is empty on
+        // success, and goes idle. False while running or idle.
+        bool poll(std::string& path, std::string& error, bool wait = false);
+
+    private:
+        struct Job;
+
+        std::unique_ptr<Job> job;
+        std::thread worker;
+        std::atomic<bool> done;
+    };
+
+    // Union of the visible items' bounds, empty for an empty document.
+    static sf::FloatRect contentBounds(const Document& document);
+
+    static bool writePng(const Document& document, const std::string& path, const Options& options,
+                         std::string& error);
+    static bool writeSvg(const Document& document, const std::string& path, const Options& options,
+                         std::string& error);
+
+    // SVG when path ends in .svg, PNG otherwise.
+    static bool write(const Document& document, const std::string& path, const Options& options,
+                      std::string& error);
+};
+
+#endif
@@ -0,0 +1,138 @@
+#include "FloodFill.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    struct Span
+    {
+        int x1, x2, y, dy;
+    };
+
+    inline std::uint32_t load(const sf::Uint8* p)
+    {
+        std::uint32_t v;
+        std::memcpy(&v, p, sizeof v);
+        return v;
+    }
+
+    // Per-channel window around the seed colour, packed so a match test is
+    // four byte compares against constants with no abs() or shifting loop.
+    struct Window
+    {
+        std::uint8_t lo[4], hi[4];
+
+        Window(const sf::Uint8* seed, int tolerance)
+        {
+            for (int c = 0; c < 4; ++c)
+            {
+                lo[c] = (std::uint8_t)std::max(0, seed[c] - tolerance);
+                hi[c] = (std::uint8_t)std::min(255, seed[c] + tolerance);
+            }
+        }
+
+        bool operator()(const sf::Uint8* p) const
+        {
+            return p[0] >= lo[0] && p[0] <= hi[0] && p[1] >= lo[1] && p[1] <= hi[1] &&
+                   p[2] >= lo[2] && p[2] <= hi[2] && p[3] >= lo[3] && p[3] <= hi[3];
+        }
+    };
+
+    struct Exact
+    {
+        std::uint32_t seed;
+
+        bool operator()(const sf::Uint8* p) const
+        {
+            return load(p) == seed;
+        }
+    };
+
+    template <typename Match>
+    void scan(const sf::Uint8* pixels, int w, int h, int x, int y, Match match,
+              std::vector<std::uint8_t>& visited, sf::IntRect& bounds)
+    {
+        int minX = x, maxX = x, minY = y, maxY = y;
+
+        // Rows are resolved once per pop, so the hot loops below only walk a
+        // single row pointer and a single visited pointer.
+        const sf::Uint8* row = nullptr;
+        std::uint8_t* seen = nullptr;
+        auto inside = [&](int px) {
+            return px >= 0 && px < w && !seen[px] && match(row + (std::size_t)px * 4);
+        };
+
+        std::vector<Span> stack;
+        stack.push_back({x, x, y, 1});
+        stack.push_back({x, x, y - 1, -1});
+        while (!stack.empty())
+        {
+            Span s = stack.back();
+            stack.pop_back();
+            if (s.y < 0 || s.y >= h) continue;
+            row = pixels + (std::size_t)s.y * w * 4;
+            seen = visited.data() + (std::size_t)s.y * w;
+
+            int x1 = s.x1, x2 = s.x2, px = x1;
+            int rowMin = w, rowMax = -1;
+            if (inside(px))
+            {
+                while (inside(px - 1)) seen[--px] = 1;
+                if (px < x1) stack.push_back({px, x1 - 1, s.y - s.dy, -s.dy});
+            }
+            while (x1 <= x2)
+            {
+                while (inside(x1)) seen[x1++] = 1;
+                if (x1 > px)
+                {
+                    rowMin = std::min(rowMin, px);
+                    rowMax = std::max(rowMax, x1 - 1);
+                    stack.push_back({px, x1 - 1, s.y + s.dy, s.dy});
+                }
+                if (x1 - 1 > x2) stack.push_back({x2 + 1, x1 - 1, s.y - s.dy, -s.dy});
+                ++x1;
+                while (x1 < x2 && !inside(x1)) ++x1;
+                px = x1;
+            }
+            if (rowMax >= rowMin)
+            {
+                minX = std::min(minX, rowMin);
+                maxX = std::max(maxX, rowMax);
+                minY = std::min(minY, s.y);
+                maxY = std::max(maxY, s.y);
+            }
+        }
+        bounds = sf::IntRect(minX, minY, maxX - minX + 1, maxY - minY + 1);
+    }
+}
+
+namespace FloodFill
+{
+    bool fill(const sf::Uint8* pixels, unsigned width, unsigned height,
+              unsigned x, unsigned y, int tolerance, Region& out)
+    {
+        if (x >= width || y >= height) return false;
+
+        const int w = (int)width, h = (int)height;
+        // The visited map is reused between fills and only the rectangle a
+        // fill touched is cleared afterwards, so bucket spam on a large canvas
+        // does not pay for a fresh full-size allocation every click.
+        thread_local std::vector<std::uint8_t> visited;
+        if (visited.size() != (std::size_t)w * h) visited.assign((std::size_t)w * h, 0);
+        const sf::Uint8* seed = pixels + ((std::size_t)y * w + x) * 4;
+        if (tolerance <= 0)
+            scan(pixels, w, h, (int)x, (int)y, Exact{load(seed)}, visited, out.bounds);
+        else
+            scan(pixels, w, h, (int)x, (int)y, Window(seed, tolerance), visited, out.bounds);
+
+        const int minX = out.bounds.left, minY = out.bounds.top;
+        out.mask.assign((std::size_t)out.bounds.width * out.bounds.height, 0);
+        for (int ry = 0; ry < out.bounds.height; ++ry)
+        {
+            std::uint8_t* src = visited.data() + (std::size_t)(minY + ry) * w + minX;
+            std::memcpy(out.mask.data() + (std::size_t)ry * out.bounds.width, src, out.bounds.width);
+            std::memset(src, 0, out.bounds.width);
+        }
+        return true;
+    }
+}
@@ -0,0 +1,24 @@
+#ifndef FLOODFILL_HPP
+#define FLOODFILL_HPP
+
+#include <SFML/Graphics.hpp>
+#include <cstdint>
+#include <vector>
+
+namespace FloodFill
+{
+    // Pixels reached by a fill, cropped to their bounding box. mask holds one
+    // byte per pixel of bounds, non-zero where the region is covered.
+    struct Region
+    {
+        sf::IntRect bounds;
+        std::vector<std::uint8_t> mask;
+    };
+
+    // Span-based scanline fill over a tightly packed RGBA buffer. A pixel joins
+    // the region when every channel is within tolerance of the seed pixel.
+    bool fill(const sf::Uint8* pixels, unsigned width, unsigned height,
+              unsigned x, unsigned y, int tolerance, Region& out);
+}
+
+#endif
@@ -0,0 +1,109 @@
+#include "GlyphRun.hpp"
+
+namespace
+{
+    // Same one pixel padding sf::Text uses so smoothed glyph edges are not clipped.
+    const float padding = 1.f;
+    const unsigned minAtlas = 16, maxAtlas = 256;
+}
+
+GlyphRun::GlyphRun()
+    : font(nullptr), size(0), atlas(minAtlas), ratio(1.f), whitespace(0.f), lineSpacing(0.f), pen{0.f, 0.f, 0, 0}
+{
+}
+
+unsigned GlyphRun::atlasSize(unsigned size)
+{
+    unsigned atlas = minAtlas;
+    while (atlas < size && atlas < maxAtlas) atlas *= 2;
+    return atlas;
+}
+
+void GlyphRun::reset(const sf::Font& f, unsigned characterSize)
+{
+    font = &f;
+    size = characterSize;
+    atlas = atlasSize(characterSize);
+    ratio = (float)size / atlas;
+    whitespace = font->getGlyph(L' ', atlas, false).advance;
+    lineSpacing = font->getLineSpacing(atlas);
+    pen = Pen{0.f, (float)atlas, 0, 0};
+    history.clear();
+    quads.clear();
+}
+
+void GlyphRun::push(sf::Uint32 c)
+{
+    history.push_back(pen);
+    pen.x += font->getKerning(pen.previous, c, atlas);
+    pen.previous = c;
+    if (c == L' ') { pen.x += whitespace; return; }
+    if (c == L'\t') { pen.x += whitespace * 4; return; }
+    if (c == L'\n') { pen.x = 0.f; pen.y += lineSpacing; return; }
+
+    const sf::Glyph& g = font->getGlyph(c, atlas, false);
+    sf::FloatRect bounds((pen.x + g.bounds.left - padding) * ratio, (pen.y + g.bounds.top - padding) * ratio,
+                         (g.bounds.width + 2 * padding) * ratio, (g.bounds.height + 2 * padding) * ratio);
+    sf::FloatRect uv(g.textureRect.left - padding, g.textureRect.top - padding,
+                     g.textureRect.width + 2 * padding, g.textureRect.height + 2 * padding);
+    quads.push_back(Quad{bounds, uv});
+    pen.quads = (std::uint32_t)quads.size();
+    pen.x += g.advance;
+}
+
+void GlyphRun::pop()
+{
+    if (history.empty()) return;
+    pen = history.back();
+    history.pop_back();
+    quads.resize(pen.quads);
+}
+
+std::size_t GlyphRun::getLength() const
+{
+    return history.size();
+}
+
+unsigned GlyphRun::getSize() const
+{
+    return size;
+}
+
+const std::vector<GlyphRun::Quad>& GlyphRun::getQuads() const
+{
+    return quads;
+}
+
+const sf::Texture& GlyphRun::getTexture() const
+{
+    return font->getTexture(atlas);
+}
+
+sf::Vector2f GlyphRun::getCaret() const
+{
+    return sf::Vector2f(pen.x * ratio, (pen.y - atlas) * ratio);
+}
+
+void GlyphRun::appendVertices(const Quad* quads, std::size_t count, const sf::Vector2f& origin, sf::Color color,
+                              std::vector<sf::Vertex>& out)
+{
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        const sf::FloatRect& b = quads[i].bounds;
+        const sf::FloatRect& uv = quads[i].uv;
+        float left = origin.x + b.left, top = origin.y + b.top, right = left + b.width, bottom = top + b.height;
+        float u0 = uv.left, v0 = uv.top, u1 = uv.left + uv.width, v1 = uv.top + uv.height;
+        out.push_back(sf::Vertex({left, top}, color, {u0, v0}));
+        out.push_back(sf::Vertex({right, top}, color, {u1, v0}));
+        out.push_back(sf::Vertex({left, bottom}, color, {u0, v1}));
+        out.push_back(sf::Vertex({left, bottom}, color, {u0, v1}));
+        out.push_back(sf::Vertex({right, top}, color, {u1, v0}));
+        out.push_back(sf::Vertex({right, bottom}, color, {u1, v1}));
+    }
+}
+
+void GlyphRun::appendSolid(const sf::FloatRect& bounds, sf::Color color, std::vector<sf::Vertex>& out)
+{
+    Quad quad{bounds, sf::FloatRect(1.f, 1.f, 0.f, 0.f)};
+    appendVertices(&quad, 1, sf::Vector2f(0.f, 0.f), color, out);
+}
@@ -0,0 +1,68 @@
+#ifndef GLYPHRUN_HPP
+#define GLYPHRUN_HPP
+
+#include <SFML/Graphics.hpp>
+#include <cstdint>
+#include <vector>
+
+// Shaped glyphs of one string as colour-free quads relative to its origin,
+// so recolouring never shapes again. Glyphs are rasterized at atlasSize()
+// and scaled to the requested size: text of any size within a band shares
+// one font page, and so one batch, and changing an item's size only scales
+// its quads. Characters can be pushed and popped one at a time without
+// laying out the rest of the string again.
+class GlyphRun
+{
+public:
+    struct Quad
+    {
+        sf::FloatRect bounds;
+        sf::FloatRect uv;
+    };
+
+    GlyphRun();
+
+    // Size glyphs of the given character size are rasterized at: the next
+    // power of two from 16 up to 256.
+    static unsigned atlasSize(unsigned size);
+
+    void reset(const sf::Font& font, unsigned size);
+    void push(sf::Uint32 c);
+    void pop();
+
+    std::size_t getLength() const;
+    unsigned getSize() const;
+    const std::vector<Quad>& getQuads() const;
+    const sf::Texture& getTexture() const;
+
+    // Top left of where the next glyph goes; the caret is getSize() tall.
+    sf::Vector2f getCaret() const;
+
+    // Two triangles per quad, offset by origin and tinted by color.
+    static void appendVertices(const Quad* quads, std::size_t count, const sf::Vector2f& origin, sf::Color color,
+                               std::vector<sf::Vertex>& out);
+    // A solid quad from the white block every font page reserves for
+    // underlines, so carets and rules batch with the glyphs.
+    static void appendSolid(const sf::FloatRect& bounds, sf::Color color, std::vector<sf::Vertex>& out);
+
+private:
+    struct Pen
+    {
+        float x, y;
+        sf::Uint32 previous;
+        std::uint32_t quads;
+    };
+
+    const sf::Font* font;
+    unsigned size;
+    unsigned atlas;
+    float ratio;
+    float whitespace;
+    float lineSpacing;
+    Pen pen;
+    // Pen before each pushed character, for pop().
+    std::vector<Pen> history;
+    std::vector<Quad> quads;
+};
+
+#endif
@@ -0,0 +1,116 @@
+#include "History.hpp"
+
+History::History()
+    : cursor(0)
+{
+}
+
+std::int64_t History::discardRedo()
+{
+    std::int64_t first = -1;
+    for (std::size_t i = cursor; i < entries.size(); ++i)
+    {
+        if (entries[i].op == Op::Add && (first < 0 || entries[i].id < first)) first = entries[i].id;
+    }
+    entries.resize(cursor);
+    return first;
+}
+
+void History::record(const Entry& entry)
+{
+    discardRedo();
+    entries.push_back(entry);
+    cursor = entries.size();
+}
+
+const History::Entry* History::undo()
+{
+    if (cursor == 0) return nullptr;
+    return &entries[--cursor];
+}
+
+const History::Entry* History::redo()
+{
+    if (cursor == entries.size()) return nullptr;
+    return &entries[cursor++];
+}
+
+const History::Entry* History::redoJoined()
+{
+    if (cursor == entries.size() || !entries[cursor].joined) return nullptr;
+    return &entries[cursor++];
+}
+
+std::uint32_t History::redoFloor(std::uint32_t limit) const
+{
+    for (std::size_t i = cursor; i < entries.size(); ++i)
+    {
+        if (entries[i].op != Op::Background && entries[i].id < limit) limit = entries[i].id;
+    }
+    return limit;
+}
+
+void History::forget(std::uint32_t count)
+{
+    std::size_t end = 0;
+    for (std::size_t i = 0; i < cursor; ++i)
+    {
+        if (entries[i].op != Op::Background && entries[i].id < count) end = i + 1;
+    }
+    // Never leave half a step behind.
+    while (end < cursor && entries[end].joined) ++end;
+    entries.erase(entries.begin(), entries.begin() + end);
+    entries.shrink_to_fit();
+    cursor -= end;
+}
+
+void History::shift(std::uint32_t count)
+{
+    // Only clears recorded since can still hold a lower base, which is
+    // where the flattened items now start.
+    for (auto& entry : entries)
+    {
+        if (entry.op != Op::Background) entry.id = entry.id > count ? entry.id - count : 0;
+    }
+}
+
+void History::collect(Op op, std::vector<std::uint32_t>& out) const
+{
+    out.clear();
+    for (const auto& entry : entries)
+    {
+        if (entry.op != op) continue;
+        out.push_back(entry.before);
+        out.push_back(entry.after);
+    }
+}
+
+void History::renumber(Op op, const std::vector<std::uint32_t>& map)
+{
+    for (auto& entry : entries)
+    {
+        if (entry.op != op) continue;
+        if (entry.before < map.size()) entry.before = map[entry.before];
+        if (entry.after < map.size()) entry.after = map[entry.after];
+    }
+}
+
+bool History::canUndo() const
+{
+    return cursor > 0;
+}
+
+bool History::canRedo() const
+{
+    return cursor < entries.size();
+}
+
+std::size_t History::size() const
+{
+    return entries.size();
+}
+
+std::size_t History::memoryUsage() const
+{
+    return entries.capacity() * sizeof(Entry);
+}
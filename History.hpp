@@ -0,0 +1,80 @@
+#ifndef HISTORY_HPP
+#define HISTORY_HPP
+
+#include <cstdint>
+#include <vector>
+
+// Undo/redo journal. Each edit is a fixed 16-byte command that is enough to
+// apply or revert it against the document on its own: the document keeps
+// every item it ever drew, so nothing is copied when recording and an undo
+// or redo costs as much as the edit itself. Memory grows with the number of
+// edits, never with document size times history depth. An edit to many
+// items at once records one entry per item, joined into a single step.
+class History
+{
+public:
+    enum class Op : std::uint8_t
+    {
+        Add,        // id: the item appended
+        Recolor,    // id: the item; before/after: its colour slot, as sf::Color::toInteger()
+        Background, // before/after: the background colour, likewise
+        Clear,      // id: the document base before clearing
+        Hide,       // id: the item deleted or wholly erased
+        Place,      // id: the item; before/after: its placement number
+        Cut         // id: the stroke; before/after: its cut number
+    };
+
+    struct Entry
+    {
+        Op op;
+        // Undone and redone together with the entry before it.
+        bool joined;
+        std::uint32_t id;
+        std::uint32_t before;
+        std::uint32_t after;
+    };
+
+    History();
+
+    // Forgets the redo branch ahead of a new edit. Returns the first item id
+    // the forgotten adds created, so the caller can truncate the document
+    // there, or -1 if there were none.
+    std::int64_t discardRedo();
+
+    void record(const Entry& entry);
+
+    // Entry to revert or re-apply, or null at either end of the journal.
+    // A step is undone until an entry that is not joined has been reverted,
+    // and redone while redoJoined() has more.
+    const Entry* undo();
+    const Entry* redo();
+    const Entry* redoJoined();
+
+    // Lowest item id the redo branch refers to, or limit when it refers to
+    // none below it. Items under it can be flattened without breaking redo.
+    std::uint32_t redoFloor(std::uint32_t limit) const;
+
+    // Drops the oldest entries up to the last one that refers to an item
+    // below count, so nothing left can undo into items being flattened.
+    // count must not exceed redoFloor().
+    void forget(std::uint32_t count);
+
+    // Renumbers the remaining entries once the items below count are gone.
+    void shift(std::uint32_t count);
+
+    // Placement or cut numbers (op is Place or Cut) that entries name, and
+    // renumbering them through map once the document has compacted them.
+    void collect(Op op, std::vector<std::uint32_t>& out) const;
+    void renumber(Op op, const std::vector<std::uint32_t>& map);
+
+    bool canUndo() const;
+    bool canRedo() const;
+    std::size_t size() const;
+    std::size_t memoryUsage() const;
+
+private:
+    std::vector<Entry> entries;
+    std::size_t cursor;
+};
+
+#endif
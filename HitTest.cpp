@@ -0,0 +1,38 @@
+#include "HitTest.hpp"
+#include <algorithm>
+
+namespace
+{
+    float cross(const sf::Vector2f& o, const sf::Vector2f& a, const sf::Vector2f& b)
+    {
+        return (a.x - o.x) * (b.y - o.y) - (a.y - o.y) * (b.x - o.x);
+    }
+}
+
+namespace HitTest
+{
+    bool pointInTriangle(const sf::Vector2f& p, const sf::Vector2f& a, const sf::Vector2f& b, const sf::Vector2f& c)
+    {
+        float d1 = cross(a, b, p);
+        float d2 = cross(b, c, p);
+        float d3 = cross(c, a, p);
+        bool hasNeg = d1 < 0 || d2 < 0 || d3 < 0;
+        bool hasPos = d1 > 0 || d2 > 0 || d3 > 0;
+        return !(hasNeg && hasPos);
+    }
+
+    bool pointInCircle(const sf::Vector2f& p, const sf::Vector2f& center, float radius)
+    {
+        sf::Vector2f d = p - center;
+        return d.x * d.x + d.y * d.y <= radius * radius;
+    }
+
+    bool pointInCapsule(const sf::Vector2f& p, const sf::Vector2f& a, const sf::Vector2f& b, float radius)
+    {
+        sf::Vector2f ab = b - a, ap = p - a;
+        float len2 = ab.x * ab.x + ab.y * ab.y;
+        float t = len2 > 0 ? std::max(0.f, std::min(1.f, (ap.x * ab.x + ap.y * ab.y) / len2)) : 0.f;
+        sf::Vector2f d = ap - ab * t;
+        return d.x * d.x + d.y * d.y <= radius * radius;
+    }
+}
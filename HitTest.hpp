@@ -0,0 +1,15 @@
+#ifndef HITTEST_HPP
+#define HITTEST_HPP
+
+#include <SFML/Graphics.hpp>
+
+// Exact point-in-primitive tests used once the spatial index has narrowed
+// the candidates down to the few items whose bounds contain the point.
+namespace HitTest
+{
+    bool pointInTriangle(const sf::Vector2f& p, const sf::Vector2f& a, const sf::Vector2f& b, const sf::Vector2f& c);
+    bool pointInCircle(const sf::Vector2f& p, const sf::Vector2f& center, float radius);
+    bool pointInCapsule(const sf::Vector2f& p, const sf::Vector2f& a, const sf::Vector2f& b, float radius);
+}
+
+#endif
@@ -0,0 +1,73 @@
+#include "InputQueue.hpp"
+#include <chrono>
+#include <thread>
+
+InputQueue::InputQueue()
+    : sleeping(false), notified(false), closed(false)
+{
+}
+
+void InputQueue::push(const InputCommand& command)
+{
+    while (!ring.push(command)) std::this_thread::yield();
+
+    // Pairs with the fence in wait(): either the render thread sees the new
+    // command before sleeping, or this sees it asleep and wakes it.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleeping.load(std::memory_order_relaxed))
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        wake.notify_one();
+    }
+}
+
+bool InputQueue::pop(InputCommand& command)
+{
+    return ring.pop(command);
+}
+
+void InputQueue::wait(sf::Time timeout)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    sleeping.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (timeout == sf::Time::Zero)
+        wake.wait(lock, [this] { return ready(); });
+    else
+        wake.wait_for(lock, std::chrono::microseconds(timeout.asMicroseconds()), [this] { return ready(); });
+    sleeping.store(false, std::memory_order_relaxed);
+    notified.store(false, std::memory_order_relaxed);
+}
+
+void InputQueue::notify()
+{
+    notified.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleeping.load(std::memory_order_relaxed))
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        wake.notify_one();
+    }
+}
+
+void InputQueue::close()
+{
+    closed.store(true);
+    std::lock_guard<std::mutex> lock(mutex);
+    wake.notify_one();
+}
+
+bool InputQueue::isClosed() const
+{
+    return closed.load();
+}
+
+std::size_t InputQueue::size() const
+{
+    return ring.size();
+}
+
+bool InputQueue::ready() const
+{
+    return !ring.empty() || notified.load() || closed.load();
+}
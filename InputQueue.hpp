@@ -0,0 +1,59 @@
+#ifndef INPUTQUEUE_HPP
+#define INPUTQUEUE_HPP
+
+#include <SFML/System/Time.hpp>
+#include <SFML/Window/Event.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include "SpscQueue.hpp"
+
+// A window event stamped with the time the event thread received it, on
+// the clock App::inputTime() reads.
+struct InputCommand
+{
+    sf::Event event;
+    sf::Time time;
+};
+
+// Carries events from the thread that polls the window to the thread that
+// renders. Commands go through a lock-free ring; the mutex is only taken
+// to wake a render thread that has gone idle, never while it is busy.
+class InputQueue
+{
+public:
+    InputQueue();
+
+    // Event thread. Waits for room rather than drop input when the render
+    // thread has fallen a whole ring behind.
+    void push(const InputCommand& command);
+
+    // Render thread.
+    bool pop(InputCommand& command);
+
+    // Render thread: blocks until a command arrives, the queue is closed,
+    // or timeout passes (never, when it is zero).
+    void wait(sf::Time timeout = sf::Time::Zero);
+
+    // Any thread: wakes the render thread once without a command, for
+    // work that arrives from elsewhere, such as a shared drawing.
+    void notify();
+
+    // Wakes the render thread for good.
+    void close();
+    bool isClosed() const;
+
+    std::size_t size() const;
+
+private:
+    bool ready() const;
+
+    SpscQueue<InputCommand, 1024> ring;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::atomic<bool> sleeping;
+    std::atomic<bool> notified;
+    std::atomic<bool> closed;
+};
+
+#endif
@@ -0,0 +1,51 @@
+#include "LatencyStats.hpp"
+#include <algorithm>
+#include <cmath>
+#include <ostream>
+
+LatencyStats::LatencyStats()
+    : next(0), total(0), deepest(0), depthSum(0.0)
+{
+}
+
+void LatencyStats::add(sf::Time latency, std::size_t queueDepth)
+{
+    if (samples.size() < window) samples.push_back(latency.asMicroseconds());
+    else samples[next] = latency.asMicroseconds();
+    next = (next + 1) % window;
+    ++total;
+    deepest = std::max(deepest, queueDepth);
+    depthSum += (double)queueDepth;
+}
+
+std::size_t LatencyStats::count() const
+{
+    return total;
+}
+
+sf::Time LatencyStats::percentile(float p) const
+{
+    if (samples.empty()) return sf::Time::Zero;
+    std::vector<sf::Int64> sorted(samples);
+    std::size_t i = (std::size_t)std::lround(std::min(1.f, std::max(0.f, p)) * (sorted.size() - 1));
+    std::nth_element(sorted.begin(), sorted.begin() + i, sorted.end());
+    return sf::microseconds(sorted[i]);
+}
+
+std::size_t LatencyStats::maxDepth() const
+{
+    return deepest;
+}
+
+double LatencyStats::meanDepth() const
+{
+    return total ? depthSum / total : 0.0;
+}
+
+void LatencyStats::print(std::ostream& out) const
+{
+    auto ms = [](sf::Time t) { return t.asMicroseconds() / 1000.0; };
+    out << "input latency over " << samples.size() << " frames: p50 " << ms(percentile(0.5f)) << " ms, p95 "
+        << ms(percentile(0.95f)) << " ms, p99 " << ms(percentile(0.99f)) << " ms, max " << ms(percentile(1.f))
+        << " ms; queue depth mean " << meanDepth() << ", max " << maxDepth() << "\n";
+}
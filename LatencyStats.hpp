@@ -0,0 +1,39 @@
+#ifndef LATENCYSTATS_HPP
+#define LATENCYSTATS_HPP
+
+#include <SFML/System/Time.hpp>
+#include <cstddef>
+#include <iosfwd>
+#include <vector>
+
+// Event-to-photon latency of recent frames: from the oldest input a frame
+// consumed being stamped on the event thread to display() returning with
+// its effect on screen, along with how deep the input queue was when the
+// frame started draining it.
+class LatencyStats
+{
+public:
+    LatencyStats();
+
+    void add(sf::Time latency, std::size_t queueDepth);
+
+    std::size_t count() const;
+
+    // p in [0, 1], over the frames still in the window.
+    sf::Time percentile(float p) const;
+    std::size_t maxDepth() const;
+    double meanDepth() const;
+
+    void print(std::ostream& out) const;
+
+private:
+    static const std::size_t window = 4096;
+
+    std::vector<sf::Int64> samples;
+    std::size_t next;
+    std::size_t total;
+    std::size_t deepest;
+    double depthSum;
+};
+
+#endif
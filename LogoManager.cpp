@@ -1,14 +1,15 @@
 #include "LogoManager.hpp"
+#include "AssetBundle.hpp"
 #include <iostream>
 
 namespace LogoManager
 {
-    bool setWindowIcon(sf::RenderWindow& window, const std::string& logoPath)
+    bool setWindowIcon(sf::RenderWindow& window)
     {
         sf::Image icon;
-        if (!icon.loadFromFile(logoPath))
+        if (!icon.loadFromMemory(AssetBundle::logo.data, AssetBundle::logo.size))
         {
-            std::cerr << "Failed to load icon from " << logoPath << std::endl;
+            std::cerr << "Failed to decode the bundled icon" << std::endl;
             return false;
         }
         window.setIcon(icon.getSize().x, icon.getSize().y, icon.getPixelsPtr());
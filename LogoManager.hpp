@@ -2,11 +2,11 @@
 #define LOGOMANAGER_HPP
 
 #include <SFML/Graphics.hpp>
-#include <string>
 
 namespace LogoManager
 {
-    bool setWindowIcon(sf::RenderWindow& window, const std::string& logoPath);
+    // Uses the bundled logo.
+    bool setWindowIcon(sf::RenderWindow& window);
 }
 
 #endif
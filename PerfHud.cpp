@@ -0,0 +1,102 @@
+#include "PerfHud.hpp"
+
+#ifdef DIBUJO_PROFILE
+
+#include <algorithm>
+#include <cstdio>
+
+namespace
+{
+    const float barWidth = 2.f;
+    const float graphHeight = 60.f;
+    // Frame time at the top of the graph; longer frames are clipped.
+    const float graphMillis = 50.f;
+    const float budgetMillis = 1000.f / 60.f;
+    const float padding = 6.f;
+
+    sf::Color frameColor(float millis)
+    {
+        if (millis <= budgetMillis) return sf::Color(90, 200, 90);
+        if (millis <= 2.f * budgetMillis) return sf::Color(230, 200, 60);
+        return sf::Color(230, 70, 60);
+    }
+
+    void quad(sf::VertexArray& vertices, float left, float top, float width, float height, sf::Color color)
+    {
+        vertices.append(sf::Vertex({left, top}, color));
+        vertices.append(sf::Vertex({left + width, top}, color));
+        vertices.append(sf::Vertex({left + width, top + height}, color));
+        vertices.append(sf::Vertex({left, top + height}, color));
+    }
+}
+
+PerfHud::PerfHud()
+    : graph(sf::Quads)
+{
+    panel.setFillColor(sf::Color(0, 0, 0, 170));
+    text.setCharacterSize(12);
+    text.setFillColor(sf::Color::White);
+}
+
+void PerfHud::setFont(const sf::Font& font)
+{
+    text.setFont(font);
+}
+
+void PerfHud::update(const Stats& stats, const sf::Vector2u& size)
+{
+    Profiler::frameHistory(history);
+    float last = history.empty() ? 0.f : history.back();
+    float worst = history.empty() ? 0.f : *std::max_element(history.begin(), history.end());
+
+    char line[512];
+    std::snprintf(line, sizeof line,
+                  "frame %.2f ms (worst %.2f)\n"
+                  "draws %zu  verts %zu  uploads %zu\n"
+                  "items %zu  stroke %zu pts\n"
+                  "heap %.2f MB\n"
+                  "input %.2f ms  queue %zu%s",
+                  last, worst, stats.drawCalls, stats.vertices, stats.textureUploads, stats.items,
+                  stats.strokePoints, Profiler::heapBytes() / (1024.0 * 1024.0),
+                  Profiler::lastLatency().asMicroseconds() / 1000.0, Profiler::lastQueueDepth(),
+                  Profiler::isTracing() ? "\ntracing (F4 to stop)" : "");
+    text.setString(line);
+
+    float width = barWidth * Profiler::historySize;
+    sf::FloatRect bounds = text.getLocalBounds();
+    float height = graphHeight + padding * 3.f + bounds.top + bounds.height;
+    float left = padding;
+    float top = (float)size.y - height - padding;
+    panel.setPosition(left, top);
+    panel.setSize({width + padding * 2.f, height});
+    text.setPosition(left + padding, top + padding * 2.f + graphHeight);
+
+    graph.clear();
+    float base = top + padding + graphHeight;
+    for (std::size_t i = 0; i < history.size(); ++i)
+    {
+        float bar = std::min(history[i], graphMillis) / graphMillis * graphHeight;
+        quad(graph, left + padding + barWidth * i, base - bar, barWidth - 0.5f, bar, frameColor(history[i]));
+    }
+    float budget = base - budgetMillis / graphMillis * graphHeight;
+    quad(graph, left + padding, budget, width, 1.f, sf::Color(255, 255, 255, 120));
+}
+
+std::size_t PerfHud::drawCalls() const
+{
+    return 3;
+}
+
+std::size_t PerfHud::vertexCount() const
+{
+    return 4 + graph.getVertexCount() + text.getString().getSize() * 6;
+}
+
+void PerfHud::draw(sf::RenderTarget& target, sf::RenderStates states) const
+{
+    target.draw(panel, states);
+    target.draw(graph, states);
+    target.draw(text, states);
+}
+
+#endif
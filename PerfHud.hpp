@@ -0,0 +1,49 @@
+#ifndef PERFHUD_HPP
+#define PERFHUD_HPP
+
+#include "Profiler.hpp"
+
+#ifdef DIBUJO_PROFILE
+
+#include <SFML/Graphics.hpp>
+#include <vector>
+
+// Overlay with the numbers Profiler and RenderStats collect: a rolling
+// histogram of frame times, draw calls, vertices and texture uploads of the
+// frame being drawn, document and stroke sizes, heap in use and the input
+// latency of the last frame that consumed events.
+class PerfHud : public sf::Drawable
+{
+public:
+    struct Stats
+    {
+        std::size_t drawCalls = 0;
+        std::size_t vertices = 0;
+        std::size_t textureUploads = 0;
+        std::size_t items = 0;
+        std::size_t strokePoints = 0;
+    };
+
+    PerfHud();
+
+    void setFont(const sf::Font& font);
+
+    // Rebuilds the overlay for a target of the given size, in pixels.
+    void update(const Stats& stats, const sf::Vector2u& size);
+
+    // Draw calls and vertices draw() itself costs, for RenderStats.
+    std::size_t drawCalls() const;
+    std::size_t vertexCount() const;
+
+private:
+    void draw(sf::RenderTarget& target, sf::RenderStates states) const override;
+
+    sf::RectangleShape panel;
+    sf::VertexArray graph;
+    sf::Text text;
+    std::vector<float> history;
+};
+
+#endif
+
+#endif
@@ -0,0 +1,143 @@
+#include "Profiler.hpp"
+
+#ifdef DIBUJO_PROFILE
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <mutex>
+
+namespace
+{
+    struct TraceEvent
+    {
+        const char* name;
+        long long start;
+        long long duration;
+        int thread;
+    };
+
+    std::mutex traceMutex;
+    std::vector<TraceEvent> traceEvents;
+    std::atomic<bool> tracing(false);
+    std::atomic<int> threadCount(0);
+
+    std::mutex frameMutex;
+    float frameTimes[Profiler::historySize];
+    std::size_t frameCount = 0;
+
+    std::atomic<long long> latency(0);
+    std::atomic<std::size_t> queueDepth(0);
+    std::atomic<std::size_t> heap(0);
+
+    long long now()
+    {
+        static const auto epoch = std::chrono::steady_clock::now();
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - epoch).count();
+    }
+
+    int threadId()
+    {
+        thread_local int id = ++threadCount;
+        return id;
+    }
+}
+
+Profiler::Scope::Scope(const char* name)
+    : name(name), start(tracing.load(std::memory_order_relaxed) ? now() : -1)
+{
+}
+
+Profiler::Scope::~Scope()
+{
+    if (start < 0 || !tracing.load(std::memory_order_relaxed)) return;
+    TraceEvent event{name, start, now() - start, threadId()};
+    std::lock_guard<std::mutex> lock(traceMutex);
+    traceEvents.push_back(event);
+}
+
+void Profiler::startTrace()
+{
+    std::lock_guard<std::mutex> lock(traceMutex);
+    traceEvents.clear();
+    tracing.store(true);
+}
+
+bool Profiler::stopTrace(const std::string& path, std::string& error)
+{
+    std::vector<TraceEvent> events;
+    {
+        std::lock_guard<std::mutex> lock(traceMutex);
+        tracing.store(false);
+        events.swap(traceEvents);
+    }
+
+    std::ofstream out(path);
+    out << "{\"traceEvents\":[\n";
+    for (std::size_t i = 0; i < events.size(); ++i)
+    {
+        const TraceEvent& e = events[i];
+        out << (i ? ",\n" : "") << "{\"name\":\"" << e.name << "\",\"ph\":\"X\",\"ts\":" << e.start
+            << ",\"dur\":" << e.duration << ",\"pid\":1,\"tid\":" << e.thread << "}";
+    }
+    out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+    out.close();
+    if (out.fail())
+    {
+        error = "could not write " + path;
+        return false;
+    }
+    return true;
+}
+
+bool Profiler::isTracing()
+{
+    return tracing.load();
+}
+
+void Profiler::frame(sf::Time duration)
+{
+    std::lock_guard<std::mutex> lock(frameMutex);
+    frameTimes[frameCount++ % historySize] = duration.asMicroseconds() / 1000.f;
+}
+
+void Profiler::frameHistory(std::vector<float>& millis)
+{
+    std::lock_guard<std::mutex> lock(frameMutex);
+    std::size_t count = std::min(frameCount, historySize);
+    millis.resize(count);
+    for (std::size_t i = 0; i < count; ++i) millis[i] = frameTimes[(frameCount - count + i) % historySize];
+}
+
+void Profiler::input(sf::Time last, std::size_t depth)
+{
+    latency.store(last.asMicroseconds(), std::memory_order_relaxed);
+    queueDepth.store(depth, std::memory_order_relaxed);
+}
+
+sf::Time Profiler::lastLatency()
+{
+    return sf::microseconds(latency.load(std::memory_order_relaxed));
+}
+
+std::size_t Profiler::lastQueueDepth()
+{
+    return queueDepth.load(std::memory_order_relaxed);
+}
+
+void Profiler::allocated(std::size_t bytes)
+{
+    heap.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void Profiler::freed(std::size_t bytes)
+{
+    heap.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+std::size_t Profiler::heapBytes()
+{
+    return heap.load(std::memory_order_relaxed);
+}
+
+#endif
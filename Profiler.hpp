@@ -0,0 +1,64 @@
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+// Frame timing, input latency, heap use and scoped timers for the perf HUD
+// and Chrome trace export. Everything here only exists in builds with
+// DIBUJO_PROFILE defined (make PROFILE=1); otherwise DIBUJO_PROFILE_SCOPE
+// expands to nothing and no profiling code is compiled at all.
+#ifdef DIBUJO_PROFILE
+
+#include <SFML/System/Time.hpp>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace Profiler
+{
+    // Times the enclosing block into the trace while one is recording.
+    class Scope
+    {
+    public:
+        explicit Scope(const char* name);
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        const char* name;
+        long long start;
+    };
+
+    // Collects scopes from every thread until stopTrace() writes them out
+    // as Chrome trace-event JSON (chrome://tracing, Perfetto).
+    void startTrace();
+    bool stopTrace(const std::string& path, std::string& error);
+    bool isTracing();
+
+    // Time from the start of one rendered frame's work to its display().
+    void frame(sf::Time duration);
+    // Oldest first, the last historySize frames.
+    void frameHistory(std::vector<float>& millis);
+    const std::size_t historySize = 120;
+
+    void input(sf::Time latency, std::size_t queueDepth);
+    sf::Time lastLatency();
+    std::size_t lastQueueDepth();
+
+    // Fed by the operator new/delete replacements in the front end.
+    void allocated(std::size_t bytes);
+    void freed(std::size_t bytes);
+    std::size_t heapBytes();
+}
+
+#define DIBUJO_PROFILE_CONCAT2(a, b) a##b
+#define DIBUJO_PROFILE_CONCAT(a, b) DIBUJO_PROFILE_CONCAT2(a, b)
+#define DIBUJO_PROFILE_SCOPE(name) Profiler::Scope DIBUJO_PROFILE_CONCAT(profileScope, __LINE__)(name)
+
+#else
+
+#define DIBUJO_PROFILE_SCOPE(name) ((void)0)
+
+#endif
+
+#endif
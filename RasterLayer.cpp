@@ -0,0 +1,373 @@
+#include "RasterLayer.hpp"
+#include "RenderStats.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+    const std::size_t tilePixels = (std::size_t)RasterLayer::tileSize * RasterLayer::tileSize;
+
+    std::uint32_t pixelAt(const std::uint8_t* rgba, std::size_t i)
+    {
+        const std::uint8_t* p = rgba + i * 4;
+        // Every transparent pixel is the same, so they all run together.
+        if (p[3] == 0) return 0;
+        return (std::uint32_t)p[0] | (std::uint32_t)p[1] << 8 | (std::uint32_t)p[2] << 16 | (std::uint32_t)p[3] << 24;
+    }
+
+    void putPixel(std::vector<std::uint8_t>& out, std::uint32_t v)
+    {
+        for (int i = 0; i < 4; ++i) out.push_back((std::uint8_t)(v >> (i * 8)));
+    }
+
+    // Walks an encoded tile, writing its pixels to rgba unless that is null.
+    bool unpack(const std::uint8_t* data, std::size_t size, std::uint8_t* rgba)
+    {
+        if (size < 4 || data[0] > data[2] || data[1] > data[3]) return false;
+        const std::uint8_t* p = data + 4;
+        const std::uint8_t* end = data + size;
+        std::size_t i = 0;
+        while (p < end)
+        {
+            std::uint8_t header = *p++;
+            std::size_t count = header < 128 ? header + 1u : header - 126u;
+            std::size_t bytes = header < 128 ? count * 4 : 4;
+            if ((std::size_t)(end - p) < bytes || i + count > tilePixels) return false;
+            if (rgba)
+            {
+                if (header < 128)
+                {
+                    std::memcpy(rgba + i * 4, p, bytes);
+                }
+                else
+                {
+                    for (std::size_t k = 0; k < count; ++k) std::memcpy(rgba + (i + k) * 4, p, 4);
+                }
+            }
+            p += bytes;
+            i += count;
+        }
+        return i == tilePixels;
+    }
+
+    std::int32_t half(std::int32_t v)
+    {
+        return (v - (v < 0)) / 2;
+    }
+
+    // Box-filters a whole tile into a quarter of another, averaging with
+    // premultiplied alpha so transparent neighbours do not darken edges.
+    void downsample(const std::uint8_t* child, std::uint8_t* parent, unsigned offsetX, unsigned offsetY)
+    {
+        const unsigned size = RasterLayer::tileSize;
+        for (unsigned y = 0; y < size / 2; ++y)
+        {
+            for (unsigned x = 0; x < size / 2; ++x)
+            {
+                unsigned alpha = 0, color[3] = {0, 0, 0};
+                for (unsigned k = 0; k < 4; ++k)
+                {
+                    const std::uint8_t* p = child + ((std::size_t)(y * 2 + k / 2) * size + x * 2 + k % 2) * 4;
+                    alpha += p[3];
+                    for (int c = 0; c < 3; ++c) color[c] += p[c] * p[3];
+                }
+                std::uint8_t* out = parent + ((std::size_t)(offsetY + y) * size + offsetX + x) * 4;
+                out[3] = (std::uint8_t)((alpha + 2) / 4);
+                for (int c = 0; c < 3; ++c) out[c] = alpha ? (std::uint8_t)((color[c] + alpha / 2) / alpha) : 0;
+            }
+        }
+    }
+}
+
+RasterLayer::RasterLayer(float pixelsPerUnit, std::size_t capacity)
+    : pixelsPerUnit(pixelsPerUnit), capacity(capacity), encoded(0), clock(0)
+{
+}
+
+RasterLayer::RasterLayer(const RasterLayer& other)
+    : pixelsPerUnit(other.pixelsPerUnit), capacity(other.capacity), tiles(other.tiles), encoded(other.encoded),
+      clock(0)
+{
+}
+
+RasterLayer& RasterLayer::operator=(const RasterLayer& other)
+{
+    if (this == &other) return *this;
+    pixelsPerUnit = other.pixelsPerUnit;
+    capacity = other.capacity;
+    tiles = other.tiles;
+    encoded = other.encoded;
+    // Textures whose tile is unchanged are kept; the rest are remade on use.
+    for (auto it = resident.begin(); it != resident.end();)
+    {
+        auto tile = tiles.find(it->first);
+        if (tile == tiles.end()) it = resident.erase(it);
+        else ++it;
+    }
+    return *this;
+}
+
+float RasterLayer::getPixelsPerUnit() const
+{
+    return pixelsPerUnit;
+}
+
+sf::FloatRect RasterLayer::tileArea(int level, std::int32_t x, std::int32_t y) const
+{
+    float span = std::ldexp((float)tileSize, level) / pixelsPerUnit;
+    return sf::FloatRect(x * span, y * span, span, span);
+}
+
+int RasterLayer::levelFor(float scale) const
+{
+    if (scale >= pixelsPerUnit) return 0;
+    return std::min(levels - 1, (int)std::floor(std::log2(pixelsPerUnit / scale)));
+}
+
+bool RasterLayer::empty() const
+{
+    return tiles.empty();
+}
+
+std::size_t RasterLayer::tileCount() const
+{
+    return tiles.size();
+}
+
+sf::FloatRect RasterLayer::getBounds() const
+{
+    float left = 0.f, top = 0.f, right = 0.f, bottom = 0.f;
+    bool any = false;
+    for (const auto& entry : tiles)
+    {
+        const Tile& tile = entry.second;
+        if (tile.level != 0) continue;
+        const std::uint8_t* box = tile.data->data();
+        sf::FloatRect area = tileArea(0, tile.x, tile.y);
+        float l = area.left + box[0] / pixelsPerUnit, t = area.top + box[1] / pixelsPerUnit;
+        float r = area.left + (box[2] + 1) / pixelsPerUnit, b = area.top + (box[3] + 1) / pixelsPerUnit;
+        if (!any)
+        {
+            left = l;
+            top = t;
+            right = r;
+            bottom = b;
+            any = true;
+        }
+        left = std::min(left, l);
+        top = std::min(top, t);
+        right = std::max(right, r);
+        bottom = std::max(bottom, b);
+    }
+    return sf::FloatRect(left, top, right - left, bottom - top);
+}
+
+std::size_t RasterLayer::encodedSize() const
+{
+    return encoded;
+}
+
+std::size_t RasterLayer::memoryUsage() const
+{
+    return encoded + tiles.size() * (sizeof(Tile) + sizeof(std::uint64_t)) + resident.size() * tilePixels * 4;
+}
+
+RasterLayer::Data RasterLayer::find(int level, std::int32_t x, std::int32_t y) const
+{
+    auto it = tiles.find(key(level, x, y));
+    return it == tiles.end() ? Data() : it->second.data;
+}
+
+void RasterLayer::set(int level, std::int32_t x, std::int32_t y, Data data)
+{
+    std::uint64_t k = key(level, x, y);
+    auto it = tiles.find(k);
+    if (it != tiles.end())
+    {
+        encoded -= it->second.data->size();
+        if (data)
+        {
+            it->second.data = std::move(data);
+            encoded += it->second.data->size();
+        }
+        else
+        {
+            tiles.erase(it);
+            resident.erase(k);
+        }
+        return;
+    }
+    if (!data) return;
+    encoded += data->size();
+    tiles.emplace(k, Tile{level, x, y, std::move(data)});
+}
+
+void RasterLayer::clear()
+{
+    tiles.clear();
+    resident.clear();
+    encoded = 0;
+}
+
+void RasterLayer::rebuildPyramid(const std::vector<sf::Vector2i>& changed)
+{
+    std::vector<sf::Vector2i> current = changed, parents;
+    std::vector<std::uint8_t> child(tilePixels * 4), parent(tilePixels * 4);
+    for (int level = 1; level < levels && !current.empty(); ++level)
+    {
+        parents.clear();
+        for (const auto& c : current) parents.push_back(sf::Vector2i(half(c.x), half(c.y)));
+        std::sort(parents.begin(), parents.end(), [](const sf::Vector2i& a, const sf::Vector2i& b) {
+            return a.y != b.y ? a.y < b.y : a.x < b.x;
+        });
+        parents.erase(std::unique(parents.begin(), parents.end()), parents.end());
+
+        for (const auto& p : parents)
+        {
+            std::fill(parent.begin(), parent.end(), 0);
+            for (unsigned k = 0; k < 4; ++k)
+            {
+                Data data = find(level - 1, p.x * 2 + (std::int32_t)(k % 2), p.y * 2 + (std::int32_t)(k / 2));
+                if (!data || !decode(data->data(), data->size(), child.data())) continue;
+                downsample(child.data(), parent.data(), k % 2 * tileSize / 2, k / 2 * tileSize / 2);
+            }
+            set(level, p.x, p.y, encode(parent.data()));
+        }
+        current.swap(parents);
+    }
+}
+
+void RasterLayer::draw(sf::RenderTarget& target, sf::RenderStates states, const sf::FloatRect& area,
+                       float scale) const
+{
+    if (tiles.empty()) return;
+    int level = levelFor(scale);
+    float span = tileArea(level, 0, 0).width;
+    std::int32_t x0 = (std::int32_t)std::floor(area.left / span);
+    std::int32_t y0 = (std::int32_t)std::floor(area.top / span);
+    std::int32_t x1 = (std::int32_t)std::floor((area.left + area.width) / span);
+    std::int32_t y1 = (std::int32_t)std::floor((area.top + area.height) / span);
+
+    ++clock;
+    quad.resize(4);
+    float size = (float)tileSize;
+    for (std::int32_t y = y0; y <= y1; ++y)
+    {
+        for (std::int32_t x = x0; x <= x1; ++x)
+        {
+            std::uint64_t k = key(level, x, y);
+            auto it = tiles.find(k);
+            if (it == tiles.end()) continue;
+            states.texture = textureOf(k, it->second.data);
+            if (!states.texture) continue;
+
+            sf::FloatRect r = tileArea(level, x, y);
+            quad[0] = sf::Vertex({r.left, r.top}, {0.f, 0.f});
+            quad[1] = sf::Vertex({r.left + r.width, r.top}, {size, 0.f});
+            quad[2] = sf::Vertex({r.left + r.width, r.top + r.height}, {size, size});
+            quad[3] = sf::Vertex({r.left, r.top + r.height}, {0.f, size});
+            target.draw(quad.data(), quad.size(), sf::Quads, states);
+            RenderStats::draw(4);
+        }
+    }
+
+    // Textures on screen this time are kept even past capacity.
+    while (resident.size() > capacity)
+    {
+        auto oldest = std::min_element(resident.begin(), resident.end(), [](const auto& a, const auto& b) {
+            return a.second.lastUsed < b.second.lastUsed;
+        });
+        if (oldest->second.lastUsed == clock) break;
+        resident.erase(oldest);
+    }
+}
+
+const sf::Texture* RasterLayer::textureOf(std::uint64_t k, const Data& data) const
+{
+    Resident& r = resident[k];
+    r.lastUsed = clock;
+    if (r.texture && r.source == data) return r.texture.get();
+
+    pixels.resize(tilePixels * 4);
+    if (!decode(data->data(), data->size(), pixels.data())) return nullptr;
+    if (!r.texture)
+    {
+        r.texture = std::make_unique<sf::Texture>();
+        if (!r.texture->create(tileSize, tileSize))
+        {
+            resident.erase(k);
+            return nullptr;
+        }
+        r.texture->setSmooth(true);
+    }
+    r.texture->update(pixels.data());
+    RenderStats::upload();
+    r.source = data;
+    return r.texture.get();
+}
+
+RasterLayer::Data RasterLayer::encode(const std::uint8_t* rgba)
+{
+    unsigned left = tileSize, top = tileSize, right = 0, bottom = 0;
+    for (unsigned y = 0; y < tileSize; ++y)
+    {
+        for (unsigned x = 0; x < tileSize; ++x)
+        {
+            if (rgba[((std::size_t)y * tileSize + x) * 4 + 3] == 0) continue;
+            left = std::min(left, x);
+            top = std::min(top, y);
+            right = std::max(right, x);
+            bottom = std::max(bottom, y);
+        }
+    }
+    if (left > right) return Data();
+
+    auto out = std::make_shared<std::vector<std::uint8_t>>();
+    out->push_back((std::uint8_t)left);
+    out->push_back((std::uint8_t)top);
+    out->push_back((std::uint8_t)right);
+    out->push_back((std::uint8_t)bottom);
+    for (std::size_t i = 0; i < tilePixels;)
+    {
+        std::uint32_t v = pixelAt(rgba, i);
+        std::size_t run = 1;
+        while (i + run < tilePixels && run < 129 && pixelAt(rgba, i + run) == v) ++run;
+        if (run >= 2)
+        {
+            out->push_back((std::uint8_t)(run + 126));
+            putPixel(*out, v);
+            i += run;
+            continue;
+        }
+
+        // Literals up to where the next run of two starts.
+        std::size_t start = i, length = 0;
+        while (i < tilePixels && length < 128)
+        {
+            if (i + 1 < tilePixels && pixelAt(rgba, i + 1) == pixelAt(rgba, i)) break;
+            ++i;
+            ++length;
+        }
+        out->push_back((std::uint8_t)(length - 1));
+        for (std::size_t k = start; k < start + length; ++k) putPixel(*out, pixelAt(rgba, k));
+    }
+    out->shrink_to_fit();
+    return out;
+}
+
+bool RasterLayer::decode(const std::uint8_t* data, std::size_t size, std::uint8_t* rgba)
+{
+    return unpack(data, size, rgba);
+}
+
+bool RasterLayer::validate(const std::uint8_t* data, std::size_t size)
+{
+    return unpack(data, size, nullptr);
+}
+
+std::uint64_t RasterLayer::key(int level, std::int32_t x, std::int32_t y)
+{
+    return ((std::uint64_t)level << 56) ^ ((std::uint64_t)((std::uint32_t)x & 0xfffffff) << 28) ^
+           ((std::uint32_t)y & 0xfffffff);
+}
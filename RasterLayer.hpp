@@ -0,0 +1,108 @@
+#ifndef RASTERLAYER_HPP
+#define RASTERLAYER_HPP
+
+#include <SFML/Graphics.hpp>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// Items flattened out of a document: a sparse pyramid of RGBA tiles drawn
+// beneath everything still live. Level 0 holds pixelsPerUnit pixels per
+// document unit and each level above halves that, so a zoomed-out view
+// draws a handful of tiles rather than thousands.
+//
+// Tiles are stored run-length encoded, which suits the flat colours of a
+// drawing, and fully transparent tiles are not stored at all. They are only
+// decoded into textures while on screen, through a small LRU pool. Encoded
+// tiles are immutable and shared, so copying a layer for a background job
+// copies pointers, never pixels.
+class RasterLayer
+{
+public:
+    typedef std::shared_ptr<const std::vector<std::uint8_t>> Data;
+
+    static const unsigned tileSize = 256;
+    static const int levels = 12;
+
+    explicit RasterLayer(float pixelsPerUnit = 2.f, std::size_t capacity = 64);
+
+    // Copies the tiles, not the textures made from them.
+    RasterLayer(const RasterLayer& other);
+    RasterLayer& operator=(const RasterLayer& other);
+    RasterLayer(RasterLayer&&) = default;
+    RasterLayer& operator=(RasterLayer&&) = default;
+
+    float getPixelsPerUnit() const;
+    // Document-space area a tile covers.
+    sf::FloatRect tileArea(int level, std::int32_t x, std::int32_t y) const;
+    // Level whose resolution is the nearest at or above scale screen pixels per unit.
+    int levelFor(float scale) const;
+
+    bool empty() const;
+    std::size_t tileCount() const;
+    // Union of the non-transparent pixels of level 0, empty for an empty layer.
+    sf::FloatRect getBounds() const;
+    // Encoded bytes, and those plus the decoded textures resident now.
+    std::size_t encodedSize() const;
+    std::size_t memoryUsage() const;
+
+    // Null for a transparent tile.
+    Data find(int level, std::int32_t x, std::int32_t y) const;
+    // Null erases the tile.
+    void set(int level, std::int32_t x, std::int32_t y, Data data);
+    void clear();
+
+    // Calls visit(level, x, y, data) for every stored tile.
+    template <typename Visit>
+    void forEach(Visit visit) const
+    {
+        for (const auto& tile : tiles) visit(tile.second.level, tile.second.x, tile.second.y, tile.second.data);
+    }
+
+    // Remakes the tiles of every level above the given level 0 tiles from
+    // their four children.
+    void rebuildPyramid(const std::vector<sf::Vector2i>& changed);
+
+    // Draws the tiles of the level suited to scale over area.
+    void draw(sf::RenderTarget& target, sf::RenderStates states, const sf::FloatRect& area, float scale) const;
+
+    // A tile is a u8 box [left, top, right, bottom] around its visible
+    // pixels, inclusive, then runs over all tileSize^2 pixels: a header h
+    // below 128 is followed by h + 1 literal pixels, otherwise by one pixel
+    // repeated h - 126 times. encode() returns null for a transparent tile.
+    static Data encode(const std::uint8_t* rgba);
+    static bool decode(const std::uint8_t* data, std::size_t size, std::uint8_t* rgba);
+    static bool validate(const std::uint8_t* data, std::size_t size);
+
+private:
+    struct Tile
+    {
+        int level;
+        std::int32_t x, y;
+        Data data;
+    };
+
+    struct Resident
+    {
+        std::unique_ptr<sf::Texture> texture;
+        // The tile this texture was decoded from; stale once it is replaced.
+        Data source;
+        std::uint64_t lastUsed;
+    };
+
+    static std::uint64_t key(int level, std::int32_t x, std::int32_t y);
+    const sf::Texture* textureOf(std::uint64_t key, const Data& data) const;
+
+    float pixelsPerUnit;
+    std::size_t capacity;
+    std::unordered_map<std::uint64_t, Tile> tiles;
+    std::size_t encoded;
+
+    mutable std::unordered_map<std::uint64_t, Resident> resident;
+    mutable std::uint64_t clock;
+    mutable std::vector<std::uint8_t> pixels;
+    mutable std::vector<sf::Vertex> quad;
+};
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef RENDERSTATS_HPP
+#define RENDERSTATS_HPP
+
+#include <cstddef>
+
+// Per-frame counters filled in by every draw path we own. The frame loop
+// (or the benchmark) resets them before rendering and reads them after.
+namespace RenderStats
+{
+    struct Counters
+    {
+        std::size_t drawCalls = 0;
+        std::size_t vertices = 0;
+        std::size_t textureUploads = 0;
+    };
+
+    inline Counters& current()
+    {
+        static Counters counters;
+        return counters;
+    }
+
+    inline void reset()
+    {
+        current() = Counters();
+    }
+
+    inline void draw(std::size_t vertices)
+    {
+        current().drawCalls++;
+        current().vertices += vertices;
+    }
+
+    inline void upload()
+    {
+        current().textureUploads++;
+    }
+}
+
+#endif
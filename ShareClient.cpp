@@ -0,0 +1,104 @@
+#include "ShareClient.hpp"
+
+namespace
+{
+    const sf::Time connectTimeout = sf::seconds(5.f);
+    // How often a quiet connection checks whether it is being closed.
+    const sf::Time stopPoll = sf::milliseconds(100);
+    const std::size_t chunkSize = 64 * 1024;
+}
+
+ShareClient::ShareClient()
+    : connected(false), waiting(false), stopping(false)
+{
+}
+
+ShareClient::~ShareClient()
+{
+    disconnect();
+}
+
+bool ShareClient::connect(const std::string& host, unsigned short port, std::function<void()> wake,
+                          std::string& error)
+{
+    disconnect();
+    sf::IpAddress address(host);
+    if (address == sf::IpAddress::None)
+    {
+        error = "unknown host " + host;
+        return false;
+    }
+    if (socket.connect(address, port, connectTimeout) != sf::Socket::Done)
+    {
+        error = "could not connect to " + host + ":" + std::to_string(port);
+        return false;
+    }
+    notify = std::move(wake);
+    incoming.clear();
+    connected = true;
+    waiting = false;
+    stopping = false;
+    worker = std::thread(&ShareClient::run, this);
+    return true;
+}
+
+void ShareClient::disconnect()
+{
+    if (!worker.joinable()) return;
+    stopping = true;
+    worker.join();
+    socket.disconnect();
+    connected = false;
+    waiting = false;
+    incoming.clear();
+}
+
+bool ShareClient::isConnected() const
+{
+    return connected.load();
+}
+
+bool ShareClient::hasData() const
+{
+    return waiting.load();
+}
+
+void ShareClient::receive(ShareStream::Reader& reader)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        taken.swap(incoming);
+        waiting = false;
+    }
+    if (!taken.empty()) reader.feed(taken.data(), taken.size());
+    taken.clear();
+}
+
+void ShareClient::run()
+{
+    sf::SocketSelector selector;
+    selector.add(socket);
+    std::vector<std::uint8_t> chunk(chunkSize);
+    while (!stopping)
+    {
+        if (!selector.wait(stopPoll)) continue;
+        std::size_t received = 0;
+        sf::Socket::Status status = socket.receive(chunk.data(), chunk.size(), received);
+        if (status == sf::Socket::Done)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                incoming.insert(incoming.end(), chunk.begin(), chunk.begin() + received);
+                waiting = true;
+            }
+            if (notify) notify();
+        }
+        else if (status != sf::Socket::NotReady)
+        {
+            connected = false;
+            waiting = true;
+            if (notify) notify();
+            return;
+        }
+    }
+}
@@ -0,0 +1,55 @@
+#ifndef SHARECLIENT_HPP
+#define SHARECLIENT_HPP
+
+#include <SFML/Network.hpp>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "ShareStream.hpp"
+
+// Viewer side of live sharing. A background thread receives the stream as
+// it arrives and wakes the render thread, which takes whatever has come in
+// once per frame.
+class ShareClient
+{
+public:
+    ShareClient();
+    ~ShareClient();
+
+    ShareClient(const ShareClient&) = delete;
+    ShareClient& operator=(const ShareClient&) = delete;
+
+    // wake is called on the network thread whenever bytes arrive or the
+    // presenter goes away.
+    bool connect(const std::string& host, unsigned short port, std::function<void()> wake, std::string& error);
+    void disconnect();
+
+    // True from connect() until the presenter goes away.
+    bool isConnected() const;
+    // True while bytes wait to be taken, or until receive() has been
+    // called once after the presenter went away.
+    bool hasData() const;
+
+    // Hands everything received since the last call to reader. Whatever
+    // arrived is dropped by disconnect().
+    void receive(ShareStream::Reader& reader);
+
+private:
+    void run();
+
+    sf::TcpSocket socket;
+    std::function<void()> notify;
+    std::thread worker;
+    std::mutex mutex;
+    std::vector<std::uint8_t> incoming;
+    std::vector<std::uint8_t> taken;
+    std::atomic<bool> connected;
+    std::atomic<bool> waiting;
+    std::atomic<bool> stopping;
+};
+
+#endif
@@ -0,0 +1,190 @@
+#include "ShareServer.hpp"
+#include "ShareStream.hpp"
+#include <chrono>
+
+namespace
+{
+    // How often an idle server checks for viewers joining, and how soon it
+    // retries writing to viewers whose socket was full.
+    const auto acceptPoll = std::chrono::milliseconds(50);
+    const auto retry = std::chrono::milliseconds(2);
+    // A viewer this many bytes behind is dropped rather than buffered for.
+    const std::size_t maxBacklog = 64u << 20;
+}
+
+ShareServer::ShareServer()
+    : port(0), stopping(false), joined(0), served(0), connected(0), sent(0)
+{
+}
+
+ShareServer::~ShareServer()
+{
+    stop();
+}
+
+bool ShareServer::start(unsigned short requested, std::function<void()> wake)
+{
+    stop();
+    if (listener.listen(requested) != sf::Socket::Done) return false;
+    listener.setBlocking(false);
+    port = listener.getLocalPort();
+    notify = std::move(wake);
+    stopping = false;
+    joined = 0;
+    served = 0;
+    worker = std::thread(&ShareServer::run, this);
+    return true;
+}
+
+void ShareServer::stop()
+{
+    if (!worker.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    worker.join();
+    listener.close();
+    viewers.clear();
+    pending.clear();
+    connected = 0;
+    port = 0;
+}
+
+bool ShareServer::isRunning() const
+{
+    return worker.joinable();
+}
+
+unsigned short ShareServer::getPort() const
+{
+    return port;
+}
+
+bool ShareServer::hasJoiners() const
+{
+    return joined.load() != served;
+}
+
+std::size_t ShareServer::viewerCount() const
+{
+    return connected.load();
+}
+
+std::uint64_t ShareServer::bytesSent() const
+{
+    return sent.load();
+}
+
+void ShareServer::push(std::vector<std::uint8_t>& messages)
+{
+    queue(messages, Audience::Following);
+}
+
+void ShareServer::pushSnapshot(std::vector<std::uint8_t>& message, bool everyone)
+{
+    // Every viewer counted so far is already on the network thread's list,
+    // so it will be waiting when this batch gets there.
+    served = joined.load();
+    queue(message, everyone ? Audience::Everyone : Audience::Joining);
+}
+
+void ShareServer::queue(std::vector<std::uint8_t>& bytes, Audience audience)
+{
+    if (bytes.empty() || !isRunning()) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (audience == Audience::Following && !pending.empty() && pending.back().audience == audience)
+            pending.back().bytes.insert(pending.back().bytes.end(), bytes.begin(), bytes.end());
+        else
+            pending.push_back(Batch{std::move(bytes), audience});
+    }
+    bytes.clear();
+    wake.notify_one();
+}
+
+void ShareServer::run()
+{
+    bool backlogged = false;
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait_for(lock, backlogged ? retry : acceptPoll, [this] { return stopping || !pending.empty(); });
+            if (stopping) return;
+            sending.swap(pending);
+        }
+        acceptViewers();
+        for (const Batch& batch : sending) deliver(batch);
+        sending.clear();
+
+        backlogged = false;
+        for (std::size_t i = 0; i < viewers.size();)
+        {
+            if (!flush(viewers[i]))
+            {
+                viewers.erase(viewers.begin() + i);
+                continue;
+            }
+            if (!viewers[i].out.empty()) backlogged = true;
+            ++i;
+        }
+        connected = viewers.size();
+    }
+}
+
+void ShareServer::acceptViewers()
+{
+    bool any = false;
+    for (;;)
+    {
+        auto socket = std::make_unique<sf::TcpSocket>();
+        if (listener.accept(*socket) != sf::Socket::Done) break;
+        socket->setBlocking(false);
+        Viewer viewer{std::move(socket), {}, 0, false};
+        ShareStream::writeHeader(viewer.out);
+        viewers.push_back(std::move(viewer));
+        ++joined;
+        any = true;
+    }
+    connected = viewers.size();
+    if (any && notify) notify();
+}
+
+void ShareServer::deliver(const Batch& batch)
+{
+    for (Viewer& viewer : viewers)
+    {
+        bool wanted = batch.audience == Audience::Everyone ||
+                      (batch.audience == Audience::Following ? viewer.following : !viewer.following);
+        if (!wanted) continue;
+        viewer.out.insert(viewer.out.end(), batch.bytes.begin(), batch.bytes.end());
+        viewer.following = true;
+    }
+}
+
+bool ShareServer::flush(Viewer& viewer)
+{
+    while (viewer.sent < viewer.out.size())
+    {
+        std::size_t written = 0;
+        sf::Socket::Status status =
+            viewer.socket->send(viewer.out.data() + viewer.sent, viewer.out.size() - viewer.sent, written);
+        viewer.sent += written;
+        sent += written;
+        if (status == sf::Socket::Disconnected || status == sf::Socket::Error) return false;
+        if (status == sf::Socket::NotReady || (status == sf::Socket::Partial && written == 0)) break;
+    }
+    if (viewer.sent == viewer.out.size())
+    {
+        viewer.out.clear();
+        viewer.sent = 0;
+    }
+    else if (viewer.sent * 2 >= viewer.out.size())
+    {
+        viewer.out.erase(viewer.out.begin(), viewer.out.begin() + viewer.sent);
+        viewer.sent = 0;
+    }
+    return viewer.out.size() - viewer.sent <= maxBacklog;
+}
@@ -0,0 +1,101 @@
+#ifndef SHARESERVER_HPP
+#define SHARESERVER_HPP
+
+#include <SFML/Network.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Presenter side of live sharing: streams ShareStream messages to every
+// viewer connected over TCP. Accepting viewers and writing to them happen on
+// a background thread with non-blocking sockets, so the render thread only
+// hands over one batch per frame and a slow viewer holds up nobody else.
+//
+// A viewer that joins waits for a snapshot of the document, then follows
+// the batches queued after it. One that falls too far behind is dropped.
+class ShareServer
+{
+public:
+    ShareServer();
+    ~ShareServer();
+
+    ShareServer(const ShareServer&) = delete;
+    ShareServer& operator=(const ShareServer&) = delete;
+
+    // Listens on port, or any free port when it is zero. wake is called on
+    // the network thread when a viewer joins, so that an idle render thread
+    // gets round to sending it a snapshot.
+    bool start(unsigned short port, std::function<void()> wake);
+    void stop();
+    bool isRunning() const;
+    unsigned short getPort() const;
+
+    // True while a viewer has joined since the last snapshot was queued.
+    bool hasJoiners() const;
+    std::size_t viewerCount() const;
+    std::uint64_t bytesSent() const;
+
+    // Queues messages for the viewers following the stream and clears
+    // them. Never blocks on the network.
+    void push(std::vector<std::uint8_t>& messages);
+
+    // Queues a snapshot message for the viewers waiting for one, or for all
+    // of them; either way they follow the stream from there. Clears it.
+    void pushSnapshot(std::vector<std::uint8_t>& message, bool everyone);
+
+private:
+    enum class Audience
+    {
+        Following,
+        Joining,
+        Everyone
+    };
+
+    struct Batch
+    {
+        std::vector<std::uint8_t> bytes;
+        Audience audience;
+    };
+
+    struct Viewer
+    {
+        std::unique_ptr<sf::TcpSocket> socket;
+        std::vector<std::uint8_t> out;
+        std::size_t sent;
+        bool following;
+    };
+
+    void queue(std::vector<std::uint8_t>& bytes, Audience audience);
+    void run();
+    void acceptViewers();
+    void deliver(const Batch& batch);
+    // Writes what the socket takes without blocking. False once the viewer
+    // has gone or fallen too far behind.
+    bool flush(Viewer& viewer);
+
+    sf::TcpListener listener;
+    unsigned short port;
+    std::function<void()> notify;
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::vector<Batch> pending;
+    std::vector<Batch> sending;
+    bool stopping;
+
+    // Network thread only.
+    std::vector<Viewer> viewers;
+
+    std::atomic<std::uint32_t> joined;
+    // Viewers joined when the last snapshot was queued; render thread only.
+    std::uint32_t served;
+    std::atomic<std::size_t> connected;
+    std::atomic<std::uint64_t> sent;
+};
+
+#endif
@@ -0,0 +1,147 @@
+#include "ShareStream.hpp"
+#include "StrokeCodec.hpp"
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+    const char magic[8] = {'D', 'I', 'B', 'S', 'H', 'A', 'R', 'E'};
+    const std::size_t headerSize = 12;
+    const std::size_t messageHeaderSize = 5;
+
+    void putU32(std::vector<std::uint8_t>& out, std::uint32_t v)
+    {
+        for (int i = 0; i < 4; ++i) out.push_back((std::uint8_t)(v >> (i * 8)));
+    }
+
+    void putF32(std::vector<std::uint8_t>& out, float v)
+    {
+        std::uint32_t bits;
+        std::memcpy(&bits, &v, 4);
+        putU32(out, bits);
+    }
+
+    std::uint32_t getU32(const std::uint8_t* p)
+    {
+        return (std::uint32_t)p[0] | (std::uint32_t)p[1] << 8 | (std::uint32_t)p[2] << 16 | (std::uint32_t)p[3] << 24;
+    }
+
+    float getF32(const std::uint8_t* p)
+    {
+        std::uint32_t bits = getU32(p);
+        float v;
+        std::memcpy(&v, &bits, 4);
+        return v;
+    }
+}
+
+namespace ShareStream
+{
+    void writeHeader(std::vector<std::uint8_t>& out)
+    {
+        out.insert(out.end(), magic, magic + 8);
+        putU32(out, version);
+    }
+
+    void append(Message type, const std::uint8_t* data, std::size_t size, std::vector<std::uint8_t>& out)
+    {
+        out.push_back((std::uint8_t)type);
+        putU32(out, (std::uint32_t)size);
+        if (size > 0) out.insert(out.end(), data, data + size);
+    }
+
+    void appendStroke(std::uint32_t first, const Stroke::Sample* samples, std::size_t count,
+                      std::vector<std::uint8_t>& out)
+    {
+        out.push_back((std::uint8_t)Message::Stroke);
+        std::size_t length = out.size();
+        putU32(out, 0);
+        putU32(out, first);
+        StrokeCodec::encode(samples, count, out);
+        std::uint32_t size = (std::uint32_t)(out.size() - length - 4);
+        for (int i = 0; i < 4; ++i) out[length + i] = (std::uint8_t)(size >> (i * 8));
+    }
+
+    void appendView(const sf::Vector2f& center, const sf::Vector2f& size, std::vector<std::uint8_t>& out)
+    {
+        out.push_back((std::uint8_t)Message::View);
+        putU32(out, 16);
+        putF32(out, center.x);
+        putF32(out, center.y);
+        putF32(out, size.x);
+        putF32(out, size.y);
+    }
+
+    bool readStroke(const std::uint8_t* data, std::size_t size, std::uint32_t& first,
+                    std::vector<Stroke::Sample>& samples)
+    {
+        if (size < 4) return false;
+        first = getU32(data);
+        StrokeCodec::decode(data + 4, size - 4, samples);
+        return true;
+    }
+
+    bool readView(const std::uint8_t* data, std::size_t size, sf::Vector2f& center, sf::Vector2f& viewSize)
+    {
+        if (size != 16) return false;
+        center = sf::Vector2f(getF32(data), getF32(data + 4));
+        viewSize = sf::Vector2f(getF32(data + 8), getF32(data + 12));
+        return std::isfinite(center.x) && std::isfinite(center.y) && std::isfinite(viewSize.x) &&
+               std::isfinite(viewSize.y) && viewSize.x > 0.f && viewSize.y > 0.f;
+    }
+
+    Reader::Reader()
+        : offset(0), started(false), corrupt(false)
+    {
+    }
+
+    void Reader::feed(const std::uint8_t* data, std::size_t size)
+    {
+        // Consumed bytes are dropped once they are at least half the buffer,
+        // so a large snapshot arriving in pieces is not moved for each one.
+        if (offset > 0 && offset * 2 >= buffer.size())
+        {
+            buffer.erase(buffer.begin(), buffer.begin() + offset);
+            offset = 0;
+        }
+        buffer.insert(buffer.end(), data, data + size);
+    }
+
+    bool Reader::next(Message& type, const std::uint8_t*& data, std::uint32_t& size)
+    {
+        if (corrupt) return false;
+        std::size_t available = buffer.size() - offset;
+        if (!started)
+        {
+            if (available < headerSize) return false;
+            std::uint32_t streamVersion = getU32(buffer.data() + offset + 8);
+            if (std::memcmp(buffer.data() + offset, magic, 8) != 0 || streamVersion == 0 || streamVersion > version)
+            {
+                corrupt = true;
+                return false;
+            }
+            started = true;
+            offset += headerSize;
+            available -= headerSize;
+        }
+        if (available < messageHeaderSize) return false;
+        const std::uint8_t* p = buffer.data() + offset;
+        std::uint32_t length = getU32(p + 1);
+        if (p[0] < (std::uint8_t)Message::Snapshot || p[0] > (std::uint8_t)Message::View || length > maxMessage)
+        {
+            corrupt = true;
+            return false;
+        }
+        if (available - messageHeaderSize < length) return false;
+        type = (Message)p[0];
+        data = p + messageHeaderSize;
+        size = length;
+        offset += messageHeaderSize + length;
+        return true;
+    }
+
+    bool Reader::failed() const
+    {
+        return corrupt;
+    }
+}
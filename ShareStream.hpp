@@ -0,0 +1,70 @@
+#ifndef SHARESTREAM_HPP
+#define SHARESTREAM_HPP
+
+#include <cstdint>
+#include <vector>
+#include "Stroke.hpp"
+
+// Wire format of live sharing. A presenter sends each viewer the magic
+// "DIBSHARE" and a u32 version, then messages of [type:u8][length:u32]
+// [data], little-endian, written in one batch per frame:
+//
+//   Snapshot  a whole document file, sent to each viewer as it joins and
+//             to every viewer once flattening has renumbered the items
+//   Edits     journal records, exactly as autosave writes them
+//   Stroke    u32 first, then StrokeCodec samples replacing those of the
+//             stroke being drawn from index first on; none at all ends it
+//   View      the presenter's camera as f32 centre x, y and width, height
+//
+// Edits and strokes reuse the quantized, delta-encoded journal records, so
+// a busy frame costs tens of bytes. The stream has no checksums of its own
+// since TCP delivers it intact, but every record is still validated before
+// it is applied.
+namespace ShareStream
+{
+    enum class Message : std::uint8_t
+    {
+        Snapshot = 1,
+        Edits,
+        Stroke,
+        View
+    };
+
+    const std::uint32_t version = 1;
+    // Anything longer is taken for a corrupt stream rather than buffered.
+    const std::uint32_t maxMessage = 1u << 30;
+
+    void writeHeader(std::vector<std::uint8_t>& out);
+
+    void append(Message type, const std::uint8_t* data, std::size_t size, std::vector<std::uint8_t>& out);
+    void appendStroke(std::uint32_t first, const Stroke::Sample* samples, std::size_t count,
+                      std::vector<std::uint8_t>& out);
+    void appendView(const sf::Vector2f& center, const sf::Vector2f& size, std::vector<std::uint8_t>& out);
+
+    bool readStroke(const std::uint8_t* data, std::size_t size, std::uint32_t& first,
+                    std::vector<Stroke::Sample>& samples);
+    bool readView(const std::uint8_t* data, std::size_t size, sf::Vector2f& center, sf::Vector2f& viewSize);
+
+    // Splits the bytes of a stream, in whatever pieces they arrive, into
+    // whole messages.
+    class Reader
+    {
+    public:
+        Reader();
+
+        void feed(const std::uint8_t* data, std::size_t size);
+
+        // The next whole message, valid until the next feed(). False until
+        // one has arrived, and for good once the stream turns out corrupt.
+        bool next(Message& type, const std::uint8_t*& data, std::uint32_t& size);
+        bool failed() const;
+
+    private:
+        std::vector<std::uint8_t> buffer;
+        std::size_t offset;
+        bool started;
+        bool corrupt;
+    };
+}
+
+#endif
@@ -0,0 +1,207 @@
+#include "SpatialIndex.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    const int maxLevels = 24;
+    // Cells reach this many top level cells out from the origin; anything
+    // further shares the outermost ones and is told apart by its bounds.
+    // Keeps cell numbers within 32 bits and any one item in a few thousand
+    // cells, however far out or large it is.
+    const double reachCells = 32.0;
+}
+
+SpatialIndex::SpatialIndex(float cellSize)
+    : cellSize(cellSize), count(0)
+{
+}
+
+int SpatialIndex::levelFor(const sf::FloatRect& bounds) const
+{
+    float extent = std::max(bounds.width, bounds.height);
+    int level = 0;
+    while (level + 1 < maxLevels && cellSizeAt(level) < extent) ++level;
+    return level;
+}
+
+float SpatialIndex::cellSizeAt(int level) const
+{
+    return std::ldexp(cellSize, level);
+}
+
+std::uint64_t SpatialIndex::key(std::int32_t x, std::int32_t y)
+{
+    return ((std::uint64_t)(std::uint32_t)x << 32) | (std::uint32_t)y;
+}
+
+std::int32_t SpatialIndex::cellOf(float v, int level) const
+{
+    double cell = std::floor((double)v / cellSizeAt(level));
+    double reach = std::ldexp(reachCells, maxLevels - 1 - level);
+    // NaN fails both comparisons and lands in cell 0.
+    if (!(cell > -reach)) return (std::int32_t)(cell == cell ? -reach : 0.0);
+    return (std::int32_t)std::min(cell, reach);
+}
+
+void SpatialIndex::cellRange(const sf::FloatRect& area, int level, std::int32_t& x0, std::int32_t& y0,
+                             std::int32_t& x1, std::int32_t& y1) const
+{
+    x0 = cellOf(area.left, level);
+    y0 = cellOf(area.top, level);
+    x1 = cellOf(area.left + area.width, level);
+    y1 = cellOf(area.top + area.height, level);
+}
+
+void SpatialIndex::insert(std::uint32_t id, const sf::FloatRect& bounds)
+{
+    if (contains(id)) remove(id);
+    if (id >= entries.size()) entries.resize(id + 1, Entry{sf::FloatRect(), -1});
+
+    int level = levelFor(bounds);
+    if (level >= (int)levels.size()) levels.resize(level + 1);
+    entries[id] = Entry{bounds, level};
+    ++count;
+
+    std::int32_t x0, y0, x1, y1;
+    cellRange(bounds, level, x0, y0, x1, y1);
+    Grid& grid = levels[level];
+    for (std::int32_t y = y0; y <= y1; ++y)
+        for (std::int32_t x = x0; x <= x1; ++x)
+            grid[key(x, y)].push_back(id);
+}
+
+void SpatialIndex::remove(std::uint32_t id)
+{
+    if (!contains(id)) return;
+    Entry& entry = entries[id];
+
+    std::int32_t x0, y0, x1, y1;
+    cellRange(entry.bounds, entry.level, x0, y0, x1, y1);
+    Grid& grid = levels[entry.level];
+    for (std::int32_t y = y0; y <= y1; ++y)
+    {
+        for (std::int32_t x = x0; x <= x1; ++x)
+        {
+            auto cell = grid.find(key(x, y));
+            if (cell == grid.end()) continue;
+            auto& ids = cell->second;
+            auto it = std::find(ids.begin(), ids.end(), id);
+            if (it != ids.end())
+            {
+                *it = ids.back();
+                ids.pop_back();
+            }
+            if (ids.empty()) grid.erase(cell);
+        }
+    }
+    entry.level = -1;
+    --count;
+}
+
+void SpatialIndex::update(std::uint32_t id, const sf::FloatRect& bounds)
+{
+    remove(id);
+    insert(id, bounds);
+}
+
+void SpatialIndex::clear()
+{
+    levels.clear();
+    entries.clear();
+    count = 0;
+}
+
+bool SpatialIndex::contains(std::uint32_t id) const
+{
+    return id < entries.size() && entries[id].level >= 0;
+}
+
+const sf::FloatRect& SpatialIndex::getBounds(std::uint32_t id) const
+{
+    return entries[id].bounds;
+}
+
+std::size_t SpatialIndex::size() const
+{
+    return count;
+}
+
+std::size_t SpatialIndex::memoryUsage() const
+{
+    // Hash nodes are counted as a key, a vector and two pointers.
+    std::size_t bytes = entries.capacity() * sizeof(Entry) + levels.capacity() * sizeof(Grid);
+    for (const auto& grid : levels)
+    {
+        bytes += grid.bucket_count() * sizeof(void*);
+        for (const auto& cell : grid)
+            bytes += sizeof(cell) + 2 * sizeof(void*) + cell.second.capacity() * sizeof(std::uint32_t);
+    }
+    return bytes;
+}
+
+void SpatialIndex::queryPoint(const sf::Vector2f& point, std::vector<std::uint32_t>& out) const
+{
+    out.clear();
+    for (std::size_t level = 0; level < levels.size(); ++level)
+    {
+        const Grid& grid = levels[level];
+        if (grid.empty()) continue;
+        auto cell = grid.find(key(cellOf(point.x, (int)level), cellOf(point.y, (int)level)));
+        if (cell == grid.end()) continue;
+        for (std::uint32_t id : cell->second)
+        {
+            if (entries[id].bounds.contains(point)) out.push_back(id);
+        }
+    }
+    std::sort(out.begin(), out.end(), [](std::uint32_t a, std::uint32_t b) { return a > b; });
+}
+
+void SpatialIndex::queryRect(const sf::FloatRect& area, std::vector<std::uint32_t>& out, float minExtent,
+                             float maxExtent) const
+{
+    out.clear();
+    bool filtered = minExtent > 0.f || maxExtent < std::numeric_limits<float>::infinity();
+    for (std::size_t level = 0; level < levels.size(); ++level)
+    {
+        const Grid& grid = levels[level];
+        if (grid.empty()) continue;
+        // A level holds extents in (cellSizeAt(level - 1), cellSizeAt(level)].
+        if (cellSizeAt((int)level) < minExtent && (int)level + 1 < maxLevels) continue;
+        if (level > 0 && cellSizeAt((int)level - 1) >= maxExtent) break;
+
+        std::int32_t x0, y0, x1, y1;
+        cellRange(area, (int)level, x0, y0, x1, y1);
+        double cells = ((double)x1 - x0 + 1) * ((double)y1 - y0 + 1);
+        auto collect = [&](const std::vector<std::uint32_t>& ids) {
+            for (std::uint32_t id : ids)
+            {
+                const sf::FloatRect& bounds = entries[id].bounds;
+                if (!bounds.intersects(area)) continue;
+                if (filtered)
+                {
+                    float extent = std::max(bounds.width, bounds.height);
+                    if (extent < minExtent || extent >= maxExtent) continue;
+                }
+                out.push_back(id);
+            }
+        };
+        if (cells > (double)grid.size())
+        {
+            for (const auto& cell : grid) collect(cell.second);
+        }
+        else
+        {
+            for (std::int32_t y = y0; y <= y1; ++y)
+            {
+                for (std::int32_t x = x0; x <= x1; ++x)
+                {
+                    auto cell = grid.find(key(x, y));
+                    if (cell != grid.end()) collect(cell->second);
+                }
+            }
+        }
+    }
+    std::sort(out.begin(), out.end());
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+}
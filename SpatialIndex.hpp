@@ -0,0 +1,62 @@
+#ifndef SPATIALINDEX_HPP
+#define SPATIALINDEX_HPP
+
+#include <SFML/Graphics/Rect.hpp>
+#include <SFML/System/Vector2.hpp>
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+// Hierarchical uniform grid over item bounds. Ids double as z-order, so a
+// higher id is drawn on top. Each item lives on the level whose cell size
+// fits its bounds, which keeps it in at most four cells no matter how big
+// it is, and point queries touch a single cell per populated level.
+class SpatialIndex
+{
+public:
+    explicit SpatialIndex(float cellSize = 64.f);
+
+    void insert(std::uint32_t id, const sf::FloatRect& bounds);
+    void remove(std::uint32_t id);
+    void update(std::uint32_t id, const sf::FloatRect& bounds);
+    void clear();
+
+    bool contains(std::uint32_t id) const;
+    const sf::FloatRect& getBounds(std::uint32_t id) const;
+    std::size_t size() const;
+    // Approximate heap bytes held.
+    std::size_t memoryUsage() const;
+
+    // Ids whose bounds contain the point, topmost first.
+    void queryPoint(const sf::Vector2f& point, std::vector<std::uint32_t>& out) const;
+
+    // Ids whose bounds intersect the area, in ascending z-order. Only items
+    // whose larger side lies in [minExtent, maxExtent) are returned; levels
+    // that cannot hold such items are skipped without being visited.
+    void queryRect(const sf::FloatRect& area, std::vector<std::uint32_t>& out, float minExtent = 0.f,
+                   float maxExtent = std::numeric_limits<float>::infinity()) const;
+
+private:
+    struct Entry
+    {
+        sf::FloatRect bounds;
+        int level;
+    };
+    typedef std::unordered_map<std::uint64_t, std::vector<std::uint32_t>> Grid;
+
+    int levelFor(const sf::FloatRect& bounds) const;
+    float cellSizeAt(int level) const;
+    static std::uint64_t key(std::int32_t x, std::int32_t y);
+    // Cell holding coordinate v on a level, clamped to the reach of the grid.
+    std::int32_t cellOf(float v, int level) const;
+    void cellRange(const sf::FloatRect& area, int level, std::int32_t& x0, std::int32_t& y0,
+                   std::int32_t& x1, std::int32_t& y1) const;
+
+    float cellSize;
+    std::vector<Grid> levels;
+    std::vector<Entry> entries;
+    std::size_t count;
+};
+
+#endif
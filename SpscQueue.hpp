@@ -0,0 +1,76 @@
+#ifndef SPSCQUEUE_HPP
+#define SPSCQUEUE_HPP
+
+#include <atomic>
+#include <cstddef>
+
+// Fixed-size ring buffer for exactly one producer thread and one consumer
+// thread. Neither side locks or allocates: each owns one index and only
+// reads the other's, with one release/acquire pair per element. Each side
+// also caches the other's index, so the shared cache line is only read
+// when the queue looks full or empty.
+template <typename T, std::size_t Capacity>
+class SpscQueue
+{
+    static_assert(Capacity && (Capacity & (Capacity - 1)) == 0, "capacity must be a power of two");
+
+public:
+    SpscQueue() : head(0), tailCache(0), tail(0), headCache(0) {}
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    // Producer only. Returns false when the queue is full.
+    bool push(const T& value)
+    {
+        std::size_t t = tail.load(std::memory_order_relaxed);
+        if (t - headCache == Capacity)
+        {
+            headCache = head.load(std::memory_order_acquire);
+            if (t - headCache == Capacity) return false;
+        }
+        slots[t & (Capacity - 1)] = value;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer only. Returns false when the queue is empty.
+    bool pop(T& value)
+    {
+        std::size_t h = head.load(std::memory_order_relaxed);
+        if (h == tailCache)
+        {
+            tailCache = tail.load(std::memory_order_acquire);
+            if (h == tailCache) return false;
+        }
+        value = slots[h & (Capacity - 1)];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Either side; exact only when the other side is idle.
+    std::size_t size() const
+    {
+        return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+    }
+
+    bool empty() const
+    {
+        return size() == 0;
+    }
+
+    static constexpr std::size_t capacity()
+    {
+        return Capacity;
+    }
+
+private:
+    // Consumer-owned and producer-owned indices on separate cache lines.
+    alignas(64) std::atomic<std::size_t> head;
+    std::size_t tailCache;
+    alignas(64) std::atomic<std::size_t> tail;
+    std::size_t headCache;
+    alignas(64) T slots[Capacity];
+};
+
+#endif
@@ -0,0 +1,458 @@
+#include "Stroke.hpp"
+#include "RenderStats.hpp"
+#include <algorithm>
+#include <cmath>
+#include <memory>
+
+namespace
+{
+    const float pi = 3.14159265f;
+    // Round parts stay within this many pixels of a true circle, and a bend
+    // is mitred while its mitre would stick out no further than this past
+    // the round join that replaces it.
+    const float roundness = 0.25f;
+    const std::size_t maxArcSteps = 32;
+
+    // The fringe texture holds one alpha profile across the stroke per row,
+    // each for a stroke rowWidth(row) pixels wide fringe included, so that
+    // the edges fade over one pixel whatever the width.
+    const unsigned profileWidth = 512;
+    const unsigned profileRows = 64;
+
+    float rowWidth(float row)
+    {
+        return 2.f + row * row / 8.f;
+    }
+
+    // Across the fringe texture: the left edge, the middle and the right edge.
+    const float leftEdge = 0.f;
+    const float middle = profileWidth * 0.5f;
+    const float rightEdge = (float)profileWidth;
+
+    struct Style
+    {
+        float pixel;
+        bool feather;
+    };
+
+    // Where the outline passes one sample. Offsets are for a unit radius, so
+    // the edge lies at position + offset * radius. The in offsets end the
+    // segment arriving at the sample and the out offsets start the one
+    // leaving it. They differ on the outer side of a round join, which an
+    // arc of sweep radians fills in between, and on its inner side when the
+    // segments overlap there rather than meet.
+    struct Section
+    {
+        sf::Vector2f position;
+        sf::Vector2f inLeft, inRight, outLeft, outRight;
+        float radius;
+        sf::Color color;
+        // Row of the fringe texture for this width.
+        float row;
+        // +1 for a round join on the left, -1 on the right, 0 when mitred.
+        int round;
+        float sweep;
+    };
+
+    float length(const sf::Vector2f& v)
+    {
+        return std::sqrt(v.x * v.x + v.y * v.y);
+    }
+
+    float dot(const sf::Vector2f& a, const sf::Vector2f& b)
+    {
+        return a.x * b.x + a.y * b.y;
+    }
+
+    float cross(const sf::Vector2f& a, const sf::Vector2f& b)
+    {
+        return a.x * b.y - a.y * b.x;
+    }
+
+    // Left-hand normal of the segment from samples[i] to samples[i + 1].
+    // Repeated points have none, so the nearest segment that does stands in.
+    sf::Vector2f normal(const Stroke::Sample* samples, std::size_t count, std::size_t i)
+    {
+        for (std::size_t j = i; j + 1 < count; ++j)
+        {
+            sf::Vector2f d = samples[j + 1].position - samples[j].position;
+            float l = length(d);
+            if (l > 0.f) return sf::Vector2f(-d.y / l, d.x / l);
+        }
+        for (std::size_t j = std::min(i, count - 1); j-- > 0;)
+        {
+            sf::Vector2f d = samples[j + 1].position - samples[j].position;
+            float l = length(d);
+            if (l > 0.f) return sf::Vector2f(-d.y / l, d.x / l);
+        }
+        return sf::Vector2f(0.f, 1.f);
+    }
+
+    Section section(const Stroke::Sample* samples, std::size_t count, std::size_t i, const Style& style)
+    {
+        const Stroke::Sample& sample = samples[i];
+        Section s;
+        s.position = sample.position;
+        s.color = sample.color;
+        s.radius = sample.width * 0.5f;
+        s.row = 0.f;
+        s.round = 0;
+        s.sweep = 0.f;
+        if (style.feather)
+        {
+            // The fringe straddles the edge. A stroke thinner than a pixel
+            // fades instead of narrowing further, keeping its coverage.
+            float pixels = sample.width / style.pixel;
+            if (pixels < 1.f) s.color.a = (sf::Uint8)(s.color.a * pixels);
+            pixels = std::max(pixels, 1.f) + 1.f;
+            s.radius = pixels * 0.5f * style.pixel;
+            s.row = std::min(std::sqrt((pixels - 2.f) * 8.f), profileRows - 1.f) + 0.5f;
+        }
+
+        sf::Vector2f in = normal(samples, count, i > 0 ? i - 1 : 0);
+        sf::Vector2f out = i + 1 < count ? normal(samples, count, i) : in;
+        sf::Vector2f sum = in + out;
+        float cosHalf = length(sum) * 0.5f;
+        if (s.radius * (1.f / std::max(cosHalf, 1e-6f) - 1.f) <= roundness * style.pixel)
+        {
+            sf::Vector2f miter = sum / (cosHalf * 2.f) / cosHalf;
+            s.inLeft = s.outLeft = miter;
+            s.inRight = s.outRight = -miter;
+            return s;
+        }
+
+        // Round on the outer side of the bend. On the inner side the edges
+        // meet where they cross, if that is within both segments; past that
+        // the segments simply overlap.
+        float turn = cross(in, out);
+        s.round = turn > 0.f ? -1 : 1;
+        float side = (float)s.round;
+        sf::Vector2f innerIn = in * -side, innerOut = out * -side;
+        if (cosHalf > 1e-4f)
+        {
+            s.sweep = std::atan2(turn, dot(in, out));
+            float back = s.radius * std::sqrt(std::max(0.f, 1.f - cosHalf * cosHalf)) / cosHalf;
+            float reach = std::min(length(sample.position - samples[i - 1].position),
+                                   length(samples[i + 1].position - sample.position));
+            if (back <= reach) innerIn = innerOut = sum / (cosHalf * 2.f) * (-side / cosHalf);
+        }
+        else
+        {
+            // Doubling straight back: a half turn round the front.
+            s.sweep = -side * pi;
+        }
+        if (s.round > 0)
+        {
+            s.inLeft = in;
+            s.outLeft = out;
+            s.inRight = innerIn;
+            s.outRight = innerOut;
+        }
+        else
+        {
+            s.inRight = -in;
+            s.outRight = -out;
+            s.inLeft = innerIn;
+            s.outLeft = innerOut;
+        }
+        return s;
+    }
+
+    // Divisions that keep an arc of the given angle within roundness pixels
+    // of a circle.
+    std::size_t arcSteps(float angle, float radius, float pixel)
+    {
+        float tolerance = roundness * pixel;
+        if (radius <= tolerance) return 1;
+        float step = 2.f * std::acos(1.f - tolerance / radius);
+        std::size_t steps = (std::size_t)std::ceil(std::fabs(angle) / step);
+        return std::max<std::size_t>(1, std::min(maxArcSteps, steps));
+    }
+
+    // Takes the outline as one triangle strip and writes it out as such, or
+    // as a triangle list without the degenerate triangles that stitch the
+    // strip together.
+    class Emitter
+    {
+    public:
+        Emitter(std::vector<sf::Vertex>& out, bool list)
+            : out(out), list(list), count(0)
+        {
+        }
+
+        void operator()(const Section& s, const sf::Vector2f& offset, float across)
+        {
+            sf::Vertex v(s.position + offset * s.radius, s.color, sf::Vector2f(across, s.row));
+            if (!list)
+            {
+                out.push_back(v);
+                return;
+            }
+            if (count >= 2)
+            {
+                sf::Vector2f ab = b.position - a.position, av = v.position - a.position;
+                if (std::fabs(cross(ab, av)) > 1e-5f * (dot(ab, ab) + dot(av, av)))
+                {
+                    out.push_back(a);
+                    out.push_back(b);
+                    out.push_back(v);
+                }
+            }
+            a = b;
+            b = v;
+            ++count;
+        }
+
+    private:
+        std::vector<sf::Vertex>& out;
+        bool list;
+        std::size_t count;
+        sf::Vertex a, b;
+    };
+
+    // Fans round the pivot offset from the strip's last point, at the unit
+    // offset from, turning sweep radians.
+    void fan(Emitter& put, const Section& s, const sf::Vector2f& pivot, float pivotAcross, sf::Vector2f from,
+             float sweep, float across, const Style& style)
+    {
+        std::size_t steps = arcSteps(sweep, s.radius, style.pixel);
+        float step = sweep / steps, c = std::cos(step), n = std::sin(step);
+        for (std::size_t k = 0; k < steps; ++k)
+        {
+            from = sf::Vector2f(from.x * c - from.y * n, from.x * n + from.y * c);
+            put(s, pivot, pivotAcross);
+            put(s, from, across);
+        }
+    }
+
+    // A round join, arriving on the in edges and leaving on the out edges.
+    // The arc fans round the sample, which also fills in the corners next to
+    // the point where the inner edges meet.
+    void join(Emitter& put, const Section& s, const Style& style)
+    {
+        sf::Vector2f centre(0.f, 0.f);
+        if (s.round > 0)
+        {
+            put(s, s.inLeft, leftEdge);
+            fan(put, s, centre, middle, s.inLeft, s.sweep, leftEdge, style);
+            put(s, s.outRight, rightEdge);
+        }
+        else
+        {
+            fan(put, s, centre, middle, s.inRight, s.sweep, rightEdge, style);
+            put(s, s.outLeft, leftEdge);
+            put(s, s.outRight, rightEdge);
+        }
+    }
+
+    // The start cap, or the whole dot for a single sample. Leaves the strip
+    // on the first sample's out edges.
+    void begin(Emitter& put, const Stroke::Sample* samples, std::size_t count, const Style& style)
+    {
+        Section s = section(samples, count, 0, style);
+        sf::Vector2f centre(0.f, 0.f);
+        if (count == 1)
+        {
+            put(s, sf::Vector2f(0.f, 1.f), leftEdge);
+            fan(put, s, centre, middle, sf::Vector2f(0.f, 1.f), 2.f * pi, leftEdge, style);
+            return;
+        }
+        put(s, s.outRight, rightEdge);
+        fan(put, s, centre, middle, s.outRight, -pi, leftEdge, style);
+        put(s, s.outRight, rightEdge);
+    }
+
+    // Everything after samples[first]: the segments and joins that follow
+    // it and the end cap. marks gets the size of out after each join.
+    void segments(Emitter& put, const Stroke::Sample* samples, std::size_t count, std::size_t first,
+                  const Style& style, const std::vector<sf::Vertex>& out, std::vector<std::size_t>* marks)
+    {
+        for (std::size_t i = first + 1; i < count; ++i)
+        {
+            Section s = section(samples, count, i, style);
+            put(s, s.inLeft, leftEdge);
+            put(s, s.inRight, rightEdge);
+            if (i + 1 == count)
+            {
+                fan(put, s, sf::Vector2f(0.f, 0.f), middle, s.inRight, pi, leftEdge, style);
+                break;
+            }
+            if (s.round) join(put, s, style);
+            if (marks) marks->push_back(out.size());
+        }
+    }
+
+    // Points strictly inside an arc round centre, from the unit offset from.
+    void arc(const sf::Vector2f& centre, sf::Vector2f from, float sweep, float radius, float pixel,
+             std::vector<sf::Vector2f>& out)
+    {
+        std::size_t steps = arcSteps(sweep, radius, pixel);
+        float step = sweep / steps, c = std::cos(step), n = std::sin(step);
+        for (std::size_t k = 1; k < steps; ++k)
+        {
+            from = sf::Vector2f(from.x * c - from.y * n, from.x * n + from.y * c);
+            out.push_back(centre + from * radius);
+        }
+    }
+}
+
+Stroke::Stroke()
+    : pixel(1.f)
+{
+}
+
+void Stroke::setPixelSize(float size)
+{
+    pixel = size;
+}
+
+void Stroke::addPoint(const sf::Vector2f& position, float width, sf::Color color)
+{
+    if (!samples.empty() && samples.back().position == position) return;
+
+    samples.push_back({position, width, color});
+    Style style{pixel, true};
+    Emitter strip(vertices, false);
+    std::size_t count = samples.size();
+    if (count < 3)
+    {
+        vertices.clear();
+        marks.clear();
+        begin(strip, samples.data(), count, style);
+        marks.push_back(vertices.size());
+        segments(strip, samples.data(), count, 0, style, vertices, &marks);
+        return;
+    }
+    // A new sample moves the end cap and reshapes the join before it, so
+    // the strip is rewritten from the join before that.
+    vertices.resize(marks[count - 3]);
+    marks.resize(count - 2);
+    segments(strip, samples.data(), count, count - 3, style, vertices, &marks);
+}
+
+void Stroke::clear()
+{
+    samples.clear();
+    vertices.clear();
+    marks.clear();
+}
+
+void Stroke::appendTriangles(const Sample* samples, std::size_t count, float pixel, bool feather,
+                             std::vector<sf::Vertex>& out)
+{
+    if (count == 0) return;
+    Style style{pixel, feather};
+    Emitter list(out, true);
+    begin(list, samples, count, style);
+    segments(list, samples, count, 0, style, out, nullptr);
+}
+
+void Stroke::appendOutline(const Sample* samples, std::size_t count, float pixel, std::vector<sf::Vector2f>& out)
+{
+    if (count == 0) return;
+    Style style{pixel, false};
+    if (count == 1)
+    {
+        Section s = section(samples, count, 0, style);
+        out.push_back(s.position + sf::Vector2f(0.f, s.radius));
+        arc(s.position, sf::Vector2f(0.f, 1.f), 2.f * pi, s.radius, pixel, out);
+        return;
+    }
+
+    std::vector<Section> sections(count);
+    for (std::size_t i = 0; i < count; ++i) sections[i] = section(samples, count, i, style);
+
+    // Down the left side, round the end, back up the right and round the
+    // start. Where overlapping segments leave the inner side, it goes via
+    // the sample.
+    for (const Section& s : sections)
+    {
+        out.push_back(s.position + s.inLeft * s.radius);
+        if (s.round > 0) arc(s.position, s.inLeft, s.sweep, s.radius, pixel, out);
+        else if (s.inLeft != s.outLeft) out.push_back(s.position);
+        if (s.inLeft != s.outLeft) out.push_back(s.position + s.outLeft * s.radius);
+    }
+    const Section& last = sections.back();
+    arc(last.position, last.inLeft, -pi, last.radius, pixel, out);
+    for (std::size_t i = count; i-- > 0;)
+    {
+        const Section& s = sections[i];
+        if (s.inRight != s.outRight) out.push_back(s.position + s.outRight * s.radius);
+        if (s.round < 0) arc(s.position, s.outRight, -s.sweep, s.radius, pixel, out);
+        else if (s.inRight != s.outRight) out.push_back(s.position);
+        out.push_back(s.position + s.inRight * s.radius);
+    }
+    const Section& first = sections.front();
+    arc(first.position, first.outRight, -pi, first.radius, pixel, out);
+}
+
+sf::FloatRect Stroke::bounds(const Sample* samples, std::size_t count)
+{
+    if (count == 0) return sf::FloatRect();
+    float left = samples[0].position.x, top = samples[0].position.y;
+    float right = left, bottom = top;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        const Sample& s = samples[i];
+        float half = s.width * 0.5f;
+        left = std::min(left, s.position.x - half);
+        top = std::min(top, s.position.y - half);
+        right = std::max(right, s.position.x + half);
+        bottom = std::max(bottom, s.position.y + half);
+    }
+    return sf::FloatRect(left, top, right - left, bottom - top);
+}
+
+const sf::Texture& Stroke::getTexture()
+{
+    static std::unique_ptr<sf::Texture> texture;
+    if (!texture)
+    {
+        // White, so the vertex colour tints it.
+        std::vector<sf::Uint8> rgba(profileWidth * profileRows * 4, 255);
+        for (unsigned row = 0; row < profileRows; ++row)
+        {
+            float width = rowWidth((float)row);
+            for (unsigned column = 0; column < profileWidth; ++column)
+            {
+                float x = (column + 0.5f) / profileWidth * width;
+                float alpha = std::max(0.f, std::min(1.f, std::min(x, width - x)));
+                rgba[(row * profileWidth + column) * 4 + 3] = (sf::Uint8)std::lround(alpha * 255.f);
+            }
+        }
+        texture = std::make_unique<sf::Texture>();
+        texture->create(profileWidth, profileRows);
+        texture->update(rgba.data());
+        texture->setSmooth(true);
+        RenderStats::upload();
+    }
+    return *texture;
+}
+
+std::size_t Stroke::getPointCount() const
+{
+    return samples.size();
+}
+
+std::size_t Stroke::getVertexCount() const
+{
+    return vertices.size();
+}
+
+sf::FloatRect Stroke::getBounds() const
+{
+    return bounds(samples.data(), samples.size());
+}
+
+const std::vector<Stroke::Sample>& Stroke::getSamples() const
+{
+    return samples;
+}
+
+void Stroke::draw(sf::RenderTarget& target, sf::RenderStates states) const
+{
+    if (samples.size() < 2) return;
+    states.texture = &getTexture();
+    target.draw(vertices.data(), vertices.size(), sf::TriangleStrip, states);
+    RenderStats::draw(vertices.size());
+}
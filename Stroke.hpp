@@ -0,0 +1,68 @@
+#ifndef STROKE_HPP
+#define STROKE_HPP
+
+#include <SFML/Graphics.hpp>
+#include <vector>
+
+// A freehand stroke tessellated as one continuous outline. Bends are mitred
+// while the mitre stays within a fraction of a pixel of round and rounded
+// beyond that, and both ends get round caps. The edges fade out over one
+// pixel through an alpha profile texture, so the stroke is anti-aliased
+// without multisampling and still costs two vertices per sample.
+class Stroke : public sf::Drawable
+{
+public:
+    struct Sample
+    {
+        sf::Vector2f position;
+        float width;
+        sf::Color color;
+    };
+
+    Stroke();
+
+    // Size of one screen pixel in stroke units, which sets the fringe width
+    // and how finely caps and round joins are divided. Kept by clear().
+    void setPixelSize(float size);
+
+    // Appends a sample and retessellates the end of the stroke it changes;
+    // identical points are ignored.
+    void addPoint(const sf::Vector2f& position, float width, sf::Color color);
+    void clear();
+
+    std::size_t getPointCount() const;
+    std::size_t getVertexCount() const;
+    sf::FloatRect getBounds() const;
+    const std::vector<Sample>& getSamples() const;
+
+    // Appends the outline of samples to out as a triangle list, for batching
+    // with other items; drawn feathered it needs getTexture(). Without
+    // feather the edges are left hard, for rasterizers that compute coverage
+    // themselves.
+    static void appendTriangles(const Sample* samples, std::size_t count, float pixel, bool feather,
+                                std::vector<sf::Vertex>& out);
+
+    // Appends the outline as one closed polygon, winding the same way all
+    // round.
+    static void appendOutline(const Sample* samples, std::size_t count, float pixel, std::vector<sf::Vector2f>& out);
+
+    // Area the outline can cover, fringe aside.
+    static sf::FloatRect bounds(const Sample* samples, std::size_t count);
+
+    // Alpha profiles that fade feathered strokes out at their edges, tinted
+    // by the vertex colour.
+    static const sf::Texture& getTexture();
+
+private:
+    void draw(sf::RenderTarget& target, sf::RenderStates states) const override;
+
+    std::vector<Sample> samples;
+    // One triangle strip.
+    std::vector<sf::Vertex> vertices;
+    // vertices.size() once the outline up to and including the join at each
+    // sample is written; what follows changes as points are added.
+    std::vector<std::size_t> marks;
+    float pixel;
+};
+
+#endif
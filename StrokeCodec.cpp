@@ -0,0 +1,215 @@
+#include "StrokeCodec.hpp"
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace
+{
+    // Deviations in width (pixels) and colour (per channel) that are still
+    // invisible on a committed stroke.
+    const float widthTolerance = 0.25f;
+    const float colorTolerance = 8.f;
+    // Quantized positions are clamped to this magnitude (2^57 pixels), so
+    // the delta between any two and its zigzag code with the style bit
+    // always fit in 64 bits. NaN is stored as 0.
+    const double quantizedLimit = 1152921504606846976.0;
+
+    std::int64_t quantize(float v, float scale)
+    {
+        double q = std::round((double)v * scale);
+        if (!(q == q)) return 0;
+        return (std::int64_t)std::max(-quantizedLimit, std::min(quantizedLimit, q));
+    }
+
+    void putVarint(std::vector<std::uint8_t>& out, std::uint64_t v)
+    {
+        while (v >= 0x80)
+        {
+            out.push_back((std::uint8_t)(v | 0x80));
+            v >>= 7;
+        }
+        out.push_back((std::uint8_t)v);
+    }
+
+    std::uint64_t getVarint(const std::uint8_t*& p, const std::uint8_t* end)
+    {
+        std::uint64_t v = 0;
+        for (int shift = 0; p < end && shift < 70; shift += 7)
+        {
+            std::uint8_t b = *p++;
+            v |= (std::uint64_t)(b & 0x7f) << shift;
+            if (!(b & 0x80)) break;
+        }
+        return v;
+    }
+
+    std::uint64_t zigzag(std::int64_t v)
+    {
+        return ((std::uint64_t)v << 1) ^ (std::uint64_t)(v >> 63);
+    }
+
+    std::int64_t unzigzag(std::uint64_t v)
+    {
+        return (std::int64_t)(v >> 1) ^ -(std::int64_t)(v & 1);
+    }
+
+    float channelError(sf::Uint8 a, sf::Uint8 b, sf::Uint8 c, float t)
+    {
+        return std::fabs(c - (a + (b - a) * t));
+    }
+
+    // Deviation of s from the segment a-b, scaled so that 1 is the largest
+    // acceptable error in whichever of position, width or colour is worst.
+    float deviation(const Stroke::Sample& a, const Stroke::Sample& b, const Stroke::Sample& s, float tolerance)
+    {
+        sf::Vector2f ab = b.position - a.position, as = s.position - a.position;
+        float length2 = ab.x * ab.x + ab.y * ab.y;
+        float t = length2 > 0.f ? std::min(1.f, std::max(0.f, (as.x * ab.x + as.y * ab.y) / length2)) : 0.f;
+        sf::Vector2f d = as - ab * t;
+
+        float error = std::sqrt(d.x * d.x + d.y * d.y) / tolerance;
+        error = std::max(error, std::fabs(s.width - (a.width + (b.width - a.width) * t)) / widthTolerance);
+        float color = std::max(std::max(channelError(a.color.r, b.color.r, s.color.r, t),
+                                        channelError(a.color.g, b.color.g, s.color.g, t)),
+                               std::max(channelError(a.color.b, b.color.b, s.color.b, t),
+                                        channelError(a.color.a, b.color.a, s.color.a, t)));
+        return std::max(error, color / colorTolerance);
+    }
+}
+
+namespace StrokeCodec
+{
+    void simplify(const Stroke::Sample* samples, std::size_t count, float tolerance,
+                  std::vector<Stroke::Sample>& out)
+    {
+        out.clear();
+        if (count < 3 || tolerance <= 0.f)
+        {
+            out.assign(samples, samples + count);
+            return;
+        }
+
+        std::vector<std::uint8_t> keep(count, 0);
+        keep[0] = keep[count - 1] = 1;
+
+        // Explicit stack of open ranges, so long strokes cannot overflow the call stack.
+        std::vector<std::pair<std::size_t, std::size_t>> ranges;
+        ranges.push_back({0, count - 1});
+        while (!ranges.empty())
+        {
+            std::size_t a = ranges.back().first, b = ranges.back().second;
+            ranges.pop_back();
+
+            float worst = 1.f;
+            std::size_t split = 0;
+            for (std::size_t i = a + 1; i < b; ++i)
+            {
+                float e = deviation(samples[a], samples[b], samples[i], tolerance);
+                if (e > worst)
+                {
+                    worst = e;
+                    split = i;
+                }
+            }
+            if (split)
+            {
+                keep[split] = 1;
+                if (split - a > 1) ranges.push_back({a, split});
+                if (b - split > 1) ranges.push_back({split, b});
+            }
+        }
+
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            if (keep[i]) out.push_back(samples[i]);
+        }
+    }
+
+    // Per sample: varint(zigzag(dx) << 1 | styled), varint(zigzag(dy)), and
+    // when styled, varint(width) followed by four colour bytes. Deltas are
+    // taken between quantized absolute positions, so rounding never drifts.
+    // Varints and deltas are 64-bit, so strokes anywhere on the canvas keep
+    // their place; values that fit 32 bits encode as they always have.
+    void encode(const Stroke::Sample* samples, std::size_t count, std::vector<std::uint8_t>& out)
+    {
+        std::int64_t x = 0, y = 0;
+        float width = -1.f;
+        sf::Color color = sf::Color::Transparent;
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            const Stroke::Sample& s = samples[i];
+            std::int64_t qx = quantize(s.position.x, positionScale), qy = quantize(s.position.y, positionScale);
+            bool styled = i == 0 || s.width != width || s.color != color;
+
+            putVarint(out, zigzag(qx - x) << 1 | (styled ? 1u : 0u));
+            putVarint(out, zigzag(qy - y));
+            if (styled)
+            {
+                putVarint(out, (std::uint64_t)std::max<std::int64_t>(0, quantize(s.width, positionScale)));
+                out.push_back(s.color.r);
+                out.push_back(s.color.g);
+                out.push_back(s.color.b);
+                out.push_back(s.color.a);
+                width = s.width;
+                color = s.color;
+            }
+            x = qx;
+            y = qy;
+        }
+    }
+
+    void decode(const std::uint8_t* data, std::size_t size, std::vector<Stroke::Sample>& out)
+    {
+        out.clear();
+        const std::uint8_t* p = data;
+        const std::uint8_t* end = data + size;
+        std::int64_t x = 0, y = 0;
+        Stroke::Sample s{sf::Vector2f(0.f, 0.f), 0.f, sf::Color::Transparent};
+        while (p < end)
+        {
+            std::uint64_t head = getVarint(p, end);
+            x = (std::int64_t)((std::uint64_t)x + (std::uint64_t)unzigzag(head >> 1));
+            y = (std::int64_t)((std::uint64_t)y + (std::uint64_t)unzigzag(getVarint(p, end)));
+            if (head & 1)
+            {
+                s.width = getVarint(p, end) / positionScale;
+                if (end - p < 4) break;
+                s.color = sf::Color(p[0], p[1], p[2], p[3]);
+                p += 4;
+            }
+            s.position = sf::Vector2f((float)(x / (double)positionScale), (float)(y / (double)positionScale));
+            out.push_back(s);
+        }
+    }
+
+    std::size_t count(const std::uint8_t* data, std::size_t size)
+    {
+        const std::uint8_t* p = data;
+        const std::uint8_t* end = data + size;
+        std::size_t samples = 0;
+        while (p < end)
+        {
+            std::uint64_t head = getVarint(p, end);
+            getVarint(p, end);
+            if (head & 1)
+            {
+                getVarint(p, end);
+                if (end - p < 4) break;
+                p += 4;
+            }
+            ++samples;
+        }
+        return samples;
+    }
+
+    sf::Color firstColor(const std::uint8_t* data, std::size_t size)
+    {
+        const std::uint8_t* p = data;
+        const std::uint8_t* end = data + size;
+        getVarint(p, end);
+        getVarint(p, end);
+        getVarint(p, end);
+        if (end - p < 4) return sf::Color::Transparent;
+        return sf::Color(p[0], p[1], p[2], p[3]);
+    }
+}
@@ -0,0 +1,34 @@
+#ifndef STROKECODEC_HPP
+#define STROKECODEC_HPP
+
+#include <cstdint>
+#include <vector>
+#include "Stroke.hpp"
+
+namespace StrokeCodec
+{
+    // Positions are stored in fixed point with this many steps per pixel.
+    const float positionScale = 8.f;
+
+    // Drops samples that lie within tolerance pixels of the polyline through
+    // their neighbours (Ramer-Douglas-Peucker). A sample whose width or
+    // colour differs noticeably from what interpolation would give is kept
+    // too, so rainbow and pressure-like variation survives.
+    void simplify(const Stroke::Sample* samples, std::size_t count, float tolerance,
+                  std::vector<Stroke::Sample>& out);
+
+    // Appends samples to out as quantized, delta-encoded varints. Width and
+    // colour are only written when they change from the previous sample.
+    void encode(const Stroke::Sample* samples, std::size_t count, std::vector<std::uint8_t>& out);
+
+    // Replaces out with the samples stored in data.
+    void decode(const std::uint8_t* data, std::size_t size, std::vector<Stroke::Sample>& out);
+
+    // Number of samples decode() would produce, without producing them.
+    std::size_t count(const std::uint8_t* data, std::size_t size);
+
+    // Colour of the first sample, without decoding the rest.
+    sf::Color firstColor(const std::uint8_t* data, std::size_t size);
+}
+
+#endif
@@ -0,0 +1,210 @@
+#include "StrokeSampler.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    // Only the last few samples are needed for the curve and the velocity estimate.
+    const std::size_t historySize = 8;
+    const std::size_t maxSubdivisions = 32;
+
+    // Samples closer together than this are polled in one batch rather than
+    // measured apart, so velocity is taken over at least this much time.
+    const float minVelocityWindow = 0.008f;
+    // Prediction is dropped once the pointer has rested this long, and never
+    // reaches further ahead than maxLead seconds or maxLeadDistance pixels.
+    const float staleAfter = 0.05f;
+    const float maxLead = 0.05f;
+    const float maxLeadDistance = 48.f;
+
+    float distance(const sf::Vector2f& a, const sf::Vector2f& b)
+    {
+        sf::Vector2f d = b - a;
+        return std::sqrt(d.x * d.x + d.y * d.y);
+    }
+
+    sf::Vector2f lerp(const sf::Vector2f& a, const sf::Vector2f& b, float ta, float tb, float t)
+    {
+        float span = tb - ta;
+        return a * ((tb - t) / span) + b * ((t - ta) / span);
+    }
+
+    // Knot spacing for centripetal parameterisation: the square root of the chord.
+    float knot(const sf::Vector2f& a, const sf::Vector2f& b)
+    {
+        return std::max(std::sqrt(distance(a, b)), 1e-3f);
+    }
+}
+
+StrokeSampler::StrokeSampler()
+    : tolerance(0.25f), smoothing(true)
+{
+    samples.reserve(historySize + 1);
+}
+
+void StrokeSampler::setTolerance(float value)
+{
+    tolerance = std::max(1e-3f, value);
+}
+
+void StrokeSampler::setSmoothing(bool enabled)
+{
+    smoothing = enabled;
+}
+
+bool StrokeSampler::getSmoothing() const
+{
+    return smoothing;
+}
+
+void StrokeSampler::begin(const sf::Vector2f& position, float time)
+{
+    samples.clear();
+    samples.push_back({position, time});
+    emitted = position;
+}
+
+void StrokeSampler::add(const sf::Vector2f& position, float time, std::vector<sf::Vector2f>& out)
+{
+    if (samples.empty())
+    {
+        begin(position, time);
+        out.push_back(position);
+        return;
+    }
+    if (samples.back().position == position)
+    {
+        samples.back().time = time;
+        return;
+    }
+
+    samples.push_back({position, time});
+    if (samples.size() > historySize) samples.erase(samples.begin());
+
+    std::size_t n = samples.size();
+    if (!smoothing)
+    {
+        out.push_back(position);
+        emitted = position;
+    }
+    else if (n >= 3)
+    {
+        span(n - 3, &samples[n - 1].position, out);
+        emitted = samples[n - 2].position;
+    }
+}
+
+void StrokeSampler::end(std::vector<sf::Vector2f>& out)
+{
+    std::size_t n = samples.size();
+    if (smoothing && n >= 2)
+    {
+        span(n - 2, nullptr, out);
+    }
+    samples.clear();
+}
+
+void StrokeSampler::span(std::size_t i, const sf::Vector2f* next, std::vector<sf::Vector2f>& out) const
+{
+    const sf::Vector2f& p1 = samples[i].position;
+    const sf::Vector2f& p2 = samples[i + 1].position;
+    // The ends of the gesture have no neighbour, so mirror the span to make one.
+    sf::Vector2f p0 = i > 0 ? samples[i - 1].position : p1 * 2.f - p2;
+    sf::Vector2f p3 = next ? *next : p2 * 2.f - p1;
+
+    // Barry-Goldman pyramidal evaluation of the centripetal Catmull-Rom segment.
+    float t0 = 0.f;
+    float t1 = t0 + knot(p0, p1);
+    float t2 = t1 + knot(p1, p2);
+    float t3 = t2 + knot(p2, p3);
+    auto at = [&](float u) {
+        float t = t1 + (t2 - t1) * u;
+        sf::Vector2f a1 = lerp(p0, p1, t0, t1, t);
+        sf::Vector2f a2 = lerp(p1, p2, t1, t2, t);
+        sf::Vector2f a3 = lerp(p2, p3, t2, t3, t);
+        sf::Vector2f b1 = lerp(a1, a2, t0, t2, t);
+        sf::Vector2f b2 = lerp(a2, a3, t1, t3, t);
+        return lerp(b1, b2, t1, t2, t);
+    };
+
+    // Strokes join round, so points are only needed where the curve
+    // bends: splitting a span n ways cuts how far it strays from its chords
+    // by about n squared.
+    float chord = distance(p1, p2);
+    float bend = 0.f;
+    for (float u : {0.25f, 0.5f, 0.75f})
+    {
+        sf::Vector2f q = at(u);
+        float off = chord > 0.f ? std::fabs((p2.x - p1.x) * (q.y - p1.y) - (p2.y - p1.y) * (q.x - p1.x)) / chord
+                                : distance(p1, q);
+        bend = std::max(bend, off);
+    }
+    std::size_t steps = (std::size_t)std::ceil(std::sqrt(bend / tolerance));
+    steps = std::max<std::size_t>(1, std::min(maxSubdivisions, steps));
+
+    for (std::size_t s = 1; s < steps; ++s) out.push_back(at((float)s / steps));
+    out.push_back(p2);
+}
+
+bool StrokeSampler::velocity(float now, sf::Vector2f& out) const
+{
+    if (samples.size() < 2) return false;
+
+    const Sample& last = samples.back();
+    if (now - last.time > staleAfter) return false;
+
+    // Measure against the newest sample that is far enough back in time.
+    for (std::size_t i = samples.size() - 1; i-- > 0;)
+    {
+        if (last.time - samples[i].time >= minVelocityWindow)
+        {
+            out = (last.position - samples[i].position) / (last.time - samples[i].time);
+            return true;
+        }
+    }
+    return false;
+}
+
+float StrokeSampler::speed(float now) const
+{
+    sf::Vector2f v;
+    if (!velocity(now, v)) return 0.f;
+    return std::sqrt(v.x * v.x + v.y * v.y);
+}
+
+bool StrokeSampler::isPredicting(float now) const
+{
+    sf::Vector2f v;
+    return velocity(now, v) && (v.x != 0.f || v.y != 0.f);
+}
+
+sf::Vector2f StrokeSampler::predict(float now, float lead) const
+{
+    if (samples.empty()) return emitted;
+
+    const Sample& last = samples.back();
+    sf::Vector2f v;
+    if (!velocity(now, v)) return last.position;
+
+    float ahead = std::min(maxLead, std::max(0.f, now - last.time) + lead);
+    sf::Vector2f offset = v * ahead;
+    float length = std::sqrt(offset.x * offset.x + offset.y * offset.y);
+    if (length > maxLeadDistance) offset *= maxLeadDistance / length;
+    return last.position + offset;
+}
+
+void StrokeSampler::preview(float now, float lead, std::vector<sf::Vector2f>& out) const
+{
+    out.clear();
+    if (samples.empty()) return;
+
+    out.push_back(emitted);
+    sf::Vector2f predicted = predict(now, lead);
+    std::size_t n = samples.size();
+    if (smoothing && n >= 2)
+    {
+        bool moving = predicted != samples.back().position;
+        span(n - 2, moving ? &predicted : nullptr, out);
+    }
+    if (out.back() != predicted) out.push_back(predicted);
+}
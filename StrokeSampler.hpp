@@ -0,0 +1,67 @@
+#ifndef STROKESAMPLER_HPP
+#define STROKESAMPLER_HPP
+
+#include <SFML/System/Vector2.hpp>
+#include <vector>
+
+// Turns the raw, timestamped pointer samples of one freehand gesture into
+// stroke points. With smoothing on, each span between two samples is filled
+// in along a centripetal Catmull-Rom curve, which cannot cusp or overshoot
+// on uneven sample spacing, divided only as finely as its bend needs. A
+// span is only final once the sample after it has arrived, so preview()
+// supplies the provisional tail, extended by a short velocity prediction to
+// hide the last frame of input latency.
+class StrokeSampler
+{
+public:
+    StrokeSampler();
+
+    // Largest distance in pixels the points may stray from the curve.
+    void setTolerance(float tolerance);
+    void setSmoothing(bool enabled);
+    bool getSmoothing() const;
+
+    // Starts a gesture; the first point is final straight away.
+    void begin(const sf::Vector2f& position, float time);
+
+    // Feeds a raw sample and appends the points that became final to out.
+    void add(const sf::Vector2f& position, float time, std::vector<sf::Vector2f>& out);
+
+    // Finishes the gesture, appending the remaining span to out.
+    void end(std::vector<sf::Vector2f>& out);
+
+    // Where the pointer is expected to be lead seconds after now, going by
+    // its recent velocity. Stale or too-sparse input predicts no motion.
+    sf::Vector2f predict(float now, float lead) const;
+
+    // Pointer speed in pixels per second, going by the same samples as
+    // predict(); zero once the pointer has rested.
+    float speed(float now) const;
+
+    // True while the prediction, and with it preview(), moves with now: from
+    // a sample until the pointer counts as rested.
+    bool isPredicting(float now) const;
+
+    // The provisional tail to draw after the final points: it starts at the
+    // last final point, follows the pending span and ends at the prediction.
+    void preview(float now, float lead, std::vector<sf::Vector2f>& out) const;
+
+private:
+    struct Sample
+    {
+        sf::Vector2f position;
+        float time;
+    };
+
+    // Appends the curve from samples[i] to samples[i + 1], excluding its start.
+    void span(std::size_t i, const sf::Vector2f* next, std::vector<sf::Vector2f>& out) const;
+    // Recent velocity, or false when it is stale or cannot be measured.
+    bool velocity(float now, sf::Vector2f& out) const;
+
+    std::vector<Sample> samples;
+    sf::Vector2f emitted;
+    float tolerance;
+    bool smoothing;
+};
+
+#endif
@@ -0,0 +1,139 @@
+#include "TileCache.hpp"
+#include "Document.hpp"
+#include "RenderStats.hpp"
+#include <algorithm>
+#include <cmath>
+
+TileCache::TileCache(unsigned tileSize, std::size_t capacity)
+    : tileSize(tileSize), capacity(capacity), clock(0)
+{
+}
+
+int TileCache::levelFor(float scale)
+{
+    if (scale >= 1.f) return 0;
+    return std::min(60, (int)std::floor(std::log2(1.f / scale)));
+}
+
+float TileCache::scaleOf(int level)
+{
+    return std::ldexp(1.f, -level);
+}
+
+float TileCache::extentLimit(int level)
+{
+    // At scales between 2^-(k+1) and 2^-k this is at most two screen pixels.
+    return std::ldexp(2.f, level);
+}
+
+std::uint64_t TileCache::key(int level, std::int32_t x, std::int32_t y)
+{
+    return ((std::uint64_t)level << 56) ^ ((std::uint64_t)((std::uint32_t)x & 0xfffffff) << 28) ^
+           ((std::uint32_t)y & 0xfffffff);
+}
+
+std::unique_ptr<sf::RenderTexture> TileCache::acquire()
+{
+    if (tiles.size() >= capacity)
+    {
+        auto oldest = std::min_element(tiles.begin(), tiles.end(), [](const auto& a, const auto& b) {
+            return a.second.lastUsed < b.second.lastUsed;
+        });
+        spare.push_back(std::move(oldest->second.texture));
+        tiles.erase(oldest);
+    }
+    if (!spare.empty())
+    {
+        auto texture = std::move(spare.back());
+        spare.pop_back();
+        return texture;
+    }
+    auto texture = std::make_unique<sf::RenderTexture>();
+    if (!texture->create(tileSize, tileSize)) return nullptr;
+    texture->setSmooth(true);
+    return texture;
+}
+
+void TileCache::build(Tile& tile, int level, const Document& document)
+{
+    sf::RenderTexture& texture = *tile.texture;
+    texture.setView(sf::View(tile.area));
+    texture.clear(sf::Color::Transparent);
+
+    Document::Detail detail;
+    detail.scale = scaleOf(level);
+    detail.maxExtent = extentLimit(level);
+    document.draw(texture, sf::RenderStates::Default, &tile.area, detail);
+    texture.display();
+}
+
+bool TileCache::draw(sf::RenderTarget& target, const sf::FloatRect& area, int level, const Document& document,
+                     int budget)
+{
+    float span = tileSize / scaleOf(level);
+    std::int32_t x0 = (std::int32_t)std::floor(area.left / span);
+    std::int32_t y0 = (std::int32_t)std::floor(area.top / span);
+    std::int32_t x1 = (std::int32_t)std::floor((area.left + area.width) / span);
+    std::int32_t y1 = (std::int32_t)std::floor((area.top + area.height) / span);
+
+    bool complete = true;
+    ++clock;
+    quad.resize(4);
+    for (std::int32_t y = y0; y <= y1; ++y)
+    {
+        for (std::int32_t x = x0; x <= x1; ++x)
+        {
+            std::uint64_t k = key(level, x, y);
+            auto it = tiles.find(k);
+            if (it == tiles.end())
+            {
+                if (budget <= 0)
+                {
+                    complete = false;
+                    continue;
+                }
+                auto texture = acquire();
+                if (!texture) return complete;
+                --budget;
+                Tile tile{std::move(texture), sf::FloatRect(x * span, y * span, span, span), clock};
+                build(tile, level, document);
+                it = tiles.emplace(k, std::move(tile)).first;
+            }
+
+            Tile& tile = it->second;
+            tile.lastUsed = clock;
+            const sf::FloatRect& r = tile.area;
+            float size = (float)tileSize;
+            quad[0] = sf::Vertex({r.left, r.top}, {0.f, 0.f});
+            quad[1] = sf::Vertex({r.left + r.width, r.top}, {size, 0.f});
+            quad[2] = sf::Vertex({r.left + r.width, r.top + r.height}, {size, size});
+            quad[3] = sf::Vertex({r.left, r.top + r.height}, {0.f, size});
+            sf::RenderStates states(&tile.texture->getTexture());
+            target.draw(quad.data(), quad.size(), sf::Quads, states);
+            RenderStats::draw(4);
+        }
+    }
+    return complete;
+}
+
+void TileCache::invalidate(const sf::FloatRect& area)
+{
+    for (auto it = tiles.begin(); it != tiles.end();)
+    {
+        if (it->second.area.intersects(area))
+        {
+            spare.push_back(std::move(it->second.texture));
+            it = tiles.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+void TileCache::clear()
+{
+    for (auto& tile : tiles) spare.push_back(std::move(tile.second.texture));
+    tiles.clear();
+}
@@ -0,0 +1,56 @@
+#ifndef TILECACHE_HPP
+#define TILECACHE_HPP
+
+#include <SFML/Graphics.hpp>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+class Document;
+
+// Imposters for items too small to be worth drawing one by one when zoomed
+// out. Level k renders the document at scale 2^-k into fixed-size tiles,
+// baking only the items whose larger side is under extentLimit(k), i.e.
+// those that cover at most a couple of screen pixels at any zoom using that
+// level. Tiles are kept in a small LRU pool and rebuilt when the items
+// under them change.
+class TileCache
+{
+public:
+    explicit TileCache(unsigned tileSize = 256, std::size_t capacity = 192);
+
+    // Level whose scale is the nearest at or above the given one.
+    static int levelFor(float scale);
+    static float scaleOf(int level);
+    static float extentLimit(int level);
+
+    // Draws the level's tiles over area, building at most budget missing
+    // ones. Returns false if some tiles had to be skipped for now.
+    bool draw(sf::RenderTarget& target, const sf::FloatRect& area, int level, const Document& document,
+              int budget);
+
+    void invalidate(const sf::FloatRect& area);
+    void clear();
+
+private:
+    struct Tile
+    {
+        std::unique_ptr<sf::RenderTexture> texture;
+        sf::FloatRect area;
+        std::uint64_t lastUsed;
+    };
+
+    static std::uint64_t key(int level, std::int32_t x, std::int32_t y);
+    std::unique_ptr<sf::RenderTexture> acquire();
+    void build(Tile& tile, int level, const Document& document);
+
+    unsigned tileSize;
+    std::size_t capacity;
+    std::uint64_t clock;
+    std::unordered_map<std::uint64_t, Tile> tiles;
+    std::vector<std::unique_ptr<sf::RenderTexture>> spare;
+    std::vector<sf::Vertex> quad;
+};
+
+#endif
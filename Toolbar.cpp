@@ -0,0 +1,101 @@
+#include "Toolbar.hpp"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+Toolbar::Toolbar()
+    : vertices(sf::Quads)
+{
+}
+
+bool Toolbar::load()
+{
+    if (!atlas.create(AssetBundle::atlasWidth, AssetBundle::atlasHeight)) return false;
+    atlas.update(AssetBundle::atlasPixels);
+    return true;
+}
+
+sf::Vector2f Toolbar::bakeLabel(const sf::Font& font, const sf::String& text, unsigned characterSize)
+{
+    // Every glyph has to be loaded before the page is read back, since
+    // loading one can grow the page.
+    std::vector<sf::Glyph> glyphs;
+    for (std::size_t i = 0; i < text.getSize(); ++i)
+    {
+        glyphs.push_back(font.getGlyph(text[i], characterSize, false));
+    }
+    sf::Image page = font.getTexture(characterSize).copyToImage();
+
+    // Glyph origins on the baseline, and the box their ink covers.
+    std::vector<sf::Vector2i> origins;
+    float pen = 0.f;
+    int left = 0, top = 0, right = 0, bottom = 0;
+    bool empty = true;
+    for (std::size_t i = 0; i < glyphs.size(); ++i)
+    {
+        if (i > 0) pen += font.getKerning(text[i - 1], text[i], characterSize);
+        const sf::Glyph& g = glyphs[i];
+        sf::Vector2i origin((int)std::lround(pen + g.bounds.left), (int)std::lround(g.bounds.top));
+        origins.push_back(origin);
+        pen += g.advance;
+        if (g.textureRect.width <= 0 || g.textureRect.height <= 0) continue;
+        left = empty ? origin.x : std::min(left, origin.x);
+        top = empty ? origin.y : std::min(top, origin.y);
+        right = empty ? origin.x + g.textureRect.width : std::max(right, origin.x + g.textureRect.width);
+        bottom = empty ? origin.y + g.textureRect.height : std::max(bottom, origin.y + g.textureRect.height);
+        empty = false;
+    }
+
+    const sf::IntRect& region = AssetBundle::sprites[AssetBundle::Label];
+    sf::Image label;
+    label.create((unsigned)region.width, (unsigned)region.height, sf::Color::Transparent);
+    for (std::size_t i = 0; i < glyphs.size(); ++i)
+    {
+        const sf::IntRect& source = glyphs[i].textureRect;
+        if (source.width <= 0 || source.height <= 0) continue;
+        label.copy(page, (unsigned)(origins[i].x - left), (unsigned)(origins[i].y - top), source);
+    }
+    atlas.update(label, (unsigned)region.left, (unsigned)region.top);
+
+    labelSize.x = empty ? 0 : std::min(right - left, region.width);
+    labelSize.y = empty ? 0 : std::min(bottom - top, region.height);
+    return sf::Vector2f((float)labelSize.x, (float)labelSize.y);
+}
+
+void Toolbar::add(AssetBundle::Sprite sprite, const sf::FloatRect& bounds, sf::Color color)
+{
+    sf::FloatRect source(AssetBundle::sprites[sprite]);
+    if (sprite == AssetBundle::Label)
+    {
+        source.width = (float)labelSize.x;
+        source.height = (float)labelSize.y;
+    }
+    else if (sprite == AssetBundle::White)
+    {
+        // Sample the middle only, well away from the transparent border.
+        source = sf::FloatRect(source.left + source.width / 2.f, source.top + source.height / 2.f, 0.f, 0.f);
+    }
+
+    float r = bounds.left + bounds.width, b = bounds.top + bounds.height;
+    float sr = source.left + source.width, sb = source.top + source.height;
+    vertices.append(sf::Vertex({bounds.left, bounds.top}, color, {source.left, source.top}));
+    vertices.append(sf::Vertex({r, bounds.top}, color, {sr, source.top}));
+    vertices.append(sf::Vertex({r, b}, color, {sr, sb}));
+    vertices.append(sf::Vertex({bounds.left, b}, color, {source.left, sb}));
+}
+
+void Toolbar::clear()
+{
+    vertices.clear();
+}
+
+std::size_t Toolbar::getVertexCount() const
+{
+    return vertices.getVertexCount();
+}
+
+void Toolbar::draw(sf::RenderTarget& target, sf::RenderStates states) const
+{
+    states.texture = &atlas;
+    target.draw(vertices, states);
+}
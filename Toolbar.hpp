@@ -0,0 +1,37 @@
+#ifndef TOOLBAR_HPP
+#define TOOLBAR_HPP
+
+#include <SFML/Graphics.hpp>
+#include "AssetBundle.hpp"
+
+// The toolbar as one vertex array over the bundled texture atlas, so the
+// buttons, their label and the colour wheel all go out in a single draw
+// call. Layout and hit testing stay with the caller.
+class Toolbar : public sf::Drawable
+{
+public:
+    Toolbar();
+
+    // Uploads the atlas; needs an active GL context.
+    bool load();
+
+    // Renders text into the atlas's Label region, trimmed to its ink, and
+    // returns the trimmed size. Later add(Label, ...) calls draw it.
+    sf::Vector2f bakeLabel(const sf::Font& font, const sf::String& text, unsigned characterSize);
+
+    // A sprite stretched over bounds and multiplied by color. White gives
+    // flat rectangles.
+    void add(AssetBundle::Sprite sprite, const sf::FloatRect& bounds, sf::Color color = sf::Color::White);
+    void clear();
+
+    std::size_t getVertexCount() const;
+
+private:
+    void draw(sf::RenderTarget& target, sf::RenderStates states) const override;
+
+    sf::Texture atlas;
+    sf::VertexArray vertices;
+    sf::Vector2i labelSize;
+};
+
+#endif
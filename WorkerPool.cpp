@@ -0,0 +1,97 @@
+#include "WorkerPool.hpp"
+#include <algorithm>
+
+WorkerPool::WorkerPool(unsigned count)
+    : queued(0), unfinished(0), next(0), stopping(false)
+{
+    if (count == 0) count = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned i = 0; i < count; ++i) queues.push_back(std::make_unique<Queue>());
+    for (unsigned i = 0; i < count; ++i) threads.emplace_back(&WorkerPool::run, this, (std::size_t)i);
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& thread : threads) thread.join();
+}
+
+void WorkerPool::submit(std::function<void()> task)
+{
+    std::size_t target;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        target = next++ % queues.size();
+    }
+    {
+        std::lock_guard<std::mutex> lock(queues[target]->mutex);
+        queues[target]->tasks.push_back(std::move(task));
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++queued;
+        ++unfinished;
+    }
+    wake.notify_one();
+}
+
+void WorkerPool::wait()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    idle.wait(lock, [this] { return unfinished == 0; });
+}
+
+unsigned WorkerPool::size() const
+{
+    return (unsigned)threads.size();
+}
+
+bool WorkerPool::take(std::size_t self, std::function<void()>& task)
+{
+    {
+        Queue& own = *queues[self];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty())
+        {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+    for (std::size_t i = 1; i < queues.size(); ++i)
+    {
+        Queue& victim = *queues[(self + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty())
+        {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkerPool::run(std::size_t self)
+{
+    std::function<void()> task;
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this] { return stopping || queued > 0; });
+            if (queued == 0) return;
+            // Claiming a task here guarantees one is left in some deque.
+            --queued;
+        }
+        while (!take(self, task)) std::this_thread::yield();
+        task();
+        task = nullptr;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--unfinished == 0) idle.notify_all();
+    }
+}
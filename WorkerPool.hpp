@@ -0,0 +1,55 @@
+#ifndef WORKERPOOL_HPP
+#define WORKERPOOL_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of threads running short tasks. Every worker has its own deque:
+// it runs the newest task from its own and, when that runs dry, steals the
+// oldest one from another, so uneven tasks even out without all workers
+// contending on a single queue.
+class WorkerPool
+{
+public:
+    // Zero threads means one per hardware thread.
+    explicit WorkerPool(unsigned threads = 0);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    void submit(std::function<void()> task);
+
+    // Blocks until every submitted task has finished.
+    void wait();
+
+    unsigned size() const;
+
+private:
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    bool take(std::size_t self, std::function<void()>& task);
+    void run(std::size_t self);
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable idle;
+    std::size_t queued;
+    std::size_t unfinished;
+    std::size_t next;
+    bool stopping;
+};
+
+#endif
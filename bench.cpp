@@ -0,0 +1,1460 @@
+// Headless replay benchmark. Drives App with synthetic (or recorded) event
+// traces into an off-screen sf::RenderTexture and reports frame-time
+// percentiles, draw calls, vertices and heap allocations per frame, followed
+// by micro-benchmarks of the hot kernels. Run with `make bench`, which fails
+// when any correctness check along the way does.
+#include <SFML/Graphics.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <new>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "App.hpp"
+#include "Assets.hpp"
+#include "Color.hpp"
+#include "Compactor.hpp"
+#include "Document.hpp"
+#include "DocumentFile.hpp"
+#include "EventTrace.hpp"
+#include "Exporter.hpp"
+#include "FloodFill.hpp"
+#include "History.hpp"
+#include "InputQueue.hpp"
+#include "RenderStats.hpp"
+#include "SpatialIndex.hpp"
+#include "Stroke.hpp"
+#include "StrokeCodec.hpp"
+#include "StrokeSampler.hpp"
+
+#if defined(__APPLE__)
+#include <mach/mach.h>
+#elif defined(__linux__)
+#include <unistd.h>
+#endif
+
+namespace
+{
+    std::atomic<std::size_t> allocations{0};
+    std::atomic<std::size_t> allocatedBytes{0};
+}
+
+void* operator new(std::size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+namespace
+{
+    typedef std::chrono::steady_clock Clock;
+    typedef std::vector<std::vector<sf::Event>> Trace;
+
+    // Set by any correctness check that fails, so the run exits non-zero.
+    bool failed = false;
+
+    // Passes ok through, remembering a failure.
+    bool check(bool ok)
+    {
+        if (!ok) failed = true;
+        return ok;
+    }
+
+    const sf::Vector2u canvasSize(1024, 768);
+
+    // Toolbar button centres, matching the layout App::init builds.
+    const sf::Vector2i rectButton(285, 25), drawButton(365, 25), circleButton(445, 25),
+        textButton(525, 25), triangleButton(605, 25), bucketButton(765, 25);
+
+    volatile std::uint32_t sink;
+
+    double millis(Clock::time_point a, Clock::time_point b)
+    {
+        return std::chrono::duration<double, std::milli>(b - a).count();
+    }
+
+    sf::Event mouseEvent(sf::Event::EventType type, int x, int y)
+    {
+        sf::Event ev{};
+        ev.type = type;
+        if (type == sf::Event::MouseMoved)
+        {
+            ev.mouseMove.x = x;
+            ev.mouseMove.y = y;
+        }
+        else
+        {
+            ev.mouseButton.button = sf::Mouse::Left;
+            ev.mouseButton.x = x;
+            ev.mouseButton.y = y;
+        }
+        return ev;
+    }
+
+    sf::Event wheelEvent(float delta, int x, int y)
+    {
+        sf::Event ev{};
+        ev.type = sf::Event::MouseWheelScrolled;
+        ev.mouseWheelScroll.wheel = sf::Mouse::VerticalWheel;
+        ev.mouseWheelScroll.delta = delta;
+        ev.mouseWheelScroll.x = x;
+        ev.mouseWheelScroll.y = y;
+        return ev;
+    }
+
+    sf::Event keyEvent(sf::Keyboard::Key code)
+    {
+        sf::Event ev{};
+        ev.type = sf::Event::KeyPressed;
+        ev.key.code = code;
+        return ev;
+    }
+
+    sf::Event textEvent(sf::Uint32 unicode)
+    {
+        sf::Event ev{};
+        ev.type = sf::Event::TextEntered;
+        ev.text.unicode = unicode;
+        return ev;
+    }
+
+    void click(Trace& trace, const sf::Vector2i& p)
+    {
+        trace.push_back({mouseEvent(sf::Event::MouseMoved, p.x, p.y),
+                         mouseEvent(sf::Event::MouseButtonPressed, p.x, p.y),
+                         mouseEvent(sf::Event::MouseButtonReleased, p.x, p.y)});
+    }
+
+    // Long freehand session: wobbly strokes sampled twice per frame.
+    Trace freehandTrace(int strokes, int framesPerStroke)
+    {
+        Trace trace;
+        std::mt19937 rng(7);
+        click(trace, drawButton);
+        for (int s = 0; s < strokes; ++s)
+        {
+            float cx = 100.f + rng() % 824, cy = 120.f + rng() % 600, r = 20.f + rng() % 80;
+            trace.push_back({mouseEvent(sf::Event::MouseButtonPressed, (int)(cx + r), (int)cy)});
+            for (int f = 1; f <= framesPerStroke; ++f)
+            {
+                std::vector<sf::Event> frame;
+                for (int k = 0; k < 2; ++k)
+                {
+                    float t = (f * 2 + k) * 0.05f;
+                    float rr = r * (1.f + 0.2f * std::sin(t * 5.f));
+                    frame.push_back(mouseEvent(sf::Event::MouseMoved, (int)(cx + rr * std::cos(t)), (int)(cy + rr * std::sin(t))));
+                }
+                trace.push_back(frame);
+            }
+            trace.push_back({mouseEvent(sf::Event::MouseButtonReleased, (int)cx, (int)cy)});
+        }
+        return trace;
+    }
+
+    // Thousands of rectangles, circles and triangles.
+    Trace shapesTrace(int count)
+    {
+        Trace trace;
+        std::mt19937 rng(11);
+        for (int i = 0; i < count; ++i)
+        {
+            int x = 20 + rng() % 980, y = 60 + rng() % 680, w = 5 + rng() % 60, h = 5 + rng() % 60;
+            switch (i % 3)
+            {
+                case 0:
+                    if (i % 300 == 0) click(trace, rectButton);
+                    trace.push_back({mouseEvent(sf::Event::MouseButtonPressed, x, y)});
+                    trace.push_back({mouseEvent(sf::Event::MouseButtonReleased, x + w, y + h)});
+                    break;
+                case 1:
+                    click(trace, circleButton);
+                    trace.push_back({mouseEvent(sf::Event::MouseButtonPressed, x, y)});
+                    trace.push_back({mouseEvent(sf::Event::MouseButtonReleased, x + w, y)});
+                    click(trace, rectButton);
+                    break;
+                default:
+                    click(trace, triangleButton);
+                    click(trace, sf::Vector2i(x, y));
+                    click(trace, sf::Vector2i(x + w, y));
+                    click(trace, sf::Vector2i(x, y + h));
+                    click(trace, rectButton);
+                    break;
+            }
+        }
+        return trace;
+    }
+
+    // Heavy text: long multi-line blocks typed a few characters per frame.
+    Trace textTrace(int blocks, int chars)
+    {
+        Trace trace;
+        click(trace, textButton);
+        for (int b = 0; b < blocks; ++b)
+        {
+            click(trace, sf::Vector2i(30 + (b % 4) * 240, 80 + (b / 4 % 6) * 110));
+            std::vector<sf::Event> frame;
+            for (int c = 0; c < chars; ++c)
+            {
+                frame.push_back(textEvent(c % 40 == 39 ? '\r' : 'a' + c % 26));
+                if (frame.size() == 3)
+                {
+                    trace.push_back(frame);
+                    frame.clear();
+                }
+            }
+            frame.push_back(keyEvent(sf::Keyboard::Escape));
+            trace.push_back(frame);
+        }
+        return trace;
+    }
+
+    // Bucket spam on top of a busy drawing, alternating recolour and flood fill.
+    Trace bucketTrace(int clicks)
+    {
+        Trace trace = shapesTrace(600);
+        std::mt19937 rng(13);
+        click(trace, bucketButton);
+        for (int i = 0; i < clicks; ++i)
+        {
+            if (i % 8 == 0) trace.push_back({keyEvent(sf::Keyboard::F)});
+            click(trace, sf::Vector2i(20 + rng() % 980, 60 + rng() % 680));
+        }
+        return trace;
+    }
+
+    // Whiteboard navigation over a busy drawing: zoom far out, pan around
+    // with the right button, zoom back in.
+    Trace navigateTrace()
+    {
+        Trace trace = shapesTrace(3000);
+        for (int i = 0; i < 60; ++i) trace.push_back({wheelEvent(-1.f, 512, 384)});
+        sf::Event press = mouseEvent(sf::Event::MouseButtonPressed, 512, 384);
+        press.mouseButton.button = sf::Mouse::Right;
+        trace.push_back({press});
+        for (int i = 1; i <= 240; ++i)
+        {
+            int x = 512 + (int)(300 * std::sin(i * 0.05f)), y = 384 + (int)(200 * std::sin(i * 0.031f));
+            trace.push_back({mouseEvent(sf::Event::MouseMoved, x, y)});
+        }
+        sf::Event release = mouseEvent(sf::Event::MouseButtonReleased, 512, 384);
+        release.mouseButton.button = sf::Mouse::Right;
+        trace.push_back({release});
+        for (int i = 0; i < 60; ++i) trace.push_back({wheelEvent(1.f, 300, 300)});
+        return trace;
+    }
+
+    sf::Event controlKey(sf::Keyboard::Key code)
+    {
+        sf::Event ev = keyEvent(code);
+        ev.key.control = true;
+        return ev;
+    }
+
+    // Drags a selection of thousands of shapes around: band-select nearly
+    // all of them, move them in a loop and undo the move. Every frame of the
+    // drag should cost about the same, whatever the number of items moving.
+    Trace selectTrace(int count)
+    {
+        Trace trace = shapesTrace(count);
+        trace.push_back({keyEvent(sf::Keyboard::V)});
+        trace.push_back({mouseEvent(sf::Event::MouseButtonPressed, 12, 52)});
+        for (int i = 1; i <= 20; ++i) trace.push_back({mouseEvent(sf::Event::MouseMoved, 12 + i * 50, 52 + i * 36)});
+        trace.push_back({mouseEvent(sf::Event::MouseButtonReleased, 1012, 772)});
+        trace.push_back({mouseEvent(sf::Event::MouseButtonPressed, 512, 400)});
+        for (int i = 1; i <= 240; ++i)
+        {
+            float t = i * 0.05f;
+            int x = 512 + (int)(150 * std::sin(t)), y = 400 + (int)(90 * std::sin(t * 0.7f));
+            trace.push_back({mouseEvent(sf::Event::MouseMoved, x, y)});
+        }
+        trace.push_back({mouseEvent(sf::Event::MouseButtonReleased, 560, 430)});
+        trace.push_back({controlKey(sf::Keyboard::Z)});
+        return trace;
+    }
+
+    // Sweeps the eraser back and forth over a drawing full of strokes,
+    // cutting them wherever it crosses, then undoes the whole pass.
+    Trace eraseTrace()
+    {
+        Trace trace = freehandTrace(300, 90);
+        trace.push_back({keyEvent(sf::Keyboard::E)});
+        trace.push_back({mouseEvent(sf::Event::MouseButtonPressed, 40, 100)});
+        for (int i = 1; i <= 240; ++i)
+        {
+            int x = 40 + (i % 60) * 16, y = 100 + i * 2;
+            trace.push_back({mouseEvent(sf::Event::MouseMoved, (i / 60) % 2 ? 1000 - x : x, y)});
+        }
+        trace.push_back({mouseEvent(sf::Event::MouseButtonReleased, 520, 580)});
+        trace.push_back({controlKey(sf::Keyboard::Z)});
+        return trace;
+    }
+
+    Trace loadTrace(const std::string& path)
+    {
+        Trace trace;
+        std::ifstream in(path);
+        std::vector<EventTrace::Entry> entries;
+        if (!in || !EventTrace::read(in, entries))
+        {
+            std::fprintf(stderr, "Failed to read trace %s\n", path.c_str());
+            return trace;
+        }
+        for (const auto& e : entries)
+        {
+            if (trace.size() <= e.frame) trace.resize(e.frame + 1);
+            trace[e.frame].push_back(e.event);
+        }
+        return trace;
+    }
+
+    double percentile(std::vector<double> values, double p)
+    {
+        if (values.empty()) return 0.0;
+        std::sort(values.begin(), values.end());
+        std::size_t i = (std::size_t)std::min<double>(values.size() - 1, std::floor(p * (values.size() - 1) + 0.5));
+        return values[i];
+    }
+
+    // Time from constructing App to its first frame: font and toolbar atlas
+    // out of the asset bundle, canvas allocation and one full render. Runs
+    // before anything else has warmed the font or GL caches.
+    void coldStart(sf::RenderTexture& target)
+    {
+        auto t0 = Clock::now();
+        App app;
+        if (!app.init(canvasSize))
+        {
+            std::printf("cold start: init failed\n");
+            return;
+        }
+        auto t1 = Clock::now();
+        app.update();
+        RenderStats::reset();
+        app.render(target);
+        target.display();
+        auto t2 = Clock::now();
+        std::printf("cold start: init %.2f ms, first frame %.2f ms, %.2f ms total (%zu draws, %zu uploads)\n\n",
+                    millis(t0, t1), millis(t1, t2), millis(t0, t2), RenderStats::current().drawCalls,
+                    RenderStats::current().textureUploads);
+    }
+
+    // Text of many sizes drawn straight from the document. addText shapes
+    // each run once; recolouring and redrawing only copy cached quads, and
+    // every size in one atlas band comes out of a single draw call.
+    void textLayer(sf::RenderTexture& target, int items)
+    {
+        sf::Font font;
+        if (!Assets::loadFont(font)) return;
+        Document doc;
+        doc.setFont(font);
+        std::mt19937 rng(31);
+        auto t0 = Clock::now();
+        for (int i = 0; i < items; ++i)
+        {
+            sf::Vector2f p((float)(rng() % canvasSize.x), (float)(rng() % canvasSize.y));
+            doc.addText("glyph run " + std::to_string(i), p, 17 + rng() % 16, sf::Color::White);
+        }
+        std::printf("text layer: %d items, sizes 17-32, shaped in %.3f ms\n", items, millis(t0, Clock::now()));
+
+        for (int pass = 0; pass < 2; ++pass)
+        {
+            if (pass == 1)
+            {
+                for (std::uint32_t id = 0; id < doc.size(); id += 3) doc.setColor(id, sf::Color::Yellow);
+            }
+            RenderStats::reset();
+            t0 = Clock::now();
+            target.clear();
+            doc.draw(target, sf::RenderStates::Default);
+            target.display();
+            std::printf("text layer: %-10s %8.3f ms %4zu draws %8zu verts\n", pass ? "recoloured" : "drawn",
+                        millis(t0, Clock::now()), RenderStats::current().drawCalls, RenderStats::current().vertices);
+        }
+    }
+
+    void replay(const char* name, const Trace& trace, sf::RenderTexture& target)
+    {
+        App app;
+        if (!app.init(canvasSize))
+        {
+            std::printf("%-10s  skipped (init failed)\n", name);
+            return;
+        }
+
+        std::vector<double> times;
+        std::size_t drawCalls = 0, vertices = 0, uploads = 0, allocs = 0;
+        times.reserve(trace.size());
+        for (const auto& frame : trace)
+        {
+            std::size_t before = allocations.load();
+            auto t0 = Clock::now();
+            for (const auto& ev : frame) app.handleEvent(ev);
+            app.update();
+            RenderStats::reset();
+            app.render(target);
+            target.display();
+            times.push_back(millis(t0, Clock::now()));
+            allocs += allocations.load() - before;
+            drawCalls += RenderStats::current().drawCalls;
+            vertices += RenderStats::current().vertices;
+            uploads += RenderStats::current().textureUploads;
+        }
+
+        double n = (double)std::max<std::size_t>(1, trace.size());
+        std::printf("%-10s %7zu %8.3f %8.3f %8.3f %8.3f %9.1f %10.0f %8.2f %9.1f %8zu\n", name, trace.size(),
+                    percentile(times, 0.5), percentile(times, 0.95), percentile(times, 0.99),
+                    percentile(times, 1.0), drawCalls / n, vertices / n, uploads / n, allocs / n,
+                    app.getDocument().size());
+    }
+
+    float distanceToPolyline(const sf::Vector2f& p, const std::vector<Stroke::Sample>& line)
+    {
+        float best = 1e30f;
+        for (std::size_t i = 1; i < line.size(); ++i)
+        {
+            sf::Vector2f a = line[i - 1].position, ab = line[i].position - a, ap = p - a;
+            float length2 = ab.x * ab.x + ab.y * ab.y;
+            float t = length2 > 0.f ? std::min(1.f, std::max(0.f, (ap.x * ab.x + ap.y * ab.y) / length2)) : 0.f;
+            sf::Vector2f d = ap - ab * t;
+            best = std::min(best, d.x * d.x + d.y * d.y);
+        }
+        return std::sqrt(best);
+    }
+
+    // One slow, careful annotation stroke from integer pointer positions at
+    // 120 Hz through the sampler. Returns the number of pointer samples.
+    int annotationStroke(std::mt19937& rng, StrokeSampler& sampler, std::vector<sf::Vector2f>& points,
+                         Stroke& stroke)
+    {
+        float cx = 100.f + rng() % 800, cy = 100.f + rng() % 600, r = 30.f + rng() % 150;
+        float turns = 0.5f + (rng() % 100) / 50.f;
+        int steps = 150 + rng() % 250;
+        for (int i = 0; i <= steps; ++i)
+        {
+            float t = turns * 6.2831853f * i / steps;
+            float rr = r * (1.f + 0.15f * std::sin(t * 3.f));
+            sf::Vector2f p(std::round(cx + rr * std::cos(t)), std::round(cy + rr * std::sin(t)));
+            points.clear();
+            if (i == 0)
+            {
+                sampler.begin(p, 0.f);
+                points.push_back(p);
+            }
+            else
+            {
+                sampler.add(p, i / 120.f, points);
+            }
+            if (i == steps) sampler.end(points);
+            for (const auto& q : points) stroke.addPoint(q, 5.f, sf::Color::White);
+        }
+        return steps + 1;
+    }
+
+    // Annotation strokes simplified and encoded the way Document commits
+    // them. Reports how much smaller they get and how far they stray.
+    void strokeCompression(float tolerance)
+    {
+        std::mt19937 rng(3);
+        StrokeSampler sampler;
+        std::vector<sf::Vector2f> points;
+        std::vector<Stroke::Sample> simplified, restored;
+        std::vector<std::uint8_t> bytes;
+        std::size_t rawSamples = 0, keptSamples = 0, encodedBytes = 0;
+        float maxError = 0.f;
+        double seconds = 0.0;
+
+        for (int s = 0; s < 200; ++s)
+        {
+            Stroke stroke;
+            annotationStroke(rng, sampler, points, stroke);
+
+            const auto& raw = stroke.getSamples();
+            auto t0 = Clock::now();
+            StrokeCodec::simplify(raw.data(), raw.size(), tolerance, simplified);
+            bytes.clear();
+            StrokeCodec::encode(simplified.data(), simplified.size(), bytes);
+            seconds += millis(t0, Clock::now()) / 1000.0;
+
+            StrokeCodec::decode(bytes.data(), bytes.size(), restored);
+            for (const auto& sample : raw) maxError = std::max(maxError, distanceToPolyline(sample.position, restored));
+            rawSamples += raw.size();
+            keptSamples += restored.size();
+            encodedBytes += bytes.size();
+        }
+
+        // Far out on the canvas, past what 32-bit fixed point holds, and
+        // straight back: every position must come back exactly.
+        const sf::Vector2f far[] = {{0.f, 0.f}, {3e8f, -3e8f}, {-2e9f, 5e12f}, {-1e15f, 1e15f}, {5.125f, -7.5f}};
+        std::vector<Stroke::Sample> farSamples;
+        for (const auto& p : far) farSamples.push_back({p, 4.f, sf::Color::White});
+        bytes.clear();
+        StrokeCodec::encode(farSamples.data(), farSamples.size(), bytes);
+        StrokeCodec::decode(bytes.data(), bytes.size(), restored);
+        bool farExact = restored.size() == farSamples.size();
+        for (std::size_t i = 0; farExact && i < restored.size(); ++i) farExact = restored[i].position == far[i];
+
+        std::printf("\nstroke compression at %.2f px: %zu -> %zu samples (%.1fx fewer vertices), "
+                    "%zu -> %zu bytes (%.1fx), max error %.3f px, %.1f us/stroke, far coordinates %s\n",
+                    tolerance, rawSamples, keptSamples, (double)rawSamples / keptSamples,
+                    rawSamples * sizeof(Stroke::Sample), encodedBytes,
+                    (double)(rawSamples * sizeof(Stroke::Sample)) / encodedBytes, maxError, seconds * 1e6 / 200,
+                    check(farExact) ? "ok" : "FAILED");
+    }
+
+    // Geometry the brush costs for the same annotation strokes: points the
+    // sampler keeps, vertices in the live strip and in the triangles batched
+    // once committed, all per pointer sample.
+    void brushGeometry()
+    {
+        std::mt19937 rng(3);
+        StrokeSampler sampler;
+        std::vector<sf::Vector2f> points;
+        std::vector<Stroke::Sample> simplified;
+        std::vector<sf::Vertex> triangles;
+        std::size_t pointer = 0, kept = 0, live = 0, batched = 0;
+        double seconds = 0.0;
+
+        for (int s = 0; s < 200; ++s)
+        {
+            Stroke stroke;
+            auto t0 = Clock::now();
+            pointer += annotationStroke(rng, sampler, points, stroke);
+            seconds += millis(t0, Clock::now()) / 1000.0;
+            kept += stroke.getPointCount();
+            live += stroke.getVertexCount();
+
+            const auto& raw = stroke.getSamples();
+            StrokeCodec::simplify(raw.data(), raw.size(), 0.5f, simplified);
+            triangles.clear();
+            Stroke::appendTriangles(simplified.data(), simplified.size(), 1.f, true, triangles);
+            batched += triangles.size();
+        }
+
+        std::printf("\nbrush geometry: %.2f points, %.2f live vertices, %.2f committed vertices per pointer sample, "
+                    "%.2f us per pointer sample\n",
+                    (double)kept / pointer, (double)live / pointer, (double)batched / pointer, seconds * 1e6 / pointer);
+    }
+
+    // Long editing session against a document of a few hundred thousand
+    // items: the journal should cost bytes per step whatever the document
+    // size, and undoing or redoing a step should not depend on it either.
+    void undoJournal(int steps)
+    {
+        Document doc;
+        History history;
+        std::mt19937 rng(17);
+        for (int i = 0; i < 200000; ++i)
+        {
+            doc.addRectangle(sf::Vector2f((float)(rng() % 20000), (float)(rng() % 20000)), sf::Vector2f(8.f, 8.f),
+                             sf::Color::Red);
+        }
+
+        for (int i = 0; i < steps; ++i)
+        {
+            if (i % 500 == 499)
+            {
+                history.record({History::Op::Clear, false, doc.clear(), 0, 0});
+            }
+            else if (i % 3 == 0 && doc.size() > 0)
+            {
+                std::uint32_t id = (std::uint32_t)(doc.size() - 1 - rng() % std::min<std::size_t>(doc.size(), 50));
+                history.record({History::Op::Recolor, false, id, doc.setColor(id, sf::Color::Blue).toInteger(),
+                                sf::Color::Blue.toInteger()});
+            }
+            else
+            {
+                std::uint32_t id = doc.addCircle(sf::Vector2f((float)(rng() % 20000), (float)(rng() % 20000)), 6.f,
+                                                 sf::Color::Green);
+                history.record({History::Op::Add, false, id, 0, 0});
+            }
+        }
+
+        auto apply = [&](const History::Entry& e, bool forward) {
+            switch (e.op)
+            {
+                case History::Op::Add: forward ? doc.show(e.id) : doc.hide(e.id); break;
+                case History::Op::Recolor: doc.setColor(e.id, sf::Color(forward ? e.after : e.before)); break;
+                case History::Op::Clear: forward ? (void)doc.clear() : doc.restore(e.id); break;
+                default: break;
+            }
+        };
+        double slowest = 0.0;
+        auto t0 = Clock::now();
+        while (const History::Entry* e = history.undo())
+        {
+            auto s0 = Clock::now();
+            apply(*e, false);
+            slowest = std::max(slowest, millis(s0, Clock::now()));
+        }
+        double undoAll = millis(t0, Clock::now());
+        t0 = Clock::now();
+        while (const History::Entry* e = history.redo()) apply(*e, true);
+        double redoAll = millis(t0, Clock::now());
+
+        std::printf("\nundo journal: %d steps over %zu items, %.1f KB (%.1f bytes/step), "
+                    "undo all %.2f ms (slowest step %.3f ms), redo all %.2f ms\n",
+                    steps, doc.size(), history.memoryUsage() / 1024.0, (double)history.memoryUsage() / steps,
+                    undoAll, slowest, redoAll);
+    }
+
+    // Round trip, damage and recovery checks for the document format, plus
+    // how long a large document takes to map and load.
+    void fileFormat(int items)
+    {
+        std::vector<std::uint8_t> journal;
+        DocumentFile::writeJournalHeader(0, journal);
+        std::size_t header = journal.size();
+
+        Document doc;
+        doc.setChangeLog(&journal);
+        doc.setBackground(sf::Color(62, 63, 63));
+        std::mt19937 rng(23);
+        FloodFill::Region region;
+        std::vector<Document::Piece> pieces;
+        std::vector<std::uint32_t> deleted;
+        for (int i = 0; i < items; ++i)
+        {
+            sf::Vector2f p((float)(rng() % 20000), (float)(rng() % 20000));
+            sf::Color color((sf::Uint8)rng(), (sf::Uint8)rng(), (sf::Uint8)rng());
+            switch (i % 6)
+            {
+                case 0: doc.addRectangle(p, sf::Vector2f(4.f + rng() % 60, 4.f + rng() % 60), color); break;
+                case 1: doc.addCircle(p, 2.f + rng() % 30, color); break;
+                case 2: doc.addTriangle(p, p + sf::Vector2f(30.f, 5.f), p + sf::Vector2f(10.f, 40.f), color); break;
+                case 3: doc.addText("dibujo " + std::to_string(i), p, 14 + rng() % 20, color); break;
+                case 4:
+                {
+                    Stroke stroke;
+                    for (int k = 0; k < 60; ++k)
+                        stroke.addPoint(p + sf::Vector2f(k * 3.f, 20.f * std::sin(k * 0.2f)), 5.f, color);
+                    std::uint32_t id = doc.addStroke(stroke);
+                    if (i % 5 == 4 && doc.eraseAlong(id, p + sf::Vector2f(90.f, -30.f), p + sf::Vector2f(90.f, 30.f),
+                                                     4.f, pieces) && !pieces.empty())
+                        doc.cut(id, pieces.data(), pieces.size());
+                    break;
+                }
+                case 5:
+                {
+                    int w = 8 + rng() % 40, h = 8 + rng() % 40;
+                    region.bounds = sf::IntRect((int)p.x, (int)p.y, w, h);
+                    region.mask.assign((std::size_t)w * h, 0);
+                    for (auto& m : region.mask) m = rng() % 4 ? 1 : 0;
+                    doc.addFill(region, color, sf::Vector2f(0.f, 0.f), 1.f + rng() % 3);
+                    break;
+                }
+            }
+            if (i % 97 == 96)
+            {
+                deleted.push_back((std::uint32_t)(rng() % doc.size()));
+                doc.hide(deleted.back());
+            }
+            if (i % 89 == 88) doc.setColor((std::uint32_t)(rng() % doc.size()), sf::Color::Yellow);
+            if (i % 83 == 82)
+            {
+                std::uint32_t id = (std::uint32_t)(rng() % doc.size());
+                doc.place(id, sf::Transform().rotate((float)(rng() % 360), p) * doc.getTransform(id));
+            }
+        }
+        std::uint32_t before = doc.clear();
+        doc.addCircle(sf::Vector2f(5.f, 5.f), 4.f, sf::Color::Red);
+        doc.restore(before);
+        doc.truncate((std::uint32_t)doc.size() - 3);
+        doc.setChangeLog(nullptr);
+
+        std::vector<std::uint8_t> bytes, again;
+        DocumentFile::write(doc, 7, bytes);
+        Document loaded;
+        std::uint32_t generation = 0;
+        std::string error;
+        bool read = DocumentFile::read(loaded, bytes.data(), bytes.size(), generation, error);
+        if (read) DocumentFile::write(loaded, generation, again);
+        bool roundTrip = read && generation == 7 && again == bytes;
+
+        Document replayed;
+        long records = DocumentFile::replay(replayed, journal.data(), journal.size(), 0);
+        again.clear();
+        DocumentFile::write(replayed, 7, again);
+        bool recovered = again == bytes;
+
+        // Undoing the clear brings back what it cleared, not what was
+        // deleted before it, here or after a reload or replay.
+        bool stayHidden = true;
+        for (std::uint32_t id : deleted)
+        {
+            if (id < doc.size())
+                stayHidden = stayHidden && !doc.isVisible(id) && !loaded.isVisible(id) && !replayed.isVisible(id);
+        }
+
+        // A journal cut off mid-record keeps every record before the cut.
+        Document torn;
+        long kept = DocumentFile::replay(torn, journal.data(), journal.size() - 3, 0);
+
+        // Every damaged copy must be rejected and leave the target as it was.
+        int accepted = 0, damaged = 0;
+        Document target;
+        target.addRectangle(sf::Vector2f(1.f, 1.f), sf::Vector2f(2.f, 2.f), sf::Color::Red);
+        std::vector<std::uint8_t> copy;
+        for (std::size_t cut = 0; cut < bytes.size(); cut += 1 + bytes.size() / 500)
+        {
+            accepted += DocumentFile::read(target, bytes.data(), cut, generation, error);
+            ++damaged;
+        }
+        for (int i = 0; i < 1000; ++i)
+        {
+            copy = bytes;
+            copy[rng() % copy.size()] ^= (std::uint8_t)(1 + rng() % 255);
+            accepted += DocumentFile::read(target, copy.data(), copy.size(), generation, error);
+            ++damaged;
+        }
+        accepted += target.size() != 1;
+        check(kept == records - 1 && accepted == 0);
+
+        // Items reaching past the coordinate range are refused, whether read
+        // whole or moved there by a journal record, and the index takes
+        // whatever bounds it is given without overflowing a cell number.
+        std::vector<std::uint8_t> farJournal;
+        DocumentFile::writeJournalHeader(0, farJournal);
+        Document far;
+        far.setChangeLog(&farJournal);
+        std::uint32_t farId = far.addRectangle(sf::Vector2f(1e29f, 0.f), sf::Vector2f(1.f, 1.f), sf::Color::Red);
+        far.place(farId, sf::Transform().scale(1e20f, 1e20f));
+        far.setChangeLog(nullptr);
+        far.addRectangle(sf::Vector2f(-9e29f, 0.f), sf::Vector2f(2e30f, 1.f), sf::Color::Red);
+        copy.clear();
+        DocumentFile::write(far, 0, copy);
+        Document farRead;
+        bool outOfRange = !DocumentFile::read(farRead, copy.data(), copy.size(), generation, error) &&
+                          DocumentFile::replay(farRead, farJournal.data(), farJournal.size(), 0) == 1 &&
+                          farRead.getBounds(farId).left == 1e29f;
+        SpatialIndex odd;
+        const float nan = std::nanf(""), inf = std::numeric_limits<float>::infinity();
+        odd.insert(0, sf::FloatRect(nan, nan, nan, nan));
+        odd.insert(1, sf::FloatRect(-inf, 0.f, inf, inf));
+        odd.insert(2, sf::FloatRect(-1e30f, -1e30f, 2e30f, 2e30f));
+        odd.insert(3, sf::FloatRect(3e20f, -3e20f, 1e18f, 1e18f));
+        std::vector<std::uint32_t> found;
+        odd.queryPoint(sf::Vector2f(3e20f, -3e20f), found);
+        outOfRange = outOfRange && found.size() == 2 && found[0] == 3 && found[1] == 2;
+        odd.queryRect(sf::FloatRect(-1e38f, -1e38f, 2e38f, 2e38f), found);
+        outOfRange = outOfRange && std::count(found.begin(), found.end(), 2u) && std::count(found.begin(), found.end(), 3u);
+
+        const char* path = "dibujo-bench.dib";
+        double loadMs = -1.0;
+        if (DocumentFile::save(doc, path, 7, error))
+        {
+            auto t0 = Clock::now();
+            Document fromDisk;
+            if (DocumentFile::load(fromDisk, path, generation, error)) loadMs = millis(t0, Clock::now());
+            std::remove(path);
+        }
+        check(loadMs >= 0.0);
+
+        std::printf("\ndocument file: %zu items in %.1f MB, round trip %s, journal %ld records (%.1f MB) %s, "
+                    "torn journal kept %ld, %d/%d damaged copies accepted, out of range items %s, load %.1f ms, "
+                    "deletions across undone clear %s\n",
+                    doc.size(), bytes.size() / 1048576.0, check(roundTrip) ? "ok" : "FAILED", records,
+                    (journal.size() - header) / 1048576.0, check(recovered) ? "replays ok" : "REPLAY FAILED",
+                    kept, accepted, damaged, check(outOfRange) ? "refused" : "ACCEPTED", loadMs, check(stayHidden) ? "ok" : "FAILED");
+    }
+
+    // Moving, scaling and erasing parts of a large drawing. Lifting builds
+    // the moving items' vertices once; committing gives each a placement
+    // and undoing puts them back, touching only those items; the eraser
+    // splits a stroke it crosses into the pieces either side.
+    void selectionEdits(sf::RenderTexture& target, int items)
+    {
+        Document doc;
+        std::mt19937 rng(41);
+        for (int i = 0; i < items; ++i)
+        {
+            sf::Vector2f p((float)(rng() % 4000), (float)(rng() % 3000));
+            sf::Color color((sf::Uint8)rng(), (sf::Uint8)rng(), (sf::Uint8)rng());
+            switch (i % 4)
+            {
+                case 0: doc.addRectangle(p, sf::Vector2f(4.f + rng() % 40, 4.f + rng() % 40), color); break;
+                case 1: doc.addCircle(p, 2.f + rng() % 20, color); break;
+                case 2: doc.addTriangle(p, p + sf::Vector2f(30.f, 5.f), p + sf::Vector2f(10.f, 40.f), color); break;
+                default:
+                {
+                    Stroke stroke;
+                    for (int k = 0; k < 30; ++k)
+                        stroke.addPoint(p + sf::Vector2f(k * 3.f, 15.f * std::sin(k * 0.3f)), 4.f, color);
+                    doc.addStroke(stroke);
+                }
+            }
+        }
+
+        std::vector<std::uint32_t> selection;
+        doc.select(sf::FloatRect(0.f, 0.f, 2000.f, 1500.f), selection);
+        std::vector<Document::Batch> batches;
+        auto t0 = Clock::now();
+        doc.lift(selection);
+        doc.appendBatches(selection, 1.f, batches);
+        double liftMs = millis(t0, Clock::now());
+        std::size_t vertices = 0;
+        for (const auto& batch : batches) vertices += batch.vertices.size();
+
+        std::vector<double> frames;
+        target.setView(sf::View(sf::FloatRect(0.f, 0.f, 2000.f, 1500.f)));
+        for (int f = 0; f < 120; ++f)
+        {
+            auto f0 = Clock::now();
+            sf::RenderStates states(sf::Transform().translate(f * 2.f, f * 1.f));
+            target.clear();
+            for (const auto& batch : batches)
+            {
+                states.texture = batch.texture;
+                target.draw(batch.vertices.data(), batch.vertices.size(), sf::Triangles, states);
+            }
+            target.display();
+            frames.push_back(millis(f0, Clock::now()));
+        }
+        target.setView(target.getDefaultView());
+        doc.drop();
+
+        History history;
+        sf::Transform move = sf::Transform().translate(240.f, 120.f).scale(1.5f, 1.5f, 1000.f, 750.f);
+        t0 = Clock::now();
+        for (std::size_t i = 0; i < selection.size(); ++i)
+        {
+            std::uint32_t id = selection[i];
+            std::uint32_t before = doc.place(id, move * doc.getTransform(id));
+            history.record({History::Op::Place, i > 0, id, before, doc.getPlacement(id)});
+        }
+        double commitMs = millis(t0, Clock::now());
+        sf::FloatRect moved = doc.getBounds(selection[0]);
+
+        t0 = Clock::now();
+        while (const History::Entry* e = history.undo())
+        {
+            doc.setPlacement(e->id, e->before);
+            if (!e->joined) break;
+        }
+        double undoMs = millis(t0, Clock::now());
+        bool undone = history.canRedo() && !history.canUndo() && doc.getBounds(selection[0]) != moved;
+
+        // A vertical sweep through the middle of a straight stroke leaves
+        // its two ends, and a second one through the left end leaves three.
+        Stroke line;
+        for (int k = 0; k <= 100; ++k) line.addPoint(sf::Vector2f(5000.f + k * 2.f, 5000.f), 4.f, sf::Color::White);
+        std::uint32_t id = doc.addStroke(line);
+        std::vector<Document::Piece> kept;
+        bool split = doc.eraseAlong(id, sf::Vector2f(5100.f, 4950.f), sf::Vector2f(5100.f, 5050.f), 6.f, kept) &&
+                     kept.size() == 2;
+        if (split) doc.cut(id, kept.data(), kept.size());
+        split = split && doc.eraseAlong(id, sf::Vector2f(5040.f, 4950.f), sf::Vector2f(5040.f, 5050.f), 6.f, kept) &&
+                kept.size() == 3;
+
+        int sweeps = 0;
+        t0 = Clock::now();
+        for (std::uint32_t other = 3; other < (std::uint32_t)items; other += 4)
+        {
+            const sf::FloatRect& b = doc.getBounds(other);
+            sf::Vector2f top(b.left + b.width / 2.f, b.top - 5.f), bottom(top.x, b.top + b.height + 5.f);
+            if (doc.eraseAlong(other, top, bottom, 3.f, kept) && !kept.empty()) doc.cut(other, kept.data(), kept.size());
+            ++sweeps;
+        }
+        double eraseUs = millis(t0, Clock::now()) * 1000.0 / std::max(1, sweeps);
+
+        std::printf("\nselection edits: %zu of %d items lifted in %.2f ms (%zu verts, %zu batches), drag frame "
+                    "p50 %.3f ms max %.3f ms, commit %.2f ms, undo %.2f ms %s, stroke split %s, erase %.2f us/stroke\n",
+                    selection.size(), items, liftMs, vertices, batches.size(), percentile(frames, 0.5),
+                    percentile(frames, 1.0), commitMs, undoMs, check(undone) ? "ok" : "FAILED",
+                    check(split) ? "ok" : "FAILED", eraseUs);
+    }
+
+    // Software export of a dense drawing at print resolution.
+    void exportImage(float scale)
+    {
+        Document doc;
+        doc.setBackground(sf::Color(62, 63, 63));
+        std::mt19937 rng(31);
+        FloodFill::Region region;
+        for (int i = 0; i < 3000; ++i)
+        {
+            sf::Vector2f p((float)(rng() % 1000), (float)(rng() % 800));
+            sf::Color color((sf::Uint8)rng(), (sf::Uint8)rng(), (sf::Uint8)rng(), i % 7 ? 255 : 128);
+            switch (i % 5)
+            {
+                case 0: doc.addRectangle(p, sf::Vector2f(4.f + rng() % 60, 4.f + rng() % 60), color); break;
+                case 1: doc.addCircle(p, 2.f + rng() % 30, color); break;
+                case 2: doc.addTriangle(p, p + sf::Vector2f(30.f, 5.f), p + sf::Vector2f(10.f, 40.f), color); break;
+                case 3:
+                {
+                    Stroke stroke;
+                    for (int k = 0; k < 60; ++k)
+                        stroke.addPoint(p + sf::Vector2f(k * 3.f, 20.f * std::sin(k * 0.2f)), 5.f, color);
+                    doc.addStroke(stroke);
+                    break;
+                }
+                case 4:
+                {
+                    int w = 8 + rng() % 40, h = 8 + rng() % 40;
+                    region.bounds = sf::IntRect((int)p.x, (int)p.y, w, h);
+                    region.mask.assign((std::size_t)w * h, 0);
+                    for (int y = 0; y < h; ++y)
+                    {
+                        for (int x = 0; x < w; ++x)
+                        {
+                            int dx = x - w / 2, dy = y - h / 2;
+                            region.mask[(std::size_t)y * w + x] = dx * dx + dy * dy < w * h / 5;
+                        }
+                    }
+                    doc.addFill(region, color);
+                    break;
+                }
+            }
+        }
+
+        Exporter::Options options;
+        options.scale = scale;
+        sf::FloatRect bounds = Exporter::contentBounds(doc);
+        double pixels = (double)bounds.width * scale * bounds.height * scale;
+        std::string error;
+        const char* png = "dibujo-bench.png";
+        const char* svg = "dibujo-bench.svg";
+        auto t0 = Clock::now();
+        bool pngOk = Exporter::writePng(doc, png, options, error);
+        double pngMs = millis(t0, Clock::now());
+        t0 = Clock::now();
+        bool svgOk = Exporter::writeSvg(doc, svg, options, error);
+        double svgMs = millis(t0, Clock::now());
+
+        // The editor's export, where only the copy holds up a frame: the
+        // file must come out the same though the document changes meanwhile.
+        const char* copy = "dibujo-bench-copy.png";
+        Exporter::Task exporting;
+        t0 = Clock::now();
+        bool started = exporting.start(doc, copy, options);
+        double startMs = millis(t0, Clock::now());
+        doc.setBackground(sf::Color::White);
+        std::string written, taskError;
+        bool taskOk = started && exporting.poll(written, taskError, true) && taskError.empty() && written == copy;
+
+        std::ifstream pngFile(png, std::ios::binary), svgFile(svg, std::ios::binary), copyFile(copy, std::ios::binary);
+        std::string pngBytes((std::istreambuf_iterator<char>(pngFile)), std::istreambuf_iterator<char>());
+        std::string copyBytes((std::istreambuf_iterator<char>(copyFile)), std::istreambuf_iterator<char>());
+        taskOk = taskOk && pngOk && copyBytes == pngBytes;
+        svgFile.seekg(0, std::ios::end);
+        double pngSize = pngOk ? (double)pngBytes.size() : 0.0, svgSize = svgOk ? (double)svgFile.tellg() : 0.0;
+        std::remove(png);
+        std::remove(svg);
+        std::remove(copy);
+
+        std::printf("\nexport x%g: %.0f Mpx PNG %s in %.0f ms (%.1f Mpx/s, %.1f MB), SVG %s in %.1f ms (%.1f MB)\n",
+                    scale, pixels / 1e6, check(pngOk) ? "ok" : "FAILED", pngMs, pixels / 1e3 / pngMs,
+                    pngSize / 1048576.0, check(svgOk) ? "ok" : "FAILED", svgMs, svgSize / 1048576.0);
+        std::printf("  in the background: %.1f ms on the calling thread, file %s\n", startMs,
+                    check(taskOk) ? "matches" : "DIFFERS");
+    }
+
+    // What `dibujo --export` does, run by headlessText() in a second copy of
+    // the benchmark that has no display.
+    int exportDocument(const char* in, const char* out)
+    {
+        sf::Font font;
+        Document doc;
+        if (Assets::loadFont(font)) doc.setFont(font);
+        std::string error;
+        std::uint32_t generation;
+        Exporter::Options options;
+        options.scale = 2.f;
+        if (DocumentFile::load(doc, in, generation, error) && Exporter::write(doc, out, options, error)) return 0;
+        std::fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+
+    // Text exported without a display, where SFML cannot make a GL context:
+    // the glyphs must be rendered without one and show up in the image.
+    void headlessText(const char* self)
+    {
+        sf::Font font;
+        if (!Assets::loadFont(font)) return;
+        Document doc;
+        doc.setFont(font);
+        doc.setBackground(sf::Color::White);
+        doc.addText("Exported without a display", sf::Vector2f(10.f, 10.f), 32, sf::Color::Black);
+        std::uint32_t id = doc.addText("and turned", sf::Vector2f(10.f, 60.f), 24, sf::Color(0, 0, 160));
+        doc.place(id, sf::Transform().rotate(20.f, sf::Vector2f(10.f, 60.f)));
+
+        const char* path = "dibujo-bench-text.dib";
+        const char* png = "dibujo-bench-text.png";
+        std::string error;
+        int inked = 0;
+        bool ok = false;
+        auto t0 = Clock::now();
+        if (DocumentFile::save(doc, path, 0, error))
+        {
+            std::string command = std::string("env -u DISPLAY \"") + self + "\" --export " + path + " " + png;
+            sf::Image image;
+            if (std::system(command.c_str()) == 0 && image.loadFromFile(png))
+            {
+                for (unsigned y = 0; y < image.getSize().y; ++y)
+                {
+                    for (unsigned x = 0; x < image.getSize().x; ++x) inked += image.getPixel(x, y).r < 128;
+                }
+                ok = inked > 500;
+            }
+        }
+        double ms = millis(t0, Clock::now());
+        std::remove(path);
+        std::remove(png);
+
+        std::printf("\nheadless text export: %s, %d inked pixels in %.0f ms\n", check(ok) ? "ok" : "FAILED", inked, ms);
+    }
+
+    // Resident set size of the process, or -1 where it cannot be read.
+    double residentMegabytes()
+    {
+#if defined(__APPLE__)
+        mach_task_basic_info info;
+        mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+        if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&info, &count) == KERN_SUCCESS)
+            return info.resident_size / 1048576.0;
+#elif defined(__linux__)
+        std::ifstream statm("/proc/self/statm");
+        long pages = 0, resident = 0;
+        if (statm >> pages >> resident) return resident * (double)sysconf(_SC_PAGESIZE) / 1048576.0;
+#endif
+        return -1.0;
+    }
+
+    // A long session under a small memory budget: items keep arriving over
+    // the same area, and whenever the live ones outgrow the budget the
+    // oldest are flattened the way App does it. Live memory and resident
+    // size should level off rather than grow with the number of items.
+    void soak(int rounds, int itemsPerRound, std::size_t budget)
+    {
+        Document doc;
+        History history;
+        Compactor compactor;
+        std::mt19937 rng(41);
+        const sf::Color palette[] = {sf::Color(211, 211, 211), sf::Color(230, 60, 60), sf::Color(60, 160, 230),
+                                     sf::Color(250, 210, 60), sf::Color(90, 200, 110), sf::Color(30, 30, 30)};
+        std::size_t total = 0, flattened = 0;
+        int compactions = 0;
+        double compactMs = 0.0;
+        std::vector<double> resident;
+        std::vector<Document::Piece> pieces;
+        std::vector<std::uint32_t> placementsUsed, cutsUsed, placementMap, cutMap;
+
+        std::printf("\nsoak, %.0f MB budget:\n%6s %9s %8s %8s %10s %9s %8s\n", budget / 1048576.0, "round", "items",
+                    "live", "live MB", "raster MB", "undo KB", "RSS MB");
+        for (int round = 1; round <= rounds; ++round)
+        {
+            for (int i = 0; i < itemsPerRound; ++i, ++total)
+            {
+                sf::Vector2f p((float)(rng() % 2000), (float)(rng() % 1500));
+                sf::Color color = palette[rng() % 6];
+                std::uint32_t id;
+                switch (i % 4)
+                {
+                    case 0:
+                    {
+                        Stroke stroke;
+                        for (int k = 0; k < 40; ++k)
+                            stroke.addPoint(p + sf::Vector2f(k * 4.f, 25.f * std::sin(k * 0.25f)), 4.f, color);
+                        id = doc.addStroke(stroke);
+                        break;
+                    }
+                    case 1: id = doc.addRectangle(p, sf::Vector2f(10.f + rng() % 80, 10.f + rng() % 80), color); break;
+                    case 2: id = doc.addCircle(p, 4.f + rng() % 40, color); break;
+                    default: id = doc.addTriangle(p, p + sf::Vector2f(40.f, 8.f), p + sf::Vector2f(15.f, 50.f), color);
+                }
+                history.record(History::Entry{History::Op::Add, false, id, 0, 0});
+            }
+            // Move recent items around in steps of a hundred, and erase
+            // across some of the strokes, so placements and cuts pile up.
+            for (int i = 0; i < itemsPerRound / 4; ++i)
+            {
+                std::uint32_t id = (std::uint32_t)(doc.size() - 1 - rng() % std::min<std::size_t>(doc.size(), 5000));
+                sf::Transform move = sf::Transform().translate((float)(rng() % 21) - 10.f, (float)(rng() % 21) - 10.f);
+                std::uint32_t before = doc.place(id, move * doc.getTransform(id));
+                history.record(History::Entry{History::Op::Place, i % 100 != 0, id, before, doc.getPlacement(id)});
+                if (doc.getItem(id).kind != ItemKind::Stroke) continue;
+                const sf::FloatRect& b = doc.getBounds(id);
+                sf::Vector2f top(b.left + (rng() % 100) / 100.f * b.width, b.top - 5.f);
+                if (!doc.eraseAlong(id, top, top + sf::Vector2f(0.f, b.height + 10.f), 3.f, pieces) || pieces.empty())
+                    continue;
+                before = doc.cut(id, pieces.data(), pieces.size());
+                history.record(History::Entry{History::Op::Cut, true, id, before, doc.getCut(id)});
+            }
+
+            std::size_t live = doc.memoryUsage() - doc.getRaster().memoryUsage();
+            if (live > budget)
+            {
+                std::size_t keep = (std::size_t)((double)doc.size() * budget / 2 / live);
+                std::uint32_t count = history.redoFloor((std::uint32_t)(doc.size() - keep));
+                history.forget(count);
+                auto t0 = Clock::now();
+                compactor.run(doc, count);
+                compactMs += millis(t0, Clock::now());
+                history.shift(count);
+                history.collect(History::Op::Place, placementsUsed);
+                history.collect(History::Op::Cut, cutsUsed);
+                doc.compactEdits(placementsUsed, cutsUsed, placementMap, cutMap);
+                history.renumber(History::Op::Place, placementMap);
+                history.renumber(History::Op::Cut, cutMap);
+                flattened += count;
+                ++compactions;
+                live = doc.memoryUsage() - doc.getRaster().memoryUsage();
+            }
+            resident.push_back(residentMegabytes());
+            std::printf("%6d %9zu %8zu %8.1f %10.1f %9.1f %8.1f\n", round, total, doc.size(), live / 1048576.0,
+                        doc.getRaster().memoryUsage() / 1048576.0, history.memoryUsage() / 1024.0, resident.back());
+        }
+        double growth = resident.back() - resident[resident.size() / 2];
+        std::printf("%zu items, %zu flattened in %d compactions (%.0f ms each), RSS %+.1f MB over the second half\n",
+                    total, flattened, compactions, compactions ? compactMs / compactions : 0.0, growth);
+    }
+
+    // Live sharing over loopback: a presenter runs the shapes workload a
+    // dozen clicks per frame, then freehand strokes streamed as they are
+    // drawn, while three viewers follow it, the last joining halfway. Every
+    // viewer must end up with the presenter's document. Also times single
+    // edits from the presenter's frame to a viewer's document.
+    void liveShare(sf::RenderTexture& target)
+    {
+        App presenter;
+        if (!presenter.init(canvasSize) || !presenter.share(0, [] {}))
+        {
+            std::printf("\nlive share: skipped (could not listen)\n");
+            return;
+        }
+        std::vector<std::unique_ptr<App>> viewers;
+        auto join = [&] {
+            auto viewer = std::make_unique<App>();
+            if (viewer->init(canvasSize) && viewer->view("127.0.0.1", presenter.getSharePort(), [] {}))
+                viewers.push_back(std::move(viewer));
+        };
+        auto frame = [&](App& app, const std::vector<sf::Event>& events) {
+            for (const auto& ev : events) app.handleEvent(ev);
+            app.update();
+            app.render(target);
+        };
+        auto follow = [&] {
+            for (auto& viewer : viewers)
+            {
+                if (viewer->needsRender()) frame(*viewer, {});
+            }
+        };
+
+        Trace shapes = shapesTrace(3000), trace;
+        const std::size_t perFrame = 12;
+        for (std::size_t i = 0; i < shapes.size(); i += perFrame)
+        {
+            std::vector<sf::Event> events;
+            for (std::size_t j = i; j < std::min(i + perFrame, shapes.size()); ++j)
+                events.insert(events.end(), shapes[j].begin(), shapes[j].end());
+            trace.push_back(events);
+        }
+        Trace strokes = freehandTrace(20, 30);
+        trace.insert(trace.end(), strokes.begin(), strokes.end());
+
+        join();
+        join();
+        auto t0 = Clock::now();
+        for (std::size_t f = 0; f < trace.size(); ++f)
+        {
+            if (f == trace.size() / 2) join();
+            frame(presenter, trace[f]);
+            follow();
+        }
+        double seconds = millis(t0, Clock::now()) / 1000.0;
+
+        std::vector<std::uint8_t> expected, actual;
+        DocumentFile::write(presenter.getDocument(), 0, expected);
+        std::size_t inSync = 0;
+        auto deadline = Clock::now() + std::chrono::seconds(5);
+        while (inSync < viewers.size() && Clock::now() < deadline)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            follow();
+            inSync = 0;
+            for (auto& viewer : viewers)
+            {
+                actual.clear();
+                DocumentFile::write(viewer->getDocument(), 0, actual);
+                if (actual == expected) ++inSync;
+            }
+        }
+        // Every viewer that joined, the late one too, ends up byte for byte
+        // with the presenter's document.
+        check(viewers.size() == 3 && inSync == viewers.size());
+        std::size_t edits = presenter.getDocument().size();
+        double bytes = (double)presenter.getSharedBytes() / std::max<std::size_t>(1, viewers.size());
+
+        std::vector<double> latencies;
+        if (!viewers.empty())
+        {
+            App& viewer = *viewers.front();
+            Trace select;
+            click(select, rectButton);
+            frame(presenter, select.front());
+            for (int i = 0; i < 100; ++i)
+            {
+                std::size_t before = viewer.getDocument().size();
+                frame(presenter, {mouseEvent(sf::Event::MouseButtonPressed, 100 + i * 8, 300),
+                                  mouseEvent(sf::Event::MouseButtonReleased, 120 + i * 8, 330)});
+                auto s0 = Clock::now();
+                while (viewer.getDocument().size() == before && millis(s0, Clock::now()) < 1000.0)
+                {
+                    if (viewer.needsRender()) frame(viewer, {});
+                    else std::this_thread::yield();
+                }
+                latencies.push_back(millis(s0, Clock::now()));
+            }
+        }
+
+        std::printf("\nlive share: %zu edits in %zu frames (%.0f edits/s), %zu/%zu viewers in sync, "
+                    "%.1f KB per viewer (%.1f bytes/edit, %.1f KB/s at 60 fps), edit latency p50 %.2f ms, "
+                    "p99 %.2f ms\n",
+                    edits, trace.size(), edits / seconds, inSync, viewers.size(), bytes / 1024.0,
+                    bytes / std::max<std::size_t>(1, edits), bytes / 1024.0 / (trace.size() / 60.0),
+                    percentile(latencies, 0.5), percentile(latencies, 0.99));
+    }
+
+    // The button held down mid-stroke with the pointer still: frames only
+    // keep coming until the prediction has gone stale, then the loop idles.
+    void heldStroke(sf::RenderTexture& target)
+    {
+        App app;
+        if (!app.init(canvasSize)) return;
+        auto frame = [&](const std::vector<sf::Event>& events) {
+            for (const auto& ev : events) app.handleEvent(ev);
+            app.update();
+            app.render(target);
+        };
+        Trace trace;
+        click(trace, drawButton);
+        trace.push_back({mouseEvent(sf::Event::MouseButtonPressed, 300, 300)});
+        for (int i = 1; i <= 10; ++i) trace.push_back({mouseEvent(sf::Event::MouseMoved, 300 + i * 6, 300 + i * 2)});
+        for (const auto& events : trace)
+        {
+            frame(events);
+            std::this_thread::sleep_for(std::chrono::milliseconds(8));
+        }
+
+        int frames = 0;
+        auto t0 = Clock::now();
+        while (millis(t0, Clock::now()) < 500.0)
+        {
+            if (app.needsRender())
+            {
+                frame({});
+                ++frames;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(4));
+        }
+        bool idle = !app.needsRender();
+        frame({mouseEvent(sf::Event::MouseButtonReleased, 360, 320)});
+
+        std::printf("\nheld stroke: %d frames in 500 ms with the pointer still, then %s\n", frames,
+                    check(idle && frames <= 20) ? "idle" : "STILL RENDERING");
+    }
+
+    // Event-thread to render-thread hand-off: every command must arrive once
+    // and in order, and the consumer sleeps whenever it catches up.
+    void inputQueue(int commands)
+    {
+        InputQueue queue;
+        sf::Clock clock;
+        std::vector<double> delays;
+        delays.reserve(commands);
+        int received = 0, misordered = 0;
+
+        auto t0 = Clock::now();
+        std::thread consumer([&] {
+            InputCommand command;
+            while (received < commands)
+            {
+                if (!queue.pop(command))
+                {
+                    queue.wait(sf::milliseconds(10));
+                    continue;
+                }
+                if (command.event.mouseMove.x != received) ++misordered;
+                delays.push_back((clock.getElapsedTime() - command.time).asMicroseconds());
+                ++received;
+            }
+        });
+        for (int i = 0; i < commands; ++i)
+        {
+            sf::Event ev;
+            ev.type = sf::Event::MouseMoved;
+            ev.mouseMove.x = i;
+            ev.mouseMove.y = 0;
+            queue.push(InputCommand{ev, clock.getElapsedTime()});
+            // Bursts with pauses, like real input, so the consumer also sleeps.
+            if (i % 4096 == 4095) std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+        consumer.join();
+        double total = millis(t0, Clock::now());
+        check(received == commands && misordered == 0);
+
+        std::printf("\ninput queue: %d commands in %.1f ms (%.1f M/s), %d out of order, "
+                    "hand-off p50 %.1f us, p99 %.1f us\n",
+                    received, total, received / total / 1000.0, misordered, percentile(delays, 0.5),
+                    percentile(delays, 0.99));
+    }
+
+    template <typename F>
+    void micro(const char* name, int reps, F body)
+    {
+        body();
+        auto t0 = Clock::now();
+        for (int i = 0; i < reps; ++i) body();
+        double total = millis(t0, Clock::now());
+        std::printf("%-34s %12.3f us/op\n", name, total * 1000.0 / reps);
+    }
+
+    void microBenchmarks()
+    {
+        std::printf("\n%-34s %18s\n", "micro-benchmark", "time");
+
+        micro("Stroke::addPoint x1000", 200, [] {
+            Stroke stroke;
+            for (int i = 0; i < 1000; ++i)
+                stroke.addPoint(sf::Vector2f(i * 0.7f, 300.f + 80.f * std::sin(i * 0.05f)), 5.f, sf::Color::White);
+            sink = (std::uint32_t)stroke.getVertexCount();
+        });
+
+        micro("HsvToRgb x10000", 100, [] {
+            std::uint32_t acc = 0;
+            for (int i = 0; i < 10000; ++i) acc += HsvToRgb((float)(i % 360), 0.8f, 0.9f).r;
+            sink = acc;
+        });
+
+        micro("getColorFromPosition 150x150", 100, [] {
+            std::uint32_t acc = 0;
+            for (int y = 0; y < 150; ++y)
+                for (int x = 0; x < 150; ++x) acc += getColorFromPosition(x, y, 150, 150).g;
+            sink = acc;
+        });
+
+        std::vector<sf::Uint8> pixels(512 * 512 * 4);
+        micro("ColorSpace::fillGradient 512x512", 50, [&] {
+            ColorSpace::fillGradient(pixels.data(), 512, 512);
+        });
+        micro("ColorSpace::fillSaturationValue", 50, [&] {
+            ColorSpace::fillSaturationValue(pixels.data(), 512, 512, 200.f);
+        });
+
+        Document doc;
+        std::mt19937 rng(5);
+        for (int i = 0; i < 100000; ++i)
+        {
+            sf::Vector2f p((float)(rng() % 8000), (float)(rng() % 8000));
+            if (i % 2) doc.addRectangle(p, sf::Vector2f(5.f + rng() % 40, 5.f + rng() % 40), sf::Color::Red);
+            else doc.addCircle(p, 3.f + rng() % 30, sf::Color::Blue);
+        }
+        micro("Document::pick (100k items)", 10000, [&] {
+            sink = (std::uint32_t)doc.pick(sf::Vector2f((float)(rng() % 8000), (float)(rng() % 8000)));
+        });
+        std::vector<std::uint32_t> ids;
+        micro("Document::query 1024x768 view", 1000, [&] {
+            doc.query(sf::FloatRect((float)(rng() % 7000), (float)(rng() % 7000), 1024.f, 768.f), ids);
+            sink = (std::uint32_t)ids.size();
+        });
+
+        const unsigned w = 3840, h = 2160;
+        std::vector<sf::Uint8> image((std::size_t)w * h * 4, 0);
+        for (std::size_t i = 3; i < image.size(); i += 4) image[i] = 255;
+        FloodFill::Region region;
+        micro("FloodFill full-screen 4K", 10, [&] {
+            FloodFill::fill(image.data(), w, h, w / 2, h / 2, 24, region);
+        });
+
+        // Concentric square walls two pixels apart, each with one gap on
+        // alternating sides, so the fill has to snake through every ring.
+        for (unsigned y = 0; y < h; ++y)
+        {
+            for (unsigned x = 0; x < w; ++x)
+            {
+                unsigned ring = std::min(std::min(x, y), std::min(w - 1 - x, h - 1 - y));
+                bool wall = ring % 3 == 0;
+                bool gap = (ring / 3) % 2 ? (y == h / 2 && x < w / 2) : (y == h / 2 && x > w / 2);
+                image[((std::size_t)y * w + x) * 4] = wall && !gap ? 255 : 0;
+            }
+        }
+        micro("FloodFill spiral maze 4K", 10, [&] {
+            FloodFill::fill(image.data(), w, h, 1, 1, 0, region);
+        });
+        std::printf("spiral fill covered %d x %d px\n", region.bounds.width, region.bounds.height);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    // headlessText() runs a copy of the benchmark as an exporter.
+    if (argc == 4 && std::strcmp(argv[1], "--export") == 0) return exportDocument(argv[2], argv[3]);
+
+    std::string tracePath;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--trace") == 0 && i + 1 < argc) tracePath = argv[++i];
+    }
+
+    sf::RenderTexture target;
+    if (!target.create(canvasSize.x, canvasSize.y))
+    {
+        std::fprintf(stderr, "Failed to create an off-screen render target (is a GL context available?)\n");
+        return 1;
+    }
+
+    coldStart(target);
+    textLayer(target, 3000);
+    std::printf("\n");
+    std::printf("%-10s %7s %8s %8s %8s %8s %9s %10s %8s %9s %8s\n", "scenario", "frames", "p50 ms", "p95 ms",
+                "p99 ms", "max ms", "draws/f", "verts/f", "upl/f", "allocs/f", "items");
+    if (!tracePath.empty())
+    {
+        replay("trace", loadTrace(tracePath), target);
+    }
+    else
+    {
+        replay("freehand", freehandTrace(300, 90), target);
+        replay("shapes", shapesTrace(3000), target);
+        replay("text", textTrace(24, 600), target);
+        replay("bucket", bucketTrace(300), target);
+        replay("navigate", navigateTrace(), target);
+        replay("select", selectTrace(3000), target);
+        replay("erase", eraseTrace(), target);
+    }
+    microBenchmarks();
+    strokeCompression(0.5f);
+    brushGeometry();
+    undoJournal(5000);
+    fileFormat(200000);
+    selectionEdits(target, 100000);
+    exportImage(4.f);
+    headlessText(argv[0]);
+    inputQueue(1 << 20);
+    heldStroke(target);
+    soak(12, 25000, 8u << 20);
+    liveShare(target);
+    if (failed) std::fprintf(stderr, "\nSome checks FAILED\n");
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,134 @@
+// Build-time asset bundler. Packs the toolbar images and a pre-rendered
+// colour wheel into one atlas and writes it, the font and the logo out as
+// AssetBundle.cpp byte arrays. The makefile runs it as
+// `dibujo-bundle AssetBundle.cpp` from the source directory.
+#include <SFML/Graphics/Image.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include "AssetBundle.hpp"
+#include "Color.hpp"
+
+namespace
+{
+    const unsigned atlasWidth = 512;
+    const unsigned wheelDiameter = 40;
+    const unsigned whiteSize = 4;
+    const unsigned labelWidth = 128, labelHeight = 32;
+    // Transparent gap around every sprite so linear filtering never
+    // bleeds a neighbour in.
+    const unsigned padding = 1;
+
+    bool readFile(const std::string& path, std::vector<unsigned char>& bytes)
+    {
+        std::ifstream in(path, std::ios::binary);
+        if (!in) return false;
+        bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        return true;
+    }
+
+    void writeArray(std::FILE* out, const char* name, const unsigned char* data, std::size_t size)
+    {
+        std::fprintf(out, "const unsigned char %s[] = {", name);
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            std::fprintf(out, "%s%u,", i % 24 ? "" : "\n", data[i]);
+        }
+        std::fprintf(out, "\n};\n\n");
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc != 2)
+    {
+        std::fprintf(stderr, "usage: %s AssetBundle.cpp\n", argv[0]);
+        return 2;
+    }
+
+    // In AssetBundle::Sprite order.
+    const char* toolbar[] = {"squares.png", "draw.png", "circle.png", "text.png",
+                             "triangle.png", "rainbow.png", "bucket.png"};
+    std::vector<sf::Image> images(AssetBundle::SpriteCount);
+    for (int i = 0; i < AssetBundle::ColorWheel; ++i)
+    {
+        if (!images[i].loadFromFile(toolbar[i]))
+        {
+            std::fprintf(stderr, "Failed to load %s\n", toolbar[i]);
+            return 1;
+        }
+    }
+    std::vector<sf::Uint8> wheel((std::size_t)wheelDiameter * wheelDiameter * 4);
+    ColorSpace::fillColorWheel(wheel.data(), wheelDiameter);
+    images[AssetBundle::ColorWheel].create(wheelDiameter, wheelDiameter, wheel.data());
+    images[AssetBundle::White].create(whiteSize, whiteSize, sf::Color::White);
+    images[AssetBundle::Label].create(labelWidth, labelHeight, sf::Color::Transparent);
+
+    // Shelf packing in sprite order; there are few enough that it fits.
+    std::vector<sf::IntRect> rects(images.size());
+    unsigned x = padding, y = padding, shelf = 0;
+    for (std::size_t i = 0; i < images.size(); ++i)
+    {
+        sf::Vector2u size = images[i].getSize();
+        if (x + size.x + padding > atlasWidth)
+        {
+            x = padding;
+            y += shelf + padding;
+            shelf = 0;
+        }
+        rects[i] = sf::IntRect((int)x, (int)y, (int)size.x, (int)size.y);
+        x += size.x + padding;
+        shelf = std::max(shelf, size.y);
+    }
+    unsigned atlasHeight = y + shelf + padding;
+
+    sf::Image atlas;
+    atlas.create(atlasWidth, atlasHeight, sf::Color::Transparent);
+    for (std::size_t i = 0; i < images.size(); ++i)
+    {
+        atlas.copy(images[i], (unsigned)rects[i].left, (unsigned)rects[i].top);
+    }
+
+    std::vector<unsigned char> font, logo;
+    if (!readFile("arial.ttf", font) || !readFile("logo.png", logo))
+    {
+        std::fprintf(stderr, "Failed to read arial.ttf or logo.png\n");
+        return 1;
+    }
+
+    std::string temporary = std::string(argv[1]) + ".tmp";
+    std::FILE* out = std::fopen(temporary.c_str(), "w");
+    if (!out)
+    {
+        std::fprintf(stderr, "Failed to create %s\n", temporary.c_str());
+        return 1;
+    }
+    std::fprintf(out, "// Generated by bundle.cpp; do not edit.\n#include \"AssetBundle.hpp\"\n\n");
+    std::fprintf(out, "namespace\n{\n");
+    writeArray(out, "fontData", font.data(), font.size());
+    writeArray(out, "logoData", logo.data(), logo.size());
+    std::fprintf(out, "}\n\nnamespace AssetBundle\n{\n");
+    std::fprintf(out, "const Blob font = {fontData, sizeof fontData};\n");
+    std::fprintf(out, "const Blob logo = {logoData, sizeof logoData};\n");
+    std::fprintf(out, "const unsigned atlasWidth = %u;\nconst unsigned atlasHeight = %u;\n\n", atlasWidth,
+                 atlasHeight);
+    writeArray(out, "atlasPixels", atlas.getPixelsPtr(), (std::size_t)atlasWidth * atlasHeight * 4);
+    std::fprintf(out, "const sf::IntRect sprites[SpriteCount] = {");
+    for (const sf::IntRect& r : rects)
+    {
+        std::fprintf(out, "\n    {%d, %d, %d, %d},", r.left, r.top, r.width, r.height);
+    }
+    std::fprintf(out, "\n};\n}\n");
+    bool ok = std::fflush(out) == 0 && !std::ferror(out);
+    ok = std::fclose(out) == 0 && ok;
+    if (!ok || std::rename(temporary.c_str(), argv[1]) != 0)
+    {
+        std::fprintf(stderr, "Failed to write %s\n", argv[1]);
+        std::remove(temporary.c_str());
+        return 1;
+    }
+    return 0;
+}
@@ -1,535 +1,231 @@
 #include <SFML/Graphics.hpp>
-#include <vector>
-#include <memory>
-#include <cmath>
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
 #include <iostream>
-#include <filesystem>
+#include <memory>
+#include <new>
+#include <thread>
 #include "LogoManager.hpp"
-
-enum class DrawingMode {
-    FreeDraw,
-    Rectangle,
-    Circle,
-    Text,
-    Triangle,
-    Rainbow,
-    PaintBucket
-};
-
-sf::Vector2f normalize(const sf::Vector2f& v) {
-    float length = std::sqrt(v.x*v.x + v.y*v.y);
-    if(length != 0) return sf::Vector2f(v.x/length, v.y/length);
-    return v;
+#include "App.hpp"
+#include "Assets.hpp"
+#include "DocumentFile.hpp"
+#include "Exporter.hpp"
+#include "EventTrace.hpp"
+#include "InputQueue.hpp"
+#include "LatencyStats.hpp"
+#include "Profiler.hpp"
+#include "RenderStats.hpp"
+
+#ifdef DIBUJO_PROFILE
+// Counts live heap bytes for the perf HUD. Each block carries its size in
+// a header that keeps the default new alignment; the array and nothrow
+// forms route through these.
+namespace {
+    const std::size_t heapHeader=__STDCPP_DEFAULT_NEW_ALIGNMENT__;
 }
 
-bool loadFontFromSystem(sf::Font& font, const std::string& fontName) {
-    std::string path = "/System/Library/Fonts/Supplemental/" + fontName;
-    if(std::filesystem::exists(path)) {
-        return font.loadFromFile(path);
-    }
-    return false;
+void* operator new(std::size_t size) {
+    void* block=std::malloc(size+heapHeader);
+    if(!block) throw std::bad_alloc();
+    *static_cast<std::size_t*>(block)=size;
+    Profiler::allocated(size);
+    return static_cast<char*>(block)+heapHeader;
 }
 
-std::shared_ptr<sf::VertexArray> makeThickLineSegment(
-    const sf::Vector2f& start,
-    const sf::Vector2f& end,
-    float thickness,
-    sf::Color color)
-{
-    auto d = normalize(end - start);
-    auto perp = sf::Vector2f(-d.y, d.x)*(thickness*0.5f);
-    sf::Vector2f p1 = start + perp;
-    sf::Vector2f p2 = start - perp;
-    sf::Vector2f p3 = end - perp;
-    sf::Vector2f p4 = end + perp;
-
-    auto quad = std::make_shared<sf::VertexArray>(sf::Quads,4);
-    (*quad)[0] = sf::Vertex(p1,color);
-    (*quad)[1] = sf::Vertex(p2,color);
-    (*quad)[2] = sf::Vertex(p3,color);
-    (*quad)[3] = sf::Vertex(p4,color);
-    return quad;
+void operator delete(void* p) noexcept {
+    if(!p) return;
+    void* block=static_cast<char*>(p)-heapHeader;
+    Profiler::freed(*static_cast<std::size_t*>(block));
+    std::free(block);
 }
 
-sf::Color getColorFromPosition(int x,int y,int w,int h) {
-    float r=(float)x/w*255.f;
-    float g=(float)y/h*255.f;
-    float b=(float)(w-x)/w*255.f;
-    return sf::Color((sf::Uint8)r,(sf::Uint8)g,(sf::Uint8)b);
+void operator delete(void* p, std::size_t) noexcept {
+    operator delete(p);
 }
+#endif
 
-sf::Color HsvToRgb(float H,float S,float V) {
-    float C=S*V;
-    float X=C*(1.f-std::fabs(std::fmod(H/60.f,2.f)-1.f));
-    float m=V-C;
-    float r=0,g=0,b=0;
-    if(H>=0&&H<60){r=C;g=X;}
-    else if(H>=60&&H<120){r=X;g=C;}
-    else if(H>=120&&H<180){g=C;b=X;}
-    else if(H>=180&&H<240){g=X;b=C;}
-    else if(H>=240&&H<300){r=X;b=C;}
-    else{r=C;b=X;}
-    return sf::Color(
-        (sf::Uint8)((r+m)*255),
-        (sf::Uint8)((g+m)*255),
-        (sf::Uint8)((b+m)*255)
-    );
+// Renders a saved document to PNG or SVG without opening a window, so it
+// also works where there is no display to open one on.
+static int exportDocument(const std::string& in, const std::string& out, float scale) {
+    sf::Font font;
+    Document doc;
+    if(Assets::loadFont(font)) doc.setFont(font);
+    else std::cerr<<"Failed to load font, text will be left out.\n";
+
+    std::string error;
+    std::uint32_t generation;
+    if(!DocumentFile::load(doc,in,generation,error)){
+        std::cerr<<"Failed to open "<<in<<": "<<error<<"\n";
+        return 1;
+    }
+    Exporter::Options options;
+    options.scale=scale;
+    sf::Clock clock;
+    if(!Exporter::write(doc,out,options,error)){
+        std::cerr<<"Failed to export "<<out<<": "<<error<<"\n";
+        return 1;
+    }
+    std::cout<<"Exported "<<out<<" in "<<clock.getElapsedTime().asMilliseconds()<<" ms\n";
+    return 0;
 }
 
-std::string getAssetPath(const std::string& name) {
-    using std::filesystem::exists;
-    std::string c = std::filesystem::current_path().string();
-    std::vector<std::string> paths = {
-        c+"/"+name,
-        "/usr/local/share/dibujo/"+name,
-        "/opt/homebrew/share/dibujo/"+name
-    };
-    for(auto& p:paths){
-        if(exists(p)) return p;
+int main(int argc, char** argv) {
+    std::unique_ptr<std::ofstream> trace;
+    std::string documentPath, exportIn, exportOut, viewAddress;
+    float exportScale=1.f;
+    long memoryBudget=0;
+    int sharePort=-1;
+    bool stats=false;
+    for(int i=1;i<argc;i++){
+        if(std::strcmp(argv[i],"--record")==0 && i+1<argc){
+            trace=std::make_unique<std::ofstream>(argv[++i]);
+        }
+        else if(std::strcmp(argv[i],"--export")==0 && i+2<argc){
+            exportIn=argv[++i];
+            exportOut=argv[++i];
+        }
+        else if(std::strcmp(argv[i],"--scale")==0 && i+1<argc){
+            exportScale=(float)std::atof(argv[++i]);
+        }
+        else if(std::strcmp(argv[i],"--stats")==0){
+            stats=true;
+        }
+        else if(std::strcmp(argv[i],"--memory")==0 && i+1<argc){
+            memoryBudget=std::atol(argv[++i]);
+        }
+        else if(std::strcmp(argv[i],"--share")==0 && i+1<argc){
+            sharePort=std::atoi(argv[++i]);
+        }
+        else if(std::strcmp(argv[i],"--view")==0 && i+1<argc){
+            viewAddress=argv[++i];
+        }
+        else if(argv[i][0]!='-'){
+            documentPath=argv[i];
+        }
+    }
+    if(!exportOut.empty()) return exportDocument(exportIn,exportOut,exportScale);
+    if(documentPath.empty()){
+        const char* home=std::getenv("HOME");
+        documentPath=std::string(home?home:".")+"/.dibujo.dib";
     }
-    return "";
-}
 
-int main() {
     sf::RenderWindow window(sf::VideoMode(1024,768),"Dibujo");
     window.setFramerateLimit(60);
 
     //handels logo manager 
-    auto logoPath = getAssetPath("logo.png");
-    LogoManager::setWindowIcon(window, logoPath);
+    LogoManager::setWindowIcon(window);
 
     sf::Cursor arrowCursor, textCursor;
     arrowCursor.loadFromSystem(sf::Cursor::Arrow);
     textCursor.loadFromSystem(sf::Cursor::Text);
     window.setMouseCursor(arrowCursor);
-
-    sf::Font font;
-    if(!font.loadFromFile("arial.ttf") &&
-       !font.loadFromFile("../share/dibujo/arial.ttf") &&
-       !loadFontFromSystem(font,"Arial.ttf"))
-    {
-        std::cerr<<"Failed to load font.\n";
-        return -1;
-    }
-
-    sf::Texture squaresT, drawT, circleT, textT, triangleT, rainbowModeT, bucketT;
-    if(!squaresT.loadFromFile(getAssetPath("squares.png")) ||
-       !drawT.loadFromFile(getAssetPath("draw.png")) ||
-       !circleT.loadFromFile(getAssetPath("circle.png")) ||
-       !textT.loadFromFile(getAssetPath("text.png")) ||
-       !triangleT.loadFromFile(getAssetPath("triangle.png")) ||
-       !rainbowModeT.loadFromFile(getAssetPath("rainbow.png")) ||
-       !bucketT.loadFromFile(getAssetPath("bucket.png")))
-    {
-        std::cerr<<"Failed to load textures.\n";
-        return -1;
+    bool showingText=false;
+
+    App app;
+    if(!app.init(window.getSize())) return -1;
+    if(memoryBudget>0) app.setMemoryBudget((std::size_t)memoryBudget<<20);
+
+    // The main thread only polls the window and forwards stamped events; a
+    // render thread owns the GL context, applies them and draws. A slow
+    // frame or a display() blocked on vsync no longer holds up input, and
+    // strokes are sampled at the times events arrived.
+    InputQueue queue;
+    LatencyStats latency;
+    std::atomic<bool> wantsText(false);
+    std::atomic<std::uint32_t> frame(0);
+
+    // Viewers show someone else's drawing; everyone else opens their own,
+    // and keeps drawing without saving when it can't be opened.
+    auto wake=[&queue]{ queue.notify(); };
+    if(!viewAddress.empty()){
+        std::size_t colon=viewAddress.rfind(':');
+        std::string host=colon==std::string::npos?"127.0.0.1":viewAddress.substr(0,colon);
+        int port=std::atoi(viewAddress.c_str()+(colon==std::string::npos?0:colon+1));
+        if(!app.view(host,(unsigned short)port,wake)) return -1;
+        window.setTitle("Dibujo - "+viewAddress);
     }
-
-    float rainbowRadius=20.f;
-    int diam=(int)(rainbowRadius*2.f);
-    sf::Image rImg;
-    rImg.create(diam,diam,sf::Color::Transparent);
-    for(int y=0;y<diam;y++){
-        for(int x=0;x<diam;x++){
-            float dx=x-rainbowRadius,dy=y-rainbowRadius;
-            float dist=std::sqrt(dx*dx+dy*dy);
-            if(dist<=rainbowRadius){
-                float angle=std::atan2(dy,dx);
-                if(angle<0)angle+=6.2831853f;
-                float hue=angle/(6.2831853f)*360.f;
-                rImg.setPixel(x,y,HsvToRgb(hue,1.f,1.f));
-            }
-        }
+    else{
+        app.open(documentPath);
+        if(sharePort>=0) app.share((unsigned short)sharePort,wake);
     }
-    sf::Texture colorWheelT;
-    colorWheelT.loadFromImage(rImg);
-    sf::CircleShape colorWheel(rainbowRadius);
-    colorWheel.setTexture(&colorWheelT);
-    colorWheel.setPosition(1024-(float)diam-10.f,10.f);
-
-    sf::Color bgc(62,63,63),brush(211,211,211);
-    float thick=5.f;
-    std::vector<sf::Color> bgColors={
-        sf::Color(62,63,63),sf::Color(255,200,200),sf::Color(200,255,200),
-        sf::Color(200,220,255),sf::Color(255,255,200),sf::Color(220,200,255),
-        sf::Color(255,220,200)
-    };
-    int bgIndex=0;
-    std::vector<std::shared_ptr<sf::Drawable>> stack;
-
-    bool isDrawing=false, showPicker=false, isRect=false, isCircle=false,
-         isTyping=false, isTri=false, rainbowModeActive=false;
-    float rainbowHue=0.f;
-
-    int triClicks=0;
-    sf::Vector2f triPts[3];
-    std::vector<std::shared_ptr<sf::Drawable>> stroke;
-    sf::Vector2f lastPos, rectStart, circCenter;
-    std::string typed;
-    sf::Text currText;
-    currText.setFont(font);
-    currText.setCharacterSize(21);
-    currText.setFillColor(brush);
-
-    DrawingMode mode=DrawingMode::FreeDraw;
-
-    sf::RectangleShape bgBtn({100.f,30.f});
-    bgBtn.setFillColor(sf::Color(150,150,150));
-    bgBtn.setPosition(10.f,10.f);
-
-    sf::Text bgLbl("BG color",font,21);
-    bgLbl.setFillColor(sf::Color::Black);
-    bgLbl.setPosition(bgBtn.getPosition().x+(bgBtn.getSize().x-bgLbl.getLocalBounds().width)/2.f,
-                      bgBtn.getPosition().y+(bgBtn.getSize().y-bgLbl.getLocalBounds().height)/2.f-5.f);
-
-    sf::RectangleShape squaresBtn({70.f,30.f});
-    squaresBtn.setTexture(&squaresT);
-    squaresBtn.setPosition(250.f,10.f);
-
-    sf::RectangleShape drawBtn({70.f,30.f});
-    drawBtn.setTexture(&drawT);
-    drawBtn.setPosition(330.f,10.f);
-
-    sf::RectangleShape circleBtn({70.f,30.f});
-    circleBtn.setTexture(&circleT);
-    circleBtn.setPosition(410.f,10.f);
-
-    sf::RectangleShape textBtn({70.f,30.f});
-    textBtn.setTexture(&textT);
-    textBtn.setPosition(490.f,10.f);
-
-    sf::RectangleShape triBtn({70.f,30.f});
-    triBtn.setTexture(&triangleT);
-    triBtn.setPosition(570.f,10.f);
-
-    sf::RectangleShape rainbowModeBtn({70.f,30.f});
-    rainbowModeBtn.setTexture(&rainbowModeT);
-    rainbowModeBtn.setPosition(650.f,10.f);
-
-    sf::RectangleShape bucketBtn({70.f,30.f});
-    bucketBtn.setTexture(&bucketT);
-    bucketBtn.setPosition(730.f,10.f);
-
-    sf::RectangleShape colorPick({150.f,150.f});
-    colorPick.setPosition(10.f,50.f);
-
-    while(window.isOpen()){
-        sf::Event ev;
-        while(window.pollEvent(ev)){
-            if(ev.type==sf::Event::Closed) window.close();
-            else if(ev.type==sf::Event::MouseButtonPressed){
-                if(ev.mouseButton.button==sf::Mouse::Left){
-                    sf::Vector2i mp=sf::Mouse::getPosition(window);
-                    if(bgBtn.getGlobalBounds().contains((float)mp.x,(float)mp.y)){
-                        bgIndex=(bgIndex+1)%bgColors.size();
-                        bgc=bgColors[bgIndex];
-                    }
-                    else if(squaresBtn.getGlobalBounds().contains((float)mp.x,(float)mp.y)){
-                        mode=DrawingMode::Rectangle;
-                    }
-                    else if(drawBtn.getGlobalBounds().contains((float)mp.x,(float)mp.y)){
-                        mode=DrawingMode::FreeDraw;
-                    }
-                    else if(circleBtn.getGlobalBounds().contains((float)mp.x,(float)mp.y)){
-                        mode=DrawingMode::Circle;
-                    }
-                    else if(textBtn.getGlobalBounds().contains((float)mp.x,(float)mp.y)){
-                        mode=DrawingMode::Text;
-                    }
-                    else if(triBtn.getGlobalBounds().contains((float)mp.x,(float)mp.y)){
-                        mode=DrawingMode::Triangle;
-                    }
-                    else if(rainbowModeBtn.getGlobalBounds().contains((float)mp.x,(float)mp.y)){
-                        mode=DrawingMode::Rainbow;
-                        rainbowModeActive=true;
-                    }
-                    else if(bucketBtn.getGlobalBounds().contains((float)mp.x,(float)mp.y)){
-                        mode=DrawingMode::PaintBucket;
-                    }
-                    else if(colorWheel.getGlobalBounds().contains((float)mp.x,(float)mp.y)){
-                        showPicker=!showPicker;
-                    }
-                    else if(showPicker && colorPick.getGlobalBounds().contains((float)mp.x,(float)mp.y)){
-                        int xx=mp.x-(int)colorPick.getPosition().x;
-                        int yy=mp.y-(int)colorPick.getPosition().y;
-                        brush=getColorFromPosition(xx,yy,(int)colorPick.getSize().x,(int)colorPick.getSize().y);
-                        rainbowModeActive=false;
-                        mode=DrawingMode::FreeDraw;
-                    }
-                    else{
-                        if(mode==DrawingMode::Rectangle){
-                            rectStart=sf::Vector2f((float)mp.x,(float)mp.y);
-                            isRect=true;
-                        }
-                        else if(mode==DrawingMode::Circle){
-                            circCenter=sf::Vector2f((float)mp.x,(float)mp.y);
-                            isCircle=true;
-                        }
-                        else if(mode==DrawingMode::Text && !isTyping){
-                            window.setMouseCursor(textCursor);
-                            currText.setPosition((float)mp.x,(float)mp.y);
-                            currText.setFillColor(brush);
-                            typed.clear();
-                            currText.setString("");
-                            isTyping=true;
-                        }
-                        else if(mode==DrawingMode::Triangle){
-                            if(!isTri){
-                                isTri=true;
-                                triClicks=1;
-                                triPts[0]=sf::Vector2f((float)mp.x,(float)mp.y);
-                            }
-                            else{
-                                triClicks++;
-                                triPts[triClicks-1]=sf::Vector2f((float)mp.x,(float)mp.y);
-                                if(triClicks==3){
-                                    if(rainbowModeActive){
-                                        brush=HsvToRgb(rainbowHue,1.f,1.f);
-                                        rainbowHue+=30.f;
-                                        if(rainbowHue>360.f) rainbowHue-=360.f;
-                                    }
-                                    auto tri=std::make_shared<sf::ConvexShape>(3);
-                                    tri->setPoint(0,triPts[0]);
-                                    tri->setPoint(1,triPts[1]);
-                                    tri->setPoint(2,triPts[2]);
-                                    tri->setFillColor(brush);
-                                    stack.push_back(tri);
-                                    isTri=false;
-                                    triClicks=0;
-                                }
-                            }
-                        }
-                        else if(mode==DrawingMode::FreeDraw||mode==DrawingMode::Rainbow){
-                            isDrawing=true;
-                            lastPos=sf::Vector2f((float)mp.x,(float)mp.y);
-                            stroke.clear();
-                        }
-                        else if(mode==DrawingMode::PaintBucket){
-                            bool shapeFound=false;
-                            for(auto it=stack.rbegin(); it!=stack.rend(); ++it){
-                                sf::Drawable* raw=it->get();
-                                if(auto rect=dynamic_cast<sf::RectangleShape*>(raw)){
-                                    if(rect->getGlobalBounds().contains((float)mp.x,(float)mp.y)){
-                                        rect->setFillColor(brush);
-                                        shapeFound=true;
-                                        break;
-                                    }
-                                }
-                                else if(auto circ=dynamic_cast<sf::CircleShape*>(raw)){
-                                    auto pos=circ->getPosition();
-                                    float r=circ->getRadius();
-                                    sf::Vector2f diff((float)mp.x-pos.x,(float)mp.y-pos.y);
-                                    if(std::sqrt(diff.x*diff.x+diff.y*diff.y)<=r){
-                                        circ->setFillColor(brush);
-                                        shapeFound=true;
-                                        break;
-                                    }
-                                }
-                                else if(auto tri=dynamic_cast<sf::ConvexShape*>(raw)){
-                                    auto gb=tri->getGlobalBounds();
-                                    if(gb.contains((float)mp.x,(float)mp.y)){
-                                        tri->setFillColor(brush);
-                                        shapeFound=true;
-                                        break;
-                                    }
-                                }
-                                else if(auto tx=dynamic_cast<sf::Text*>(raw)){
-                                    auto gb=tx->getGlobalBounds();
-                                    if(gb.contains((float)mp.x,(float)mp.y)){
-                                        tx->setFillColor(brush);
-                                        shapeFound=true;
-                                        break;
-                                    }
-                                }
-                                else if(auto va=dynamic_cast<sf::VertexArray*>(raw)){
-                                }
-                            }
-                            if(!shapeFound){
-                                bgc=brush;
-                            }
-                        }
-                    }
-                }
-            }
-            else if(ev.type==sf::Event::MouseButtonReleased){
-                if(ev.mouseButton.button==sf::Mouse::Left){
-                    if(mode==DrawingMode::Rectangle && isRect){
-                        sf::Vector2i mp=sf::Mouse::getPosition(window);
-                        sf::Vector2f ep((float)mp.x,(float)mp.y);
-                        sf::Vector2f sz(std::fabs(ep.x-rectStart.x),std::fabs(ep.y-rectStart.y));
-                        if(rainbowModeActive){
-                            brush=HsvToRgb(rainbowHue,1.f,1.f);
-                            rainbowHue+=30.f;
-                            if(rainbowHue>360.f) rainbowHue-=360.f;
-                        }
-                        auto rect=std::make_shared<sf::RectangleShape>(sz);
-                        rect->setFillColor(brush);
-                        rect->setPosition(std::min(rectStart.x,ep.x),std::min(rectStart.y,ep.y));
-                        stack.push_back(rect);
-                        isRect=false;
-                    }
-                    else if(mode==DrawingMode::Circle && isCircle){
-                        sf::Vector2i mp=sf::Mouse::getPosition(window);
-                        sf::Vector2f ep((float)mp.x,(float)mp.y);
-                        float rad=std::sqrt((ep.x-circCenter.x)*(ep.x-circCenter.x)+(ep.y-circCenter.y)*(ep.y-circCenter.y));
-                        if(rainbowModeActive){
-                            brush=HsvToRgb(rainbowHue,1.f,1.f);
-                            rainbowHue+=30.f;
-                            if(rainbowHue>360.f) rainbowHue-=360.f;
-                        }
-                        auto circ=std::make_shared<sf::CircleShape>(rad);
-                        circ->setFillColor(brush);
-                        circ->setOrigin(rad,rad);
-                        circ->setPosition(circCenter);
-                        stack.push_back(circ);
-                        isCircle=false;
-                    }
-                    else if((mode==DrawingMode::FreeDraw||mode==DrawingMode::Rainbow) && isDrawing){
-                        if(rainbowModeActive){
-                            brush=HsvToRgb(rainbowHue,1.f,1.f);
-                            rainbowHue+=30.f;
-                            if(rainbowHue>360.f) rainbowHue-=360.f;
-                        }
-                        for(auto& quad:stroke){
-                            stack.push_back(quad);
-                        }
-                        stroke.clear();
-                        isDrawing=false;
-                    }
-                    if(mode==DrawingMode::Text) window.setMouseCursor(arrowCursor);
+    window.setActive(false);
+
+    std::thread renderer([&]{
+        window.setActive(true);
+        InputCommand command;
+        while(!queue.isClosed()){
+            std::size_t depth=queue.size();
+            bool consumed=false;
+            sf::Time oldest;
+#ifdef DIBUJO_PROFILE
+            sf::Clock frameClock;
+#endif
+            {
+                DIBUJO_PROFILE_SCOPE("events");
+                while(queue.pop(command)){
+                    if(!consumed) oldest=command.time;
+                    consumed=true;
+                    app.handleEvent(command.event,command.time);
                 }
             }
-            else if(ev.type==sf::Event::TextEntered && isTyping){
-                if(ev.text.unicode=='\b'){
-                    if(!typed.empty()) typed.pop_back();
-                    currText.setString(typed);
-                }
-                else{
-                    if(ev.text.unicode=='\r') typed+='\n';
-                    else typed+=(char)ev.text.unicode;
-                    currText.setString(typed);
-                }
+            wantsText.store(app.wantsTextCursor());
+
+            if(!app.needsRender()){
+                // Nothing changed since the last frame: sleep until input
+                // arrives, or until the next timed animation (the caret
+                // blink) is due.
+                sf::Time wait;
+                if(app.nextAnimation(wait)) queue.wait(std::max(wait,sf::microseconds(1)));
+                else queue.wait();
+                continue;
             }
-            else if(ev.type==sf::Event::KeyPressed){
-                if(isTyping && ev.key.code==sf::Keyboard::Escape){
-                    auto tx=std::make_shared<sf::Text>(currText);
-                    stack.push_back(tx);
-                    isTyping=false;
-                    window.setMouseCursor(arrowCursor);
-                }
-                else if(ev.key.code==sf::Keyboard::C){
-                    stack.clear();
-                }
-                else if(ev.key.code==sf::Keyboard::P){
-                    showPicker=!showPicker;
-                }
-                else if(ev.key.code==sf::Keyboard::B){
-                    bgIndex=(bgIndex+1)%bgColors.size();
-                    bgc=bgColors[bgIndex];
-                }
-                else if(ev.key.code==sf::Keyboard::Up){
-                    thick+=1.f;
-                }
-                else if(ev.key.code==sf::Keyboard::Down){
-                    thick=std::max(1.f,thick-1.f);
-                }
+
+            {
+                DIBUJO_PROFILE_SCOPE("update");
+                app.update();
             }
-        }
-        if(isDrawing && (mode==DrawingMode::FreeDraw||mode==DrawingMode::Rainbow)){
-            sf::Vector2i mp=sf::Mouse::getPosition(window);
-            sf::Vector2f cp((float)mp.x,(float)mp.y);
-            if(cp!=lastPos){
-                auto seg=makeThickLineSegment(lastPos,cp,thick,brush);
-                stroke.push_back(seg);
-                lastPos=cp;
+            RenderStats::reset();
+            {
+                DIBUJO_PROFILE_SCOPE("render");
+                app.render(window);
             }
-        }
-        if(rainbowModeActive && mode==DrawingMode::Rainbow){
-            brush=HsvToRgb(rainbowHue,1.f,1.f);
-            rainbowHue+=0.5f;
-            if(rainbowHue>360.f) rainbowHue-=360.f;
-        }
-        window.clear(bgc);
-        for(auto& d:stack){
-            window.draw(*d);
-        }
-        for(auto& seg:stroke){
-            window.draw(*seg);
-        }
-        if(isTyping){
-            window.draw(currText);
-            static sf::Clock cl;
-            bool vis=((int)(cl.getElapsedTime().asSeconds()/0.5f)%2==0);
-            if(vis){
-                sf::RectangleShape cc(sf::Vector2f(1.f,currText.getCharacterSize()));
-                sf::FloatRect tb=currText.getLocalBounds();
-                cc.setPosition(currText.getPosition().x+tb.width+2.f,currText.getPosition().y);
-                cc.setFillColor(sf::Color::Black);
-                window.draw(cc);
+            {
+                DIBUJO_PROFILE_SCOPE("display");
+                window.display();
             }
-        }
-        if(isTri && triClicks>0 && triClicks<3){
-            sf::Vector2i mp=sf::Mouse::getPosition(window);
-            sf::Vector2f current((float)mp.x,(float)mp.y);
-            int pc=triClicks+1;
-            sf::ConvexShape preview(pc);
-            for(int i=0;i<triClicks;++i){
-                preview.setPoint(i,triPts[i]);
+            if(consumed){
+                latency.add(app.inputTime()-oldest,depth);
+#ifdef DIBUJO_PROFILE
+                Profiler::input(app.inputTime()-oldest,depth);
+#endif
             }
-            preview.setPoint(pc-1,current);
-            preview.setFillColor(sf::Color::Transparent);
-            preview.setOutlineColor(sf::Color::Black);
-            preview.setOutlineThickness(1.f);
-            window.draw(preview);
-        }
-        if(isRect && mode==DrawingMode::Rectangle){
-            sf::Vector2i mp=sf::Mouse::getPosition(window);
-            sf::Vector2f cp((float)mp.x,(float)mp.y);
-            sf::Vector2f topleft(std::min(rectStart.x,cp.x),std::min(rectStart.y,cp.y));
-            sf::Vector2f sz(std::fabs(cp.x-rectStart.x),std::fabs(cp.y-rectStart.y));
-            sf::RectangleShape pr(sz);
-            pr.setPosition(topleft);
-            pr.setFillColor(sf::Color::Transparent);
-            pr.setOutlineColor(sf::Color::Black);
-            pr.setOutlineThickness(1.f);
-            window.draw(pr);
+#ifdef DIBUJO_PROFILE
+            Profiler::frame(frameClock.getElapsedTime());
+#endif
+            frame++;
         }
-        if(isCircle && mode==DrawingMode::Circle){
-            sf::Vector2i mp=sf::Mouse::getPosition(window);
-            sf::Vector2f cp((float)mp.x,(float)mp.y);
-            float rad=std::sqrt((cp.x-circCenter.x)*(cp.x-circCenter.x)+(cp.y-circCenter.y)*(cp.y-circCenter.y));
-            sf::CircleShape c(rad);
-            c.setOrigin(rad,rad);
-            c.setPosition(circCenter);
-            c.setFillColor(sf::Color::Transparent);
-            c.setOutlineColor(sf::Color::Black);
-            c.setOutlineThickness(1.f);
-            window.draw(c);
-        }
-        if(showPicker){
-            sf::Image im;
-            im.create((unsigned int)colorPick.getSize().x,(unsigned int)colorPick.getSize().y);
-            for(unsigned int xx=0;xx<im.getSize().x;xx++){
-                for(unsigned int yy=0;yy<im.getSize().y;yy++){
-                    im.setPixel(xx,yy,getColorFromPosition(xx,yy,im.getSize().x,im.getSize().y));
-                }
-            }
-            sf::Texture ctex;
-            ctex.loadFromImage(im);
-            colorPick.setTexture(&ctex);
-            window.draw(colorPick);
+        window.setActive(false);
+    });
+
+    sf::Event ev;
+    while(window.waitEvent(ev)){
+        if(ev.type==sf::Event::Closed) break;
+        DIBUJO_PROFILE_SCOPE("poll");
+        if(trace) EventTrace::write(*trace,frame.load(),ev);
+        queue.push(InputCommand{ev,app.inputTime()});
+
+        if(wantsText.load()!=showingText){
+            showingText=wantsText.load();
+            window.setMouseCursor(showingText?textCursor:arrowCursor);
         }
-        window.draw(bgBtn);
-        window.draw(bgLbl);
-        window.draw(squaresBtn);
-        window.draw(drawBtn);
-        window.draw(circleBtn);
-        window.draw(textBtn);
-        window.draw(triBtn);
-        window.draw(rainbowModeBtn);
-        window.draw(bucketBtn);
-        window.draw(colorWheel);
-        window.display();
     }
+    queue.close();
+    renderer.join();
+    window.close();
+    app.close();
+    if(stats) latency.print(std::cout);
     return 0;
 }